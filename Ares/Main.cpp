@@ -13,15 +13,18 @@
 #include <assimp/postprocess.h>
 
 #include <iostream>
+#include <memory>
 #include <sstream>
 
 using namespace glh;
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void processInput(GLFWwindow *window);
 void renderScene();
 //void renderSphere();
+unsigned int getQuadVAO();
 void renderQuad();
 void renderBentQuad();
 unsigned int loadTexture(const char *path);
@@ -36,8 +39,25 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
+// scene used for ray queries (picking, line of sight)
+App::Scene scene;
 
 
+
+// which of the tree rendering paths is used
+// TREES_VISIBILITY rasterises the indirect list into a visibility buffer and shades it in one resolve pass
+enum TreeRenderPath { TREES_QUEUED, TREES_INSTANCED, TREES_INDIRECT, TREES_VISIBILITY };
+const TreeRenderPath treeRenderPath = TREES_QUEUED;
+// lay down depth with position-only draws first so the PBR shaders run once per pixel,
+// compare the logged pre-pass and shading times with it on and off to pick per scene
+const bool depthPrepass = true;
+// forward shades every draw with the sun and its cluster's scene point lights, deferred writes a
+// G-buffer and shades each pixel once with the sun and its tile's point lights
+enum ShadingPath { FORWARD_SHADING, DEFERRED_SHADING };
+const ShadingPath shadingPath = FORWARD_SHADING;
+// prefiltered EVSM soft sun shadows instead of 3x3 PCF, the blur radius doesn't change the lighting cost
+const bool softShadows = true;
+
 // timing
 float deltaTime = 0.0f;
 
@@ -71,6 +91,7 @@ int main(int argc, char *argv[])
 
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
 
 	// tell GLFW to capture our mouse
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -82,55 +103,68 @@ int main(int argc, char *argv[])
 		Util::Log::WriteError("Failed to initialize GLAD");
 		return -1;
 	}
+	Graphics::GLExtensions::Load();
 
 	// configure global opengl state
 	// -----------------------------
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	Graphics::GLState::SetDepthTest(true);
+	Graphics::GLState::SetCullFace(true);
 	glFrontFace(GL_CCW);
 
+	// every material of the PBR programs has these parameters, the shaders include their declaration
+	Graphics::MaterialSchema pbrSchema;
+	pbrSchema.Add("heightScale", 0.0f);
+	pbrSchema.Add("coneSteps", 12);
+	pbrSchema.Add("binarySteps", 6);
+	Graphics::Shader::SetIncludeSource("MaterialParameters.glsl", pbrSchema.GetDeclaration());
+
 	// build and compile shaders
 	// -------------------------
 	Graphics::Shader pbrShader("Data/Shaders/pbr.vs", "Data/Shaders/pbr.fs");
 	Graphics::Shader simpleDepthShader("Data/Shaders/simpleDepth.vs", "Data/Shaders/simpleDepth.fs");
 	Graphics::Shader instanceShader("Data/Shaders/Instanced.vs", "Data/Shaders/Instanced.fs");
+	Graphics::Shader indirectShader("Data/Shaders/indirect.vs", "Data/Shaders/pbrarray.fs");
+	Graphics::Shader reliefShader("Data/Shaders/pbr.vs", "Data/Shaders/pbrrelief.fs");
+	Graphics::Shader depthPrepassShader("Data/Shaders/depthPrepass.vs", "Data/Shaders/simpleDepth.fs");
+	Graphics::Shader indirectDepthShader("Data/Shaders/indirectDepth.vs", "Data/Shaders/simpleDepth.fs");
 
 
-	pbrShader.use();
-	pbrShader.setInt("albedoMap", 0);
-	pbrShader.setInt("normalMap", 1);
-	pbrShader.setInt("metallicMap", 2);
-	pbrShader.setInt("roughnessMap", 3);
-	pbrShader.setInt("aoMap", 4);
-	pbrShader.setInt("depthMap", 5);
-
 	instanceShader.use();
 	instanceShader.setInt("albedoMap", 0);
 	instanceShader.setInt("normalMap", 1);
-	instanceShader.setInt("metallicMap", 2);
-	instanceShader.setInt("roughnessMap", 3);
-	instanceShader.setInt("aoMap", 4);
-	instanceShader.setInt("depthMap", 5);
+	instanceShader.setInt("ormMap", 2);
+
+	indirectShader.use();
+	indirectShader.setInt("albedoMaps", 0);
+	indirectShader.setInt("normalMaps", 1);
+	indirectShader.setInt("ormMaps", 2);
 
 	// load PBR material textures
 	// --------------------------
 	unsigned int albedo = loadTexture("Data/Textures/PBR/rocky_dirt/albedo.png");
 	unsigned int normal = loadTexture("Data/Textures/PBR/rocky_dirt/normal.png");
-	unsigned int metallic = loadTexture("Data/Textures/PBR/rocky_dirt/metallic.png");
-	unsigned int roughness = loadTexture("Data/Textures/PBR/rocky_dirt/roughness.png");
-	unsigned int ao = loadTexture("Data/Textures/PBR/rocky_dirt/ao.png");
-	unsigned int depth = loadTexture("Data/Textures/PBR/rocky_dirt/depth.png");
+	// ao, roughness, metallic and depth packed into one texture
+	unsigned int orm = Graphics::TexturePacker::LoadORM("Data/Textures/PBR/rocky_dirt");
+	// the relaxed cones take a while to compute, so they're cached next to the depth map until it changes
+	Graphics::ReliefMap groundRelief;
+	if (!groundRelief.Load("Data/Textures/PBR/rocky_dirt/depth.relief", "Data/Textures/PBR/rocky_dirt/depth.png")) {
+		if (groundRelief.Generate("Data/Textures/PBR/rocky_dirt/depth.png"))
+			groundRelief.Save("Data/Textures/PBR/rocky_dirt/depth.relief");
+	}
+	unsigned int relief = groundRelief.Upload();
 
 	// pbr setup
-	pbrShader.use();
-	pbrShader.setVec3("albedo", 0.5f, 0.0f, 0.0f);
-	pbrShader.setFloat("ao", 1.0f);
-	pbrShader.setFloat("heightScale", 0.1f);
-
-	instanceShader.use();
-	instanceShader.setVec3("albedo", 0.5f, 0.0f, 0.0f);
-	instanceShader.setFloat("ao", 1.0f);
-	instanceShader.setFloat("heightScale", 0.0f);
+	Graphics::MaterialTable materials(&pbrSchema);
+	// materials with a relief map are drawn with cone stepping, the rest with the layered parallax search
+	materials.SetProgram(0, &pbrShader);
+	materials.SetProgram(1u << Graphics::Material::RELIEF_SLOT, &reliefShader);
+
+	// the forward shaders add the scene point lights of their fragment's cluster
+	Graphics::LightGrid lightGrid(SCR_WIDTH, SCR_HEIGHT);
+	lightGrid.SetupProgram(&pbrShader);
+	lightGrid.SetupProgram(&reliefShader);
+	lightGrid.SetupProgram(&instanceShader);
+	lightGrid.SetupProgram(&indirectShader);
 
 	// lights
 	// ------
@@ -140,6 +174,32 @@ int main(int argc, char *argv[])
 	glm::vec3 lightColors[] = {
 		glm::vec3(400.0f, 400.0f, 400.0f),
 	};
+	const unsigned int lightCount = sizeof(lightPositions) / sizeof(lightPositions[0]);
+	// the sun the forward shaders light with and the cascades shadow, the way its light travels.
+	// It comes from where the point light above rests.
+	const glm::vec3 sunDirection = glm::normalize(glm::vec3(0.0f, -5.0f, -1.0f));
+
+	// small coloured lights scattered through the forest, culled into clusters for the forward
+	// shaders and into screen tiles for the deferred path
+	std::vector<Graphics::PointLight> sceneLights(512);
+	for (Graphics::PointLight& light : sceneLights) {
+		light.Position = glm::vec3(glm::linearRand(-12.0f, 12.0f), glm::linearRand(0.2f, 3.0f), glm::linearRand(-12.0f, 12.0f));
+		light.Range = glm::linearRand(2.0f, 5.0f);
+		light.Color = glm::vec3(glm::linearRand(0.2f, 1.0f), glm::linearRand(0.2f, 1.0f), glm::linearRand(0.2f, 1.0f));
+		light.Intensity = 4.0f;
+	}
+	// a few of them sway like the main light, so their shadow cubes have to keep up
+	const unsigned int swayingLights = 4;
+	std::vector<glm::vec3> swayOrigins(swayingLights);
+	for (unsigned int i = 0; i < swayingLights; i++)
+		swayOrigins[i] = sceneLights[i].Position;
+
+	// per frame data shared by every program through uniform blocks, streamed through a ring buffer
+	Graphics::UniformRing uniformRing;
+	uniformRing.Create(256 * 1024);
+	Graphics::FrameBlock frameBlock;
+	Graphics::ViewBlock viewBlock;
+	Graphics::LightBlock lightBlock;
 	int nrRows = 0;
 	int nrColumns = 0;
 	float spacing = 2.5;
@@ -150,7 +210,18 @@ int main(int argc, char *argv[])
 
 	// load models
 	// -----------
-	Graphics::Skybox skyboxObject = Graphics::Skybox("OceanIslands");
+	Graphics::Skybox skyboxObject("OceanIslands");
+	// the ambient light of the forward shaders, integrated from the skybox once and cached next to it
+	Graphics::ImageBasedLighting environment;
+	if (!environment.Load("Data/Skyboxes/OceanIslands/environment.ibl", "OceanIslands")) {
+		if (environment.Generate("OceanIslands"))
+			environment.Save("Data/Skyboxes/OceanIslands/environment.ibl");
+	}
+	environment.Upload();
+	environment.SetupProgram(&pbrShader);
+	environment.SetupProgram(&reliefShader);
+	environment.SetupProgram(&instanceShader);
+	environment.SetupProgram(&indirectShader);
 	
 	// framebuffer
 	Graphics::Framebuffer frameBuffer(SCR_WIDTH, SCR_HEIGHT);
@@ -172,6 +243,8 @@ int main(int argc, char *argv[])
 	//Model pineTree = Model("Data/Models/rock/rock.obj", "jpg");
 	//pineTree.LoadTextures(Model::ALBEDO | Model::METALLIC | Model::NORMAL | Model::ROUGHNESS);
 	pineTree.LoadTextures(Graphics::Model::ALBEDO);
+	// depth and shadow passes read a 12 byte position stream instead of the 56 byte vertices
+	pineTree.CreateDepthStream();
 	
 	const unsigned int amount = 10;
 	glm::vec3 positions[amount];
@@ -184,65 +257,166 @@ int main(int argc, char *argv[])
 	// generate a large list of semi-random model transformation matrices
 	// ------------------------------------------------------------------
 
-	glm::mat4* modelMatrices;
-	modelMatrices = new glm::mat4[amount];
-	srand((int) glfwGetTime()); // initialize random seed	
-	float radius = 150.0;
-	float offset = 25.0f;
-	for (unsigned int i = 0; i < amount; i++)
-	{
+	// register the trees with the scene so they can be picked
+	uint32_t pineTreeMesh;
+	App::AddMesh(scene, &pineTree, &pineTreeMesh);
+	glm::mat4 treeTransforms[amount];
+	for (int i = 0; i < amount; i++) {
 		glm::mat4 model;
-
-		glm::vec3 pos = glm::vec3(glm::linearRand(-10.0f, 10.0f), 2, glm::linearRand(-10.0f, 10.0f));
-		
-		model = glm::translate(model, pos);
+		model = glm::translate(model, positions[i]);
 		model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-		model = glm::rotate(model, -1.57f, glm::vec3(1, 0, 0));
+		model = glm::rotate(model, rotations[i].x, glm::vec3(1, 0, 0));
 
-		modelMatrices[i] = model;
+		uint32_t instance;
+		App::AddInstance(scene, pineTreeMesh, &instance);
+		App::SetInstanceTransform(scene, instance, model);
+		treeTransforms[i] = model;
+	}
+	App::BuildInstanceBVH(scene);
+
+	// the trees never move, so which of them can be seen from where is baked once and cached
+	App::PotentiallyVisibleSet::BakeSettings pvsSettings;
+	pvsSettings.Bounds.Grow(glm::vec3(-50.0f, 0.0f, -50.0f));
+	pvsSettings.Bounds.Grow(glm::vec3(50.0f, 10.0f, 50.0f));
+	pvsSettings.CellSize = 5.0f;
+	App::PotentiallyVisibleSet pvs;
+	if (!pvs.Load("Data/forest.pvs", scene, pvsSettings)) {
+		pvs.Bake(scene, pvsSettings);
+		pvs.Save("Data/forest.pvs");
 	}
 
-	// configure instanced array
-	// -------------------------
-	unsigned int instancedBuffer;
-	glGenBuffers(1, &instancedBuffer);
-	
-
-	// set transformation matrices as an instance vertex attribute (with divisor 1)
-	// note: we're cheating a little by taking the, now publicly declared, VAO of the model's mesh(es) and adding new vertexAttribPointers
-	// normally you'd want to do this in a more organized fashion, but for learning purposes this will do.
-	// -----------------------------------------------------------------------------------------------------------------------------------
-	unsigned int VAO = pineTree.getVAO();
-	glBindVertexArray(VAO);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, instancedBuffer);
-	glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-	// set attribute pointers for matrix (4 times vec4)
-	glEnableVertexAttribArray(5);
-	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-	glEnableVertexAttribArray(6);
-	glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-	glEnableVertexAttribArray(7);
-	glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-	glEnableVertexAttribArray(8);
-	glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
-	
-	glVertexAttribDivisor(5, 1);
-	glVertexAttribDivisor(6, 1);
-	glVertexAttribDivisor(7, 1);
-	glVertexAttribDivisor(8, 1);
-
-	glBindVertexArray(0);
-
-
-
-
+	// the same trees drawn with one instanced draw call
+	Graphics::InstanceBatch treeBatch(&pineTree, amount);
+	for (unsigned int i = 0; i < amount; i++)
+		treeBatch.Add(treeTransforms[i]);
+
+
+
+
+
+	// trigger volumes: the trees and the player, reported when the player walks into a tree
+	Graphics::Broadphase broadphase;
+	for (uint32_t i = 0; i < App::GetInstanceCount(scene); i++)
+		broadphase.AddProxy(App::GetInstanceBounds(scene, i), i);
+	Graphics::Entity player;
+	player.SetSize(0.5f, 1.8f, 0.5f);
+	uint32_t playerProxy = broadphase.AddProxy(player.GetBounds());
+
+	// static meshes drawn through multi draw indirect share one geometry heap
+	Graphics::GeometryHeap geometryHeap;
+	unsigned int heapTreeMesh = geometryHeap.AddMesh(pineTree);
+	geometryHeap.EnableDepthStream();
+	Graphics::IndirectDrawList indirectDraws(&geometryHeap);
+	Graphics::VisibilityBuffer visibilityBuffer(SCR_WIDTH, SCR_HEIGHT);
+
+	// draws are collected into a render queue and sorted by state before being issued
+	Graphics::RenderQueue renderQueue;
+	renderQueue.SetUniformRing(&uniformRing);
+	renderQueue.SetDepthRange(0.1f, 100.0f);
+	renderQueue.SetMaterialTable(&materials);
+	renderQueue.SetDepthPrepass(depthPrepass ? &depthPrepassShader : nullptr);
+	Graphics::Material groundMaterial(&pbrSchema);
+	groundMaterial.SetTexture(Graphics::Material::ALBEDO_SLOT, albedo);
+	groundMaterial.SetTexture(Graphics::Material::NORMAL_SLOT, normal);
+	groundMaterial.SetTexture(Graphics::Material::ORM_SLOT, orm);
+	groundMaterial.SetTexture(Graphics::Material::RELIEF_SLOT, relief);
+	groundMaterial.Set("heightScale", 0.1f);
+	groundMaterial.Set("coneSteps", 12);
+	groundMaterial.Set("binarySteps", 6);
+	uint16_t groundMaterialID = materials.Add(groundMaterial);
+	uint16_t treeMaterialID = materials.Add(pineTree.GetMaterial(&pbrSchema));
+	Graphics::Shader* groundProgram = materials.GetProgram(groundMaterialID);
+	Graphics::Shader* treeProgram = materials.GetProgram(treeMaterialID);
+	// the instanced trees read their parameters from the table too
+	instanceShader.use();
+	instanceShader.Set(instanceShader.GetUniform<int>("materialIndex"), (int)treeMaterialID);
+
+	// materials of the indirect path live in texture arrays, so mixing them costs no rebinds.
+	// Their parameters come from the table, the trees' from the same entry as on the forward path.
+	Graphics::TexturePool materialPool(1024);
+	unsigned int treePoolMaterial = materialPool.AddMaterial("Data/Models/tree");
+	materialPool.SetParameters(treePoolMaterial, treeMaterialID);
+	// the ground materials for other heap meshes, with the ground's parallax depth
+	for (const char* directory : { "Data/Textures/PBR/rocky_dirt", "Data/Textures/PBR/slate2", "Data/Textures/PBR/octostone" })
+		materialPool.SetParameters(materialPool.AddMaterial(directory), groundMaterialID);
+	materialPool.Build();
 
 	camera.SetMovementSpeed(1.0f);
 	camera.SetPosition(0.0f, 1.8f, 4.0f);
 
-	Graphics::LightBuffer lightMap = Graphics::LightBuffer();
+	// sun shadows for the forward shaders, the trees and the ground never move so the far cascades
+	// stay cached until the camera walks out of them
+	Graphics::LightBuffer lightMap;
+	lightMap.SetupProgram(&pbrShader);
+	lightMap.SetupProgram(&reliefShader);
+	lightMap.SetupProgram(&instanceShader);
+	lightMap.SetupProgram(&indirectShader);
+	if (softShadows) {
+		lightMap.SetFilter(Graphics::LightBuffer::EVSM_FILTER);
+		lightMap.SetBlurRadius(4);
+	}
+	// cube shadows for the scene point lights that matter most from where the camera is
+	Graphics::PointShadowAtlas pointShadows;
+	pointShadows.SetupProgram(&pbrShader);
+	pointShadows.SetupProgram(&reliefShader);
+	pointShadows.SetupProgram(&instanceShader);
+	pointShadows.SetupProgram(&indirectShader);
+	Graphics::ShadowCaster groundCaster;
+	groundCaster.VAO = getQuadVAO();
+	groundCaster.Count = 6;
+	groundCaster.Indexed = false;
+	groundCaster.Bounds.Grow(glm::vec3(-50.0f, 0.0f, -50.0f));
+	groundCaster.Bounds.Grow(glm::vec3(50.0f, 0.0f, 50.0f));
+	lightMap.AddCaster(groundCaster);
+	pointShadows.AddCaster(groundCaster);
+	for (int i = 0; i < amount; i++) {
+		Graphics::ShadowCaster treeCaster;
+		treeCaster.VAO = pineTree.GetDepthVAO();
+		treeCaster.Count = pineTree.GetIndexCount();
+		treeCaster.Model = treeTransforms[i];
+		treeCaster.Bounds = pineTree.GetBVH().GetBounds();
+		lightMap.AddCaster(treeCaster);
+		pointShadows.AddCaster(treeCaster);
+	}
+	// indirect diffuse light through the forest, traced against the trees once and cached
+	App::IrradianceVolume::BakeSettings probeSettings;
+	probeSettings.Bounds.Grow(glm::vec3(-14.0f, 0.25f, -14.0f));
+	probeSettings.Bounds.Grow(glm::vec3(14.0f, 8.0f, 14.0f));
+	probeSettings.Spacing = 2.0f;
+	// without a skybox the probes see the default sky color
+	probeSettings.Sky = environment.IsEmpty() ? nullptr : &environment;
+	probeSettings.SunDirection = sunDirection;
+	probeSettings.HasGround = true;
+	App::IrradianceVolume probes;
+	if (!probes.Load("Data/forest.probes", scene, probeSettings)) {
+		probes.Bake(scene, probeSettings);
+		probes.Save("Data/forest.probes");
+	}
+	probes.Upload();
+	probes.SetupProgram(&pbrShader);
+	probes.SetupProgram(&reliefShader);
+	probes.SetupProgram(&instanceShader);
+	probes.SetupProgram(&indirectShader);
+
+	// the visibility buffer's resolve lights its pixels exactly like the forward shaders
+	Graphics::Shader* resolveProgram = visibilityBuffer.GetResolveProgram();
+	lightGrid.SetupProgram(resolveProgram);
+	lightMap.SetupProgram(resolveProgram);
+	pointShadows.SetupProgram(resolveProgram);
+	environment.SetupProgram(resolveProgram);
+	probes.SetupProgram(resolveProgram);
+
+	// the G-buffer and the lighting pass only exist on the deferred path, whose lighting reads
+	// the same shadows and ambient light as the forward shaders
+	std::unique_ptr<Graphics::DeferredRenderer> deferredRenderer;
+	if (shadingPath == DEFERRED_SHADING) {
+		deferredRenderer.reset(new Graphics::DeferredRenderer(SCR_WIDTH, SCR_HEIGHT));
+		Graphics::Shader* lightingProgram = deferredRenderer->GetLightingProgram();
+		lightMap.SetupProgram(lightingProgram);
+		pointShadows.SetupProgram(lightingProgram);
+		environment.SetupProgram(lightingProgram);
+		probes.SetupProgram(lightingProgram);
+	}
 
 
 
@@ -265,6 +439,49 @@ int main(int argc, char *argv[])
 		if (currentTime - lastLog >= 1.0f) {
 			lastLog += 1.0f;
 			Util::Log::Write(Util::Log::LOG_DEBUG, ("FPS: " + std::to_string(frames) + " (" + std::to_string(1000.0/frames) + " ms)"));
+			const Graphics::RenderQueue::Stats& queueStats = renderQueue.GetStats();
+			Util::Log::WriteDebug("Render queue: " + std::to_string(queueStats.Draws) + " draws, " +
+				std::to_string(queueStats.ProgramChanges) + " program changes, " +
+				std::to_string(queueStats.MaterialChanges) + " material changes, " +
+				std::to_string(queueStats.TextureBinds) + " texture binds, " +
+				std::to_string(queueStats.VAOChanges) + " VAO changes");
+			Util::Log::WriteDebug("Render queue GPU time: " + std::to_string(queueStats.PrepassMilliseconds) + " ms pre-pass (" +
+				std::to_string(queueStats.PrepassDraws) + " draws), " + std::to_string(queueStats.ShadingMilliseconds) + " ms shading");
+			const Graphics::LightGrid::Stats& gridStats = lightGrid.GetStats();
+			Util::Log::WriteDebug("Light grid: " + std::to_string(gridStats.Lights) + " lights, " +
+				std::to_string(gridStats.ClusterLightReferences) + " cluster references (" + std::to_string(gridStats.MaxClusterLights) +
+				" max), " + std::to_string(gridStats.BuildMilliseconds) + " ms build");
+			const Graphics::LightBuffer::Stats& shadowStats = lightMap.GetStats();
+			Util::Log::WriteDebug("Shadows: " + std::to_string(shadowStats.RenderedCascades) + "/" +
+				std::to_string(Graphics::LightBuffer::CASCADE_COUNT) + " cascades drawn, " + std::to_string(shadowStats.CasterDraws) + "/" +
+				std::to_string(shadowStats.Casters) + " caster draws, " + std::to_string(shadowStats.CullMilliseconds) + " ms culling, " +
+				std::to_string(shadowStats.RenderMilliseconds) + " ms GPU, " + std::to_string(shadowStats.FilterMilliseconds) + " ms filtering");
+			const Graphics::PointShadowAtlas::Stats& pointShadowStats = pointShadows.GetStats();
+			Util::Log::WriteDebug("Point shadows: " + std::to_string(pointShadowStats.ShadowedLights) + " lights, " +
+				std::to_string(pointShadowStats.UpdatedLights) + " cubes drawn (" + std::to_string(pointShadowStats.PendingLights) + " waiting), " +
+				std::to_string(pointShadowStats.CasterDraws) + " caster draws into " + std::to_string(pointShadowStats.FaceDraws) + " faces, " +
+				std::to_string(pointShadowStats.RenderMilliseconds) + " ms GPU");
+			if (shadingPath == DEFERRED_SHADING) {
+				const Graphics::DeferredRenderer::Stats& deferredStats = deferredRenderer->GetStats();
+				Util::Log::WriteDebug("Deferred: " + std::to_string(deferredStats.VisibleLights) + "/" + std::to_string(deferredStats.Lights) +
+					" lights visible, " + std::to_string(deferredStats.TileLightReferences) + " tile references (" +
+					std::to_string(deferredStats.MaxTileLights) + " max), " + std::to_string(deferredStats.CullMilliseconds) + " ms culling, " +
+					std::to_string(deferredStats.LightingMilliseconds) + " ms GPU lighting");
+			}
+			if (treeRenderPath == TREES_VISIBILITY) {
+				const Graphics::VisibilityBuffer::Stats& visibilityStats = visibilityBuffer.GetStats();
+				Util::Log::WriteDebug("Visibility buffer: " + std::to_string(visibilityStats.Objects) + " objects, " +
+					std::to_string(visibilityStats.RasterMilliseconds) + " ms raster, " +
+					std::to_string(visibilityStats.ResolveMilliseconds) + " ms resolve");
+			}
+			const Graphics::GLState::Counters& stateCounters = Graphics::GLState::GetLastFrameCounters();
+			Util::Log::WriteDebug("GL state: " + std::to_string(stateCounters.Issued) + " calls issued, " +
+				std::to_string(stateCounters.Filtered) + " filtered");
+			if (treeRenderPath == TREES_INDIRECT) {
+				const Graphics::IndirectDrawList::Stats& indirectStats = indirectDraws.GetStats();
+				Util::Log::WriteDebug("Indirect: " + std::to_string(indirectStats.Objects) + " objects in " +
+					std::to_string(indirectStats.Commands) + " commands, " + std::to_string(indirectStats.APICalls) + " API calls");
+			}
 			frames = 0;
 		}
 		frames++;
@@ -273,31 +490,26 @@ int main(int argc, char *argv[])
 		// -----
 		processInput(window);
 
+		player.SetTranslation(camera.Position.x, camera.Position.y - 0.9f, camera.Position.z);
+		broadphase.UpdateProxy(playerProxy, player.GetBounds());
+		broadphase.Update();
+		for (const Graphics::Broadphase::Pair& pair : broadphase.GetAddedPairs()) {
+			if (pair.A == playerProxy || pair.B == playerProxy)
+				Util::Log::WriteDebug("Entered tree " + std::to_string(broadphase.GetUserData(pair.A == playerProxy ? pair.B : pair.A)));
+		}
+		for (const Graphics::Broadphase::Pair& pair : broadphase.GetRemovedPairs()) {
+			if (pair.A == playerProxy || pair.B == playerProxy)
+				Util::Log::WriteDebug("Left tree " + std::to_string(broadphase.GetUserData(pair.A == playerProxy ? pair.B : pair.A)));
+		}
+
 		// rendering passes
 		// ------
 		
-		/*
 		/////////////////////////////////////////////////////////////
 		// 1. First, render the scene to the depth map for shadows
-		simpleDepthShader.use();
-		
-		glViewport(0, 0, lightMap.GetShadowBufferWidth(), lightMap.GetShadowBufferHeight());
-		lightMap.Bind();
-
-		// configure shader and matrices
-		float near_plane = 1.0f, far_plane = 7.5f;
-		glm::mat4 lightProjection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
-		glm::mat4 lightView = glm::lookAt(	glm::vec3(-2.0f, 4.0f, -1.0f),
-											glm::vec3(0.0f, 0.0f, 0.0f),
-											glm::vec3(0.0f, 1.0f, 0.0f));
-		glm::mat4 lightSpaceMatrix = lightProjection * lightView;
-
-		simpleDepthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-
-		//RenderScene();
-
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);*/
+		// only the cascades whose region or casters changed are drawn again
+		view = camera.GetViewMatrix();
+		lightMap.Render(view, projection, sunDirection);
 
 
 
@@ -313,65 +525,113 @@ int main(int argc, char *argv[])
 		glClearColor(0.1f, 0.1f, 1.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		
-		view = camera.GetViewMatrix();
-		pbrShader.use();
-		pbrShader.setMat4("projection", projection);
-		pbrShader.setMat4("view", view);
-		pbrShader.setVec3("camPos", camera.Position);
-		pbrShader.setVec3("viewPos", camera.Position);
-		pbrShader.setVec3("lightPos", lightPositions[0]);
+		pvs.SetViewPosition(camera.Position);
+		uniformRing.BeginFrame();
+		frameBlock.Time = currentTime;
+		frameBlock.DeltaTime = deltaTime;
+		viewBlock.Projection = projection;
+		viewBlock.View = view;
+		viewBlock.ViewPosition = glm::vec4(camera.Position, 1.0f);
+		lightBlock.LightPosition = glm::vec4(lightPositions[0], 1.0f);
+		lightBlock.LightCount = lightCount;
 
 		glm::mat4 model;
 
 		// render light source (simply re-render sphere at light positions)
 		// this looks a bit off as we use the same shader, but it'll make their positions obvious and 
 		// keeps the codeprint small.
-		for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+		for (unsigned int i = 0; i < lightCount; ++i)
 		{
 			glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
-			pbrShader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-			pbrShader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
-			pbrShader.setVec3("lightPos", newPos);
+			lightBlock.LightPositions[i] = glm::vec4(newPos, 1.0f);
+			lightBlock.LightColors[i] = glm::vec4(lightColors[i], 1.0f);
+			lightBlock.LightPosition = glm::vec4(newPos, 1.0f);
 
 			model = glm::mat4();
 			model = glm::translate(model, newPos);
 			model = glm::scale(model, glm::vec3(0.5f));
-			pbrShader.setMat4("model", model);
 			
 			// the quad is now a massive plane for the ground remember!
 			//renderQuad();
 		}
 
+		// one copy per block, every program picks them up from the shared binding points
+		uniformRing.Push(Graphics::FRAME_BLOCK_BINDING, &frameBlock, sizeof(frameBlock));
+		uniformRing.Push(Graphics::VIEW_BLOCK_BINDING, &viewBlock, sizeof(viewBlock));
+		uniformRing.Push(Graphics::LIGHT_BLOCK_BINDING, &lightBlock, sizeof(lightBlock));
+		for (unsigned int i = 0; i < swayingLights; i++)
+			sceneLights[i].Position = swayOrigins[i] + glm::vec3(sin(currentTime * 2.0f + i) * 2.0f, 0.0f, 0.0f);
+		pointShadows.Update(sceneLights, camera.Position);
+		pointShadows.Bind();
+		lightGrid.Update(sceneLights, view, projection, &pointShadows);
+		lightGrid.Bind();
+		lightMap.Bind();
+		environment.Bind();
+		probes.Bind();
+
+		// the deferred path sends the opaque draws to the G-buffer, everything after the lighting
+		// pass is drawn forward on top of its depth
+		Graphics::Shader* geometryProgram = nullptr;
+		if (shadingPath == DEFERRED_SHADING) {
+			geometryProgram = deferredRenderer->GetGeometryProgram();
+			deferredRenderer->BeginGeometry();
+		}
 
-		// start rendering the groubnd
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, albedo);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, normal);
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, metallic);
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, roughness);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, ao);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, depth);
-
-		model = glm::mat4();
-		pbrShader.setMat4("model", model);
-		renderQuad(); // finished rendering the ground
-
-		if (true) {
-			pbrShader.setFloat("heightScale", 0.0f);
+		// the ground
+		Graphics::DrawCommand groundDraw;
+		groundDraw.Program = shadingPath == DEFERRED_SHADING ? geometryProgram : groundProgram;
+		groundDraw.Material = groundMaterialID;
+		groundDraw.VAO = getQuadVAO();
+		groundDraw.Count = 6;
+		groundDraw.Indexed = false;
+		groundDraw.Depth = glm::abs(camera.Position.y);
+		renderQueue.Submit(groundDraw);
+
+		if (treeRenderPath == TREES_QUEUED) {
 			for (int i = 0; i < amount; i++) {
+				if (!pvs.IsVisible(i))
+					continue;
 				pineTree.SetPosition(positions[i].x, positions[i].y, positions[i].z);
 				pineTree.SetRotation(rotations[i].x, rotations[i].y, rotations[i].z);
 				pineTree.SetScale(0.1f, 0.1f, 0.1f);
-				pineTree.Draw(&pbrShader);
+				pineTree.Submit(&renderQueue, shadingPath == DEFERRED_SHADING ? geometryProgram : treeProgram, treeMaterialID, glm::length(positions[i] - camera.Position));
+			}
+		}
+		if (treeRenderPath == TREES_INDIRECT || treeRenderPath == TREES_VISIBILITY) {
+			// every visible tree in one multi draw, the heap could hold any number of other meshes too
+			for (int i = 0; i < amount; i++) {
+				if (pvs.IsVisible(i))
+					indirectDraws.Submit(heapTreeMesh, treeTransforms[i], treePoolMaterial);
+			}
+			// the trees' depth goes in before anything is shaded so they occlude the ground too
+			if (treeRenderPath == TREES_INDIRECT && depthPrepass) {
+				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+				indirectDraws.FlushDepth(&indirectDepthShader);
+				glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			}
+		}
+		renderQueue.Flush();
+		if (shadingPath == DEFERRED_SHADING)
+			deferredRenderer->Light(sceneLights, view, projection, &pointShadows, &frameBuffer);
+
+		// the trees drawn outside the queue read the same material parameters
+		materials.BeginPass();
+
+		if (treeRenderPath == TREES_INDIRECT) {
+			materialPool.Bind();
+			if (depthPrepass) {
+				Graphics::GLState::SetDepthFunc(GL_EQUAL);
+				Graphics::GLState::SetDepthMask(false);
 			}
-			pbrShader.setFloat("heightScale", 0.1f);
+			indirectDraws.Flush(&indirectShader);
+			Graphics::GLState::SetDepthFunc(GL_LESS);
+			Graphics::GLState::SetDepthMask(true);
 		}
-		else {
+		else if (treeRenderPath == TREES_VISIBILITY) {
+			visibilityBuffer.Rasterize(&indirectDraws);
+			visibilityBuffer.Resolve(&indirectDraws, &materialPool, &frameBuffer);
+		}
+		else if (treeRenderPath == TREES_INSTANCED) {
 
 			/* 
 			In general, instancing is a win if you're rendering lots of instances (1000
@@ -379,19 +639,9 @@ int main(int argc, char *argv[])
 			of vertices (20,000 is probably too many. Look more into 100-3000 or so).
 			*/
 
-			instanceShader.use();
-			instanceShader.setMat4("projection", projection);
-			instanceShader.setMat4("view", view);
-			instanceShader.setVec3("camPos", camera.Position);
-			instanceShader.setVec3("viewPos", camera.Position);
-			instanceShader.setVec3("lightPos", lightPositions[0]);
-
-			pineTree.BindTextures();
-
-			glBindVertexArray(pineTree.getVAO());
-			glDrawElementsInstanced(GL_TRIANGLES, pineTree.indices.size(), GL_UNSIGNED_INT, 0, amount);
-			glBindVertexArray(0);
+			treeBatch.Draw(&instanceShader);
 		}
+		materials.EndPass();
 
 
 		/////////////////////////////////////////////////////////////
@@ -405,6 +655,8 @@ int main(int argc, char *argv[])
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		Graphics::GLState::EndFrame();
+		uniformRing.EndFrame();
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
@@ -421,7 +673,7 @@ void renderScene() {
 
 unsigned int quadVAO = 0;
 unsigned int quadVBO;
-void renderQuad()
+unsigned int getQuadVAO()
 {
 	if (quadVAO == 0)
 	{
@@ -497,26 +749,20 @@ void renderQuad()
 			pos3.x, pos3.y, pos3.z, nm.x, nm.y, nm.z, uv3.x, uv3.y, tangent2.x, tangent2.y, tangent2.z, bitangent2.x, bitangent2.y, bitangent2.z,
 			pos4.x, pos4.y, pos4.z, nm.x, nm.y, nm.z, uv4.x, uv4.y, tangent2.x, tangent2.y, tangent2.z, bitangent2.x, bitangent2.y, bitangent2.z
 		};
-		// configure plane VAO
-		glGenVertexArrays(1, &quadVAO);
-		glGenBuffers(1, &quadVBO);
-		glBindVertexArray(quadVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(0); // positions
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(1); // normals
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(2); // texcooords
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(6 * sizeof(float)));
-		glEnableVertexAttribArray(3); // tangent
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(8 * sizeof(float)));
-		glEnableVertexAttribArray(4); // bitangent
-		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(11 * sizeof(float)));
+		// configure plane VAO, the vertices are laid out like Model::Vertex
+		static_assert(Graphics::Model::Layout::Stride(0) == 14 * sizeof(float), "quad vertices don't match the model layout");
+		quadVBO = Graphics::GLResources::CreateBuffer(sizeof(quadVertices), quadVertices);
+		quadVAO = Graphics::GLResources::CreateVertexArray();
+		Graphics::Model::Layout::Apply(quadVAO);
+		Graphics::Model::Layout::SetVertexBuffer(quadVAO, 0, quadVBO);
 	}
-	glBindVertexArray(quadVAO);
+	return quadVAO;
+}
+
+void renderQuad()
+{
+	Graphics::GLState::BindVertexArray(getQuadVAO());
 	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glBindVertexArray(0);
 }
 
 // renders (and builds at first invocation) a sphere
@@ -527,12 +773,6 @@ void renderBentQuad()
 {
 	if (bentQuadVAO == 0)
 	{
-		glGenVertexArrays(1, &bentQuadVAO);
-
-		unsigned int vbo, ebo;
-		glGenBuffers(1, &vbo);
-		glGenBuffers(1, &ebo);
-
 		std::vector<glm::vec3> positions;
 		std::vector<glm::vec2> uv;
 		std::vector<glm::vec3> normals;
@@ -688,56 +928,24 @@ void renderBentQuad()
 			bitangents.push_back(bitangent);
 		}
 
-		std::vector<float> data;
+		std::vector<Graphics::Model::Vertex> vertices(positions.size());
 		for (unsigned int i = 0; i < positions.size(); ++i)
 		{
-			data.push_back(positions[i].x);
-			data.push_back(positions[i].y);
-			data.push_back(positions[i].z);
-			if (normals.size() > 0)
-			{
-				data.push_back(normals[i].x);
-				data.push_back(normals[i].y);
-				data.push_back(normals[i].z);
-			}
-			if (uv.size() > 0)
-			{
-				data.push_back(uv[i].x);
-				data.push_back(uv[i].y);
-			}
-
-			if (tangents.size() > 0)
-			{
-				data.push_back(tangents[i].x);
-				data.push_back(tangents[i].y);
-				data.push_back(tangents[i].z);
-			}
-			if (bitangents.size() > 0)
-			{
-				data.push_back(bitangents[i].x);
-				data.push_back(bitangents[i].y);
-				data.push_back(bitangents[i].z);
-			}
+			vertices[i].Position = positions[i];
+			vertices[i].Normal = normals[i];
+			vertices[i].TexCoords = uv[i];
+			vertices[i].Tangent = tangents[i];
+			vertices[i].Bitangent = bitangents[i];
 		}
-		glBindVertexArray(bentQuadVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, bentQuadIndexCount * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-		unsigned int stride = (3 + 3 + 2 + 3 + 3) * sizeof(float);
-		glEnableVertexAttribArray(0);// positions
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-		glEnableVertexAttribArray(1);// uv
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(2);// normlas
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-		glEnableVertexAttribArray(3);// tangents
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)(8 * sizeof(float)));
-		glEnableVertexAttribArray(4);// bitangents
-		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)(11 * sizeof(float)));
+		unsigned int vbo = Graphics::GLResources::CreateBuffer(vertices.size() * sizeof(Graphics::Model::Vertex), &vertices[0]);
+		unsigned int ebo = Graphics::GLResources::CreateBuffer(bentQuadIndexCount * sizeof(unsigned int), &indices[0]);
+		bentQuadVAO = Graphics::GLResources::CreateVertexArray();
+		Graphics::Model::Layout::Apply(bentQuadVAO);
+		Graphics::Model::Layout::SetVertexBuffer(bentQuadVAO, 0, vbo);
+		Graphics::GLResources::SetElementBuffer(bentQuadVAO, ebo);
 	}
 
-	glBindVertexArray(bentQuadVAO);
+	Graphics::GLState::BindVertexArray(bentQuadVAO);
 	glDrawElements(GL_TRIANGLES, bentQuadIndexCount, GL_UNSIGNED_INT, 0);
 }
 
@@ -785,6 +993,24 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 	camera.ProcessMouseMovement(xoffset, yoffset);
 }
 
+// glfw: whenever a mouse button is pressed, this callback is called
+// -------------------------------------------------------------------
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS)
+		return;
+
+	// the cursor is captured, so pick whatever is under the centre of the screen
+	Graphics::Ray ray;
+	ray.Origin = camera.Position;
+	ray.Direction = camera.Front;
+	ray.MaxDistance = 100.0f;
+
+	Graphics::RayHit hit;
+	if (App::RayCastClosest(scene, ray, &hit))
+		Util::Log::WriteInfo("Picked instance " + std::to_string(hit.Instance) + " (triangle " + std::to_string(hit.Triangle) + ") at distance " + std::to_string(hit.Distance));
+}
+
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
@@ -812,7 +1038,7 @@ unsigned int loadTexture(char const * path)
 		else if (nrComponents == 4)
 			format = GL_RGBA;
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		Graphics::GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
 		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -11,6 +11,7 @@
 #include <glh/Graphics/Skybox.h>
 #include <glh/Graphics/Framebuffer.h>
 #include <glh/Graphics/Model.h>
+#include <glh/Graphics/InstanceBatch.h>
 #include <glh/Graphics/LightBuffer.h>
 #include <glh/IO/Log.h>
 
@@ -131,34 +132,10 @@ int main()
 
 	// configure instanced array
 	// -------------------------
-	unsigned int buffer;
-	glGenBuffers(1, &buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
-	glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-	// set transformation matrices as an instance vertex attribute (with divisor 1)
-	// note: we're cheating a little by taking the, now publicly declared, VAO of the model's mesh(es) and adding new vertexAttribPointers
-	// normally you'd want to do this in a more organized fashion, but for learning purposes this will do.
-	// -----------------------------------------------------------------------------------------------------------------------------------
-
-	unsigned int VAO = rock.getVAO();
-	glBindVertexArray(VAO);
-	// set attribute pointers for matrix (4 times vec4)
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-	glEnableVertexAttribArray(5);
-	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-	glEnableVertexAttribArray(6);
-	glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
-
-	glVertexAttribDivisor(3, 1);
-	glVertexAttribDivisor(4, 1);
-	glVertexAttribDivisor(5, 1);
-	glVertexAttribDivisor(6, 1);
-
-	glBindVertexArray(0);
+	// the batch keeps the matrices in attribute slots 5-8, clear of the model's tangent and bitangent slots
+	InstanceBatch rockBatch(&rock, amount);
+	for (unsigned int i = 0; i < amount; i++)
+		rockBatch.Add(modelMatrices[i]);
 
 	int frames = 0;
 	float lastFPS = (float)glfwGetTime();
@@ -217,12 +194,7 @@ int main()
 		// draw meteorites instanced
 		/*asteroidShader.use();
 		asteroidShader.setInt("texture_diffuse1", 0);
-		glActiveTexture(GL_TEXTURE0);
-		rock.BindTextures();
-
-		glBindVertexArray(rock.getVAO());
-		glDrawElementsInstanced(GL_TRIANGLES, rock.indices.size(), GL_UNSIGNED_INT, 0, amount);
-		glBindVertexArray(0);*/
+		rockBatch.Draw(&asteroidShader);*/
 
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
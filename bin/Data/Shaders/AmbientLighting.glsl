@@ -0,0 +1,70 @@
+// ambient light from the skybox, see ImageBasedLighting
+layout (std140) uniform EnvironmentBlock
+{
+    // irradiance / pi as spherical harmonics, premultiplied by the basis constants
+    vec4 irradianceSH[9];
+    // x: mip level of the roughest prefiltered reflection
+    vec4 environmentParameters;
+};
+
+// the skybox convolved with GGX lobes, rougher down the mips
+uniform samplerCube prefilteredMap;
+// x: N.V, y: roughness, the BRDF's scale and bias on F0
+uniform sampler2D brdfLUT;
+
+// indirect diffuse light baked into a grid of probes, see IrradianceVolume
+layout (std140) uniform ProbeBlock
+{
+    // xyz: the first probe, w: 1 when there's a grid
+    vec4 probeOrigin;
+    vec4 probeInverseSpacing;
+    vec4 probeCounts;
+};
+
+// irradiance / pi of the first two SH bands, red, green and blue each a block of the grid along z
+uniform sampler3D probeIrradiance;
+
+// the probes' irradiance / pi towards a world space normal, false outside the grid
+bool ProbeIrradiance(vec3 position, vec3 N, out vec3 irradiance)
+{
+    irradiance = vec3(0.0);
+    vec3 grid = (position - probeOrigin.xyz) * probeInverseSpacing.xyz;
+    if (probeOrigin.w == 0.0 || any(lessThan(grid, vec3(0.0))) || any(greaterThan(grid, probeCounts.xyz - 1.0)))
+        return false;
+
+    // between the first and last texel centres, so a block never filters into the next one
+    vec3 uvw = (grid + 0.5) / vec3(probeCounts.xy, probeCounts.z * 3.0);
+    vec4 basis = vec4(1.0, N.y, N.z, N.x);
+    irradiance.r = dot(texture(probeIrradiance, uvw), basis);
+    irradiance.g = dot(texture(probeIrradiance, uvw + vec3(0.0, 0.0, 1.0 / 3.0)), basis);
+    irradiance.b = dot(texture(probeIrradiance, uvw + vec3(0.0, 0.0, 2.0 / 3.0)), basis);
+    return true;
+}
+
+// split sum ambient light of a world space normal and view direction: the probes' or else the sky's
+// SH irradiance for the diffuse part, the prefiltered reflection scaled by the integrated BRDF for
+// the specular part
+vec3 AmbientLighting(vec3 fragPos, vec3 N, vec3 V, vec3 albedo, float ao, float roughness, float metallic)
+{
+    float NdotV = max(dot(N, V), 0.0001);
+
+    vec3 irradiance;
+    if (!ProbeIrradiance(fragPos, N, irradiance))
+    {
+        irradiance = irradianceSH[0].rgb
+            + irradianceSH[1].rgb * N.y + irradianceSH[2].rgb * N.z + irradianceSH[3].rgb * N.x
+            + irradianceSH[4].rgb * (N.x * N.y) + irradianceSH[5].rgb * (N.y * N.z)
+            + irradianceSH[6].rgb * (3.0 * N.z * N.z - 1.0)
+            + irradianceSH[7].rgb * (N.x * N.z) + irradianceSH[8].rgb * (N.x * N.x - N.y * N.y);
+    }
+
+    vec3 F0 = mix(vec3(0.04), albedo, metallic);
+    // Fresnel with the roughness taken into account, rough surfaces don't brighten as much at grazing angles
+    vec3 F = F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - NdotV, 5.0);
+    vec3 diffuse = max(irradiance, 0.0) * albedo * (1.0 - F) * (1.0 - metallic);
+
+    vec3 prefiltered = textureLod(prefilteredMap, reflect(-V, N), roughness * environmentParameters.x).rgb;
+    vec2 brdf = texture(brdfLUT, vec2(NdotV, roughness)).rg;
+    vec3 specular = prefiltered * (F0 * brdf.x + brdf.y);
+    return (diffuse + specular) * ao;
+}
@@ -0,0 +1,41 @@
+// Cook-Torrance with a GGX distribution, Smith-Schlick visibility and Schlick's Fresnel, the one
+// BRDF every direct light goes through in the forward, deferred and visibility buffer shaders
+const float PI = 3.14159265359;
+
+float DistributionGGX(float NdotH, float roughness)
+{
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float denom = NdotH * NdotH * (a2 - 1.0) + 1.0;
+    return a2 / (PI * denom * denom);
+}
+
+float GeometrySchlickGGX(float NdotX, float roughness)
+{
+    float k = (roughness + 1.0) * (roughness + 1.0) / 8.0;
+    return NdotX / (NdotX * (1.0 - k) + k);
+}
+
+vec3 FresnelSchlick(float cosTheta, vec3 F0)
+{
+    return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// reflected radiance per unit of radiance arriving from L, cosine included. Roughness is kept off
+// zero so a mirror doesn't turn a light into a single blown out texel.
+vec3 CookTorrance(vec3 N, vec3 V, vec3 L, vec3 albedo, float roughness, float metallic)
+{
+    roughness = max(roughness, 0.05);
+    float NdotV = max(dot(N, V), 0.0001);
+    float NdotL = max(dot(N, L), 0.0);
+    vec3 H = normalize(V + L);
+    float NdotH = max(dot(N, H), 0.0);
+    vec3 F0 = mix(vec3(0.04), albedo, metallic);
+    vec3 F = FresnelSchlick(max(dot(H, V), 0.0), F0);
+    float D = DistributionGGX(NdotH, roughness);
+    float G = GeometrySchlickGGX(NdotV, roughness) * GeometrySchlickGGX(NdotL, roughness);
+
+    vec3 specular = D * G * F / (4.0 * NdotV * NdotL + 0.0001);
+    vec3 diffuse = (1.0 - F) * (1.0 - metallic) * albedo / PI;
+    return (diffuse + specular) * NdotL;
+}
@@ -0,0 +1,75 @@
+#include "ViewBlock.glsl"
+
+// shadow of the main light from the cascades, see LightBuffer
+layout (std140) uniform ShadowBlock
+{
+    // world to shadow map texture space of each cascade
+    mat4 cascadeMatrices[4];
+    // view depth where each cascade ends
+    vec4 cascadeSplits;
+    vec4 shadowLightDirection;
+    // x: 1 for EVSM, 0 for PCF, y, z: the EVSM exponents, w: light bleeding reduction
+    vec4 shadowFilter;
+};
+
+uniform sampler2DArrayShadow shadowMap;
+uniform sampler2DArray shadowMoments;
+
+// Chebyshev's upper bound on the share of the filter region at least as far as depth,
+// with the lowest shares cut off against light bleeding
+float ChebyshevUpperBound(vec2 moments, float depth)
+{
+    if (depth <= moments.x)
+        return 1.0;
+    float variance = max(moments.y - moments.x * moments.x, 0.0001 * depth * depth);
+    float difference = depth - moments.x;
+    float lit = variance / (variance + difference * difference);
+    return clamp((lit - shadowFilter.w) / (1.0 - shadowFilter.w), 0.0, 1.0);
+}
+
+// 1 where the fragment sees the light, from the EVSM moments or 3x3 texels of PCF in the first
+// cascade that holds it. Everything past the last cascade is lit. The moments' mip comes from
+// fragPos's change one pixel right and up.
+float CascadedShadowGrad(vec3 fragPos, vec3 fragPosDdx, vec3 fragPosDdy, float NdotL)
+{
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    int cascade = 0;
+    while (cascade < 4 && viewDepth > cascadeSplits[cascade])
+        cascade++;
+    if (cascade == 4)
+        return 1.0;
+
+    vec3 shadowPos = (cascadeMatrices[cascade] * vec4(fragPos, 1.0)).xyz;
+    if (shadowFilter.x > 0.5)
+    {
+        // one trilinear lookup whatever the blur radius, the mips filter the minified cascades.
+        // The cascades are orthographic, so the derivatives in this one are its matrix times the
+        // world space ones.
+        mat3 toCascade = mat3(cascadeMatrices[cascade]);
+        vec2 shadowPosDdx = (toCascade * fragPosDdx).xy;
+        vec2 shadowPosDdy = (toCascade * fragPosDdy).xy;
+        vec4 moments = textureGrad(shadowMoments, vec3(shadowPos.xy, float(cascade)), shadowPosDdx, shadowPosDdy);
+        float depth = shadowPos.z * 2.0 - 1.0;
+        float positive = ChebyshevUpperBound(moments.xy, exp(shadowFilter.y * depth));
+        float negative = ChebyshevUpperBound(moments.zw, -exp(-shadowFilter.z * depth));
+        return min(positive, negative);
+    }
+
+    // the caster pass has a slope scaled offset, this only covers grazing receivers
+    float bias = 0.0005 * (2.0 - NdotL);
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+            lit += texture(shadowMap, vec4(shadowPos.xy + vec2(x, y) * texelSize, float(cascade), shadowPos.z - bias));
+    }
+    return lit / 9.0;
+}
+
+// the same from the fragment's own derivatives, call it from uniform control flow
+float CascadedShadow(vec3 fragPos, float NdotL)
+{
+    // taken before the cascade is picked, neighbouring pixels can pick different ones
+    return CascadedShadowGrad(fragPos, dFdx(fragPos), dFdy(fragPos), NdotL);
+}
@@ -0,0 +1,36 @@
+#include "ViewBlock.glsl"
+#include "PointLight.glsl"
+
+// clustered point lights, see LightGrid
+layout (std140) uniform ClusterBlock
+{
+    // x, y: clusters per pixel, z, w: log(view depth) to depth slice scale and bias
+    vec4 clusterScale;
+    // clusters along x, y and z, then the light count
+    uvec4 clusterCounts;
+};
+
+// two texels per light: position and range, colour * intensity and shadow slot + 1
+uniform samplerBuffer clusterLights;
+// an offset and count per cluster, then the light lists
+uniform usamplerBuffer clusterItems;
+
+// every light of the fragment's cluster, from a world space normal and view direction
+vec3 ClusteredLighting(vec3 fragPos, vec3 normal, vec3 viewDir, vec3 albedo, float roughness, float metallic)
+{
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    uint slice = uint(max(log(viewDepth) * clusterScale.z - clusterScale.w, 0.0));
+    uvec3 cluster = min(uvec3(uvec2(gl_FragCoord.xy * clusterScale.xy), slice), clusterCounts.xyz - 1u);
+    int item = int(((cluster.z * clusterCounts.y + cluster.y) * clusterCounts.x + cluster.x) * 2u);
+    int first = int(texelFetch(clusterItems, item).r);
+    int count = int(texelFetch(clusterItems, item + 1).r);
+
+    vec3 result = vec3(0.0);
+    for (int i = 0; i < count; i++)
+    {
+        int light = int(texelFetch(clusterItems, first + i).r);
+        result += PointLight(fragPos, normal, viewDir, albedo, roughness, metallic,
+            texelFetch(clusterLights, light * 2), texelFetch(clusterLights, light * 2 + 1));
+    }
+    return result;
+}
@@ -4,71 +4,31 @@ out vec4 FragColor;
 in VS_OUT {
     vec3 FragPos;
     vec2 TexCoords;
-    vec3 TangentLightPos;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
 } fs_in;
 
-uniform sampler2D diffuseMap;
-uniform sampler2D normalMap;
-uniform sampler2D metallicMap;
-uniform sampler2D roughnessMap;
-uniform sampler2D aoMap;
-uniform sampler2D depthMap;
-
-uniform float heightScale;
-
-vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
-{ 
-	if (heightScale == 0)
-		return texCoords;
+// rotates world space directions into tangent space, the transpose brings normal map normals out
+in mat3 WorldToTangent;
 
-    // number of depth layers
-    const float minLayers = 8;
-    const float maxLayers = 48;
-
-	float dotProd = dot(vec3(0.0, 0.0, 1.0), viewDir);
-
-	float numLayers = mix(maxLayers, minLayers, abs(dotProd));  
-    //float numLayers = mix(maxLayers, minLayers, abs(pow(dotProd, 0.4))); 
-	
-    // calculate the size of each layer
-    float layerDepth = 1.0 / numLayers;
-    // depth of current layer
-    float currentLayerDepth = 0.0;
-    // the amount to shift the texture coordinates per layer (from vector P)
-    vec2 P = viewDir.xy / viewDir.z * heightScale; 
-    vec2 deltaTexCoords = P / numLayers;
-  
-    // get initial values
-    vec2  currentTexCoords     = texCoords;
-    float currentDepthMapValue = texture(depthMap, currentTexCoords).r;
-      
-    while(currentLayerDepth < currentDepthMapValue)
-    {
-        // shift texture coordinates along direction of P
-        currentTexCoords -= deltaTexCoords;
-        // get depthmap value at current texture coordinates
-        currentDepthMapValue = texture(depthMap, currentTexCoords).r;
-        // get depth of next layer
-        currentLayerDepth += layerDepth;  
-    }
-	// end of steep parallax mapping, onwards with parallax occlusion mapping
+uniform sampler2D albedoMap;
+uniform sampler2D normalMap;
+// r: ao, g: roughness, b: metallic, a: parallax depth
+uniform sampler2D ormMap;
 
-	// get texture coordinates before collision (reverse operations)
-	vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
+// MaterialParameters materials[] and materialIndex, generated from the MaterialSchema in Main.cpp
+#include "MaterialParameters.glsl"
 
-	// get depth after and before collision for linear interpolation
-	float afterDepth  = currentDepthMapValue - currentLayerDepth;
-	float beforeDepth = texture(depthMap, prevTexCoords).r - currentLayerDepth + layerDepth;
- 
-	// interpolation of texture coordinates
-	float weight = afterDepth / (afterDepth - beforeDepth);
-	vec2 finalTexCoords = prevTexCoords * weight + currentTexCoords * (1.0 - weight);
-    
-    return finalTexCoords;
+float ParallaxDepth(vec2 texCoords)
+{
+    return texture(ormMap, texCoords).a;
 }
 
+#include "Parallax.glsl"
+#include "ClusteredLighting.glsl"
+#include "SunLighting.glsl"
+#include "AmbientLighting.glsl"
+
 void main()
 {
     // offset texture coordinates with Parallax Mapping
@@ -79,7 +39,7 @@ void main()
 	if (texCoords.y > 1.0f)
 		texCoords.y -= floor(texCoords.y);
     
-    //texCoords = ParallaxMapping(texCoords,  viewDir);
+    //texCoords = ParallaxMapping(texCoords, viewDir, materials[materialIndex].heightScale);
     //if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
         //discard;
 
@@ -87,19 +47,15 @@ void main()
     vec3 normal = texture(normalMap, texCoords).rgb;
     normal = normalize(normal * 2.0 - 1.0);   
    
+    // the shared lighting works in world space, WorldToTangent is a rotation
+    vec3 worldNormal = normal * WorldToTangent;
+    vec3 worldViewDir = viewDir * WorldToTangent;
+   
     // get diffuse color
-    vec3 color = texture(diffuseMap, texCoords).rgb;
-    // ambient
-    vec3 ambient = 0.1 * color;
-    // diffuse
-    vec3 lightDir = normalize(fs_in.TangentLightPos - fs_in.TangentFragPos);
-    float diff = max(dot(lightDir, normal), 0.0);
-    vec3 diffuse = diff * color;
-    // specular
-    vec3 reflectDir = reflect(-lightDir, normal);
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
-
-    vec3 specular = vec3(0.2) * spec;
-    FragColor = vec4(ambient + diffuse + specular, 1.0);
+    vec3 color = texture(albedoMap, texCoords).rgb;
+    // ambient, the trees only have an albedo map so they're a rough dielectric
+    vec3 ambient = AmbientLighting(fs_in.FragPos, worldNormal, worldViewDir, color, 1.0, 0.8, 0.0);
+    vec3 sun = SunLighting(fs_in.FragPos, worldNormal, worldViewDir, color, 0.8, 0.0);
+    vec3 clustered = ClusteredLighting(fs_in.FragPos, worldNormal, worldViewDir, color, 0.8, 0.0);
+    FragColor = vec4(ambient + sun + clustered, 1.0);
 }
\ No newline at end of file
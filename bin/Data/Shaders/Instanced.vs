@@ -9,16 +9,14 @@ layout (location = 5) in mat4 aInstanceMatrix;
 out VS_OUT {
     vec3 FragPos;
     vec2 TexCoords;
-    vec3 TangentLightPos;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+// the lighting is done in world space, the fragment shader rotates its normal back with this
+out mat3 WorldToTangent;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+#include "ViewBlock.glsl"
 
 void main()
 {
@@ -29,9 +27,9 @@ void main()
     vec3 B = normalize(mat3(aInstanceMatrix) * aBitangent);
     vec3 N = normalize(mat3(aInstanceMatrix) * aNormal);
     mat3 TBN = transpose(mat3(T, B, N));
+    WorldToTangent = TBN;
 
-    vs_out.TangentLightPos = TBN * lightPos;
-    vs_out.TangentViewPos  = TBN * viewPos;
+    vs_out.TangentViewPos  = TBN * viewPosition.xyz;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
     
     gl_Position = projection * view * aInstanceMatrix * vec4(aPos, 1.0);
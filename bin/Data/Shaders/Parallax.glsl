@@ -0,0 +1,52 @@
+// Parallax occlusion mapping in tangent space. The including shader defines
+//
+// float ParallaxDepth(vec2 texCoords);   // the material's parallax depth, 0 at the surface
+//
+// before this file, so the same steps read a texture, a layer of an array or explicit gradients.
+vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir, float heightScale)
+{ 
+	if (heightScale == 0)
+		return texCoords;
+
+    // number of depth layers
+    const float minLayers = 8;
+    const float maxLayers = 48;
+
+	float numLayers = mix(maxLayers, minLayers, abs(viewDir.z));  
+	
+    // calculate the size of each layer
+    float layerDepth = 1.0 / numLayers;
+    // depth of current layer
+    float currentLayerDepth = 0.0;
+    // the amount to shift the texture coordinates per layer (from vector P)
+    vec2 P = viewDir.xy / viewDir.z * heightScale; 
+    vec2 deltaTexCoords = P / numLayers;
+  
+    // get initial values
+    vec2  currentTexCoords     = texCoords;
+    float currentDepthMapValue = ParallaxDepth(currentTexCoords);
+      
+    while(currentLayerDepth < currentDepthMapValue)
+    {
+        // shift texture coordinates along direction of P
+        currentTexCoords -= deltaTexCoords;
+        // get depthmap value at current texture coordinates
+        currentDepthMapValue = ParallaxDepth(currentTexCoords);
+        // get depth of next layer
+        currentLayerDepth += layerDepth;  
+    }
+	// end of steep parallax mapping, onwards with parallax occlusion mapping
+
+	// get texture coordinates before collision (reverse operations)
+	vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
+
+	// get depth after and before collision for linear interpolation
+	float afterDepth  = currentDepthMapValue - currentLayerDepth;
+	float beforeDepth = ParallaxDepth(prevTexCoords) - currentLayerDepth + layerDepth;
+ 
+	// interpolation of texture coordinates
+	float weight = afterDepth / (afterDepth - beforeDepth);
+	vec2 finalTexCoords = prevTexCoords * weight + currentTexCoords * (1.0 - weight);
+    
+    return finalTexCoords;
+}
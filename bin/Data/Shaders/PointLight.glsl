@@ -0,0 +1,22 @@
+#include "BRDF.glsl"
+#include "PointShadow.glsl"
+
+// A point light as LightGrid and DeferredRenderer pack it, position and range, then colour *
+// intensity and shadow slot + 1. Inverse square falloff windowed to reach zero at the range
+// (Karis, "Real Shading in Unreal Engine 4").
+vec3 PointLight(vec3 fragPos, vec3 N, vec3 V, vec3 albedo, float roughness, float metallic, vec4 positionRange, vec4 radianceSlot)
+{
+    vec3 toLight = positionRange.xyz - fragPos;
+    float distance = length(toLight);
+    if (distance >= positionRange.w)
+        return vec3(0.0);
+
+    float window = clamp(1.0 - pow(distance / positionRange.w, 4.0), 0.0, 1.0);
+    float attenuation = window * window / (distance * distance + 1.0);
+    // w: shadow slot + 1, 0 without a shadow
+    if (radianceSlot.w > 0.0)
+        attenuation *= PointShadow(int(radianceSlot.w) - 1, -toLight, positionRange.w);
+
+    vec3 L = toLight / max(distance, 0.0001);
+    return CookTorrance(N, V, L, albedo, roughness, metallic) * radianceSlot.rgb * attenuation;
+}
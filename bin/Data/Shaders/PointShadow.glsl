@@ -0,0 +1,34 @@
+// cube shadows of the most important point lights, see PointShadowAtlas
+uniform sampler2DArrayShadow pointShadowMaps;
+
+// 1 where the light sees the fragment at lightToFrag from it. The face and its coordinates follow
+// GL's cube map layout, which is how PointShadowAtlas draws them.
+float PointShadow(int slot, vec3 lightToFrag, float range)
+{
+    vec3 size = abs(lightToFrag);
+    int face;
+    float major;
+    vec2 st;
+    if (size.x >= size.y && size.x >= size.z)
+    {
+        major = size.x;
+        face = lightToFrag.x > 0.0 ? 0 : 1;
+        st = vec2(lightToFrag.x > 0.0 ? -lightToFrag.z : lightToFrag.z, -lightToFrag.y);
+    }
+    else if (size.y >= size.z)
+    {
+        major = size.y;
+        face = lightToFrag.y > 0.0 ? 2 : 3;
+        st = vec2(lightToFrag.x, lightToFrag.y > 0.0 ? lightToFrag.z : -lightToFrag.z);
+    }
+    else
+    {
+        major = size.z;
+        face = lightToFrag.z > 0.0 ? 4 : 5;
+        st = vec2(lightToFrag.z > 0.0 ? lightToFrag.x : -lightToFrag.x, -lightToFrag.y);
+    }
+    vec2 uv = st / major * 0.5 + 0.5;
+    // the cubes hold distance over range
+    float depth = length(lightToFrag) / range;
+    return texture(pointShadowMaps, vec4(uv, float(slot * 6 + face), depth - 0.01));
+}
@@ -0,0 +1,19 @@
+#include "BRDF.glsl"
+#include "CascadedShadow.glsl"
+
+// the sun, the white directional light of unit irradiance the cascades are drawn from, with a
+// world space normal and view direction. fragPosDdx and fragPosDdy are its change one pixel right
+// and up, for passes where the rasteriser's derivatives don't follow the surface.
+vec3 SunLightingGrad(vec3 fragPos, vec3 fragPosDdx, vec3 fragPosDdy, vec3 normal, vec3 viewDir, vec3 albedo, float roughness, float metallic)
+{
+    vec3 lightDir = -shadowLightDirection.xyz;
+    float NdotL = max(dot(lightDir, normal), 0.0);
+    return CookTorrance(normal, viewDir, lightDir, albedo, roughness, metallic) *
+        CascadedShadowGrad(fragPos, fragPosDdx, fragPosDdy, NdotL);
+}
+
+// the same from the fragment's own derivatives, call it from uniform control flow
+vec3 SunLighting(vec3 fragPos, vec3 normal, vec3 viewDir, vec3 albedo, float roughness, float metallic)
+{
+    return SunLightingGrad(fragPos, dFdx(fragPos), dFdy(fragPos), normal, viewDir, albedo, roughness, metallic);
+}
@@ -0,0 +1,7 @@
+// the camera, see ViewBlock in UniformBlocks.h
+layout (std140) uniform ViewBlock
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
@@ -0,0 +1,69 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// G-buffer, see gbuffer.fs
+uniform sampler2D albedoBuffer;
+uniform sampler2D normalBuffer;
+uniform sampler2D ormBuffer;
+uniform sampler2D depthBuffer;
+
+// two texels per light, packed like the forward shaders' clusterLights
+uniform samplerBuffer lights;
+// an offset and light count per tile, row by row from the bottom left, followed by the light lists
+uniform usamplerBuffer tiles;
+uniform int tileCountX;
+
+uniform mat4 inverseViewProjection;
+
+// the sun, the point lights and the ambient light, shared with the forward shaders so both paths
+// draw the same image
+#include "SunLighting.glsl"
+#include "PointLight.glsl"
+#include "AmbientLighting.glsl"
+
+// must match DeferredRenderer::TILE_SIZE
+const int TILE_SIZE = 16;
+
+vec3 DecodeNormal(vec2 f)
+{
+    vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(depthBuffer, pixel, 0).r;
+    // nothing was drawn here, the skybox fills it in later. These pixels still go through the sun
+    // and ambient light so the shadow lookups' derivatives stay in uniform control flow.
+    bool background = depth == 1.0;
+
+    vec4 world = inverseViewProjection * vec4(TexCoords * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec3 fragPos = world.xyz / world.w;
+
+    vec3 albedo = texelFetch(albedoBuffer, pixel, 0).rgb;
+    vec3 N = DecodeNormal(texelFetch(normalBuffer, pixel, 0).rg);
+    vec3 orm = texelFetch(ormBuffer, pixel, 0).rgb;
+    vec3 V = normalize(viewPosition.xyz - fragPos);
+
+    ivec2 tile = pixel / TILE_SIZE;
+    int tileIndex = (tile.y * tileCountX + tile.x) * 2;
+    int first = int(texelFetch(tiles, tileIndex).r);
+    int count = background ? 0 : int(texelFetch(tiles, tileIndex + 1).r);
+
+    vec3 Lo = vec3(0.0);
+    for (int i = 0; i < count; i++)
+    {
+        int light = int(texelFetch(tiles, first + i).r);
+        Lo += PointLight(fragPos, N, V, albedo, orm.g, orm.b, texelFetch(lights, light * 2), texelFetch(lights, light * 2 + 1));
+    }
+
+    vec3 sun = SunLighting(fragPos, N, V, albedo, orm.g, orm.b);
+    vec3 ambient = AmbientLighting(fragPos, N, V, albedo, orm.r, orm.g, orm.b);
+    FragColor = background ? vec4(0.0, 0.0, 0.0, 1.0) : vec4(ambient + sun + Lo, 1.0);
+}
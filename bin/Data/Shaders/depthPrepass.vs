@@ -0,0 +1,17 @@
+#version 330 core
+// depth pre-pass for the programs using pbr.vs, gl_Position has to match it exactly
+layout (location = 0) in vec3 aPos;
+
+invariant gl_Position;
+
+#include "ViewBlock.glsl"
+
+layout (std140) uniform ObjectBlock
+{
+    mat4 model;
+};
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,27 @@
+#version 330 core
+// one direction of the separable Gaussian over the EVSM moments, see LightBuffer
+out vec4 FragColor;
+
+uniform sampler2D source;
+// (1, 0) for the horizontal pass, (0, 1) for the vertical one
+uniform vec2 texelStep;
+uniform int radius;
+
+void main()
+{
+    ivec2 center = ivec2(gl_FragCoord.xy);
+    ivec2 limit = textureSize(source, 0) - 1;
+    ivec2 direction = ivec2(texelStep);
+    // sigma of half the radius puts the cut off tails at two standard deviations
+    float sigma = max(float(radius) * 0.5, 0.5);
+
+    vec4 sum = vec4(0.0);
+    float weights = 0.0;
+    for (int i = -radius; i <= radius; i++)
+    {
+        float weight = exp(-float(i * i) / (2.0 * sigma * sigma));
+        sum += texelFetch(source, clamp(center + direction * i, ivec2(0), limit), 0) * weight;
+        weights += weight;
+    }
+    FragColor = sum / weights;
+}
@@ -0,0 +1,26 @@
+#version 330 core
+// exponential variance moments of one cascade at half resolution, see LightBuffer
+out vec4 FragColor;
+
+uniform sampler2DArray depthMap;
+uniform int layer;
+// the positive and negative warp exponents
+uniform vec2 exponents;
+
+void main()
+{
+    // each moment texel averages the warped moments of the 2x2 depth texels under it
+    ivec2 first = ivec2(gl_FragCoord.xy) * 2;
+    vec4 moments = vec4(0.0);
+    for (int y = 0; y < 2; y++)
+    {
+        for (int x = 0; x < 2; x++)
+        {
+            float depth = texelFetch(depthMap, ivec3(first + ivec2(x, y), layer), 0).r * 2.0 - 1.0;
+            float positive = exp(exponents.x * depth);
+            float negative = -exp(-exponents.y * depth);
+            moments += vec4(positive, positive * positive, negative, negative * negative);
+        }
+    }
+    FragColor = moments * 0.25;
+}
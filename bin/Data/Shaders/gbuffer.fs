@@ -0,0 +1,58 @@
+#version 330 core
+// G-buffer layout, see DeferredRenderer
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec2 gNormal;
+layout (location = 2) out vec4 gORM;
+
+in VS_OUT {
+    vec2 TexCoords;
+    mat3 TBN;
+    vec3 TangentViewPos;
+    vec3 TangentFragPos;
+} fs_in;
+
+uniform sampler2D albedoMap;
+uniform sampler2D normalMap;
+// r: ao, g: roughness, b: metallic, a: parallax depth
+uniform sampler2D ormMap;
+
+// MaterialParameters materials[] and materialIndex, generated from the MaterialSchema in Main.cpp
+#include "MaterialParameters.glsl"
+
+float ParallaxDepth(vec2 texCoords)
+{
+    return texture(ormMap, texCoords).a;
+}
+
+#include "Parallax.glsl"
+
+// octahedral normal encoding (Cigolle et al., "A Survey of Efficient Representations for
+// Independent Unit Vectors"), two components in [-1, 1], decoded in deferredLighting.fs
+vec2 OctWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+}
+
+void main()
+{
+    vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
+    vec2 texCoords = fs_in.TexCoords;
+    if (texCoords.x > 1.0f)
+        texCoords.x -= floor(texCoords.x);
+    if (texCoords.y > 1.0f)
+        texCoords.y -= floor(texCoords.y);
+    texCoords = ParallaxMapping(texCoords, viewDir, materials[materialIndex].heightScale);
+
+    vec3 normal = normalize(texture(normalMap, texCoords).rgb * 2.0 - 1.0);
+    normal = normalize(fs_in.TBN * normal);
+
+    gAlbedo = vec4(texture(albedoMap, texCoords).rgb, 1.0);
+    gNormal = EncodeNormal(normal);
+    gORM = vec4(texture(ormMap, texCoords).rgb, 1.0);
+}
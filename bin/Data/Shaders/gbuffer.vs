@@ -0,0 +1,41 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+
+out VS_OUT {
+    vec2 TexCoords;
+    // world space tangent frame for the normal map
+    mat3 TBN;
+    vec3 TangentViewPos;
+    vec3 TangentFragPos;
+} vs_out;
+
+// must match depthPrepass.vs
+invariant gl_Position;
+
+#include "ViewBlock.glsl"
+
+layout (std140) uniform ObjectBlock
+{
+    mat4 model;
+};
+
+void main()
+{
+    vec3 fragPos = vec3(model * vec4(aPos, 1.0));
+    vs_out.TexCoords = aTexCoords;
+
+    vec3 T = normalize(mat3(model) * aTangent);
+    vec3 B = normalize(mat3(model) * aBitangent);
+    vec3 N = normalize(mat3(model) * aNormal);
+    vs_out.TBN = mat3(T, B, N);
+
+    mat3 inverseTBN = transpose(vs_out.TBN);
+    vs_out.TangentViewPos = inverseTBN * viewPosition.xyz;
+    vs_out.TangentFragPos = inverseTBN * fragPos;
+
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,51 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+// x: index of the transform in instanceTransforms, y: material index
+layout (location = 5) in uvec2 aInstance;
+
+out VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    vec3 TangentViewPos;
+    vec3 TangentFragPos;
+} vs_out;
+
+// the lighting is done in world space, the fragment shader rotates its normal back with this
+out mat3 WorldToTangent;
+flat out uint MaterialIndex;
+
+// must match indirectDepth.vs
+invariant gl_Position;
+
+#include "ViewBlock.glsl"
+
+// one mat4 per object, stored as 4 RGBA32F texels
+uniform samplerBuffer instanceTransforms;
+
+void main()
+{
+    int base = int(aInstance.x) * 4;
+    mat4 model = mat4(texelFetch(instanceTransforms, base),
+                      texelFetch(instanceTransforms, base + 1),
+                      texelFetch(instanceTransforms, base + 2),
+                      texelFetch(instanceTransforms, base + 3));
+    MaterialIndex = aInstance.y;
+
+    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    vs_out.TexCoords = aTexCoords;
+
+    vec3 T = normalize(mat3(model) * aTangent);
+    vec3 B = normalize(mat3(model) * aBitangent);
+    vec3 N = normalize(mat3(model) * aNormal);
+    mat3 TBN = transpose(mat3(T, B, N));
+    WorldToTangent = TBN;
+
+    vs_out.TangentViewPos  = TBN * viewPosition.xyz;
+    vs_out.TangentFragPos  = TBN * vs_out.FragPos;
+
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
+}
@@ -0,0 +1,25 @@
+#version 330 core
+// depth-only variant of indirect.vs, reads the heap's position stream
+layout (location = 0) in vec3 aPos;
+// x: index of the transform in instanceTransforms, y: material index
+layout (location = 5) in uvec2 aInstance;
+
+invariant gl_Position;
+
+#include "ViewBlock.glsl"
+
+// one mat4 per object, stored as 4 RGBA32F texels
+uniform samplerBuffer instanceTransforms;
+
+void main()
+{
+    int base = int(aInstance.x) * 4;
+    mat4 model = mat4(texelFetch(instanceTransforms, base),
+                      texelFetch(instanceTransforms, base + 1),
+                      texelFetch(instanceTransforms, base + 2),
+                      texelFetch(instanceTransforms, base + 3));
+
+    // the same expression as indirect.vs so the depth pre-pass matches it exactly
+    vec3 fragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(fragPos, 1.0);
+}
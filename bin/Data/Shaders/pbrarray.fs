@@ -0,0 +1,74 @@
+#version 330 core
+out vec4 FragColor;
+
+in VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    vec3 TangentViewPos;
+    vec3 TangentFragPos;
+} fs_in;
+
+// rotates world space directions into tangent space, the transpose brings normal map normals out
+in mat3 WorldToTangent;
+flat in uint MaterialIndex;
+
+// one layer per material map, filled by TexturePool
+uniform sampler2DArray albedoMaps;
+uniform sampler2DArray normalMaps;
+// r: ao, g: roughness, b: metallic, a: parallax depth
+uniform sampler2DArray ormMaps;
+
+// per material: albedo, normal and ORM layers, the entry of materials[] holding its parameters
+layout (std140) uniform MaterialBlock
+{
+    uvec4 materialLayers[256];
+};
+
+#include "MaterialParameters.glsl"
+
+float ormLayer;
+
+float ParallaxDepth(vec2 texCoords)
+{
+    return texture(ormMaps, vec3(texCoords, ormLayer)).a;
+}
+
+#include "Parallax.glsl"
+#include "ClusteredLighting.glsl"
+#include "SunLighting.glsl"
+#include "AmbientLighting.glsl"
+
+void main()
+{
+    uvec4 layers = materialLayers[MaterialIndex];
+    ormLayer = float(layers.z);
+
+    // offset texture coordinates with Parallax Mapping
+    vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
+    vec2 texCoords = fs_in.TexCoords;
+	if (texCoords.x > 1.0f)
+		texCoords.x -= floor(texCoords.x);
+	if (texCoords.y > 1.0f)
+		texCoords.y -= floor(texCoords.y);
+    
+    texCoords = ParallaxMapping(texCoords, viewDir, materials[layers.w].heightScale);
+    //if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
+        //discard;
+
+    // obtain normal from normal map
+    vec3 normal = texture(normalMaps, vec3(texCoords, float(layers.y))).rgb;
+    normal = normalize(normal * 2.0 - 1.0);   
+   
+    // the shared lighting works in world space, WorldToTangent is a rotation
+    vec3 worldNormal = normal * WorldToTangent;
+    vec3 worldViewDir = viewDir * WorldToTangent;
+   
+    // get diffuse color
+    vec3 color = texture(albedoMaps, vec3(texCoords, float(layers.x))).rgb;
+    // ambient
+    vec3 orm = texture(ormMaps, vec3(texCoords, ormLayer)).rgb;
+    vec3 ambient = AmbientLighting(fs_in.FragPos, worldNormal, worldViewDir, color, orm.r, orm.g, orm.b);
+    vec3 sun = SunLighting(fs_in.FragPos, worldNormal, worldViewDir, color, orm.g, orm.b);
+    vec3 clustered = ClusteredLighting(fs_in.FragPos, worldNormal, worldViewDir, color, orm.g, orm.b);
+    FragColor = vec4(ambient + sun + clustered, 1.0);
+}
\ No newline at end of file
@@ -9,10 +9,8 @@ in vec3 Normal;
 // material parameters
 uniform sampler2D albedoMap;
 uniform sampler2D normalMap;
-uniform sampler2D metallicMap;
-uniform sampler2D roughnessMap;
-uniform sampler2D aoMap;
-uniform sampler2D depthMap;
+// r: ao, g: roughness, b: metallic, a: parallax depth
+uniform sampler2D ormMap;
 
 
 in VS_OUT {
@@ -117,14 +115,14 @@ vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
   
     // get initial values
     vec2  currentTexCoords     = texCoords;
-    float currentDepthMapValue = texture(depthMap, currentTexCoords).r;
+    float currentDepthMapValue = texture(ormMap, currentTexCoords).a;
       
     while(currentLayerDepth < currentDepthMapValue)
     {
         // shift texture coordinates along direction of P
         currentTexCoords -= deltaTexCoords;
         // get depthmap value at current texture coordinates
-        currentDepthMapValue = texture(depthMap, currentTexCoords).r;  
+        currentDepthMapValue = texture(ormMap, currentTexCoords).a;  
         // get depth of next layer
         currentLayerDepth += layerDepth;  
     }
@@ -142,9 +140,10 @@ void main()
         discard;
 
     vec3  albedo    = pow(texture(albedoMap, texCoords).rgb, vec3(2.2));
-    float metallic  = texture(metallicMap, texCoords).r;
-    float roughness = texture(roughnessMap, texCoords).r;
-    float ao        = texture(aoMap, texCoords).r;
+    vec3  orm       = texture(ormMap, texCoords).rgb;
+    float ao        = orm.r;
+    float roughness = orm.g;
+    float metallic  = orm.b;
 
     vec3 N = getNormalFromMap(texCoords);
     vec3 V = normalize(camPos - WorldPos);
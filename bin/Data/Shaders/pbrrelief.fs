@@ -0,0 +1,103 @@
+#version 330 core
+out vec4 FragColor;
+
+in VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    vec3 TangentViewPos;
+    vec3 TangentFragPos;
+} fs_in;
+
+// rotates world space directions into tangent space, the transpose brings normal map normals out
+in mat3 WorldToTangent;
+
+uniform sampler2D albedoMap;
+uniform sampler2D normalMap;
+// r: ao, g: roughness, b: metallic, a: parallax depth
+uniform sampler2D ormMap;
+
+// r: depth, g: square root of the relaxed cone ratio (see ReliefMap)
+uniform sampler2D reliefMap;
+
+// MaterialParameters materials[] and materialIndex, generated from the MaterialSchema in Main.cpp
+#include "MaterialParameters.glsl"
+
+// relief mapping depth and cost/quality of the current material
+float heightScale;
+int coneSteps;
+int binarySteps;
+
+// relaxed cone stepping: each step moves the ray to the edge of the cone stored under it, which
+// can't pass more than one crossing of the surface, then a binary search finds the crossing
+vec2 ReliefMapping(vec2 texCoords, vec3 viewDir)
+{
+    if (heightScale == 0)
+        return texCoords;
+
+    // the view ray in (uv, depth), scaled to move one unit of depth
+    vec3 rayStep = vec3(-viewDir.xy / viewDir.z * heightScale, 1.0);
+    float rayLength = length(rayStep.xy);
+    vec3 position = vec3(texCoords, 0.0);
+
+    for (int i = 0; i < coneSteps; i++)
+    {
+        vec2 relief = texture(reliefMap, position.xy).rg;
+        float height = clamp(relief.r - position.z, 0.0, 1.0);
+        float coneRatio = relief.g * relief.g;
+        position += rayStep * (coneRatio * height / max(rayLength + coneRatio, 0.0001));
+    }
+
+    // the crossing lies between the start of the ray and the last cone step
+    vec3 delta = rayStep * position.z * 0.5;
+    position = vec3(texCoords, 0.0) + delta;
+    for (int i = 0; i < binarySteps; i++)
+    {
+        delta *= 0.5;
+        if (position.z < texture(reliefMap, position.xy).r)
+            position += delta;
+        else
+            position -= delta;
+    }
+
+    return position.xy;
+}
+
+#include "ClusteredLighting.glsl"
+#include "SunLighting.glsl"
+#include "AmbientLighting.glsl"
+
+void main()
+{
+    heightScale = materials[materialIndex].heightScale;
+    coneSteps = materials[materialIndex].coneSteps;
+    binarySteps = materials[materialIndex].binarySteps;
+
+    // offset texture coordinates with relief mapping
+    vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
+    vec2 texCoords = fs_in.TexCoords;
+	if (texCoords.x > 1.0f)
+		texCoords.x -= floor(texCoords.x);
+	if (texCoords.y > 1.0f)
+		texCoords.y -= floor(texCoords.y);
+    
+    texCoords = ReliefMapping(texCoords, viewDir);
+    //if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
+        //discard;
+
+    // obtain normal from normal map
+    vec3 normal = texture(normalMap, texCoords).rgb;
+    normal = normalize(normal * 2.0 - 1.0);   
+   
+    // the shared lighting works in world space, WorldToTangent is a rotation
+    vec3 worldNormal = normal * WorldToTangent;
+    vec3 worldViewDir = viewDir * WorldToTangent;
+   
+    // get diffuse color
+    vec3 color = texture(albedoMap, texCoords).rgb;
+    // ambient
+    vec3 orm = texture(ormMap, texCoords).rgb;
+    vec3 ambient = AmbientLighting(fs_in.FragPos, worldNormal, worldViewDir, color, orm.r, orm.g, orm.b);
+    vec3 sun = SunLighting(fs_in.FragPos, worldNormal, worldViewDir, color, orm.g, orm.b);
+    vec3 clustered = ClusteredLighting(fs_in.FragPos, worldNormal, worldViewDir, color, orm.g, orm.b);
+    FragColor = vec4(ambient + sun + clustered, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 330 core
+in vec3 FragPos;
+
+// xyz: light position, w: range
+uniform vec4 lightPositionRange;
+
+// glPolygonOffset(2, 4) by hand, polygon offset doesn't reach depth the shader writes
+const float SLOPE_BIAS = 2.0;
+const float CONSTANT_BIAS = 4.0 / 16777216.0;
+
+void main()
+{
+    // distance over range, the same on every face so the lookups need no per face projection
+    float depth = length(FragPos - lightPositionRange.xyz) / lightPositionRange.w;
+    float slope = max(abs(dFdx(depth)), abs(dFdy(depth)));
+    gl_FragDepth = depth + SLOPE_BIAS * slope + CONSTANT_BIAS;
+}
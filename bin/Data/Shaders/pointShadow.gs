@@ -0,0 +1,40 @@
+#version 330 core
+// draws every triangle into each face of the light's cube it can touch, see PointShadowAtlas
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+uniform mat4 faceMatrices[6];
+// layer of the slot's first face
+uniform int firstLayer;
+// the faces the caster's bounds reach, one bit per face
+uniform int faceMask;
+
+out vec3 FragPos;
+
+void main()
+{
+    for (int face = 0; face < 6; face++)
+    {
+        if ((faceMask & (1 << face)) == 0)
+            continue;
+
+        vec4 clip[3];
+        for (int i = 0; i < 3; i++)
+            clip[i] = faceMatrices[face] * gl_in[i].gl_Position;
+        // skip the face when the whole triangle is outside one of its side planes
+        if ((clip[0].x > clip[0].w && clip[1].x > clip[1].w && clip[2].x > clip[2].w) ||
+            (clip[0].x < -clip[0].w && clip[1].x < -clip[1].w && clip[2].x < -clip[2].w) ||
+            (clip[0].y > clip[0].w && clip[1].y > clip[1].w && clip[2].y > clip[2].w) ||
+            (clip[0].y < -clip[0].w && clip[1].y < -clip[1].w && clip[2].y < -clip[2].w))
+            continue;
+
+        for (int i = 0; i < 3; i++)
+        {
+            gl_Layer = firstLayer + face;
+            FragPos = gl_in[i].gl_Position.xyz;
+            gl_Position = clip[i];
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
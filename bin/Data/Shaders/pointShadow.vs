@@ -0,0 +1,10 @@
+#version 330 core
+// world space positions for pointShadow.gs, which projects them onto the cube faces
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+
+void main()
+{
+    gl_Position = model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) out uint VisibilityID;
+
+flat in uint ObjectIndex;
+
+// must match VisibilityBuffer::TRIANGLE_BITS
+const uint TRIANGLE_BITS = 18u;
+
+void main()
+{
+    // gl_PrimitiveID restarts with every draw command, so it's the triangle's index in its mesh
+    VisibilityID = (ObjectIndex << TRIANGLE_BITS) | uint(gl_PrimitiveID);
+}
@@ -0,0 +1,195 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// object << TRIANGLE_BITS | triangle, all ones where nothing was drawn
+uniform usampler2D visibilityBuffer;
+// the geometry heap: Model::Vertex as 7 RG32F texels and 32 bit indices
+uniform samplerBuffer vertices;
+uniform usamplerBuffer indices;
+// per object: first index, base vertex, material, mesh (see IndirectDrawList::EnableObjectTable)
+uniform usamplerBuffer objects;
+// one mat4 per object, stored as 4 RGBA32F texels
+uniform samplerBuffer instanceTransforms;
+uniform vec2 screenSize;
+
+// one layer per material map, filled by TexturePool
+uniform sampler2DArray albedoMaps;
+uniform sampler2DArray normalMaps;
+// r: ao, g: roughness, b: metallic, a: parallax depth
+uniform sampler2DArray ormMaps;
+
+// per material: albedo, normal and ORM layers, the entry of materials[] holding its parameters
+layout (std140) uniform MaterialBlock
+{
+    uvec4 materialLayers[256];
+};
+
+#include "MaterialParameters.glsl"
+
+// the forward shaders' lighting, so the visibility buffer draws the same image
+#include "ClusteredLighting.glsl"
+#include "SunLighting.glsl"
+#include "AmbientLighting.glsl"
+
+// must match VisibilityBuffer::TRIANGLE_BITS
+const uint TRIANGLE_BITS = 18u;
+
+struct Vertex
+{
+    vec3 Position;
+    vec3 Normal;
+    vec2 TexCoords;
+    vec3 Tangent;
+    vec3 Bitangent;
+};
+
+Vertex FetchVertex(uint index)
+{
+    int base = int(index) * 7;
+    vec2 t0 = texelFetch(vertices, base).rg;
+    vec2 t1 = texelFetch(vertices, base + 1).rg;
+    vec2 t2 = texelFetch(vertices, base + 2).rg;
+    vec2 t3 = texelFetch(vertices, base + 3).rg;
+    vec2 t4 = texelFetch(vertices, base + 4).rg;
+    vec2 t5 = texelFetch(vertices, base + 5).rg;
+    vec2 t6 = texelFetch(vertices, base + 6).rg;
+
+    Vertex vertex;
+    vertex.Position = vec3(t0, t1.x);
+    vertex.Normal = vec3(t1.y, t2);
+    vertex.TexCoords = t3;
+    vertex.Tangent = vec3(t4, t5.x);
+    vertex.Bitangent = vec3(t5.y, t6);
+    return vertex;
+}
+
+// Perspective correct barycentrics of the pixel and their change one pixel right and up, from
+// the triangle's clip space positions (Schied and Dachsbacher, "Deferred Attribute Interpolation
+// for Memory-Efficient Deferred Shading"). The derivatives stand in for the ones the rasteriser
+// would have given the forward shader, so texture filtering picks the same mip levels.
+struct Barycentrics
+{
+    vec3 Lambda;
+    vec3 Ddx;
+    vec3 Ddy;
+};
+
+Barycentrics ComputeBarycentrics(vec4 p0, vec4 p1, vec4 p2, vec2 pixelNDC)
+{
+    vec3 invW = 1.0 / vec3(p0.w, p1.w, p2.w);
+    vec2 ndc0 = p0.xy * invW.x;
+    vec2 ndc1 = p1.xy * invW.y;
+    vec2 ndc2 = p2.xy * invW.z;
+
+    float invDet = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+    vec3 ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+    vec3 ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+    float ddxSum = dot(ddx, vec3(1.0));
+    float ddySum = dot(ddy, vec3(1.0));
+
+    vec2 delta = pixelNDC - ndc0;
+    float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+    float interpW = 1.0 / interpInvW;
+
+    Barycentrics result;
+    result.Lambda = interpW * (vec3(invW.x, 0.0, 0.0) + delta.x * ddx + delta.y * ddy);
+
+    // one pixel is 2 / size in normalised device coordinates
+    vec2 pixelSize = 2.0 / screenSize;
+    ddx *= pixelSize.x;
+    ddy *= pixelSize.y;
+    ddxSum *= pixelSize.x;
+    ddySum *= pixelSize.y;
+    result.Ddx = (result.Lambda * interpInvW + ddx) / (interpInvW + ddxSum) - result.Lambda;
+    result.Ddy = (result.Lambda * interpInvW + ddy) / (interpInvW + ddySum) - result.Lambda;
+    return result;
+}
+
+float ormLayer;
+vec2 texCoordsDdx;
+vec2 texCoordsDdy;
+
+// the parallax steps with the gradients of the triangle, not of the screen quad
+float ParallaxDepth(vec2 texCoords)
+{
+    return textureGrad(ormMaps, vec3(texCoords, ormLayer), texCoordsDdx, texCoordsDdy).a;
+}
+
+#include "Parallax.glsl"
+
+void main()
+{
+    uint id = texelFetch(visibilityBuffer, ivec2(gl_FragCoord.xy), 0).r;
+    // nothing was drawn here, whatever the target already holds stays
+    if (id == 0xffffffffu)
+        discard;
+
+    uint object = id >> TRIANGLE_BITS;
+    uint triangle = id & ((1u << TRIANGLE_BITS) - 1u);
+    uvec4 objectData = texelFetch(objects, int(object));
+
+    int firstIndex = int(objectData.x + triangle * 3u);
+    Vertex v0 = FetchVertex(texelFetch(indices, firstIndex).r + objectData.y);
+    Vertex v1 = FetchVertex(texelFetch(indices, firstIndex + 1).r + objectData.y);
+    Vertex v2 = FetchVertex(texelFetch(indices, firstIndex + 2).r + objectData.y);
+
+    int base = int(object) * 4;
+    mat4 model = mat4(texelFetch(instanceTransforms, base),
+                      texelFetch(instanceTransforms, base + 1),
+                      texelFetch(instanceTransforms, base + 2),
+                      texelFetch(instanceTransforms, base + 3));
+    // the same expressions as indirect.vs, per corner
+    vec3 world0 = vec3(model * vec4(v0.Position, 1.0));
+    vec3 world1 = vec3(model * vec4(v1.Position, 1.0));
+    vec3 world2 = vec3(model * vec4(v2.Position, 1.0));
+    mat4 viewProjection = projection * view;
+    Barycentrics bary = ComputeBarycentrics(viewProjection * vec4(world0, 1.0), viewProjection * vec4(world1, 1.0),
+                                            viewProjection * vec4(world2, 1.0), TexCoords * 2.0 - 1.0);
+
+    mat3 worldRows = mat3(world0, world1, world2);
+    vec3 fragPos = worldRows * bary.Lambda;
+    // the rasteriser's derivatives are of the screen quad, the shadow lookup wants the triangle's
+    vec3 fragPosDdx = worldRows * bary.Ddx;
+    vec3 fragPosDdy = worldRows * bary.Ddy;
+    // depth from the triangle, so the result is depth tested against what's already in the target
+    vec4 clipPos = viewProjection * vec4(fragPos, 1.0);
+    gl_FragDepth = clipPos.z / clipPos.w * 0.5 + 0.5;
+    mat3x2 texCoordRows = mat3x2(v0.TexCoords, v1.TexCoords, v2.TexCoords);
+    vec2 texCoords = texCoordRows * bary.Lambda;
+    texCoordsDdx = texCoordRows * bary.Ddx;
+    texCoordsDdy = texCoordRows * bary.Ddy;
+
+    vec3 T = normalize(mat3(model) * (mat3(v0.Tangent, v1.Tangent, v2.Tangent) * bary.Lambda));
+    vec3 B = normalize(mat3(model) * (mat3(v0.Bitangent, v1.Bitangent, v2.Bitangent) * bary.Lambda));
+    vec3 N = normalize(mat3(model) * (mat3(v0.Normal, v1.Normal, v2.Normal) * bary.Lambda));
+    mat3 TBN = transpose(mat3(T, B, N));
+    vec3 tangentViewPos = TBN * viewPosition.xyz;
+    vec3 tangentFragPos = TBN * fragPos;
+
+    // from here on the material is shaded exactly as pbr.fs does
+    uvec4 layers = materialLayers[objectData.z];
+    ormLayer = float(layers.z);
+
+    vec3 viewDir = normalize(tangentViewPos - tangentFragPos);
+    if (texCoords.x > 1.0f)
+        texCoords.x -= floor(texCoords.x);
+    if (texCoords.y > 1.0f)
+        texCoords.y -= floor(texCoords.y);
+    texCoords = ParallaxMapping(texCoords, viewDir, materials[layers.w].heightScale);
+
+    vec3 normal = textureGrad(normalMaps, vec3(texCoords, float(layers.y)), texCoordsDdx, texCoordsDdy).rgb;
+    normal = normalize(normal * 2.0 - 1.0);
+
+    // the shared lighting works in world space, TBN is a rotation
+    vec3 worldNormal = normal * TBN;
+    vec3 worldViewDir = viewDir * TBN;
+
+    vec3 color = textureGrad(albedoMaps, vec3(texCoords, float(layers.x)), texCoordsDdx, texCoordsDdy).rgb;
+    vec3 orm = textureGrad(ormMaps, vec3(texCoords, ormLayer), texCoordsDdx, texCoordsDdy).rgb;
+    vec3 ambient = AmbientLighting(fragPos, worldNormal, worldViewDir, color, orm.r, orm.g, orm.b);
+    vec3 sun = SunLightingGrad(fragPos, fragPosDdx, fragPosDdy, worldNormal, worldViewDir, color, orm.g, orm.b);
+    vec3 clustered = ClusteredLighting(fragPos, worldNormal, worldViewDir, color, orm.g, orm.b);
+    FragColor = vec4(ambient + sun + clustered, 1.0);
+}
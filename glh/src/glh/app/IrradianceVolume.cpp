@@ -0,0 +1,357 @@
+#include "IrradianceVolume.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "../graphics/GLResources.h"
+#include "../graphics/GLState.h"
+#include "../util/Log.h"
+#include "../util/Parallel.h"
+#include "../util/Timer.h"
+
+namespace glh {
+	namespace App {
+
+		static const char PROBE_MAGIC[4] = { 'P', 'R', 'B', '2' };
+		static const float PI = 3.14159265358979f;
+		// rays start this far off the surface they leave
+		static const float SURFACE_OFFSET = 1e-3f;
+		static const uint64_t MAX_PROBES = 1 << 20;
+
+		void IrradianceVolume::Bake(const Scene& scene, const BakeSettings& settings)
+		{
+			double startTime = Util::Timer::GetTime();
+
+			bakeSettings = settings;
+			bakeSettings.Sky = nullptr;
+			skyKey = GetSkyKey(settings);
+			sceneHash = GetInstanceHash(scene);
+			missingSky = settings.Sky != nullptr && settings.Sky->IsEmpty();
+			if (missingSky)
+				Util::Log::WriteWarning("PROBES: the sky is empty, baking against SkyColor");
+
+			origin = settings.Bounds.Min;
+			spacing = settings.Spacing;
+			GetProbeCounts(settings, probeCounts);
+			if (GetProbeCount() == 0)
+			{
+				Util::Log::WriteError("PROBES: the grid needs more than " + std::to_string(MAX_PROBES) + " probes");
+				coefficients.clear();
+				return;
+			}
+
+			// a spherical Fibonacci set, the same for every probe so neighbours don't differ by noise
+			std::vector<glm::vec3> directions(settings.RaysPerProbe);
+			const float goldenAngle = PI * (3.0f - std::sqrt(5.0f));
+			for (unsigned int i = 0; i < settings.RaysPerProbe; i++)
+			{
+				float z = 1.0f - (2.0f * i + 1.0f) / settings.RaysPerProbe;
+				float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+				float phi = goldenAngle * i;
+				directions[i] = glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+			}
+
+			uint32_t probeCount = GetProbeCount();
+			coefficients.assign(probeCount * SH_COEFFICIENTS, glm::vec3(0.0f));
+			Util::Parallel::For(probeCount, [&](unsigned int probe)
+			{
+				glm::vec3 position = origin + spacing * glm::vec3(
+					(float)(probe % probeCounts[0]),
+					(float)((probe / probeCounts[0]) % probeCounts[1]),
+					(float)(probe / (probeCounts[0] * probeCounts[1])));
+
+				// seeded per probe so the result doesn't depend on which thread baked it
+				std::mt19937 random(probe);
+
+				glm::vec3 radiance[SH_COEFFICIENTS] = {};
+				Graphics::Ray ray;
+				ray.Origin = position;
+				ray.MaxDistance = settings.MaxDistance;
+				for (const glm::vec3& direction : directions)
+				{
+					ray.Direction = direction;
+					glm::vec3 light = Trace(scene, settings, ray, random);
+					radiance[0] += light * 0.282095f;
+					radiance[1] += light * (0.488603f * direction.y);
+					radiance[2] += light * (0.488603f * direction.z);
+					radiance[3] += light * (0.488603f * direction.x);
+				}
+
+				// every ray stands for the same solid angle. Convolving with the cosine scales the
+				// bands by pi and 2pi / 3, the shaders want irradiance / pi with the basis constants
+				// folded in, like the sky's in ImageBasedLighting.
+				float solidAngle = 4.0f * PI / settings.RaysPerProbe;
+				glm::vec3* probeCoefficients = &coefficients[probe * SH_COEFFICIENTS];
+				probeCoefficients[0] = radiance[0] * (solidAngle * 0.282095f);
+				for (unsigned int i = 1; i < SH_COEFFICIENTS; i++)
+					probeCoefficients[i] = radiance[i] * (solidAngle * 2.0f / 3.0f * 0.488603f);
+			});
+
+			Util::Log::WriteInfo("PROBES: baked " + std::to_string(probeCounts[0]) + "x" + std::to_string(probeCounts[1]) + "x" +
+				std::to_string(probeCounts[2]) + " probes with " + std::to_string(settings.RaysPerProbe) + " rays each in " +
+				std::to_string(Util::Timer::GetTime() - startTime) + "s on " + std::to_string(Util::Parallel::GetWorkerCount()) + " threads");
+		}
+
+		// A surface the ray hits is lit by the sun if nothing stands between them, and by the sky
+		// through one cosine distributed ray, which averages out over the probe's many rays.
+		glm::vec3 IrradianceVolume::Trace(const Scene& scene, const BakeSettings& settings, const Graphics::Ray& ray, std::mt19937& random)
+		{
+			float groundDistance = FLT_MAX;
+			if (settings.HasGround && ray.Direction.y < 0.0f && ray.Origin.y > settings.GroundHeight)
+				groundDistance = (settings.GroundHeight - ray.Origin.y) / ray.Direction.y;
+
+			Graphics::RayHit hit;
+			bool hitScene = RayCastClosest(scene, ray, &hit) && hit.Distance < groundDistance;
+			if (!hitScene && groundDistance > ray.MaxDistance)
+				return GetSkyRadiance(settings, ray.Direction);
+
+			glm::vec3 position, normal, albedo;
+			if (hitScene)
+			{
+				position = ray.Origin + ray.Direction * hit.Distance;
+				normal = GetHitNormal(scene, hit);
+				// leaves are seen from both sides
+				if (glm::dot(normal, ray.Direction) > 0.0f)
+					normal = -normal;
+				albedo = settings.Albedo;
+			}
+			else
+			{
+				position = ray.Origin + ray.Direction * groundDistance;
+				normal = glm::vec3(0.0f, 1.0f, 0.0f);
+				albedo = settings.GroundAlbedo;
+			}
+
+			Graphics::Ray bounce;
+			bounce.Origin = position + normal * SURFACE_OFFSET;
+			bounce.MaxDistance = settings.MaxDistance;
+
+			glm::vec3 irradiance(0.0f);
+			float NdotL = -glm::dot(normal, settings.SunDirection);
+			if (NdotL > 0.0f)
+			{
+				bounce.Direction = -settings.SunDirection;
+				if (!RayCastAny(scene, bounce))
+					irradiance += settings.SunColor * NdotL;
+			}
+
+			// cosine distributed around the normal, so the sky's irradiance is pi times its radiance
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+			float u = unit(random);
+			float phi = 2.0f * PI * unit(random);
+			float r = std::sqrt(u);
+			glm::vec3 up = std::fabs(normal.y) < 0.999f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+			glm::vec3 tangent = glm::normalize(glm::cross(up, normal));
+			glm::vec3 bitangent = glm::cross(normal, tangent);
+			bounce.Direction = tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * std::sqrt(1.0f - u);
+			bool groundBlocks = settings.HasGround && bounce.Direction.y < 0.0f;
+			if (!groundBlocks && !RayCastAny(scene, bounce))
+				irradiance += GetSkyRadiance(settings, bounce.Direction) * PI;
+
+			return albedo * irradiance / PI;
+		}
+
+		glm::vec3 IrradianceVolume::GetSkyRadiance(const BakeSettings& settings, const glm::vec3& direction)
+		{
+			return settings.Sky != nullptr && !settings.Sky->IsEmpty() ? settings.Sky->GetRadiance(direction) : settings.SkyColor;
+		}
+
+		uint64_t IrradianceVolume::GetSkyKey(const BakeSettings& settings)
+		{
+			return settings.Sky != nullptr ? settings.Sky->GetSourceKey() : 0;
+		}
+
+		void IrradianceVolume::GetProbeCounts(const BakeSettings& settings, uint32_t* counts)
+		{
+			// in floats so a tiny spacing can't overflow before the bound is checked
+			glm::vec3 extent = settings.Bounds.Extent();
+			float total = 1.0f;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float count = std::max(2.0f, std::ceil(extent[axis] / settings.Spacing) + 1.0f);
+				total *= count;
+				counts[axis] = (uint32_t)std::min(count, (float)MAX_PROBES);
+			}
+			if (!(total <= (float)MAX_PROBES))
+				counts[0] = counts[1] = counts[2] = 0;
+		}
+
+		bool IrradianceVolume::SameSettings(const BakeSettings& a, const BakeSettings& b)
+		{
+			return a.Bounds.Min == b.Bounds.Min && a.Bounds.Max == b.Bounds.Max && a.Spacing == b.Spacing &&
+				a.RaysPerProbe == b.RaysPerProbe && a.MaxDistance == b.MaxDistance && a.SkyColor == b.SkyColor &&
+				a.SunDirection == b.SunDirection && a.SunColor == b.SunColor && a.Albedo == b.Albedo &&
+				a.HasGround == b.HasGround && a.GroundHeight == b.GroundHeight && a.GroundAlbedo == b.GroundAlbedo;
+		}
+
+		bool IrradianceVolume::Save(const std::string& path) const
+		{
+			if (coefficients.empty())
+				return false;
+			// the next run would load probes lit by the wrong sky
+			if (missingSky)
+			{
+				Util::Log::WriteWarning("PROBES: not saving " + path + ", it was baked without its sky");
+				return false;
+			}
+
+			std::ofstream file(path, std::ios::binary);
+			if (!file)
+			{
+				Util::Log::WriteError("PROBES: could not write " + path);
+				return false;
+			}
+
+			uint8_t hasGround = bakeSettings.HasGround ? 1 : 0;
+			file.write(PROBE_MAGIC, sizeof(PROBE_MAGIC));
+			file.write((const char*)&bakeSettings.Bounds, sizeof(bakeSettings.Bounds));
+			file.write((const char*)&bakeSettings.Spacing, sizeof(bakeSettings.Spacing));
+			file.write((const char*)&bakeSettings.RaysPerProbe, sizeof(bakeSettings.RaysPerProbe));
+			file.write((const char*)&bakeSettings.MaxDistance, sizeof(bakeSettings.MaxDistance));
+			file.write((const char*)&bakeSettings.SkyColor, sizeof(bakeSettings.SkyColor));
+			file.write((const char*)&bakeSettings.SunDirection, sizeof(bakeSettings.SunDirection));
+			file.write((const char*)&bakeSettings.SunColor, sizeof(bakeSettings.SunColor));
+			file.write((const char*)&bakeSettings.Albedo, sizeof(bakeSettings.Albedo));
+			file.write((const char*)&hasGround, sizeof(hasGround));
+			file.write((const char*)&bakeSettings.GroundHeight, sizeof(bakeSettings.GroundHeight));
+			file.write((const char*)&bakeSettings.GroundAlbedo, sizeof(bakeSettings.GroundAlbedo));
+			file.write((const char*)&skyKey, sizeof(skyKey));
+			file.write((const char*)&sceneHash, sizeof(sceneHash));
+			file.write((const char*)probeCounts, sizeof(probeCounts));
+			file.write((const char*)coefficients.data(), coefficients.size() * sizeof(glm::vec3));
+			return true;
+		}
+
+		bool IrradianceVolume::Load(const std::string& path, const Scene& scene, const BakeSettings& settings)
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
+				return false;
+
+			char magic[4];
+			file.read(magic, sizeof(magic));
+			if (!file || std::string(magic, 4) != std::string(PROBE_MAGIC, 4))
+			{
+				Util::Log::WriteError("PROBES: " + path + " is not a probe file");
+				return false;
+			}
+
+			BakeSettings fileSettings;
+			uint8_t hasGround = 0;
+			uint64_t fileSkyKey = 0;
+			uint64_t fileSceneHash = 0;
+			file.read((char*)&fileSettings.Bounds, sizeof(fileSettings.Bounds));
+			file.read((char*)&fileSettings.Spacing, sizeof(fileSettings.Spacing));
+			file.read((char*)&fileSettings.RaysPerProbe, sizeof(fileSettings.RaysPerProbe));
+			file.read((char*)&fileSettings.MaxDistance, sizeof(fileSettings.MaxDistance));
+			file.read((char*)&fileSettings.SkyColor, sizeof(fileSettings.SkyColor));
+			file.read((char*)&fileSettings.SunDirection, sizeof(fileSettings.SunDirection));
+			file.read((char*)&fileSettings.SunColor, sizeof(fileSettings.SunColor));
+			file.read((char*)&fileSettings.Albedo, sizeof(fileSettings.Albedo));
+			file.read((char*)&hasGround, sizeof(hasGround));
+			file.read((char*)&fileSettings.GroundHeight, sizeof(fileSettings.GroundHeight));
+			file.read((char*)&fileSettings.GroundAlbedo, sizeof(fileSettings.GroundAlbedo));
+			file.read((char*)&fileSkyKey, sizeof(fileSkyKey));
+			file.read((char*)&fileSceneHash, sizeof(fileSceneHash));
+			fileSettings.HasGround = hasGround != 0;
+			if (!file || !SameSettings(fileSettings, settings) || fileSkyKey != GetSkyKey(settings) || fileSceneHash != GetInstanceHash(scene))
+			{
+				Util::Log::WriteInfo("PROBES: " + path + " was baked from another scene, sky or other settings");
+				return false;
+			}
+
+			// the counts follow from the settings, anything else is a damaged file
+			uint32_t fileProbeCounts[3];
+			file.read((char*)fileProbeCounts, sizeof(fileProbeCounts));
+			GetProbeCounts(settings, probeCounts);
+			if (!file || GetProbeCount() == 0 || fileProbeCounts[0] != probeCounts[0] || fileProbeCounts[1] != probeCounts[1] ||
+				fileProbeCounts[2] != probeCounts[2])
+			{
+				Util::Log::WriteError("PROBES: " + path + " has a corrupt header");
+				coefficients.clear();
+				return false;
+			}
+
+			bakeSettings = settings;
+			bakeSettings.Sky = nullptr;
+			skyKey = fileSkyKey;
+			sceneHash = fileSceneHash;
+			missingSky = false;
+			origin = settings.Bounds.Min;
+			spacing = settings.Spacing;
+			coefficients.resize((size_t)GetProbeCount() * SH_COEFFICIENTS);
+			file.read((char*)coefficients.data(), coefficients.size() * sizeof(glm::vec3));
+
+			if (!file)
+			{
+				Util::Log::WriteError("PROBES: " + path + " is truncated");
+				coefficients.clear();
+				return false;
+			}
+			return true;
+		}
+
+		bool IrradianceVolume::Upload()
+		{
+			bool baked = !coefficients.empty();
+			if (!baked)
+				Util::Log::WriteWarning("PROBES: nothing was baked or loaded, the shaders fall back to the sky");
+
+			// without probes a single zero probe keeps the texture and the ProbeBlock valid, and
+			// probeOrigin.w = 0 tells the shaders there's no grid
+			uint32_t counts[3] = { 1, 1, 1 };
+			if (baked)
+				std::copy(probeCounts, probeCounts + 3, counts);
+
+			// red, green and blue each take a block of counts[2] slices
+			uint32_t probeCount = counts[0] * counts[1] * counts[2];
+			std::vector<float> texels((size_t)probeCount * 3 * SH_COEFFICIENTS, 0.0f);
+			for (uint32_t channel = 0; baked && channel < 3; channel++)
+			{
+				for (uint32_t probe = 0; probe < probeCount; probe++)
+				{
+					float* texel = &texels[(channel * probeCount + probe) * SH_COEFFICIENTS];
+					for (unsigned int i = 0; i < SH_COEFFICIENTS; i++)
+						texel[i] = coefficients[probe * SH_COEFFICIENTS + i][channel];
+				}
+			}
+
+			probeTexture = Graphics::GLResources::CreateTexture3D(GL_TEXTURE_3D, GL_RGBA16F, counts[0], counts[1], counts[2] * 3);
+			Graphics::GLResources::UploadTexture3D(GL_TEXTURE_3D, probeTexture, 0, 0, counts[0], counts[1], counts[2] * 3,
+				GL_RGBA, GL_FLOAT, texels.data());
+			Graphics::GLResources::SetTextureParameter(GL_TEXTURE_3D, probeTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			Graphics::GLResources::SetTextureParameter(GL_TEXTURE_3D, probeTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			Graphics::GLResources::SetTextureParameter(GL_TEXTURE_3D, probeTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			Graphics::GLResources::SetTextureParameter(GL_TEXTURE_3D, probeTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			Graphics::GLResources::SetTextureParameter(GL_TEXTURE_3D, probeTexture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+			Graphics::ProbeBlock block;
+			block.Origin = glm::vec4(origin, baked ? 1.0f : 0.0f);
+			block.InverseSpacing = glm::vec4(glm::vec3(baked ? 1.0f / spacing : 1.0f), 0.0f);
+			block.Counts = glm::vec4((float)counts[0], (float)counts[1], (float)counts[2], 0.0f);
+			blockBuffer = Graphics::GLResources::CreateBuffer(sizeof(Graphics::ProbeBlock), &block);
+			return baked;
+		}
+
+		void IrradianceVolume::SetupProgram(Graphics::Shader* program) const
+		{
+			program->use();
+			program->setInt("probeIrradiance", PROBE_TEXTURE_UNIT);
+		}
+
+		void IrradianceVolume::Bind() const
+		{
+			Graphics::GLState::BindTexture(PROBE_TEXTURE_UNIT, GL_TEXTURE_3D, probeTexture);
+			glBindBufferBase(GL_UNIFORM_BUFFER, Graphics::PROBE_BLOCK_BINDING, blockBuffer);
+		}
+
+		uint32_t IrradianceVolume::GetProbeCount() const
+		{
+			// GetProbeCounts keeps the product within MAX_PROBES
+			return probeCounts[0] * probeCounts[1] * probeCounts[2];
+		}
+	}
+}
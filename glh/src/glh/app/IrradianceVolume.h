@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <string>
+
+#include "Scene.h"
+#include "../graphics/AABB.h"
+#include "../graphics/ImageBasedLighting.h"
+#include "../graphics/UniformBlocks.h"
+
+namespace glh {
+	namespace App {
+
+		// Baked irradiance probes for static scenes.
+		// The baker places a grid of probes over a region and traces rays from each of them
+		// against the scene. A ray that escapes brings back the sky, one that hits a surface brings
+		// back what that surface reflects of the sun and the sky, so the probes hold the sky as the
+		// scene blocks it plus one bounce. Each probe's light is projected onto the first two
+		// spherical harmonics bands and convolved with the cosine lobe, which is as much as diffuse
+		// irradiance needs between probes this close.
+		//
+		// The grid is one RGBA16F 3D texture holding the four coefficients of red, then green, then
+		// blue, each a block of the full grid stacked along z. Shaders fetch the three blocks
+		// trilinearly and use the sky's own irradiance outside the grid:
+		//
+		// layout (std140) uniform ProbeBlock { vec4 probeOrigin; vec4 probeInverseSpacing; vec4 probeCounts; };
+		// uniform sampler3D probeIrradiance;
+		class IrradianceVolume
+		{
+		public:
+			static const unsigned int PROBE_TEXTURE_UNIT = 18;
+			// irradiance / pi of the first two bands, premultiplied by the basis constants
+			static const unsigned int SH_COEFFICIENTS = 4;
+
+			struct BakeSettings
+			{
+				// region the probes cover, there's a probe on every corner of the grid
+				Graphics::AABB Bounds;
+				float Spacing = 2.0f;
+				// rays per probe, spread evenly over the sphere
+				unsigned int RaysPerProbe = 256;
+				float MaxDistance = 1000.0f;
+
+				// the sky rays escape to, SkyColor when there's none
+				const Graphics::ImageBasedLighting* Sky = nullptr;
+				glm::vec3 SkyColor = glm::vec3(0.5f, 0.6f, 0.8f);
+				// the way the sun's light travels and its irradiance, white like the forward shaders'
+				glm::vec3 SunDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+				glm::vec3 SunColor = glm::vec3(1.0f);
+				// the scene has no materials to trace, so every surface reflects this much
+				glm::vec3 Albedo = glm::vec3(0.3f);
+
+				// an infinite floor under the scene, for ground that isn't one of its instances
+				bool HasGround = false;
+				float GroundHeight = 0.0f;
+				glm::vec3 GroundAlbedo = glm::vec3(0.25f);
+			};
+
+			// multithreaded over probes, results are deterministic for a given scene and settings.
+			// An empty Sky bakes against SkyColor instead and isn't saved.
+			void Bake(const Scene& scene, const BakeSettings& settings);
+
+			bool Save(const std::string& path) const;
+			// false if the file wasn't baked from this scene's instances, this sky and these settings
+			bool Load(const std::string& path, const Scene& scene, const BakeSettings& settings);
+
+			// creates the 3D texture and the ProbeBlock, false if nothing was baked or loaded, in which
+			// case they hold an empty grid so the shaders use the sky's irradiance
+			bool Upload();
+			// points the program's probeIrradiance sampler at PROBE_TEXTURE_UNIT
+			void SetupProgram(Graphics::Shader* program) const;
+			// binds the grid and the ProbeBlock for the shaders that follow
+			void Bind() const;
+
+			uint32_t GetProbeCount() const;
+
+		private:
+			// at least two on every axis, 0 if the grid would hold more than MAX_PROBES
+			static void GetProbeCounts(const BakeSettings& settings, uint32_t* counts);
+			static bool SameSettings(const BakeSettings& a, const BakeSettings& b);
+			// the sky's source key, 0 for SkyColor
+			static uint64_t GetSkyKey(const BakeSettings& settings);
+
+			// linear radiance arriving along the ray, random picks the sky ray of the surface it hits
+			static glm::vec3 Trace(const Scene& scene, const BakeSettings& settings, const Graphics::Ray& ray, std::mt19937& random);
+			static glm::vec3 GetSkyRadiance(const BakeSettings& settings, const glm::vec3& direction);
+
+			// what the probes were baked from, saved so Load can tell a stale file. Sky isn't used.
+			BakeSettings bakeSettings;
+			uint64_t skyKey = 0;
+			uint64_t sceneHash = 0;
+			// baked against SkyColor because Sky was empty
+			bool missingSky = false;
+
+			glm::vec3 origin;
+			float spacing = 0.0f;
+			uint32_t probeCounts[3] = { 0, 0, 0 };
+			// SH_COEFFICIENTS RGB coefficients per probe, x fastest
+			std::vector<glm::vec3> coefficients;
+
+			unsigned int probeTexture = 0;
+			unsigned int blockBuffer = 0;
+		};
+	}
+}
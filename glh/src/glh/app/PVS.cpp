@@ -0,0 +1,318 @@
+#include "PVS.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+
+#include "../util/Log.h"
+#include "../util/Parallel.h"
+#include "../util/Timer.h"
+
+namespace glh {
+	namespace App {
+
+		static const char PVS_MAGIC[4] = { 'P', 'V', 'S', '2' };
+		// more cells than this is a corrupt file rather than a bake
+		static const uint64_t MAX_CELLS = 1 << 24;
+
+		void PotentiallyVisibleSet::Bake(const Scene& scene, const BakeSettings& settings)
+		{
+			double startTime = Util::Timer::GetTime();
+
+			bakeSettings = settings;
+			sceneHash = GetInstanceHash(scene);
+			bounds = settings.Bounds;
+			GetCellCounts(settings, cellCounts);
+			clusterCount = GetInstanceCount(scene);
+
+			uint32_t cellCount = GetCellCount();
+			uint32_t rowSize = (clusterCount + 7) / 8;
+			glm::vec3 cellSize = GetCellSize();
+
+			std::vector<std::vector<uint8_t>> compressedCells(cellCount);
+			Util::Parallel::For(cellCount, [&](unsigned int cell)
+			{
+				std::vector<uint8_t> bits(rowSize, 0);
+				glm::vec3 cellMin = bounds.Min + cellSize * glm::vec3(
+					(float)(cell % cellCounts[0]),
+					(float)((cell / cellCounts[0]) % cellCounts[1]),
+					(float)(cell / (cellCounts[0] * cellCounts[1])));
+				Graphics::AABB cellBounds;
+				cellBounds.Grow(cellMin);
+				cellBounds.Grow(cellMin + cellSize);
+
+				// seeded per cell so the result doesn't depend on which thread baked it
+				std::mt19937 random(cell);
+				std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+				// anything the cell is inside of is trivially visible
+				for (uint32_t cluster = 0; cluster < clusterCount; cluster++)
+				{
+					if (GetInstanceBounds(scene, cluster).Overlaps(cellBounds))
+						bits[cluster / 8] |= 1 << (cluster % 8);
+				}
+
+				Graphics::Ray ray;
+				ray.MaxDistance = settings.MaxDistance;
+				Graphics::RayHit hit;
+				for (unsigned int sample = 0; sample < settings.SamplesPerCell; sample++)
+				{
+					ray.Origin = cellMin + cellSize * glm::vec3(unit(random), unit(random), unit(random));
+
+					for (unsigned int i = 0; i < settings.RaysPerSample; i++)
+					{
+						// uniform direction on the sphere
+						float z = unit(random) * 2.0f - 1.0f;
+						float phi = unit(random) * 6.28318530718f;
+						float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+						ray.Direction = glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+						if (RayCastClosest(scene, ray, &hit))
+							bits[hit.Instance / 8] |= 1 << (hit.Instance % 8);
+					}
+
+					for (uint32_t cluster = 0; cluster < clusterCount; cluster++)
+					{
+						if (bits[cluster / 8] & (1 << (cluster % 8)))
+							continue;
+
+						const Graphics::AABB& clusterBounds = GetInstanceBounds(scene, cluster);
+						for (unsigned int i = 0; i < settings.RaysPerCluster; i++)
+						{
+							glm::vec3 target = clusterBounds.Min + clusterBounds.Extent() * glm::vec3(unit(random), unit(random), unit(random));
+							// unnormalised so the target sits at distance 1 and the ray may run on past it
+							ray.Direction = target - ray.Origin;
+							ray.MaxDistance = settings.MaxDistance / std::max(glm::length(ray.Direction), 1e-6f);
+							if (RayCastClosest(scene, ray, &hit))
+								bits[hit.Instance / 8] |= 1 << (hit.Instance % 8);
+						}
+						ray.MaxDistance = settings.MaxDistance;
+					}
+				}
+
+				Compress(bits, &compressedCells[cell]);
+			});
+
+			cellOffsets.resize(cellCount + 1);
+			visibility.clear();
+			for (uint32_t cell = 0; cell < cellCount; cell++)
+			{
+				cellOffsets[cell] = (uint32_t)visibility.size();
+				visibility.insert(visibility.end(), compressedCells[cell].begin(), compressedCells[cell].end());
+			}
+			cellOffsets[cellCount] = (uint32_t)visibility.size();
+			currentCell = -1;
+
+			Util::Log::WriteInfo("PVS: baked " + std::to_string(cellCount) + " cells x " + std::to_string(clusterCount) + " clusters in " +
+				std::to_string(Util::Timer::GetTime() - startTime) + "s (" + std::to_string(visibility.size()) + " bytes compressed)");
+		}
+
+		bool PotentiallyVisibleSet::Save(const std::string& path) const
+		{
+			std::ofstream file(path, std::ios::binary);
+			if (!file)
+			{
+				Util::Log::WriteError("PVS: could not write " + path);
+				return false;
+			}
+
+			uint32_t dataSize = (uint32_t)visibility.size();
+			file.write(PVS_MAGIC, sizeof(PVS_MAGIC));
+			file.write((const char*)&bakeSettings.Bounds, sizeof(bakeSettings.Bounds));
+			file.write((const char*)&bakeSettings.CellSize, sizeof(bakeSettings.CellSize));
+			file.write((const char*)&bakeSettings.SamplesPerCell, sizeof(bakeSettings.SamplesPerCell));
+			file.write((const char*)&bakeSettings.RaysPerSample, sizeof(bakeSettings.RaysPerSample));
+			file.write((const char*)&bakeSettings.RaysPerCluster, sizeof(bakeSettings.RaysPerCluster));
+			file.write((const char*)&bakeSettings.MaxDistance, sizeof(bakeSettings.MaxDistance));
+			file.write((const char*)&sceneHash, sizeof(sceneHash));
+			file.write((const char*)cellCounts, sizeof(cellCounts));
+			file.write((const char*)&clusterCount, sizeof(clusterCount));
+			file.write((const char*)&dataSize, sizeof(dataSize));
+			file.write((const char*)cellOffsets.data(), cellOffsets.size() * sizeof(uint32_t));
+			file.write((const char*)visibility.data(), visibility.size());
+			return true;
+		}
+
+		bool PotentiallyVisibleSet::Load(const std::string& path, const Scene& scene, const BakeSettings& settings)
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
+				return false;
+
+			char magic[4];
+			file.read(magic, sizeof(magic));
+			if (!file || std::string(magic, 4) != std::string(PVS_MAGIC, 4))
+			{
+				Util::Log::WriteError("PVS: " + path + " is not a PVS file");
+				return false;
+			}
+
+			BakeSettings fileSettings;
+			uint64_t fileSceneHash = 0;
+			file.read((char*)&fileSettings.Bounds, sizeof(fileSettings.Bounds));
+			file.read((char*)&fileSettings.CellSize, sizeof(fileSettings.CellSize));
+			file.read((char*)&fileSettings.SamplesPerCell, sizeof(fileSettings.SamplesPerCell));
+			file.read((char*)&fileSettings.RaysPerSample, sizeof(fileSettings.RaysPerSample));
+			file.read((char*)&fileSettings.RaysPerCluster, sizeof(fileSettings.RaysPerCluster));
+			file.read((char*)&fileSettings.MaxDistance, sizeof(fileSettings.MaxDistance));
+			file.read((char*)&fileSceneHash, sizeof(fileSceneHash));
+			if (!file || !SameSettings(fileSettings, settings) || fileSceneHash != GetInstanceHash(scene))
+			{
+				Util::Log::WriteInfo("PVS: " + path + " was baked from another scene or other settings");
+				return false;
+			}
+
+			// the counts follow from the settings, anything else is a damaged file
+			uint32_t fileCellCounts[3];
+			uint32_t fileClusterCount = 0;
+			uint32_t dataSize = 0;
+			file.read((char*)fileCellCounts, sizeof(fileCellCounts));
+			file.read((char*)&fileClusterCount, sizeof(fileClusterCount));
+			file.read((char*)&dataSize, sizeof(dataSize));
+			GetCellCounts(settings, cellCounts);
+			uint64_t cellCount = (uint64_t)cellCounts[0] * cellCounts[1] * cellCounts[2];
+			// a cell's run length code is at most 1.5 times its bitset
+			uint64_t maxDataSize = cellCount * ((GetInstanceCount(scene) + 7) / 8) * 2;
+			if (!file || fileCellCounts[0] != cellCounts[0] || fileCellCounts[1] != cellCounts[1] || fileCellCounts[2] != cellCounts[2] ||
+				fileClusterCount != GetInstanceCount(scene) || cellCount > MAX_CELLS || dataSize > maxDataSize)
+			{
+				Util::Log::WriteError("PVS: " + path + " has a corrupt header");
+				cellOffsets.clear();
+				return false;
+			}
+
+			bakeSettings = settings;
+			sceneHash = fileSceneHash;
+			bounds = settings.Bounds;
+			clusterCount = fileClusterCount;
+			cellOffsets.resize((size_t)cellCount + 1);
+			visibility.resize(dataSize);
+			file.read((char*)cellOffsets.data(), cellOffsets.size() * sizeof(uint32_t));
+			file.read((char*)visibility.data(), visibility.size());
+			currentCell = -1;
+
+			bool validOffsets = !cellOffsets.empty() && cellOffsets.front() == 0 && cellOffsets.back() == dataSize &&
+				std::is_sorted(cellOffsets.begin(), cellOffsets.end());
+			if (!file || !validOffsets)
+			{
+				Util::Log::WriteError("PVS: " + path + " is truncated");
+				cellOffsets.clear();
+				visibility.clear();
+				return false;
+			}
+			return true;
+		}
+
+		void PotentiallyVisibleSet::SetViewPosition(const glm::vec3& position)
+		{
+			uint32_t cell;
+			if (cellOffsets.empty() || !GetCell(position, &cell))
+			{
+				currentCell = -1;
+				return;
+			}
+
+			if (cell == currentCell)
+				return;
+
+			currentCell = cell;
+			Decompress(cell, &currentVisibility);
+		}
+
+		bool PotentiallyVisibleSet::IsVisible(uint32_t cluster) const
+		{
+			if (currentCell < 0 || cluster >= clusterCount)
+				return true;
+
+			return (currentVisibility[cluster / 8] & (1 << (cluster % 8))) != 0;
+		}
+
+		uint32_t PotentiallyVisibleSet::GetCellCount() const
+		{
+			return cellCounts[0] * cellCounts[1] * cellCounts[2];
+		}
+
+		uint32_t PotentiallyVisibleSet::GetClusterCount() const
+		{
+			return clusterCount;
+		}
+
+		size_t PotentiallyVisibleSet::GetCompressedSize() const
+		{
+			return visibility.size();
+		}
+
+		void PotentiallyVisibleSet::GetCellCounts(const BakeSettings& settings, uint32_t* counts)
+		{
+			glm::vec3 extent = settings.Bounds.Extent();
+			for (int axis = 0; axis < 3; axis++)
+				counts[axis] = std::max(1, (int)std::ceil(extent[axis] / settings.CellSize));
+		}
+
+		bool PotentiallyVisibleSet::SameSettings(const BakeSettings& a, const BakeSettings& b)
+		{
+			return a.Bounds.Min == b.Bounds.Min && a.Bounds.Max == b.Bounds.Max && a.CellSize == b.CellSize &&
+				a.SamplesPerCell == b.SamplesPerCell && a.RaysPerSample == b.RaysPerSample &&
+				a.RaysPerCluster == b.RaysPerCluster && a.MaxDistance == b.MaxDistance;
+		}
+
+		bool PotentiallyVisibleSet::GetCell(const glm::vec3& position, uint32_t* cell) const
+		{
+			if (!bounds.Contains(position))
+				return false;
+
+			glm::vec3 local = (position - bounds.Min) / GetCellSize();
+			uint32_t x = std::min((uint32_t)local.x, cellCounts[0] - 1);
+			uint32_t y = std::min((uint32_t)local.y, cellCounts[1] - 1);
+			uint32_t z = std::min((uint32_t)local.z, cellCounts[2] - 1);
+			*cell = x + cellCounts[0] * (y + cellCounts[1] * z);
+			return true;
+		}
+
+		glm::vec3 PotentiallyVisibleSet::GetCellSize() const
+		{
+			return bounds.Extent() / glm::vec3((float)cellCounts[0], (float)cellCounts[1], (float)cellCounts[2]);
+		}
+
+		// zero bytes are stored as a 0 followed by the length of the run, as most clusters aren't visible from most cells
+		void PotentiallyVisibleSet::Compress(const std::vector<uint8_t>& bits, std::vector<uint8_t>* compressed)
+		{
+			compressed->clear();
+			for (size_t i = 0; i < bits.size(); i++)
+			{
+				if (bits[i] != 0)
+				{
+					compressed->push_back(bits[i]);
+					continue;
+				}
+
+				uint8_t run = 0;
+				while (i < bits.size() && bits[i] == 0 && run < 255)
+				{
+					run++;
+					i++;
+				}
+				i--;
+				compressed->push_back(0);
+				compressed->push_back(run);
+			}
+		}
+
+		void PotentiallyVisibleSet::Decompress(uint32_t cell, std::vector<uint8_t>* bits) const
+		{
+			bits->clear();
+			for (uint32_t i = cellOffsets[cell]; i < cellOffsets[cell + 1]; i++)
+			{
+				if (visibility[i] != 0)
+				{
+					bits->push_back(visibility[i]);
+					continue;
+				}
+
+				bits->insert(bits->end(), (size_t)visibility[i + 1], (uint8_t)0);
+				i++;
+			}
+			bits->resize((clusterCount + 7) / 8, (uint8_t)0);
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+#include "Scene.h"
+#include "../graphics/AABB.h"
+
+namespace glh {
+	namespace App {
+
+		// Precomputed potentially visible sets for static scenes.
+		// The baker splits a region into a grid of view cells and finds which scene instances
+		// (the clusters) can be seen from anywhere inside each cell by casting rays against the
+		// scene. At runtime the camera's cell is looked up and its visibility bits decompressed
+		// once per cell change, so drawing only costs a bit test per cluster.
+		class PotentiallyVisibleSet
+		{
+		public:
+			struct BakeSettings
+			{
+				// region the camera can move through
+				Graphics::AABB Bounds;
+				float CellSize = 4.0f;
+				// random eye positions per cell
+				unsigned int SamplesPerCell = 16;
+				// rays cast in uniformly distributed directions from every eye position
+				unsigned int RaysPerSample = 256;
+				// extra rays aimed at random points inside every cluster's bounds, to catch small clusters
+				unsigned int RaysPerCluster = 4;
+				float MaxDistance = 1000.0f;
+			};
+
+			// multithreaded over cells, results are deterministic for a given scene and settings
+			void Bake(const Scene& scene, const BakeSettings& settings);
+
+			bool Save(const std::string& path) const;
+			// false if the file wasn't baked from this scene's instances with these settings
+			bool Load(const std::string& path, const Scene& scene, const BakeSettings& settings);
+
+			void SetViewPosition(const glm::vec3& position);
+			// whether the cluster can be seen from the cell of the last view position.
+			// Everything is visible when the view is outside the baked region.
+			bool IsVisible(uint32_t cluster) const;
+
+			uint32_t GetCellCount() const;
+			uint32_t GetClusterCount() const;
+			size_t GetCompressedSize() const;
+
+		private:
+			static void GetCellCounts(const BakeSettings& settings, uint32_t* counts);
+			static bool SameSettings(const BakeSettings& a, const BakeSettings& b);
+
+			bool GetCell(const glm::vec3& position, uint32_t* cell) const;
+			glm::vec3 GetCellSize() const;
+
+			static void Compress(const std::vector<uint8_t>& bits, std::vector<uint8_t>* compressed);
+			void Decompress(uint32_t cell, std::vector<uint8_t>* bits) const;
+
+			// what the sets were baked from, saved so Load can tell a stale file
+			BakeSettings bakeSettings;
+			uint64_t sceneHash = 0;
+
+			Graphics::AABB bounds;
+			uint32_t cellCounts[3] = { 0, 0, 0 };
+			uint32_t clusterCount = 0;
+
+			// run length compressed bitset of every cell, cell i lives in [cellOffsets[i], cellOffsets[i + 1])
+			std::vector<uint32_t> cellOffsets;
+			std::vector<uint8_t> visibility;
+
+			// decompressed bits of the cell the view is in
+			int64_t currentCell = -1;
+			std::vector<uint8_t> currentVisibility;
+		};
+	}
+}
@@ -1,11 +1,157 @@
-
 #include "Scene.h"
 
+#include "../util/Hash.h"
+
 namespace glh {
 	namespace App {
 		Scene::Scene() {
 			
 		}
 
+		void AddMesh(Scene& scene, Graphics::Model* model, uint32_t* newMeshID) {
+			*newMeshID = (uint32_t)scene.m_Meshes.size();
+			scene.m_Meshes.push_back(model);
+		}
+
+		void AddInstance(Scene& scene, uint32_t meshID, uint32_t* newInstanceID) {
+			*newInstanceID = (uint32_t)scene.m_Instances.size();
+
+			Scene::Instance instance;
+			instance.MeshID = meshID;
+			instance.Bounds = scene.m_Meshes[meshID]->GetBVH().GetBounds();
+			scene.m_Instances.push_back(instance);
+		}
+
+		void SetInstanceTransform(Scene& scene, uint32_t instanceID, const glm::mat4& transform) {
+			Scene::Instance& instance = scene.m_Instances[instanceID];
+			instance.Transform = transform;
+			instance.InverseTransform = glm::inverse(transform);
+			instance.Bounds = scene.m_Meshes[instance.MeshID]->GetBVH().GetBounds().Transform(transform);
+		}
+
+		uint32_t GetInstanceCount(const Scene& scene) {
+			return (uint32_t)scene.m_Instances.size();
+		}
+
+		const Graphics::AABB& GetInstanceBounds(const Scene& scene, uint32_t instanceID) {
+			return scene.m_Instances[instanceID].Bounds;
+		}
+
+		uint64_t GetInstanceHash(const Scene& scene) {
+			uint64_t hash = Util::Hash::SEED;
+			for (const Scene::Instance& instance : scene.m_Instances)
+			{
+				hash = Util::Hash::Bytes(&instance.MeshID, sizeof(instance.MeshID), hash);
+				hash = Util::Hash::Bytes(&instance.Transform, sizeof(instance.Transform), hash);
+				hash = Util::Hash::Bytes(&instance.Bounds, sizeof(instance.Bounds), hash);
+			}
+			return hash;
+		}
+
+		void BuildInstanceBVH(Scene& scene) {
+			std::vector<Graphics::AABB> bounds(scene.m_Instances.size());
+			for (unsigned int i = 0; i < scene.m_Instances.size(); i++)
+				bounds[i] = scene.m_Instances[i].Bounds;
+
+			Graphics::BVHBuilder::Build(bounds, 1, &scene.m_InstanceNodes, &scene.m_InstanceOrder);
+		}
+
+		bool RayCastClosest(const Scene& scene, const Graphics::Ray& ray, Graphics::RayHit* hit) {
+			return scene.RayCast<false>(ray, hit);
+		}
+
+		bool RayCastAny(const Scene& scene, const Graphics::Ray& ray) {
+			return scene.RayCast<true>(ray, nullptr);
+		}
+
+		glm::vec3 GetHitNormal(const Scene& scene, const Graphics::RayHit& hit) {
+			const Scene::Instance& instance = scene.m_Instances[hit.Instance];
+			const Graphics::Model* model = scene.m_Meshes[instance.MeshID];
+			const std::vector<Graphics::Model::Vertex>& vertices = model->GetVertices();
+			const unsigned int* triangle = &model->indices[hit.Triangle * 3];
+			glm::vec3 normal = vertices[triangle[0]].Normal * (1.0f - hit.U - hit.V) +
+				vertices[triangle[1]].Normal * hit.U +
+				vertices[triangle[2]].Normal * hit.V;
+
+			// normals go through the inverse transpose so non-uniform scales keep them perpendicular
+			return glm::normalize(glm::transpose(glm::mat3(instance.InverseTransform)) * normal);
+		}
+
+		template <bool ANY_HIT>
+		bool Scene::RayCast(const Graphics::Ray& ray, Graphics::RayHit* hit) const {
+			if (m_InstanceNodes.empty())
+				return false;
+
+			glm::vec3 inverseDirection = Graphics::SafeInverse(ray.Direction);
+			float closest = ray.MaxDistance;
+			bool found = false;
+
+			// deep enough for any sensible tree, a degenerate one spills the rest onto the heap.
+			// overflow is only pushed to while stack is full, so popping it first keeps the order.
+			unsigned int stack[64];
+			unsigned int stackSize = 0;
+			std::vector<unsigned int> overflow;
+			auto push = [&](unsigned int nodeIndex)
+			{
+				if (stackSize < 64)
+					stack[stackSize++] = nodeIndex;
+				else
+					overflow.push_back(nodeIndex);
+			};
+
+			push(0);
+			while (stackSize > 0)
+			{
+				unsigned int nodeIndex;
+				if (!overflow.empty())
+				{
+					nodeIndex = overflow.back();
+					overflow.pop_back();
+				}
+				else
+					nodeIndex = stack[--stackSize];
+
+				const Graphics::BVHNode& node = m_InstanceNodes[nodeIndex];
+				if (Graphics::IntersectAABB(node.Bounds, ray.Origin, inverseDirection, closest) == FLT_MAX)
+					continue;
+
+				if (node.Count == 0)
+				{
+					push(node.Right);
+					push(node.Left);
+					continue;
+				}
+
+				for (unsigned int i = node.First; i < node.First + node.Count; i++)
+				{
+					unsigned int instanceID = m_InstanceOrder[i];
+					const Instance& instance = m_Instances[instanceID];
+
+					// move the ray into model space, the direction is left unnormalised so distances stay comparable
+					Graphics::Ray localRay;
+					localRay.Origin = glm::vec3(instance.InverseTransform * glm::vec4(ray.Origin, 1.0f));
+					localRay.Direction = glm::mat3(instance.InverseTransform) * ray.Direction;
+					localRay.MaxDistance = closest;
+
+					const Graphics::TriangleBVH& bvh = m_Meshes[instance.MeshID]->GetBVH();
+					if (ANY_HIT)
+					{
+						if (bvh.Occluded(localRay))
+							return true;
+						continue;
+					}
+
+					Graphics::RayHit localHit;
+					if (bvh.Intersect(localRay, &localHit))
+					{
+						closest = localHit.Distance;
+						*hit = localHit;
+						hit->Instance = instanceID;
+						found = true;
+					}
+				}
+			}
+			return found;
+		}
 	}
-}
\ No newline at end of file
+}
@@ -12,6 +12,8 @@
 #include "../graphics/Camera.h"
 #include "../graphics/Shader.h"
 #include "../graphics/Entity.h"
+#include "../graphics/Model.h"
+#include "../graphics/BVH.h"
 
 namespace glh {
 	namespace App {
@@ -19,11 +21,42 @@ namespace glh {
 		class Scene
 		{
 		public:
+			Scene();
 			void Init();
 		private:
+			struct Instance
+			{
+				uint32_t MeshID;
+				glm::mat4 Transform;
+				glm::mat4 InverseTransform;
+				// world space bounds of the mesh under Transform
+				Graphics::AABB Bounds;
+			};
+
+			template <bool ANY_HIT>
+			bool RayCast(const Graphics::Ray& ray, Graphics::RayHit* hit) const;
+
 			std::vector<Graphics::Shader*> m_Shaders;
 			std::vector<Graphics::Entity*> m_Entities;
 			std::vector<Graphics::Camera*> m_Cameras;
+
+			std::vector<Graphics::Model*> m_Meshes;
+			std::vector<Instance> m_Instances;
+
+			// top level BVH over the world bounds of m_Instances, the leaves index m_InstanceOrder
+			std::vector<Graphics::BVHNode> m_InstanceNodes;
+			std::vector<unsigned int> m_InstanceOrder;
+
+			friend void AddMesh(Scene& scene, Graphics::Model* model, uint32_t* newMeshID);
+			friend void AddInstance(Scene& scene, uint32_t meshID, uint32_t* newInstanceID);
+			friend void SetInstanceTransform(Scene& scene, uint32_t instanceID, const glm::mat4& transform);
+			friend void BuildInstanceBVH(Scene& scene);
+			friend bool RayCastClosest(const Scene& scene, const Graphics::Ray& ray, Graphics::RayHit* hit);
+			friend bool RayCastAny(const Scene& scene, const Graphics::Ray& ray);
+			friend glm::vec3 GetHitNormal(const Scene& scene, const Graphics::RayHit& hit);
+			friend uint32_t GetInstanceCount(const Scene& scene);
+			friend const Graphics::AABB& GetInstanceBounds(const Scene& scene, uint32_t instanceID);
+			friend uint64_t GetInstanceHash(const Scene& scene);
 		};
 
 		void LoadMeshes(
@@ -31,9 +64,47 @@ namespace glh {
 			const std::string& filename,
 			std::vector<uint32_t>* loadedMeshIDs);
 
+		void AddMesh(
+			Scene& scene,
+			Graphics::Model* model,
+			uint32_t* newMeshID);
+
 		void AddInstance(
 			Scene& scene,
 			uint32_t meshID,
 			uint32_t* newInstanceID);
+
+		void SetInstanceTransform(
+			Scene& scene,
+			uint32_t instanceID,
+			const glm::mat4& transform);
+
+		uint32_t GetInstanceCount(const Scene& scene);
+
+		const Graphics::AABB& GetInstanceBounds(
+			const Scene& scene,
+			uint32_t instanceID);
+
+		// changes whenever an instance is added, moved or given another mesh, for keying baked data
+		uint64_t GetInstanceHash(const Scene& scene);
+
+		// rebuilds the top level BVH, call after instances have been added or moved
+		void BuildInstanceBVH(Scene& scene);
+
+		// closest hit against the triangles of every instance, hit->Instance is the instance ID
+		bool RayCastClosest(
+			const Scene& scene,
+			const Graphics::Ray& ray,
+			Graphics::RayHit* hit);
+
+		// returns true as soon as anything blocks the ray, for line of sight checks
+		bool RayCastAny(
+			const Scene& scene,
+			const Graphics::Ray& ray);
+
+		// world space vertex normal at a hit of RayCastClosest, interpolated and normalised
+		glm::vec3 GetHitNormal(
+			const Scene& scene,
+			const Graphics::RayHit& hit);
 	}
-}
\ No newline at end of file
+}
@@ -4,14 +4,42 @@
 // glh header file
 //
 
+#include "glh/app/IrradianceVolume.h"
+#include "glh/app/PVS.h"
 #include "glh/app/Scene.h"
 
+#include "glh/graphics/BVH.h"
+#include "glh/graphics/Broadphase.h"
 #include "glh/graphics/Camera.h"
+#include "glh/graphics/DeferredRenderer.h"
+#include "glh/graphics/Entity.h"
 #include "glh/graphics/Framebuffer.h"
+#include "glh/graphics/GLExtensions.h"
+#include "glh/graphics/GLResources.h"
+#include "glh/graphics/GLState.h"
+#include "glh/graphics/GPUTimer.h"
+#include "glh/graphics/GeometryHeap.h"
+#include "glh/graphics/ImageBasedLighting.h"
+#include "glh/graphics/IndirectDrawList.h"
+#include "glh/graphics/InstanceBatch.h"
+#include "glh/graphics/Light.h"
 #include "glh/graphics/LightBuffer.h"
+#include "glh/graphics/LightGrid.h"
+#include "glh/graphics/Material.h"
 #include "glh/graphics/Model.h"
+#include "glh/graphics/PointShadowAtlas.h"
+#include "glh/graphics/ReliefMap.h"
+#include "glh/graphics/RenderQueue.h"
 #include "glh/graphics/Shader.h"
 #include "glh/graphics/Skybox.h"
+#include "glh/graphics/TexturePacker.h"
+#include "glh/graphics/TexturePool.h"
+#include "glh/graphics/UniformBlocks.h"
+#include "glh/graphics/UniformRing.h"
+#include "glh/graphics/VertexLayout.h"
+#include "glh/graphics/VisibilityBuffer.h"
 
+#include "glh/util/Hash.h"
 #include "glh/util/Log.h"
+#include "glh/util/Parallel.h"
 #include "glh/util/Timer.h"
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+
+namespace glh {
+	namespace Graphics {
+
+		// Axis aligned bounding box. Starts out empty (inverted) so that growing it by
+		// the first point or box gives that point or box back.
+		struct AABB
+		{
+			glm::vec3 Min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+			glm::vec3 Max = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+			void Grow(const glm::vec3& point)
+			{
+				Min = glm::min(Min, point);
+				Max = glm::max(Max, point);
+			}
+
+			void Grow(const AABB& box)
+			{
+				Min = glm::min(Min, box.Min);
+				Max = glm::max(Max, box.Max);
+			}
+
+			bool IsEmpty() const
+			{
+				return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z;
+			}
+
+			glm::vec3 Center() const
+			{
+				return (Min + Max) * 0.5f;
+			}
+
+			glm::vec3 Extent() const
+			{
+				return Max - Min;
+			}
+
+			// half the surface area, which is all the SAH cost function needs
+			float HalfArea() const
+			{
+				if (IsEmpty())
+					return 0.0f;
+				glm::vec3 e = Extent();
+				return e.x * e.y + e.y * e.z + e.z * e.x;
+			}
+
+			bool Overlaps(const AABB& other) const
+			{
+				return Min.x <= other.Max.x && Max.x >= other.Min.x &&
+					Min.y <= other.Max.y && Max.y >= other.Min.y &&
+					Min.z <= other.Max.z && Max.z >= other.Min.z;
+			}
+
+			bool Contains(const glm::vec3& point) const
+			{
+				return point.x >= Min.x && point.x <= Max.x &&
+					point.y >= Min.y && point.y <= Max.y &&
+					point.z >= Min.z && point.z <= Max.z;
+			}
+
+			// returns the box enclosing this box after it has been transformed by the given matrix
+			AABB Transform(const glm::mat4& matrix) const
+			{
+				AABB result;
+				if (IsEmpty())
+					return result;
+
+				// Arvo's method: start with the translation and add the min/max contribution of each axis
+				glm::vec3 translation = glm::vec3(matrix[3]);
+				result.Min = translation;
+				result.Max = translation;
+				for (int column = 0; column < 3; column++)
+				{
+					for (int row = 0; row < 3; row++)
+					{
+						float a = matrix[column][row] * Min[column];
+						float b = matrix[column][row] * Max[column];
+						result.Min[row] += a < b ? a : b;
+						result.Max[row] += a < b ? b : a;
+					}
+				}
+				return result;
+			}
+		};
+	}
+}
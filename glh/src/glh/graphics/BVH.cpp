@@ -0,0 +1,395 @@
+#include "BVH.h"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <future>
+
+#include "../util/Parallel.h"
+
+namespace glh {
+	namespace Graphics {
+
+		void BVHBuilder::Build(const std::vector<AABB>& primitiveBounds,
+			unsigned int maxLeafSize,
+			std::vector<BVHNode>* nodes,
+			std::vector<unsigned int>* primitiveIndices)
+		{
+			nodes->clear();
+			primitiveIndices->resize(primitiveBounds.size());
+			if (primitiveBounds.empty())
+				return;
+
+			std::vector<glm::vec3> centroids(primitiveBounds.size());
+			for (unsigned int i = 0; i < primitiveBounds.size(); i++)
+			{
+				centroids[i] = primitiveBounds[i].Center();
+				(*primitiveIndices)[i] = i;
+			}
+
+			// a binary tree with n leaves has 2n - 1 nodes, reserve for the worst case of single primitive leaves
+			nodes->reserve(primitiveBounds.size() * 2);
+			BuildRange(primitiveBounds, centroids, primitiveIndices->data(), 0, (unsigned int)primitiveBounds.size(), maxLeafSize, 0, nodes);
+		}
+
+		// builds the subtree over primitiveIndices[first, first + count) and appends it to nodes, root first
+		void BVHBuilder::BuildRange(const std::vector<AABB>& primitiveBounds,
+			const std::vector<glm::vec3>& centroids,
+			unsigned int* primitiveIndices,
+			unsigned int first,
+			unsigned int count,
+			unsigned int maxLeafSize,
+			unsigned int depth,
+			std::vector<BVHNode>* nodes)
+		{
+			unsigned int nodeIndex = (unsigned int)nodes->size();
+			nodes->push_back(BVHNode());
+
+			AABB bounds;
+			AABB centroidBounds;
+			for (unsigned int i = first; i < first + count; i++)
+			{
+				bounds.Grow(primitiveBounds[primitiveIndices[i]]);
+				centroidBounds.Grow(centroids[primitiveIndices[i]]);
+			}
+			(*nodes)[nodeIndex].Bounds = bounds;
+
+			// evaluate the SAH for every bin boundary along every axis
+			int bestAxis = -1;
+			unsigned int bestSplit = 0;
+			float bestCost = FLT_MAX;
+			for (int axis = 0; axis < 3 && count > 1; axis++)
+			{
+				float axisMin = centroidBounds.Min[axis];
+				float extent = centroidBounds.Max[axis] - axisMin;
+				if (extent <= 0.0f)
+					continue;
+
+				AABB binBounds[BIN_COUNT];
+				unsigned int binCounts[BIN_COUNT] = { 0 };
+				float scale = BIN_COUNT / extent;
+				for (unsigned int i = first; i < first + count; i++)
+				{
+					unsigned int primitive = primitiveIndices[i];
+					unsigned int bin = std::min(BIN_COUNT - 1, (unsigned int)((centroids[primitive][axis] - axisMin) * scale));
+					binBounds[bin].Grow(primitiveBounds[primitive]);
+					binCounts[bin]++;
+				}
+
+				// sweep from the left storing area * count, then from the right evaluating the cost
+				float leftCost[BIN_COUNT - 1];
+				unsigned int leftCount[BIN_COUNT - 1];
+				AABB sweep;
+				unsigned int sweepCount = 0;
+				for (unsigned int i = 0; i < BIN_COUNT - 1; i++)
+				{
+					sweep.Grow(binBounds[i]);
+					sweepCount += binCounts[i];
+					leftCost[i] = sweep.HalfArea() * sweepCount;
+					leftCount[i] = sweepCount;
+				}
+				sweep = AABB();
+				sweepCount = 0;
+				for (unsigned int i = BIN_COUNT - 1; i > 0; i--)
+				{
+					sweep.Grow(binBounds[i]);
+					sweepCount += binCounts[i];
+					if (leftCount[i - 1] == 0 || sweepCount == 0)
+						continue;
+
+					float cost = leftCost[i - 1] + sweep.HalfArea() * sweepCount;
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = i - 1;
+					}
+				}
+			}
+
+			// one traversal step is costed the same as one primitive test
+			float leafCost = bounds.HalfArea() * count;
+			float splitCost = bounds.HalfArea() + bestCost;
+			if (count == 1 || (count <= maxLeafSize && (bestAxis < 0 || splitCost >= leafCost)))
+			{
+				(*nodes)[nodeIndex].First = first;
+				(*nodes)[nodeIndex].Count = count;
+				return;
+			}
+
+			unsigned int leftCount;
+			if (bestAxis >= 0)
+			{
+				float axisMin = centroidBounds.Min[bestAxis];
+				float scale = BIN_COUNT / (centroidBounds.Max[bestAxis] - axisMin);
+				unsigned int* middle = std::partition(primitiveIndices + first, primitiveIndices + first + count,
+					[&](unsigned int primitive)
+				{
+					unsigned int bin = std::min(BIN_COUNT - 1, (unsigned int)((centroids[primitive][bestAxis] - axisMin) * scale));
+					return bin <= bestSplit;
+				});
+				leftCount = (unsigned int)(middle - (primitiveIndices + first));
+			}
+			else
+			{
+				// all centroids coincide, there is nothing better than splitting the range in half
+				leftCount = count / 2;
+			}
+
+			unsigned int left;
+			unsigned int right;
+			// every split above this depth hands one side to a new thread, so there are never more
+			// threads than cores
+			if (count >= PARALLEL_THRESHOLD && depth < 32 && (1u << depth) < Util::Parallel::GetWorkerCount())
+			{
+				// build the left subtree on a worker while this thread builds the right one
+				std::vector<BVHNode> leftNodes;
+				std::vector<BVHNode> rightNodes;
+				std::future<void> leftBuild = std::async(std::launch::async, [&]()
+				{
+					BuildRange(primitiveBounds, centroids, primitiveIndices, first, leftCount, maxLeafSize, depth + 1, &leftNodes);
+				});
+				BuildRange(primitiveBounds, centroids, primitiveIndices, first + leftCount, count - leftCount, maxLeafSize, depth + 1, &rightNodes);
+				leftBuild.wait();
+
+				left = Splice(nodes, leftNodes);
+				right = Splice(nodes, rightNodes);
+			}
+			else
+			{
+				left = (unsigned int)nodes->size();
+				BuildRange(primitiveBounds, centroids, primitiveIndices, first, leftCount, maxLeafSize, depth + 1, nodes);
+				right = (unsigned int)nodes->size();
+				BuildRange(primitiveBounds, centroids, primitiveIndices, first + leftCount, count - leftCount, maxLeafSize, depth + 1, nodes);
+			}
+
+			(*nodes)[nodeIndex].Left = left;
+			(*nodes)[nodeIndex].Right = right;
+		}
+
+		// appends a subtree built into its own array, returns the index its root ends up at
+		unsigned int BVHBuilder::Splice(std::vector<BVHNode>* nodes, const std::vector<BVHNode>& subtree)
+		{
+			unsigned int offset = (unsigned int)nodes->size();
+			for (const BVHNode& node : subtree)
+			{
+				nodes->push_back(node);
+				if (node.Count == 0)
+				{
+					nodes->back().Left += offset;
+					nodes->back().Right += offset;
+				}
+			}
+			return offset;
+		}
+
+		void TriangleBVH::Build(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+		{
+			triangleCount = (unsigned int)(indices.size() / 3);
+
+			std::vector<AABB> triangleBounds(triangleCount);
+			for (unsigned int i = 0; i < triangleCount; i++)
+			{
+				triangleBounds[i].Grow(positions[indices[i * 3 + 0]]);
+				triangleBounds[i].Grow(positions[indices[i * 3 + 1]]);
+				triangleBounds[i].Grow(positions[indices[i * 3 + 2]]);
+			}
+
+			std::vector<unsigned int> order;
+			BVHBuilder::Build(triangleBounds, MAX_LEAF_TRIANGLES, &nodes, &order);
+
+			// repack every leaf into SoA packets of 4, after which a leaf's First/Count refer to packets
+			packets.clear();
+			for (BVHNode& node : nodes)
+			{
+				if (node.Count == 0)
+					continue;
+
+				unsigned int firstPacket = (unsigned int)packets.size();
+				for (unsigned int i = 0; i < node.Count; i += 4)
+				{
+					TrianglePacket packet = {};
+					for (unsigned int lane = 0; lane < 4; lane++)
+					{
+						// unused lanes are left as degenerate triangles, which never report a hit
+						packet.triangle[lane] = ~0u;
+						if (i + lane >= node.Count)
+							continue;
+
+						unsigned int triangle = order[node.First + i + lane];
+						const glm::vec3& p0 = positions[indices[triangle * 3 + 0]];
+						const glm::vec3& p1 = positions[indices[triangle * 3 + 1]];
+						const glm::vec3& p2 = positions[indices[triangle * 3 + 2]];
+						for (int axis = 0; axis < 3; axis++)
+						{
+							packet.v0[axis][lane] = p0[axis];
+							packet.edge1[axis][lane] = p1[axis] - p0[axis];
+							packet.edge2[axis][lane] = p2[axis] - p0[axis];
+						}
+						packet.triangle[lane] = triangle;
+					}
+					packets.push_back(packet);
+				}
+				node.First = firstPacket;
+				node.Count = (unsigned int)packets.size() - firstPacket;
+			}
+		}
+
+		bool TriangleBVH::Intersect(const Ray& ray, RayHit* hit) const
+		{
+			return Traverse<false>(ray, hit);
+		}
+
+		bool TriangleBVH::Occluded(const Ray& ray) const
+		{
+			return Traverse<true>(ray, nullptr);
+		}
+
+		template <bool ANY_HIT>
+		bool TriangleBVH::Traverse(const Ray& ray, RayHit* hit) const
+		{
+			if (nodes.empty())
+				return false;
+
+			glm::vec3 inverseDirection = SafeInverse(ray.Direction);
+			float closest = ray.MaxDistance;
+			if (IntersectAABB(nodes[0].Bounds, ray.Origin, inverseDirection, closest) == FLT_MAX)
+				return false;
+
+			const __m128 origin[3] = { _mm_set1_ps(ray.Origin.x), _mm_set1_ps(ray.Origin.y), _mm_set1_ps(ray.Origin.z) };
+			const __m128 direction[3] = { _mm_set1_ps(ray.Direction.x), _mm_set1_ps(ray.Direction.y), _mm_set1_ps(ray.Direction.z) };
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 epsilon = _mm_set1_ps(1e-12f);
+			const __m128 signMask = _mm_set1_ps(-0.0f);
+
+			bool found = false;
+			// like Scene::RayCast, a tree deeper than the stack spills the rest onto the heap
+			unsigned int stack[128];
+			unsigned int stackSize = 0;
+			std::vector<unsigned int> overflow;
+			auto push = [&](unsigned int nodeIndex)
+			{
+				if (stackSize < 128)
+					stack[stackSize++] = nodeIndex;
+				else
+					overflow.push_back(nodeIndex);
+			};
+
+			push(0);
+			while (stackSize > 0)
+			{
+				unsigned int nodeIndex;
+				if (!overflow.empty())
+				{
+					nodeIndex = overflow.back();
+					overflow.pop_back();
+				}
+				else
+					nodeIndex = stack[--stackSize];
+
+				const BVHNode& node = nodes[nodeIndex];
+				if (node.Count > 0)
+				{
+					for (unsigned int p = node.First; p < node.First + node.Count; p++)
+					{
+						// Moller-Trumbore on 4 triangles at once
+						const TrianglePacket& packet = packets[p];
+						__m128 v0[3], edge1[3], edge2[3];
+						for (int axis = 0; axis < 3; axis++)
+						{
+							v0[axis] = _mm_loadu_ps(packet.v0[axis]);
+							edge1[axis] = _mm_loadu_ps(packet.edge1[axis]);
+							edge2[axis] = _mm_loadu_ps(packet.edge2[axis]);
+						}
+						__m128 px = _mm_sub_ps(_mm_mul_ps(direction[1], edge2[2]), _mm_mul_ps(direction[2], edge2[1]));
+						__m128 py = _mm_sub_ps(_mm_mul_ps(direction[2], edge2[0]), _mm_mul_ps(direction[0], edge2[2]));
+						__m128 pz = _mm_sub_ps(_mm_mul_ps(direction[0], edge2[1]), _mm_mul_ps(direction[1], edge2[0]));
+						__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1[0], px), _mm_mul_ps(edge1[1], py)), _mm_mul_ps(edge1[2], pz));
+						__m128 inverseDet = _mm_div_ps(one, det);
+
+						__m128 tx = _mm_sub_ps(origin[0], v0[0]);
+						__m128 ty = _mm_sub_ps(origin[1], v0[1]);
+						__m128 tz = _mm_sub_ps(origin[2], v0[2]);
+						__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverseDet);
+
+						__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, edge1[2]), _mm_mul_ps(tz, edge1[1]));
+						__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, edge1[0]), _mm_mul_ps(tx, edge1[2]));
+						__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, edge1[1]), _mm_mul_ps(ty, edge1[0]));
+						__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(direction[0], qx), _mm_mul_ps(direction[1], qy)), _mm_mul_ps(direction[2], qz)), inverseDet);
+						__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2[0], qx), _mm_mul_ps(edge2[1], qy)), _mm_mul_ps(edge2[2], qz)), inverseDet);
+
+						__m128 mask = _mm_cmpgt_ps(_mm_andnot_ps(signMask, det), epsilon);
+						mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+						mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+						mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+						mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+						mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(closest)));
+						int lanes = _mm_movemask_ps(mask);
+						if (lanes == 0)
+							continue;
+						if (ANY_HIT)
+							return true;
+
+						alignas(16) float laneT[4];
+						alignas(16) float laneU[4];
+						alignas(16) float laneV[4];
+						_mm_store_ps(laneT, t);
+						_mm_store_ps(laneU, u);
+						_mm_store_ps(laneV, v);
+						for (int lane = 0; lane < 4; lane++)
+						{
+							if ((lanes & (1 << lane)) && laneT[lane] < closest)
+							{
+								closest = laneT[lane];
+								hit->Distance = laneT[lane];
+								hit->U = laneU[lane];
+								hit->V = laneV[lane];
+								hit->Triangle = packet.triangle[lane];
+								found = true;
+							}
+						}
+					}
+					continue;
+				}
+
+				// visit the nearer child first so the closest hit shrinks the ray early
+				unsigned int nearChild = node.Left;
+				unsigned int farChild = node.Right;
+				float nearDistance = IntersectAABB(nodes[nearChild].Bounds, ray.Origin, inverseDirection, closest);
+				float farDistance = IntersectAABB(nodes[farChild].Bounds, ray.Origin, inverseDirection, closest);
+				if (farDistance < nearDistance)
+				{
+					std::swap(nearChild, farChild);
+					std::swap(nearDistance, farDistance);
+				}
+				if (farDistance != FLT_MAX)
+					push(farChild);
+				if (nearDistance != FLT_MAX)
+					push(nearChild);
+			}
+			return found;
+		}
+
+		const AABB& TriangleBVH::GetBounds() const
+		{
+			static const AABB empty;
+			return nodes.empty() ? empty : nodes[0].Bounds;
+		}
+
+		bool TriangleBVH::IsBuilt() const
+		{
+			return !nodes.empty();
+		}
+
+		unsigned int TriangleBVH::GetNodeCount() const
+		{
+			return (unsigned int)nodes.size();
+		}
+
+		unsigned int TriangleBVH::GetTriangleCount() const
+		{
+			return triangleCount;
+		}
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cfloat>
+
+#include "AABB.h"
+
+namespace glh {
+	namespace Graphics {
+
+		struct Ray
+		{
+			glm::vec3 Origin;
+			// does not need to be normalised, hit distances are measured in multiples of it
+			glm::vec3 Direction;
+			float MaxDistance = FLT_MAX;
+		};
+
+		struct RayHit
+		{
+			float Distance = FLT_MAX;
+			// barycentric coordinates of the hit on the triangle
+			float U = 0.0f;
+			float V = 0.0f;
+			unsigned int Triangle = 0;
+			unsigned int Instance = 0;
+		};
+
+		// A node is a leaf when Count is non zero, in which case First indexes the leaf's
+		// primitives. Otherwise Left and Right index the two children.
+		struct BVHNode
+		{
+			AABB Bounds;
+			unsigned int Left = 0;
+			unsigned int Right = 0;
+			unsigned int First = 0;
+			unsigned int Count = 0;
+		};
+
+		// Builds a BVH over a set of primitive bounds using the binned surface area heuristic.
+		// Large subtrees near the root are built in parallel, one thread per core at most.
+		// primitiveIndices receives the primitive order the leaves refer into.
+		class BVHBuilder
+		{
+		public:
+			static void Build(const std::vector<AABB>& primitiveBounds,
+				unsigned int maxLeafSize,
+				std::vector<BVHNode>* nodes,
+				std::vector<unsigned int>* primitiveIndices);
+
+		private:
+			static const unsigned int BIN_COUNT = 16;
+			// subtrees with fewer primitives than this are built on the calling thread
+			static const unsigned int PARALLEL_THRESHOLD = 4096;
+
+			static void BuildRange(const std::vector<AABB>& primitiveBounds,
+				const std::vector<glm::vec3>& centroids,
+				unsigned int* primitiveIndices,
+				unsigned int first,
+				unsigned int count,
+				unsigned int maxLeafSize,
+				unsigned int depth,
+				std::vector<BVHNode>* nodes);
+
+			static unsigned int Splice(std::vector<BVHNode>* nodes, const std::vector<BVHNode>& subtree);
+		};
+
+		// Slab test against a node's bounds, returns the entry distance or FLT_MAX on a miss.
+		inline float IntersectAABB(const AABB& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance)
+		{
+			glm::vec3 t0 = (box.Min - origin) * inverseDirection;
+			glm::vec3 t1 = (box.Max - origin) * inverseDirection;
+			glm::vec3 tNear = glm::min(t0, t1);
+			glm::vec3 tFar = glm::max(t0, t1);
+			float entry = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+			float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, maxDistance));
+			return entry <= exit ? entry : FLT_MAX;
+		}
+
+		inline glm::vec3 SafeInverse(const glm::vec3& direction)
+		{
+			// avoid 0 * inf = NaN in the slab test for axis aligned rays
+			const float tiny = 1e-20f;
+			return glm::vec3(
+				1.0f / (glm::abs(direction.x) > tiny ? direction.x : (direction.x < 0.0f ? -tiny : tiny)),
+				1.0f / (glm::abs(direction.y) > tiny ? direction.y : (direction.y < 0.0f ? -tiny : tiny)),
+				1.0f / (glm::abs(direction.z) > tiny ? direction.z : (direction.z < 0.0f ? -tiny : tiny)));
+		}
+
+		// Bottom level acceleration structure over the triangles of a single mesh.
+		// Leaves hold packets of 4 triangles that are tested at once with SSE.
+		class TriangleBVH
+		{
+		public:
+			void Build(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices);
+
+			// closest hit, returns false if nothing was hit before ray.MaxDistance
+			bool Intersect(const Ray& ray, RayHit* hit) const;
+			// any hit, stops at the first triangle found before ray.MaxDistance
+			bool Occluded(const Ray& ray) const;
+
+			const AABB& GetBounds() const;
+			bool IsBuilt() const;
+			unsigned int GetNodeCount() const;
+			unsigned int GetTriangleCount() const;
+
+			static const unsigned int MAX_LEAF_TRIANGLES = 8;
+
+		private:
+			// plain floats loaded unaligned, std::vector doesn't promise 16 byte alignment before C++17
+			struct TrianglePacket
+			{
+				// vertex 0 and the two edges of 4 triangles in SoA form
+				float v0[3][4];
+				float edge1[3][4];
+				float edge2[3][4];
+				unsigned int triangle[4];
+			};
+
+			template <bool ANY_HIT>
+			bool Traverse(const Ray& ray, RayHit* hit) const;
+
+			std::vector<BVHNode> nodes;
+			std::vector<TrianglePacket> packets;
+			unsigned int triangleCount = 0;
+		};
+	}
+}
@@ -0,0 +1,212 @@
+#include "Broadphase.h"
+
+#include <algorithm>
+
+namespace glh {
+	namespace Graphics {
+
+		uint32_t Broadphase::AddProxy(const AABB& bounds, uint32_t userData)
+		{
+			uint32_t proxy;
+			if (!freeProxies.empty())
+			{
+				proxy = freeProxies.back();
+				freeProxies.pop_back();
+			}
+			else
+			{
+				proxy = (uint32_t)alive.size();
+				boxes.push_back(Box());
+				userDatas.push_back(0);
+				alive.push_back(0);
+			}
+
+			alive[proxy] = 1;
+			userDatas[proxy] = userData;
+			UpdateProxy(proxy, bounds);
+
+			// the endpoints are inserted on the next update so a batch of adds is sorted in one go
+			pendingAdds.push_back(proxy);
+			return proxy;
+		}
+
+		void Broadphase::RemoveProxy(uint32_t proxy)
+		{
+			if (!alive[proxy])
+				return;
+
+			alive[proxy] = 0;
+			pendingRemoves.push_back(proxy);
+		}
+
+		void Broadphase::UpdateProxy(uint32_t proxy, const AABB& bounds)
+		{
+			Box& box = boxes[proxy];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				box.Min[axis] = bounds.Min[axis];
+				box.Max[axis] = bounds.Max[axis];
+			}
+			box.Min[3] = 0.0f;
+			box.Max[3] = 0.0f;
+		}
+
+		uint32_t Broadphase::GetUserData(uint32_t proxy) const
+		{
+			return userDatas[proxy];
+		}
+
+		void Broadphase::Update()
+		{
+			addedPairs.clear();
+			removedPairs.clear();
+
+			if (!pendingRemoves.empty())
+			{
+				// drop the pairs and endpoints of removed proxies, then recycle their IDs
+				for (auto it = pairs.begin(); it != pairs.end();)
+				{
+					uint32_t a = (uint32_t)(*it >> 32);
+					uint32_t b = (uint32_t)(*it & 0xffffffff);
+					if (alive[a] && alive[b])
+					{
+						++it;
+						continue;
+					}
+					removedPairs.push_back({ a, b });
+					it = pairs.erase(it);
+				}
+
+				for (int axis = 0; axis < 3; axis++)
+				{
+					size_t count = 0;
+					for (size_t i = 0; i < endpointIDs[axis].size(); i++)
+					{
+						if (!alive[endpointIDs[axis][i] >> 1])
+							continue;
+						endpointValues[axis][count] = endpointValues[axis][i];
+						endpointIDs[axis][count] = endpointIDs[axis][i];
+						count++;
+					}
+					endpointValues[axis].resize(count);
+					endpointIDs[axis].resize(count);
+				}
+
+				pendingAdds.erase(std::remove_if(pendingAdds.begin(), pendingAdds.end(),
+					[&](uint32_t proxy) { return !alive[proxy]; }), pendingAdds.end());
+				freeProxies.insert(freeProxies.end(), pendingRemoves.begin(), pendingRemoves.end());
+				pendingRemoves.clear();
+			}
+
+			// new endpoints go on the end and get sorted into place with everything else
+			for (uint32_t proxy : pendingAdds)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					endpointIDs[axis].push_back(proxy << 1);
+					endpointIDs[axis].push_back((proxy << 1) | 1);
+					endpointValues[axis].push_back(0.0f);
+					endpointValues[axis].push_back(0.0f);
+				}
+			}
+			pendingAdds.clear();
+
+			for (int axis = 0; axis < 3; axis++)
+				SortAxis(axis);
+		}
+
+		void Broadphase::SortAxis(int axis)
+		{
+			std::vector<float>& values = endpointValues[axis];
+			std::vector<uint32_t>& ids = endpointIDs[axis];
+			// pull the current box values into the endpoint array
+			for (size_t i = 0; i < ids.size(); i++)
+			{
+				uint32_t id = ids[i];
+				const Box& box = boxes[id >> 1];
+				values[i] = (id & 1) ? box.Max[axis] : box.Min[axis];
+			}
+
+			// insertion sort, each swap of a min and a max endpoint is a potential overlap change
+			for (size_t i = 1; i < values.size(); i++)
+			{
+				float value = values[i];
+				uint32_t id = ids[i];
+				uint32_t proxy = id >> 1;
+				bool isMax = (id & 1) != 0;
+
+				size_t j = i;
+				while (j > 0 && value < values[j - 1])
+				{
+					uint32_t other = ids[j - 1];
+					uint32_t otherProxy = other >> 1;
+					bool otherIsMax = (other & 1) != 0;
+
+					if (!isMax && otherIsMax)
+					{
+						// our min moved below their max, the boxes may now overlap
+						if (Overlaps(proxy, otherProxy))
+							AddPair(proxy, otherProxy);
+					}
+					else if (isMax && !otherIsMax)
+					{
+						// our max moved below their min, they can't overlap any more
+						RemovePair(proxy, otherProxy);
+					}
+
+					values[j] = values[j - 1];
+					ids[j] = other;
+					j--;
+				}
+				values[j] = value;
+				ids[j] = id;
+			}
+		}
+
+		bool Broadphase::Overlaps(uint32_t a, uint32_t b) const
+		{
+			if (a == b)
+				return false;
+
+			// separated on an axis if one box ends before the other begins, the fourth lane is ignored
+			__m128 minA = _mm_loadu_ps(boxes[a].Min);
+			__m128 maxA = _mm_loadu_ps(boxes[a].Max);
+			__m128 minB = _mm_loadu_ps(boxes[b].Min);
+			__m128 maxB = _mm_loadu_ps(boxes[b].Max);
+			__m128 separated = _mm_or_ps(_mm_cmpgt_ps(minA, maxB), _mm_cmplt_ps(maxA, minB));
+			return (_mm_movemask_ps(separated) & 7) == 0;
+		}
+
+		void Broadphase::AddPair(uint32_t a, uint32_t b)
+		{
+			if (pairs.insert(PairKey(a, b)).second)
+				addedPairs.push_back({ std::min(a, b), std::max(a, b) });
+		}
+
+		void Broadphase::RemovePair(uint32_t a, uint32_t b)
+		{
+			if (pairs.erase(PairKey(a, b)) > 0)
+				removedPairs.push_back({ std::min(a, b), std::max(a, b) });
+		}
+
+		uint64_t Broadphase::PairKey(uint32_t a, uint32_t b)
+		{
+			return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+		}
+
+		const std::vector<Broadphase::Pair>& Broadphase::GetAddedPairs() const
+		{
+			return addedPairs;
+		}
+
+		const std::vector<Broadphase::Pair>& Broadphase::GetRemovedPairs() const
+		{
+			return removedPairs;
+		}
+
+		size_t Broadphase::GetPairCount() const
+		{
+			return pairs.size();
+		}
+	}
+}
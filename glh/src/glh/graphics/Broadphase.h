@@ -0,0 +1,73 @@
+#pragma once
+
+#include <xmmintrin.h>
+
+#include <cstdint>
+#include <vector>
+#include <unordered_set>
+
+#include "AABB.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// Incremental sweep and prune over axis aligned boxes.
+		// Every axis keeps a sorted array of box endpoints. Between updates boxes only move a little,
+		// so the arrays are nearly sorted and an insertion sort fixes them up in close to linear time.
+		// Overlaps only begin or end where a min endpoint passes a max endpoint, which is where the
+		// added and removed pair events come from.
+		class Broadphase
+		{
+		public:
+			struct Pair
+			{
+				// proxy IDs, A < B
+				uint32_t A;
+				uint32_t B;
+			};
+
+			uint32_t AddProxy(const AABB& bounds, uint32_t userData = 0);
+			void RemoveProxy(uint32_t proxy);
+			void UpdateProxy(uint32_t proxy, const AABB& bounds);
+			uint32_t GetUserData(uint32_t proxy) const;
+
+			// re-sorts the endpoints and collects the pair events since the last update
+			void Update();
+
+			const std::vector<Pair>& GetAddedPairs() const;
+			const std::vector<Pair>& GetRemovedPairs() const;
+			size_t GetPairCount() const;
+
+		private:
+			bool Overlaps(uint32_t a, uint32_t b) const;
+			void AddPair(uint32_t a, uint32_t b);
+			void RemovePair(uint32_t a, uint32_t b);
+			void SortAxis(int axis);
+
+			static uint64_t PairKey(uint32_t a, uint32_t b);
+
+			// x, y, z and an unused lane, so one SSE compare tests all three axes of a pair
+			struct Box
+			{
+				float Min[4];
+				float Max[4];
+			};
+
+			std::vector<Box> boxes;
+			std::vector<uint32_t> userDatas;
+			std::vector<uint8_t> alive;
+			std::vector<uint32_t> freeProxies;
+
+			// sorted endpoints per axis, the ID is the proxy shifted left once with the low bit set for max endpoints
+			std::vector<float> endpointValues[3];
+			std::vector<uint32_t> endpointIDs[3];
+
+			std::vector<uint32_t> pendingAdds;
+			std::vector<uint32_t> pendingRemoves;
+
+			std::unordered_set<uint64_t> pairs;
+			std::vector<Pair> addedPairs;
+			std::vector<Pair> removedPairs;
+		};
+	}
+}
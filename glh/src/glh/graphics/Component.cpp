@@ -0,0 +1,56 @@
+#include "Component.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace glh {
+	namespace Graphics {
+
+		Component::Component() {
+
+		}
+
+		void Component::SetTranslation(float x, float y, float z) {
+			translate.x = x;
+			translate.y = y;
+			translate.z = z;
+		}
+
+		void Component::SetRotation(float x, float y, float z) {
+			rotate.x = x;
+			rotate.y = y;
+			rotate.z = z;
+		}
+
+		void Component::SetSize(float x, float y, float z) {
+			size.x = x;
+			size.y = y;
+			size.z = z;
+		}
+
+		Translation Component::GetTranslation() const {
+			return translate;
+		}
+
+		Rotation Component::GetRotation() const {
+			return rotate;
+		}
+
+		Size Component::GetSize() const {
+			return size;
+		}
+
+		AABB Component::GetBounds() const {
+			AABB local;
+			local.Grow(glm::vec3(-size.x, -size.y, -size.z) * 0.5f);
+			local.Grow(glm::vec3(size.x, size.y, size.z) * 0.5f);
+
+			// same order as Model: translate, then rotate about x, y and z
+			glm::mat4 transform;
+			transform = glm::translate(transform, glm::vec3(translate.x, translate.y, translate.z));
+			transform = glm::rotate(transform, rotate.x, glm::vec3(1, 0, 0));
+			transform = glm::rotate(transform, rotate.y, glm::vec3(0, 1, 0));
+			transform = glm::rotate(transform, rotate.z, glm::vec3(0, 0, 1));
+			return local.Transform(transform);
+		}
+	}
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "AABB.h"
+
 namespace glh {
 	namespace Graphics {
 
@@ -17,15 +19,32 @@ namespace glh {
 			float z = 0;
 		};
 
+		// full extents of the component's box before rotation
+		struct Size
+		{
+			float x = 1;
+			float y = 1;
+			float z = 1;
+		};
+
 		class Component {
 		public:
 			Component();
-			void GetSize();
+			void SetTranslation(float x, float y, float z);
+			void SetRotation(float x, float y, float z);
+			void SetSize(float x, float y, float z);
+			Translation GetTranslation() const;
+			Rotation GetRotation() const;
+			Size GetSize() const;
+
+			// world space box around the rotated component, for the broadphase
+			AABB GetBounds() const;
 
 		private:
 			Translation translate;
 			Rotation rotate;
+			Size size;
 
 		};
 	}
-}
\ No newline at end of file
+}
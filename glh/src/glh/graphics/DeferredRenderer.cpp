@@ -0,0 +1,229 @@
+#include "DeferredRenderer.h"
+
+#include <glad/glad.h>
+
+#include <cmath>
+
+#include "../util/Log.h"
+#include "../util/Parallel.h"
+#include "../util/Timer.h"
+#include "GLResources.h"
+#include "GLState.h"
+#include "PointShadowAtlas.h"
+
+namespace glh {
+	namespace Graphics {
+
+		DeferredRenderer::DeferredRenderer(unsigned int width, unsigned int height) :
+			gBuffer(width, height), width(width), height(height)
+		{
+			tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+			tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+			gBuffer.AddColourBuffer(GL_RGBA8);
+			gBuffer.AddColourBuffer(GL_RG16F);
+			gBuffer.AddColourBuffer(GL_RGBA8);
+			gBuffer.AddDepthTexture(GL_DEPTH24_STENCIL8);
+			gBuffer.CheckStatus();
+
+			geometryProgram = Shader("Data/Shaders/gbuffer.vs", "Data/Shaders/gbuffer.fs");
+			geometryProgram.use();
+			geometryProgram.setInt("albedoMap", 0);
+			geometryProgram.setInt("normalMap", 1);
+			geometryProgram.setInt("ormMap", 2);
+
+			lightingProgram = Shader("Data/Shaders/fullscreen.vs", "Data/Shaders/deferredLighting.fs");
+			lightingProgram.use();
+			lightingProgram.setInt("albedoBuffer", GBUFFER_TEXTURE_UNIT + ALBEDO_TARGET);
+			lightingProgram.setInt("normalBuffer", GBUFFER_TEXTURE_UNIT + NORMAL_TARGET);
+			lightingProgram.setInt("ormBuffer", GBUFFER_TEXTURE_UNIT + ORM_TARGET);
+			lightingProgram.setInt("depthBuffer", DEPTH_TEXTURE_UNIT);
+			lightingProgram.setInt("lights", LIGHT_TEXTURE_UNIT);
+			lightingProgram.setInt("tiles", TILE_TEXTURE_UNIT);
+			inverseViewProjection = lightingProgram.GetUniform<glm::mat4>("inverseViewProjection");
+			tileCountX = lightingProgram.GetUniform<int>("tileCountX");
+
+			// both lists are orphaned and refilled every frame
+			lightBuffer = GLResources::CreateStreamBuffer(2 * sizeof(glm::vec4));
+			tileBuffer = GLResources::CreateStreamBuffer(tilesX * tilesY * 2 * sizeof(unsigned int));
+			lightTexture = GLResources::CreateBufferTexture(GL_RGBA32F, lightBuffer);
+			tileTexture = GLResources::CreateBufferTexture(GL_R32UI, tileBuffer);
+
+			emptyVAO = GLResources::CreateVertexArray();
+			tileLights.resize(tilesX * tilesY);
+		}
+
+		Shader* DeferredRenderer::GetGeometryProgram()
+		{
+			return &geometryProgram;
+		}
+
+		Shader* DeferredRenderer::GetLightingProgram()
+		{
+			return &lightingProgram;
+		}
+
+		Framebuffer* DeferredRenderer::GetGBuffer()
+		{
+			return &gBuffer;
+		}
+
+		void DeferredRenderer::BeginGeometry()
+		{
+			gBuffer.Bind();
+			// a zero normal marks pixels nothing was drawn to, though depth is what the lighting pass checks
+			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+		}
+
+		void DeferredRenderer::Light(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+			const PointShadowAtlas* shadows, Framebuffer* target)
+		{
+			double cullStart = Util::Timer::GetTime();
+			CullLights(lights, view, projection, shadows);
+			stats.CullMilliseconds = (Util::Timer::GetTime() - cullStart) * 1000.0;
+
+			GLResources::StreamBuffer(lightBuffer, lightData.size() * sizeof(glm::vec4), lightData.data());
+			GLResources::StreamBuffer(tileBuffer, tileData.size() * sizeof(unsigned int), tileData.data());
+
+			lightingTimer.Begin();
+			target->Bind();
+			// the triangle covers every pixel once, there is nothing to test against
+			GLState::SetDepthTest(false);
+			lightingProgram.use();
+			lightingProgram.Set(inverseViewProjection, glm::inverse(projection * view));
+			lightingProgram.Set(tileCountX, (int)tilesX);
+			for (unsigned int i = 0; i < GBUFFER_TARGET_COUNT; i++)
+				GLState::BindTexture(GBUFFER_TEXTURE_UNIT + i, GL_TEXTURE_2D, gBuffer.GetColourBuffer(i));
+			GLState::BindTexture(DEPTH_TEXTURE_UNIT, GL_TEXTURE_2D, gBuffer.GetDepthTexture());
+			GLState::BindTexture(LIGHT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, lightTexture);
+			GLState::BindTexture(TILE_TEXTURE_UNIT, GL_TEXTURE_BUFFER, tileTexture);
+			GLState::BindVertexArray(emptyVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			lightingTimer.End();
+
+			gBuffer.BlitDepth(target);
+			GLState::SetDepthTest(true);
+			stats.LightingMilliseconds = lightingTimer.GetMilliseconds();
+		}
+
+		// Projects the corners of the sphere's view space bounding box. That's looser than the exact
+		// projected ellipse but never misses a pixel, and the range window already makes the extra
+		// tiles cheap to reject in the shader.
+		bool DeferredRenderer::GetTileRect(const PointLight& light, const glm::mat4& view, const glm::mat4& projection, int* rect) const
+		{
+			glm::vec4 center = view * glm::vec4(light.Position, 1.0f);
+			float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+
+			// view space looks down -z, a sphere entirely behind the near plane can't be seen
+			if (center.z - light.Range > -nearPlane)
+				return false;
+
+			if (center.z + light.Range > -nearPlane)
+			{
+				// crossing the near plane, corners behind the camera don't project sensibly
+				rect[0] = 0;
+				rect[1] = 0;
+				rect[2] = (int)tilesX - 1;
+				rect[3] = (int)tilesY - 1;
+				return true;
+			}
+
+			float minX = 1.0f, minY = 1.0f, maxX = -1.0f, maxY = -1.0f;
+			for (int corner = 0; corner < 8; corner++)
+			{
+				glm::vec4 position = center;
+				position.x += corner & 1 ? light.Range : -light.Range;
+				position.y += corner & 2 ? light.Range : -light.Range;
+				position.z += corner & 4 ? light.Range : -light.Range;
+				glm::vec4 clip = projection * position;
+				float x = clip.x / clip.w;
+				float y = clip.y / clip.w;
+				minX = glm::min(minX, x);
+				minY = glm::min(minY, y);
+				maxX = glm::max(maxX, x);
+				maxY = glm::max(maxY, y);
+			}
+			if (maxX < -1.0f || maxY < -1.0f || minX > 1.0f || minY > 1.0f)
+				return false;
+
+			// normalised device coordinates to tiles, with the same origin as gl_FragCoord
+			rect[0] = glm::max((int)std::floor((minX * 0.5f + 0.5f) * width / TILE_SIZE), 0);
+			rect[1] = glm::max((int)std::floor((minY * 0.5f + 0.5f) * height / TILE_SIZE), 0);
+			rect[2] = glm::min((int)std::floor((maxX * 0.5f + 0.5f) * width / TILE_SIZE), (int)tilesX - 1);
+			rect[3] = glm::min((int)std::floor((maxY * 0.5f + 0.5f) * height / TILE_SIZE), (int)tilesY - 1);
+			return true;
+		}
+
+		void DeferredRenderer::CullLights(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+			const PointShadowAtlas* shadows)
+		{
+			unsigned int lightCount = (unsigned int)lights.size();
+			if (lightCount > MAX_LIGHTS)
+			{
+				Util::Log::WriteWarning("DEFERRED: " + std::to_string(lightCount) + " lights, only the first " + std::to_string(MAX_LIGHTS) + " are shaded");
+				lightCount = MAX_LIGHTS;
+			}
+
+			lightData.resize(lightCount * 2);
+			lightRects.resize(lightCount * 4);
+			Util::Parallel::For(lightCount, [&](unsigned int i) {
+				const PointLight& light = lights[i];
+				lightData[i * 2] = glm::vec4(light.Position, light.Range);
+				float shadowSlot = shadows != nullptr ? (float)(shadows->GetSlot(i) + 1) : 0.0f;
+				lightData[i * 2 + 1] = glm::vec4(light.Color * light.Intensity, shadowSlot);
+
+				int* rect = &lightRects[i * 4];
+				if (!GetTileRect(light, view, projection, rect))
+				{
+					rect[0] = 1;
+					rect[2] = 0;
+				}
+			});
+
+			// each row only writes its own tiles and walks the lights in order, so the lists come
+			// out the same however the rows are spread over the threads
+			Util::Parallel::For(tilesY, [&](unsigned int row) {
+				for (unsigned int x = 0; x < tilesX; x++)
+					tileLights[row * tilesX + x].clear();
+
+				for (unsigned int i = 0; i < lightCount; i++)
+				{
+					const int* rect = &lightRects[i * 4];
+					if (rect[0] > rect[2] || (int)row < rect[1] || (int)row > rect[3])
+						continue;
+					for (int x = rect[0]; x <= rect[2]; x++)
+						tileLights[row * tilesX + x].push_back(i);
+				}
+			});
+
+			stats.Lights = lightCount;
+			stats.VisibleLights = 0;
+			stats.TileLightReferences = 0;
+			stats.MaxTileLights = 0;
+			for (unsigned int i = 0; i < lightCount; i++)
+			{
+				if (lightRects[i * 4] <= lightRects[i * 4 + 2])
+					stats.VisibleLights++;
+			}
+
+			unsigned int tileCount = tilesX * tilesY;
+			tileData.resize(tileCount * 2);
+			for (unsigned int tile = 0; tile < tileCount; tile++)
+			{
+				const std::vector<unsigned int>& list = tileLights[tile];
+				tileData[tile * 2] = (unsigned int)tileData.size();
+				tileData[tile * 2 + 1] = (unsigned int)list.size();
+				tileData.insert(tileData.end(), list.begin(), list.end());
+				stats.TileLightReferences += (unsigned int)list.size();
+				if (list.size() > stats.MaxTileLights)
+					stats.MaxTileLights = (unsigned int)list.size();
+			}
+		}
+
+		const DeferredRenderer::Stats& DeferredRenderer::GetStats() const
+		{
+			return stats;
+		}
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Framebuffer.h"
+#include "GPUTimer.h"
+#include "Light.h"
+#include "Shader.h"
+
+namespace glh {
+	namespace Graphics {
+
+		class PointShadowAtlas;
+
+		// Deferred shading through a thin G-buffer, for scenes with far more lights than the forward
+		// shaders' LightBlock holds. The geometry pass writes surface attributes only; the lighting
+		// pass then shades every pixel exactly once with just the lights that reach it, so its cost
+		// follows the screen size and light count rather than how much geometry was drawn.
+		//
+		// G-buffer targets (see gbuffer.fs):
+		//   0 RGBA8   albedo, a unused
+		//   1 RG16F   world normal, octahedral encoded
+		//   2 RGBA8   r: ao, g: roughness, b: metallic, a unused
+		//   depth     D24S8 texture, world positions are rebuilt from it
+		//
+		// Lights are culled on the CPU into TILE_SIZE pixel screen tiles by the screen rectangle of
+		// their range sphere. The lighting shader reads its tile's list from a buffer texture.
+		//
+		// The lighting pass also shades the sun with the cascaded shadows and the ambient light of
+		// the sky and the probes, through the same includes as the forward shaders. Set up the
+		// lighting program with the SetupProgram of LightBuffer, PointShadowAtlas,
+		// ImageBasedLighting and IrradianceVolume, and bind them before Light.
+		class DeferredRenderer
+		{
+		public:
+			enum GBufferTarget { ALBEDO_TARGET, NORMAL_TARGET, ORM_TARGET, GBUFFER_TARGET_COUNT };
+
+			static const unsigned int TILE_SIZE = 16;
+			// lights past this are dropped with a warning
+			static const unsigned int MAX_LIGHTS = 4096;
+
+			// texture units the lighting pass reads from, above the material slots
+			static const unsigned int GBUFFER_TEXTURE_UNIT = 7;
+			static const unsigned int DEPTH_TEXTURE_UNIT = GBUFFER_TEXTURE_UNIT + GBUFFER_TARGET_COUNT;
+			static const unsigned int LIGHT_TEXTURE_UNIT = DEPTH_TEXTURE_UNIT + 1;
+			static const unsigned int TILE_TEXTURE_UNIT = LIGHT_TEXTURE_UNIT + 1;
+
+			struct Stats
+			{
+				unsigned int Lights = 0;
+				// lights whose range is on screen at all
+				unsigned int VisibleLights = 0;
+				// sum of the tile list lengths, the number of light evaluations per pixel summed over tiles
+				unsigned int TileLightReferences = 0;
+				unsigned int MaxTileLights = 0;
+				double CullMilliseconds = 0.0;
+				double LightingMilliseconds = 0.0;
+			};
+
+			DeferredRenderer(unsigned int width, unsigned int height);
+
+			// writes the G-buffer for materials of the PBR schema, submit the opaque draws with it
+			Shader* GetGeometryProgram();
+			Shader* GetLightingProgram();
+			Framebuffer* GetGBuffer();
+
+			// binds and clears the G-buffer, the geometry pass draws into it until Light is called
+			void BeginGeometry();
+
+			// shades the G-buffer into target, then copies its depth there so forward passes
+			// (transparent draws, the skybox) can be drawn on top. target needs a D24S8 depth attachment.
+			// The lights shadowed in shadows, if there is one, get their cube shadows.
+			void Light(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+				const PointShadowAtlas* shadows, Framebuffer* target);
+
+			const Stats& GetStats() const;
+
+		private:
+			// screen rectangle in tiles covered by the range sphere, false if it's entirely off screen
+			bool GetTileRect(const PointLight& light, const glm::mat4& view, const glm::mat4& projection, int* rect) const;
+			void CullLights(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+				const PointShadowAtlas* shadows);
+
+			Framebuffer gBuffer;
+			Shader geometryProgram;
+			Shader lightingProgram;
+
+			unsigned int width;
+			unsigned int height;
+			unsigned int tilesX;
+			unsigned int tilesY;
+
+			// two texels per light, see deferredLighting.fs
+			std::vector<glm::vec4> lightData;
+			std::vector<int> lightRects;
+			std::vector<std::vector<unsigned int>> tileLights;
+			// an offset and count per tile followed by all tile lists
+			std::vector<unsigned int> tileData;
+
+			unsigned int lightBuffer = 0;
+			unsigned int lightTexture = 0;
+			unsigned int tileBuffer = 0;
+			unsigned int tileTexture = 0;
+			// the fullscreen triangle is generated from gl_VertexID, but a VAO still has to be bound
+			unsigned int emptyVAO = 0;
+
+			Uniform<glm::mat4> inverseViewProjection;
+			Uniform<int> tileCountX;
+			GPUTimer lightingTimer;
+			Stats stats;
+		};
+	}
+}
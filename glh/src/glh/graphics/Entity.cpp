@@ -0,0 +1,10 @@
+#include "Entity.h"
+
+namespace glh {
+	namespace Graphics {
+
+		Entity::Entity() {
+
+		}
+	}
+}
@@ -3,10 +3,17 @@
 #include <glad\glad.h>
 
 #include "../util/Log.h"
+#include "GLResources.h"
+#include "GLState.h"
+#include "VertexLayout.h"
 
 namespace glh {
 	namespace Graphics {
 
+		// screen quad vertices are a position and a texture coordinate
+		typedef VertexLayout<VertexAttribute<0, glm::vec2>, VertexAttribute<1, glm::vec2>> QuadLayout;
+		static_assert(QuadLayout::Stride(0) == 4 * sizeof(float), "screen quad vertices are 4 floats");
+
 		Framebuffer::Framebuffer(int width, int height) {
 
 			_width = width;
@@ -24,15 +31,10 @@ namespace glh {
 			};
 
 			// set up VAO
-			glGenVertexArrays(1, &quadVAO);
-			glGenBuffers(1, &quadVBO);
-			glBindVertexArray(quadVAO);
-			glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-			glEnableVertexAttribArray(0);
-			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+			quadVBO = GLResources::CreateBuffer(sizeof(quadVertices), quadVertices);
+			quadVAO = GLResources::CreateVertexArray();
+			QuadLayout::Apply(quadVAO);
+			QuadLayout::SetVertexBuffer(quadVAO, 0, quadVBO);
 
 			// set up shader
 			screenQuadShader = Shader("Data/Shaders/screenQuad.vs", "Data/Shaders/screenQuad.fs");
@@ -40,23 +42,13 @@ namespace glh {
 			screenQuadShader.setInt("screenTexture", 0);
 
 			// set up framebuffer
-			glGenFramebuffers(1, &fbo);
-			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-			// create a color attachment texture
-
-
-			// create a renderbuffer object for depth and stencil attachment (we won't be sampling these)
-
-
-
-			// now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			fbo = GLResources::CreateFramebuffer();
 
 			Util::Log::WriteTrace("Framebuffer set up successfully");
 		}
 
 		void Framebuffer::CheckStatus() {
-			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			if (!GLResources::IsComplete(fbo)) {
 				Util::Log::WriteError("ERROR::FRAMEBUFFER:: Framebuffer is not complete!");
 			}
 			else {
@@ -65,53 +57,87 @@ namespace glh {
 		}
 
 
-		void Framebuffer::AddColourBuffer() {
-			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		unsigned int Framebuffer::AddColourBuffer(GLenum internalFormat) {
+			unsigned int index = (unsigned int)colourBuffers.size();
+			unsigned int texture = GLResources::CreateTexture(GL_TEXTURE_2D, internalFormat, _width, _height);
+			// integer textures can't be filtered and are incomplete unless set to nearest
+			GLint filter = GLResources::IsIntegerFormat(internalFormat) ? GL_NEAREST : GL_LINEAR;
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, texture, GL_TEXTURE_MIN_FILTER, filter);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, texture, GL_TEXTURE_MAG_FILTER, filter);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			GLResources::AttachTexture(fbo, GL_COLOR_ATTACHMENT0 + index, texture);
+			colourBuffers.push_back(texture);
+
+			// output n of the fragment shader goes to attachment n
+			std::vector<GLenum> drawBuffers;
+			for (unsigned int i = 0; i < colourBuffers.size(); i++)
+				drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+			GLResources::SetDrawBuffers(fbo, (GLsizei)drawBuffers.size(), &drawBuffers[0]);
+			return index;
+		}
+
+		void Framebuffer::AddDepthStencBuffer() {
+			rbo = GLResources::CreateRenderbuffer(GL_DEPTH24_STENCIL8, _width, _height); // use a single renderbuffer object for both a depth AND stencil buffer.
+			GLResources::AttachRenderbuffer(fbo, GL_DEPTH_STENCIL_ATTACHMENT, rbo); // now actually attach it
+		}
+
+		void Framebuffer::AddDepthTexture(GLenum internalFormat) {
+			depthStenc = GLResources::CreateTexture(GL_TEXTURE_2D, internalFormat, _width, _height);
+			// depth is read back texel for texel, filtering it would blend unrelated surfaces
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, depthStenc, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, depthStenc, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, depthStenc, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, depthStenc, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			GLenum attachment = internalFormat == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+			GLResources::AttachTexture(fbo, attachment, depthStenc);
+		}
 
-			glGenTextures(1, &textureColorbuffer);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, _width, _height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorbuffer, 0);
+		unsigned int Framebuffer::GetColourBuffer(unsigned int index) const {
+			return index < colourBuffers.size() ? colourBuffers[index] : 0;
+		}
 
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		unsigned int Framebuffer::GetColourBufferCount() const {
+			return (unsigned int)colourBuffers.size();
 		}
-		void Framebuffer::AddDepthStencBuffer() {
-			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
-			/*glGenTextures(1, &depthStenc);
-			glBindTexture(GL_TEXTURE_2D, depthStenc);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 0);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthStenc, 0);*/
+		unsigned int Framebuffer::GetDepthTexture() const {
+			return depthStenc;
+		}
+
+		unsigned int Framebuffer::GetWidth() const {
+			return _width;
+		}
 
-			glGenRenderbuffers(1, &rbo);
-			glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, _width, _height); // use a single renderbuffer object for both a depth AND stencil buffer.
-			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo); // now actually attach it
+		unsigned int Framebuffer::GetHeight() const {
+			return _height;
+		}
 
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		void Framebuffer::BlitDepth(Framebuffer* target) {
+			// GLState tracks both binding points as one, so the read binding is put back afterwards
+			GLState::BindFramebuffer(target->fbo);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+			glBlitFramebuffer(0, 0, _width, _height, 0, 0, target->_width, target->_height, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, target->fbo);
 		}
 
 		void Framebuffer::DrawToScreen() {
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-			glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
+			GLState::BindFramebuffer(0);
+			GLState::SetDepthTest(false); // disable depth test so screen-space quad isn't discarded due to depth test.
 
 			glClearColor(1.0f, 0.0f, 1.0f, 1.0f); // set clear color to white (not really necessery actually, since we won't be able to see behind the quad anyways)
 			glClear(GL_COLOR_BUFFER_BIT);
 
 			screenQuadShader.use();
-			glBindVertexArray(quadVAO);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, textureColorbuffer);	// use the color attachment texture as the texture of the quad plane
+			GLState::BindVertexArray(quadVAO);
+			GLState::BindTexture(0, GL_TEXTURE_2D, GetColourBuffer(0));	// use the color attachment texture as the texture of the quad plane
 			glDrawArrays(GL_TRIANGLES, 0, 6);
-			glEnable(GL_DEPTH_TEST);
+			// depth testing is left off, Bind() turns it back on for the next frame
 		}
 
 		void Framebuffer::Bind() {
-			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-			glEnable(GL_DEPTH_TEST); // enable depth testing (is disabled for rendering screen-space quad)
+			GLState::BindFramebuffer(fbo);
+			GLState::SetDepthTest(true); // enable depth testing (is disabled for rendering screen-space quad)
 		}
 
 		void Framebuffer::Clear() {
@@ -120,7 +146,7 @@ namespace glh {
 		}
 
 		void Framebuffer::Unbind() {
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			GLState::BindFramebuffer(0);
 		}
 	}
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <glad/glad.h>
+
 #include "../Graphics/Shader.h"
 
 #include <vector>
@@ -17,18 +19,29 @@ namespace glh {
 
 			void CheckStatus();
 
-			void AddColourBuffer();
+			// adds a colour attachment and routes the next fragment output to it, returns its index
+			unsigned int AddColourBuffer(GLenum internalFormat = GL_RGB8);
+			// depth and stencil in a renderbuffer, for targets whose depth is never sampled
 			void AddDepthStencBuffer();
+			// depth (and stencil with GL_DEPTH24_STENCIL8) in a texture later passes can sample
+			void AddDepthTexture(GLenum internalFormat = GL_DEPTH24_STENCIL8);
+
+			unsigned int GetColourBuffer(unsigned int index) const;
+			unsigned int GetColourBufferCount() const;
+			unsigned int GetDepthTexture() const;
+			unsigned int GetWidth() const;
+			unsigned int GetHeight() const;
 
+			// copies depth and stencil into target, whose depth attachment needs the same format
+			void BlitDepth(Framebuffer* target);
 
 		private:
 			unsigned int _width;
 			unsigned int _height;
 
 			unsigned int fbo;
-			unsigned int textureColorbuffer;
-			unsigned int rbo;
-			unsigned int depthStenc;
+			unsigned int rbo = 0;
+			unsigned int depthStenc = 0;
 
 			unsigned int quadVAO, quadVBO;
 			std::vector<unsigned int> colourBuffers;
@@ -0,0 +1,162 @@
+#include "GLExtensions.h"
+
+#include <GLFW\glfw3.h>
+
+#include <cstring>
+
+#include "../util/Log.h"
+
+namespace glh {
+	namespace Graphics {
+
+		GLExtensions::BufferStorageProc GLExtensions::BufferStorage = nullptr;
+		GLExtensions::MultiDrawElementsIndirectProc GLExtensions::MultiDrawElementsIndirect = nullptr;
+
+		GLExtensions::CreateBuffersProc GLExtensions::CreateBuffers = nullptr;
+		GLExtensions::NamedBufferStorageProc GLExtensions::NamedBufferStorage = nullptr;
+		GLExtensions::NamedBufferSubDataProc GLExtensions::NamedBufferSubData = nullptr;
+		GLExtensions::CreateTexturesProc GLExtensions::CreateTextures = nullptr;
+		GLExtensions::TextureStorage2DProc GLExtensions::TextureStorage2D = nullptr;
+		GLExtensions::TextureStorage3DProc GLExtensions::TextureStorage3D = nullptr;
+		GLExtensions::TextureSubImage2DProc GLExtensions::TextureSubImage2D = nullptr;
+		GLExtensions::TextureSubImage3DProc GLExtensions::TextureSubImage3D = nullptr;
+		GLExtensions::TextureParameteriProc GLExtensions::TextureParameteri = nullptr;
+		GLExtensions::GenerateTextureMipmapProc GLExtensions::GenerateTextureMipmap = nullptr;
+		GLExtensions::CreateFramebuffersProc GLExtensions::CreateFramebuffers = nullptr;
+		GLExtensions::NamedFramebufferTextureProc GLExtensions::NamedFramebufferTexture = nullptr;
+		GLExtensions::NamedFramebufferRenderbufferProc GLExtensions::NamedFramebufferRenderbuffer = nullptr;
+		GLExtensions::NamedFramebufferDrawBufferProc GLExtensions::NamedFramebufferDrawBuffer = nullptr;
+		GLExtensions::NamedFramebufferDrawBuffersProc GLExtensions::NamedFramebufferDrawBuffers = nullptr;
+		GLExtensions::NamedFramebufferReadBufferProc GLExtensions::NamedFramebufferReadBuffer = nullptr;
+		GLExtensions::CheckNamedFramebufferStatusProc GLExtensions::CheckNamedFramebufferStatus = nullptr;
+		GLExtensions::CreateRenderbuffersProc GLExtensions::CreateRenderbuffers = nullptr;
+		GLExtensions::NamedRenderbufferStorageProc GLExtensions::NamedRenderbufferStorage = nullptr;
+		GLExtensions::CreateVertexArraysProc GLExtensions::CreateVertexArrays = nullptr;
+		GLExtensions::VertexArrayVertexBufferProc GLExtensions::VertexArrayVertexBuffer = nullptr;
+		GLExtensions::VertexArrayElementBufferProc GLExtensions::VertexArrayElementBuffer = nullptr;
+		GLExtensions::EnableVertexArrayAttribProc GLExtensions::EnableVertexArrayAttrib = nullptr;
+		GLExtensions::VertexArrayAttribFormatProc GLExtensions::VertexArrayAttribFormat = nullptr;
+		GLExtensions::VertexArrayAttribIFormatProc GLExtensions::VertexArrayAttribIFormat = nullptr;
+		GLExtensions::VertexArrayAttribBindingProc GLExtensions::VertexArrayAttribBinding = nullptr;
+		GLExtensions::VertexArrayBindingDivisorProc GLExtensions::VertexArrayBindingDivisor = nullptr;
+
+		bool GLExtensions::directStateAccess = false;
+		bool GLExtensions::loaded = false;
+		int GLExtensions::majorVersion = 3;
+		int GLExtensions::minorVersion = 3;
+
+		void GLExtensions::Load()
+		{
+			glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+			glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+
+			if (IsVersion(4, 4) || HasExtension("GL_ARB_buffer_storage"))
+				BufferStorage = (BufferStorageProc)glfwGetProcAddress("glBufferStorage");
+			// base instance is core in 4.2, multi draw indirect in 4.3
+			if (IsVersion(4, 3) || (HasExtension("GL_ARB_multi_draw_indirect") && HasExtension("GL_ARB_base_instance")))
+				MultiDrawElementsIndirect = (MultiDrawElementsIndirectProc)glfwGetProcAddress("glMultiDrawElementsIndirect");
+
+			if (IsVersion(4, 5) || HasExtension("GL_ARB_direct_state_access"))
+			{
+				CreateBuffers = (CreateBuffersProc)glfwGetProcAddress("glCreateBuffers");
+				NamedBufferStorage = (NamedBufferStorageProc)glfwGetProcAddress("glNamedBufferStorage");
+				NamedBufferSubData = (NamedBufferSubDataProc)glfwGetProcAddress("glNamedBufferSubData");
+				CreateTextures = (CreateTexturesProc)glfwGetProcAddress("glCreateTextures");
+				TextureStorage2D = (TextureStorage2DProc)glfwGetProcAddress("glTextureStorage2D");
+				TextureStorage3D = (TextureStorage3DProc)glfwGetProcAddress("glTextureStorage3D");
+				TextureSubImage2D = (TextureSubImage2DProc)glfwGetProcAddress("glTextureSubImage2D");
+				TextureSubImage3D = (TextureSubImage3DProc)glfwGetProcAddress("glTextureSubImage3D");
+				TextureParameteri = (TextureParameteriProc)glfwGetProcAddress("glTextureParameteri");
+				GenerateTextureMipmap = (GenerateTextureMipmapProc)glfwGetProcAddress("glGenerateTextureMipmap");
+				CreateFramebuffers = (CreateFramebuffersProc)glfwGetProcAddress("glCreateFramebuffers");
+				NamedFramebufferTexture = (NamedFramebufferTextureProc)glfwGetProcAddress("glNamedFramebufferTexture");
+				NamedFramebufferRenderbuffer = (NamedFramebufferRenderbufferProc)glfwGetProcAddress("glNamedFramebufferRenderbuffer");
+				NamedFramebufferDrawBuffer = (NamedFramebufferDrawBufferProc)glfwGetProcAddress("glNamedFramebufferDrawBuffer");
+				NamedFramebufferDrawBuffers = (NamedFramebufferDrawBuffersProc)glfwGetProcAddress("glNamedFramebufferDrawBuffers");
+				NamedFramebufferReadBuffer = (NamedFramebufferReadBufferProc)glfwGetProcAddress("glNamedFramebufferReadBuffer");
+				CheckNamedFramebufferStatus = (CheckNamedFramebufferStatusProc)glfwGetProcAddress("glCheckNamedFramebufferStatus");
+				CreateRenderbuffers = (CreateRenderbuffersProc)glfwGetProcAddress("glCreateRenderbuffers");
+				NamedRenderbufferStorage = (NamedRenderbufferStorageProc)glfwGetProcAddress("glNamedRenderbufferStorage");
+				CreateVertexArrays = (CreateVertexArraysProc)glfwGetProcAddress("glCreateVertexArrays");
+				VertexArrayVertexBuffer = (VertexArrayVertexBufferProc)glfwGetProcAddress("glVertexArrayVertexBuffer");
+				VertexArrayElementBuffer = (VertexArrayElementBufferProc)glfwGetProcAddress("glVertexArrayElementBuffer");
+				EnableVertexArrayAttrib = (EnableVertexArrayAttribProc)glfwGetProcAddress("glEnableVertexArrayAttrib");
+				VertexArrayAttribFormat = (VertexArrayAttribFormatProc)glfwGetProcAddress("glVertexArrayAttribFormat");
+				VertexArrayAttribIFormat = (VertexArrayAttribIFormatProc)glfwGetProcAddress("glVertexArrayAttribIFormat");
+				VertexArrayAttribBinding = (VertexArrayAttribBindingProc)glfwGetProcAddress("glVertexArrayAttribBinding");
+				VertexArrayBindingDivisor = (VertexArrayBindingDivisorProc)glfwGetProcAddress("glVertexArrayBindingDivisor");
+				directStateAccess = CreateBuffers != nullptr &&
+					NamedBufferStorage != nullptr &&
+					NamedBufferSubData != nullptr &&
+					CreateTextures != nullptr &&
+					TextureStorage2D != nullptr &&
+					TextureStorage3D != nullptr &&
+					TextureSubImage2D != nullptr &&
+					TextureSubImage3D != nullptr &&
+					TextureParameteri != nullptr &&
+					GenerateTextureMipmap != nullptr &&
+					CreateFramebuffers != nullptr &&
+					NamedFramebufferTexture != nullptr &&
+					NamedFramebufferRenderbuffer != nullptr &&
+					NamedFramebufferDrawBuffer != nullptr &&
+					NamedFramebufferDrawBuffers != nullptr &&
+					NamedFramebufferReadBuffer != nullptr &&
+					CheckNamedFramebufferStatus != nullptr &&
+					CreateRenderbuffers != nullptr &&
+					NamedRenderbufferStorage != nullptr &&
+					CreateVertexArrays != nullptr &&
+					VertexArrayVertexBuffer != nullptr &&
+					VertexArrayElementBuffer != nullptr &&
+					EnableVertexArrayAttrib != nullptr &&
+					VertexArrayAttribFormat != nullptr &&
+					VertexArrayAttribIFormat != nullptr &&
+					VertexArrayAttribBinding != nullptr &&
+					VertexArrayBindingDivisor != nullptr;
+			}
+
+			loaded = true;
+			Util::Log::WriteInfo("GL: version " + std::to_string(majorVersion) + "." + std::to_string(minorVersion) +
+				(HasBufferStorage() ? ", buffer storage" : "") +
+				(HasMultiDrawIndirect() ? ", multi draw indirect" : "") +
+				(HasDirectStateAccess() ? ", direct state access" : ""));
+		}
+
+		bool GLExtensions::IsLoaded()
+		{
+			return loaded;
+		}
+
+		bool GLExtensions::HasBufferStorage()
+		{
+			return BufferStorage != nullptr;
+		}
+
+		bool GLExtensions::HasMultiDrawIndirect()
+		{
+			return MultiDrawElementsIndirect != nullptr;
+		}
+
+		bool GLExtensions::HasDirectStateAccess()
+		{
+			return directStateAccess;
+		}
+
+		bool GLExtensions::HasExtension(const char* name)
+		{
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+			for (GLint i = 0; i < count; i++)
+			{
+				const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+				if (extension != nullptr && strcmp(extension, name) == 0)
+					return true;
+			}
+			return false;
+		}
+
+		bool GLExtensions::IsVersion(int major, int minor)
+		{
+			return majorVersion > major || (majorVersion == major && minorVersion >= minor);
+		}
+	}
+}
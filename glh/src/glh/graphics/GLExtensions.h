@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// glad is generated for GL 3.3 core, the few newer enums glh uses are defined here when missing
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+namespace glh {
+	namespace Graphics {
+
+		// Entry points past GL 3.3 that glad wasn't generated with. They're looked up through GLFW once
+		// a context is current and are only non null when the driver supports them, so every use
+		// needs a 3.3 fallback.
+		class GLExtensions
+		{
+		public:
+			typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+			typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+
+			// direct state access (GL 4.5 / ARB_direct_state_access)
+			typedef void (APIENTRYP CreateBuffersProc)(GLsizei count, GLuint* buffers);
+			typedef void (APIENTRYP NamedBufferStorageProc)(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags);
+			typedef void (APIENTRYP NamedBufferSubDataProc)(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+			typedef void (APIENTRYP CreateTexturesProc)(GLenum target, GLsizei count, GLuint* textures);
+			typedef void (APIENTRYP TextureStorage2DProc)(GLuint texture, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+			typedef void (APIENTRYP TextureStorage3DProc)(GLuint texture, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth);
+			typedef void (APIENTRYP TextureSubImage2DProc)(GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels);
+			typedef void (APIENTRYP TextureSubImage3DProc)(GLuint texture, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels);
+			typedef void (APIENTRYP TextureParameteriProc)(GLuint texture, GLenum name, GLint value);
+			typedef void (APIENTRYP GenerateTextureMipmapProc)(GLuint texture);
+			typedef void (APIENTRYP CreateFramebuffersProc)(GLsizei count, GLuint* framebuffers);
+			typedef void (APIENTRYP NamedFramebufferTextureProc)(GLuint framebuffer, GLenum attachment, GLuint texture, GLint level);
+			typedef void (APIENTRYP NamedFramebufferRenderbufferProc)(GLuint framebuffer, GLenum attachment, GLenum renderbufferTarget, GLuint renderbuffer);
+			typedef void (APIENTRYP NamedFramebufferDrawBufferProc)(GLuint framebuffer, GLenum buffer);
+			typedef void (APIENTRYP NamedFramebufferDrawBuffersProc)(GLuint framebuffer, GLsizei count, const GLenum* buffers);
+			typedef void (APIENTRYP NamedFramebufferReadBufferProc)(GLuint framebuffer, GLenum buffer);
+			typedef GLenum (APIENTRYP CheckNamedFramebufferStatusProc)(GLuint framebuffer, GLenum target);
+			typedef void (APIENTRYP CreateRenderbuffersProc)(GLsizei count, GLuint* renderbuffers);
+			typedef void (APIENTRYP NamedRenderbufferStorageProc)(GLuint renderbuffer, GLenum internalFormat, GLsizei width, GLsizei height);
+			typedef void (APIENTRYP CreateVertexArraysProc)(GLsizei count, GLuint* arrays);
+			typedef void (APIENTRYP VertexArrayVertexBufferProc)(GLuint vao, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride);
+			typedef void (APIENTRYP VertexArrayElementBufferProc)(GLuint vao, GLuint buffer);
+			typedef void (APIENTRYP EnableVertexArrayAttribProc)(GLuint vao, GLuint attribute);
+			typedef void (APIENTRYP VertexArrayAttribFormatProc)(GLuint vao, GLuint attribute, GLint size, GLenum type, GLboolean normalized, GLuint relativeOffset);
+			typedef void (APIENTRYP VertexArrayAttribIFormatProc)(GLuint vao, GLuint attribute, GLint size, GLenum type, GLuint relativeOffset);
+			typedef void (APIENTRYP VertexArrayAttribBindingProc)(GLuint vao, GLuint attribute, GLuint binding);
+			typedef void (APIENTRYP VertexArrayBindingDivisorProc)(GLuint vao, GLuint binding, GLuint divisor);
+
+			// call once after gladLoadGLLoader
+			static void Load();
+
+			static bool IsLoaded();
+			static bool HasBufferStorage();
+			// glMultiDrawElementsIndirect with base instance support
+			static bool HasMultiDrawIndirect();
+			// every direct state access entry point below is available
+			static bool HasDirectStateAccess();
+
+			static BufferStorageProc BufferStorage;
+			static MultiDrawElementsIndirectProc MultiDrawElementsIndirect;
+
+			static CreateBuffersProc CreateBuffers;
+			static NamedBufferStorageProc NamedBufferStorage;
+			static NamedBufferSubDataProc NamedBufferSubData;
+			static CreateTexturesProc CreateTextures;
+			static TextureStorage2DProc TextureStorage2D;
+			static TextureStorage3DProc TextureStorage3D;
+			static TextureSubImage2DProc TextureSubImage2D;
+			static TextureSubImage3DProc TextureSubImage3D;
+			static TextureParameteriProc TextureParameteri;
+			static GenerateTextureMipmapProc GenerateTextureMipmap;
+			static CreateFramebuffersProc CreateFramebuffers;
+			static NamedFramebufferTextureProc NamedFramebufferTexture;
+			static NamedFramebufferRenderbufferProc NamedFramebufferRenderbuffer;
+			static NamedFramebufferDrawBufferProc NamedFramebufferDrawBuffer;
+			static NamedFramebufferDrawBuffersProc NamedFramebufferDrawBuffers;
+			static NamedFramebufferReadBufferProc NamedFramebufferReadBuffer;
+			static CheckNamedFramebufferStatusProc CheckNamedFramebufferStatus;
+			static CreateRenderbuffersProc CreateRenderbuffers;
+			static NamedRenderbufferStorageProc NamedRenderbufferStorage;
+			static CreateVertexArraysProc CreateVertexArrays;
+			static VertexArrayVertexBufferProc VertexArrayVertexBuffer;
+			static VertexArrayElementBufferProc VertexArrayElementBuffer;
+			static EnableVertexArrayAttribProc EnableVertexArrayAttrib;
+			static VertexArrayAttribFormatProc VertexArrayAttribFormat;
+			static VertexArrayAttribIFormatProc VertexArrayAttribIFormat;
+			static VertexArrayAttribBindingProc VertexArrayAttribBinding;
+			static VertexArrayBindingDivisorProc VertexArrayBindingDivisor;
+
+		private:
+			static bool HasExtension(const char* name);
+			static bool IsVersion(int major, int minor);
+
+			static bool directStateAccess;
+			static bool loaded;
+			static int majorVersion;
+			static int minorVersion;
+		};
+	}
+}
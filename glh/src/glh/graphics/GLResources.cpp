@@ -0,0 +1,560 @@
+#include "GLResources.h"
+
+#include <cmath>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+
+namespace glh {
+	namespace Graphics {
+
+		static_assert(GLResources::EDIT_TEXTURE_UNIT < GLState::MAX_TEXTURE_UNITS, "the edit unit has to be tracked by GLState");
+
+		std::unordered_map<unsigned int, GLResources::VertexArrayState> GLResources::vertexArrays;
+
+		unsigned int GLResources::CreateBuffer(GLsizeiptr size, const void* data, bool dynamic)
+		{
+			unsigned int buffer;
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::CreateBuffers(1, &buffer);
+				GLExtensions::NamedBufferStorage(buffer, size, data, dynamic ? GL_DYNAMIC_STORAGE_BIT : 0);
+				return buffer;
+			}
+
+			// the copy write target isn't used for drawing, so binding to it disturbs nothing
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, size, data, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			return buffer;
+		}
+
+		void GLResources::UpdateBuffer(unsigned int buffer, GLintptr offset, GLsizeiptr size, const void* data)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::NamedBufferSubData(buffer, offset, size, data);
+				return;
+			}
+
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+
+		// immutable storage can't change size, so these take the GL 3.3 path whatever the version
+		unsigned int GLResources::CreateStreamBuffer(GLsizeiptr size)
+		{
+			unsigned int buffer;
+			glGenBuffers(1, &buffer);
+			StreamBuffer(buffer, size, nullptr);
+			return buffer;
+		}
+
+		void GLResources::StreamBuffer(unsigned int buffer, GLsizeiptr size, const void* data)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STREAM_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+
+		void GLResources::DeleteBuffer(unsigned int buffer)
+		{
+			glDeleteBuffers(1, &buffer);
+		}
+
+		void GLResources::GetUploadFormat(GLenum internalFormat, GLenum* format, GLenum* type)
+		{
+			*type = GL_UNSIGNED_BYTE;
+			switch (internalFormat)
+			{
+			case GL_DEPTH_COMPONENT16:
+			case GL_DEPTH_COMPONENT24:
+			case GL_DEPTH_COMPONENT32F:
+				*format = GL_DEPTH_COMPONENT;
+				*type = GL_FLOAT;
+				break;
+			case GL_DEPTH24_STENCIL8:
+				*format = GL_DEPTH_STENCIL;
+				*type = GL_UNSIGNED_INT_24_8;
+				break;
+			case GL_R8:
+				*format = GL_RED;
+				break;
+			case GL_R16F:
+			case GL_R32F:
+				*format = GL_RED;
+				*type = GL_FLOAT;
+				break;
+			case GL_RG8:
+				*format = GL_RG;
+				break;
+			case GL_RG16F:
+			case GL_RG32F:
+				*format = GL_RG;
+				*type = GL_FLOAT;
+				break;
+			case GL_RGB8:
+			case GL_SRGB8:
+				*format = GL_RGB;
+				break;
+			case GL_RGB16F:
+			case GL_RGB32F:
+			case GL_R11F_G11F_B10F:
+				*format = GL_RGB;
+				*type = GL_FLOAT;
+				break;
+			case GL_RGBA16F:
+			case GL_RGBA32F:
+				*format = GL_RGBA;
+				*type = GL_FLOAT;
+				break;
+			case GL_R32UI:
+				*format = GL_RED_INTEGER;
+				*type = GL_UNSIGNED_INT;
+				break;
+			case GL_RG32UI:
+				*format = GL_RG_INTEGER;
+				*type = GL_UNSIGNED_INT;
+				break;
+			case GL_RGBA32UI:
+				*format = GL_RGBA_INTEGER;
+				*type = GL_UNSIGNED_INT;
+				break;
+			default:
+				*format = GL_RGBA;
+				break;
+			}
+		}
+
+		bool GLResources::IsIntegerFormat(GLenum internalFormat)
+		{
+			switch (internalFormat)
+			{
+			case GL_R8UI:
+			case GL_R16UI:
+			case GL_R32UI:
+			case GL_RG32UI:
+			case GL_RGBA32UI:
+			case GL_R32I:
+			case GL_RG32I:
+			case GL_RGBA32I:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		unsigned int GLResources::CreateBufferTexture(GLenum internalFormat, unsigned int buffer)
+		{
+			unsigned int texture;
+			glGenTextures(1, &texture);
+			GLState::BindTexture(EDIT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture);
+			glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer);
+			return texture;
+		}
+
+		void GLResources::DeleteTexture(unsigned int texture)
+		{
+			glDeleteTextures(1, &texture);
+			GLState::ForgetTexture(texture);
+		}
+
+		unsigned int GLResources::CreateTexture(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei levels)
+		{
+			if (levels == 0)
+				levels = 1 + (GLsizei)std::floor(std::log2((float)(width > height ? width : height)));
+
+			unsigned int texture;
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::CreateTextures(target, 1, &texture);
+				GLExtensions::TextureStorage2D(texture, levels, internalFormat, width, height);
+				return texture;
+			}
+
+			// without immutable storage every level is allocated and the chain is capped to match
+			GLenum format, type;
+			GetUploadFormat(internalFormat, &format, &type);
+			glGenTextures(1, &texture);
+			GLState::BindTexture(EDIT_TEXTURE_UNIT, target, texture);
+			for (GLsizei level = 0; level < levels; level++)
+			{
+				GLsizei levelWidth = width >> level > 0 ? width >> level : 1;
+				GLsizei levelHeight = height >> level > 0 ? height >> level : 1;
+				if (target == GL_TEXTURE_CUBE_MAP)
+				{
+					for (GLenum face = 0; face < 6; face++)
+						glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, internalFormat, levelWidth, levelHeight, 0, format, type, nullptr);
+				}
+				else
+					glTexImage2D(target, level, internalFormat, levelWidth, levelHeight, 0, format, type, nullptr);
+			}
+			glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+			return texture;
+		}
+
+		unsigned int GLResources::CreateTexture3D(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth,
+			GLsizei levels)
+		{
+			GLsizei largest = width > height ? width : height;
+			if (target == GL_TEXTURE_3D && depth > largest)
+				largest = depth;
+			if (levels == 0)
+				levels = 1 + (GLsizei)std::floor(std::log2((float)largest));
+
+			unsigned int texture;
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::CreateTextures(target, 1, &texture);
+				GLExtensions::TextureStorage3D(texture, levels, internalFormat, width, height, depth);
+				return texture;
+			}
+
+			GLenum format, type;
+			GetUploadFormat(internalFormat, &format, &type);
+			glGenTextures(1, &texture);
+			GLState::BindTexture(EDIT_TEXTURE_UNIT, target, texture);
+			for (GLsizei level = 0; level < levels; level++)
+			{
+				GLsizei levelWidth = width >> level > 0 ? width >> level : 1;
+				GLsizei levelHeight = height >> level > 0 ? height >> level : 1;
+				GLsizei levelDepth = target != GL_TEXTURE_3D ? depth : (depth >> level > 0 ? depth >> level : 1);
+				glTexImage3D(target, level, internalFormat, levelWidth, levelHeight, levelDepth, 0, format, type, nullptr);
+			}
+			glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+			return texture;
+		}
+
+		void GLResources::UploadTexture(GLenum target, unsigned int texture, GLint level, GLint layer, GLsizei width, GLsizei height,
+			GLenum format, GLenum type, const void* pixels)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				// cube map faces are layers of the texture when it's edited by name
+				if (target == GL_TEXTURE_CUBE_MAP)
+					GLExtensions::TextureSubImage3D(texture, level, 0, 0, layer, width, height, 1, format, type, pixels);
+				else
+					GLExtensions::TextureSubImage2D(texture, level, 0, 0, width, height, format, type, pixels);
+				return;
+			}
+
+			GLState::BindTexture(EDIT_TEXTURE_UNIT, target, texture);
+			GLenum imageTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + layer : target;
+			glTexSubImage2D(imageTarget, level, 0, 0, width, height, format, type, pixels);
+		}
+
+		void GLResources::UploadTexture3D(GLenum target, unsigned int texture, GLint level, GLint z, GLsizei width, GLsizei height,
+			GLsizei depth, GLenum format, GLenum type, const void* pixels)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::TextureSubImage3D(texture, level, 0, 0, z, width, height, depth, format, type, pixels);
+				return;
+			}
+
+			GLState::BindTexture(EDIT_TEXTURE_UNIT, target, texture);
+			glTexSubImage3D(target, level, 0, 0, z, width, height, depth, format, type, pixels);
+		}
+
+		void GLResources::SetTextureParameter(GLenum target, unsigned int texture, GLenum name, GLint value)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::TextureParameteri(texture, name, value);
+				return;
+			}
+
+			GLState::BindTexture(EDIT_TEXTURE_UNIT, target, texture);
+			glTexParameteri(target, name, value);
+		}
+
+		void GLResources::GenerateMipmaps(GLenum target, unsigned int texture)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::GenerateTextureMipmap(texture);
+				return;
+			}
+
+			GLState::BindTexture(EDIT_TEXTURE_UNIT, target, texture);
+			glGenerateMipmap(target);
+		}
+
+		unsigned int GLResources::CreateFramebuffer()
+		{
+			unsigned int framebuffer;
+			if (GLExtensions::HasDirectStateAccess())
+				GLExtensions::CreateFramebuffers(1, &framebuffer);
+			else
+				glGenFramebuffers(1, &framebuffer);
+			return framebuffer;
+		}
+
+		unsigned int GLResources::CreateRenderbuffer(GLenum internalFormat, GLsizei width, GLsizei height)
+		{
+			unsigned int renderbuffer;
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::CreateRenderbuffers(1, &renderbuffer);
+				GLExtensions::NamedRenderbufferStorage(renderbuffer, internalFormat, width, height);
+				return renderbuffer;
+			}
+
+			// the renderbuffer binding only matters for editing, nothing draws through it
+			glGenRenderbuffers(1, &renderbuffer);
+			glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+			glRenderbufferStorage(GL_RENDERBUFFER, internalFormat, width, height);
+			glBindRenderbuffer(GL_RENDERBUFFER, 0);
+			return renderbuffer;
+		}
+
+		void GLResources::AttachTexture(unsigned int framebuffer, GLenum attachment, unsigned int texture, GLint level)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::NamedFramebufferTexture(framebuffer, attachment, texture, level);
+				return;
+			}
+
+			unsigned int previous = GLState::GetFramebuffer();
+			GLState::BindFramebuffer(framebuffer);
+			glFramebufferTexture(GL_FRAMEBUFFER, attachment, texture, level);
+			GLState::BindFramebuffer(previous);
+		}
+
+		void GLResources::AttachRenderbuffer(unsigned int framebuffer, GLenum attachment, unsigned int renderbuffer)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::NamedFramebufferRenderbuffer(framebuffer, attachment, GL_RENDERBUFFER, renderbuffer);
+				return;
+			}
+
+			unsigned int previous = GLState::GetFramebuffer();
+			GLState::BindFramebuffer(framebuffer);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, renderbuffer);
+			GLState::BindFramebuffer(previous);
+		}
+
+		void GLResources::SetDrawBuffer(unsigned int framebuffer, GLenum buffer)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::NamedFramebufferDrawBuffer(framebuffer, buffer);
+				return;
+			}
+
+			unsigned int previous = GLState::GetFramebuffer();
+			GLState::BindFramebuffer(framebuffer);
+			glDrawBuffer(buffer);
+			GLState::BindFramebuffer(previous);
+		}
+
+		void GLResources::SetDrawBuffers(unsigned int framebuffer, GLsizei count, const GLenum* buffers)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::NamedFramebufferDrawBuffers(framebuffer, count, buffers);
+				return;
+			}
+
+			unsigned int previous = GLState::GetFramebuffer();
+			GLState::BindFramebuffer(framebuffer);
+			glDrawBuffers(count, buffers);
+			GLState::BindFramebuffer(previous);
+		}
+
+		void GLResources::SetReadBuffer(unsigned int framebuffer, GLenum buffer)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::NamedFramebufferReadBuffer(framebuffer, buffer);
+				return;
+			}
+
+			unsigned int previous = GLState::GetFramebuffer();
+			GLState::BindFramebuffer(framebuffer);
+			glReadBuffer(buffer);
+			GLState::BindFramebuffer(previous);
+		}
+
+		bool GLResources::IsComplete(unsigned int framebuffer)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+				return GLExtensions::CheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+			unsigned int previous = GLState::GetFramebuffer();
+			GLState::BindFramebuffer(framebuffer);
+			bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+			GLState::BindFramebuffer(previous);
+			return complete;
+		}
+
+		void GLResources::DeleteFramebuffer(unsigned int framebuffer)
+		{
+			glDeleteFramebuffers(1, &framebuffer);
+			GLState::ForgetFramebuffer(framebuffer);
+		}
+
+		void GLResources::DeleteRenderbuffer(unsigned int renderbuffer)
+		{
+			glDeleteRenderbuffers(1, &renderbuffer);
+		}
+
+		unsigned int GLResources::CreateVertexArray()
+		{
+			unsigned int vao;
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::CreateVertexArrays(1, &vao);
+				return vao;
+			}
+
+			glGenVertexArrays(1, &vao);
+			vertexArrays[vao] = VertexArrayState();
+			return vao;
+		}
+
+		void GLResources::SetVertexBuffer(unsigned int vao, unsigned int binding, unsigned int buffer, GLintptr offset, GLsizei stride)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::VertexArrayVertexBuffer(vao, binding, buffer, offset, stride);
+				return;
+			}
+
+			VertexArrayState& state = vertexArrays[vao];
+			state.Bindings[binding].Buffer = buffer;
+			state.Bindings[binding].Offset = offset;
+			state.Bindings[binding].Stride = stride;
+
+			// every attribute reading from the binding has to pick up the new buffer
+			unsigned int previous = GLState::GetVertexArray();
+			GLState::BindVertexArray(vao);
+			for (unsigned int attribute = 0; attribute < MAX_VERTEX_ATTRIBUTES; attribute++)
+			{
+				if (state.Attributes[attribute].Enabled && state.Attributes[attribute].Binding == binding)
+					ApplyAttribute(state, attribute);
+			}
+			GLState::BindVertexArray(previous);
+		}
+
+		void GLResources::SetElementBuffer(unsigned int vao, unsigned int buffer)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::VertexArrayElementBuffer(vao, buffer);
+				return;
+			}
+
+			// the element buffer binding is part of the vertex array
+			unsigned int previous = GLState::GetVertexArray();
+			GLState::BindVertexArray(vao);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+			GLState::BindVertexArray(previous);
+		}
+
+		void GLResources::SetAttribute(unsigned int vao, unsigned int attribute, unsigned int binding, GLint size, GLenum type,
+			bool normalized, GLuint relativeOffset)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::EnableVertexArrayAttrib(vao, attribute);
+				GLExtensions::VertexArrayAttribFormat(vao, attribute, size, type, normalized ? GL_TRUE : GL_FALSE, relativeOffset);
+				GLExtensions::VertexArrayAttribBinding(vao, attribute, binding);
+				return;
+			}
+
+			VertexArrayState& state = vertexArrays[vao];
+			VertexAttribute& format = state.Attributes[attribute];
+			format.Enabled = true;
+			format.Integer = false;
+			format.Normalized = normalized;
+			format.Binding = binding;
+			format.Size = size;
+			format.Type = type;
+			format.RelativeOffset = relativeOffset;
+
+			unsigned int previous = GLState::GetVertexArray();
+			GLState::BindVertexArray(vao);
+			ApplyAttribute(state, attribute);
+			GLState::BindVertexArray(previous);
+		}
+
+		void GLResources::SetIntegerAttribute(unsigned int vao, unsigned int attribute, unsigned int binding, GLint size, GLenum type,
+			GLuint relativeOffset)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::EnableVertexArrayAttrib(vao, attribute);
+				GLExtensions::VertexArrayAttribIFormat(vao, attribute, size, type, relativeOffset);
+				GLExtensions::VertexArrayAttribBinding(vao, attribute, binding);
+				return;
+			}
+
+			VertexArrayState& state = vertexArrays[vao];
+			VertexAttribute& format = state.Attributes[attribute];
+			format.Enabled = true;
+			format.Integer = true;
+			format.Normalized = false;
+			format.Binding = binding;
+			format.Size = size;
+			format.Type = type;
+			format.RelativeOffset = relativeOffset;
+
+			unsigned int previous = GLState::GetVertexArray();
+			GLState::BindVertexArray(vao);
+			ApplyAttribute(state, attribute);
+			GLState::BindVertexArray(previous);
+		}
+
+		void GLResources::SetBindingDivisor(unsigned int vao, unsigned int binding, GLuint divisor)
+		{
+			if (GLExtensions::HasDirectStateAccess())
+			{
+				GLExtensions::VertexArrayBindingDivisor(vao, binding, divisor);
+				return;
+			}
+
+			VertexArrayState& state = vertexArrays[vao];
+			state.Bindings[binding].Divisor = divisor;
+
+			unsigned int previous = GLState::GetVertexArray();
+			GLState::BindVertexArray(vao);
+			for (unsigned int attribute = 0; attribute < MAX_VERTEX_ATTRIBUTES; attribute++)
+			{
+				if (state.Attributes[attribute].Enabled && state.Attributes[attribute].Binding == binding)
+					glVertexAttribDivisor(attribute, divisor);
+			}
+			GLState::BindVertexArray(previous);
+		}
+
+		void GLResources::DeleteVertexArray(unsigned int vao)
+		{
+			glDeleteVertexArrays(1, &vao);
+			GLState::ForgetVertexArray(vao);
+			vertexArrays.erase(vao);
+		}
+
+		void GLResources::ApplyAttribute(const VertexArrayState& state, unsigned int attribute)
+		{
+			const VertexAttribute& format = state.Attributes[attribute];
+			const VertexBinding& binding = state.Bindings[format.Binding];
+			// the pointer can only be set once the binding has a buffer
+			if (binding.Buffer == 0)
+				return;
+
+			glBindBuffer(GL_ARRAY_BUFFER, binding.Buffer);
+			const void* pointer = (const void*)(binding.Offset + format.RelativeOffset);
+			if (format.Integer)
+				glVertexAttribIPointer(attribute, format.Size, format.Type, binding.Stride, pointer);
+			else
+				glVertexAttribPointer(attribute, format.Size, format.Type, format.Normalized ? GL_TRUE : GL_FALSE, binding.Stride, pointer);
+			glVertexAttribDivisor(attribute, binding.Divisor);
+			glEnableVertexAttribArray(attribute);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+	}
+}
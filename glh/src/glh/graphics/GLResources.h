@@ -0,0 +1,118 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <unordered_map>
+
+namespace glh {
+	namespace Graphics {
+
+		// Creates and edits buffers, textures, framebuffers and vertex arrays without touching the
+		// bindings draws depend on. With direct state access (GL 4.5) objects are edited by name,
+		// get immutable storage and vertex arrays use separate attribute formats and buffer bindings.
+		// On GL 3.3 the same calls bind to edit, but only through binding points rendering doesn't
+		// use (the copy write buffer, a reserved texture unit) or through GLState, restoring the
+		// previous vertex array or framebuffer afterwards. Vertex format/binding separation is
+		// emulated by remembering each vertex array's bindings and formats.
+		class GLResources
+		{
+		public:
+			// texture unit the GL 3.3 path binds textures to while editing them
+			static const unsigned int EDIT_TEXTURE_UNIT = 15;
+			static const unsigned int MAX_VERTEX_ATTRIBUTES = 16;
+			static const unsigned int MAX_VERTEX_BINDINGS = 8;
+
+			// buffers
+			// dynamic buffers can be changed with UpdateBuffer, the others are written once
+			static unsigned int CreateBuffer(GLsizeiptr size, const void* data, bool dynamic = false);
+			static void UpdateBuffer(unsigned int buffer, GLintptr offset, GLsizeiptr size, const void* data);
+			// buffers refilled whole every frame at any size, StreamBuffer orphans the old contents
+			static unsigned int CreateStreamBuffer(GLsizeiptr size);
+			static void StreamBuffer(unsigned int buffer, GLsizeiptr size, const void* data);
+			static void DeleteBuffer(unsigned int buffer);
+
+			// textures
+			// allocates every level of a 2D or cube map texture, levels = 0 makes a full mip chain
+			static unsigned int CreateTexture(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei levels = 1);
+			// allocates every level of a 2D array or 3D texture, levels = 0 makes a full mip chain.
+			// Array layers stay depth at every level, a 3D texture's depth halves like its other sides.
+			static unsigned int CreateTexture3D(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth,
+				GLsizei levels = 1);
+			// layer is the cube map face, 0 for 2D textures
+			static void UploadTexture(GLenum target, unsigned int texture, GLint level, GLint layer, GLsizei width, GLsizei height,
+				GLenum format, GLenum type, const void* pixels);
+			// depth layers or slices of a 2D array or 3D texture from z on
+			static void UploadTexture3D(GLenum target, unsigned int texture, GLint level, GLint z, GLsizei width, GLsizei height,
+				GLsizei depth, GLenum format, GLenum type, const void* pixels);
+			static void SetTextureParameter(GLenum target, unsigned int texture, GLenum name, GLint value);
+			static void GenerateMipmaps(GLenum target, unsigned int texture);
+			// a GL_TEXTURE_BUFFER reading buffer's contents as internalFormat texels
+			static unsigned int CreateBufferTexture(GLenum internalFormat, unsigned int buffer);
+			// whether shaders read the format as integers, through usampler/isampler
+			static bool IsIntegerFormat(GLenum internalFormat);
+			// also drops the texture from GLState's bindings so its recycled name is bound again
+			static void DeleteTexture(unsigned int texture);
+
+			// framebuffers
+			static unsigned int CreateFramebuffer();
+			static unsigned int CreateRenderbuffer(GLenum internalFormat, GLsizei width, GLsizei height);
+			static void AttachTexture(unsigned int framebuffer, GLenum attachment, unsigned int texture, GLint level = 0);
+			static void AttachRenderbuffer(unsigned int framebuffer, GLenum attachment, unsigned int renderbuffer);
+			// GL_NONE for depth only framebuffers
+			static void SetDrawBuffer(unsigned int framebuffer, GLenum buffer);
+			// routes fragment outputs 0 to count - 1 to the given attachments
+			static void SetDrawBuffers(unsigned int framebuffer, GLsizei count, const GLenum* buffers);
+			static void SetReadBuffer(unsigned int framebuffer, GLenum buffer);
+			static bool IsComplete(unsigned int framebuffer);
+			static void DeleteFramebuffer(unsigned int framebuffer);
+			static void DeleteRenderbuffer(unsigned int renderbuffer);
+
+			// vertex arrays
+			static unsigned int CreateVertexArray();
+			static void SetVertexBuffer(unsigned int vao, unsigned int binding, unsigned int buffer, GLintptr offset, GLsizei stride);
+			static void SetElementBuffer(unsigned int vao, unsigned int buffer);
+			// enables a float attribute read from binding, integer types are converted (normalised if asked)
+			static void SetAttribute(unsigned int vao, unsigned int attribute, unsigned int binding, GLint size, GLenum type,
+				bool normalized, GLuint relativeOffset);
+			// an attribute read as an integer by the shader
+			static void SetIntegerAttribute(unsigned int vao, unsigned int attribute, unsigned int binding, GLint size, GLenum type,
+				GLuint relativeOffset);
+			// 1 advances the binding once per instance instead of per vertex
+			static void SetBindingDivisor(unsigned int vao, unsigned int binding, GLuint divisor);
+			static void DeleteVertexArray(unsigned int vao);
+
+		private:
+			struct VertexBinding
+			{
+				unsigned int Buffer = 0;
+				GLintptr Offset = 0;
+				GLsizei Stride = 0;
+				GLuint Divisor = 0;
+			};
+
+			struct VertexAttribute
+			{
+				bool Enabled = false;
+				bool Integer = false;
+				bool Normalized = false;
+				unsigned int Binding = 0;
+				GLint Size = 4;
+				GLenum Type = GL_FLOAT;
+				GLuint RelativeOffset = 0;
+			};
+
+			struct VertexArrayState
+			{
+				VertexBinding Bindings[MAX_VERTEX_BINDINGS];
+				VertexAttribute Attributes[MAX_VERTEX_ATTRIBUTES];
+			};
+
+			static void GetUploadFormat(GLenum internalFormat, GLenum* format, GLenum* type);
+			// specifies an attribute of the bound vertex array from its format and binding
+			static void ApplyAttribute(const VertexArrayState& state, unsigned int attribute);
+
+			// GL 3.3 only
+			static std::unordered_map<unsigned int, VertexArrayState> vertexArrays;
+		};
+	}
+}
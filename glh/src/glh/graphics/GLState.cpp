@@ -0,0 +1,246 @@
+#include "GLState.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// state that hasn't been set through GLState yet
+		static const unsigned int UNKNOWN = 0xffffffff;
+
+		unsigned int GLState::program = UNKNOWN;
+		unsigned int GLState::vao = UNKNOWN;
+		unsigned int GLState::activeUnit = UNKNOWN;
+		unsigned int GLState::textures[GLState::MAX_TEXTURE_UNITS][GLState::TEXTURE_TARGETS];
+		unsigned int GLState::framebuffer = UNKNOWN;
+		unsigned int GLState::depthTest = UNKNOWN;
+		unsigned int GLState::depthFunc = UNKNOWN;
+		unsigned int GLState::depthMask = UNKNOWN;
+		unsigned int GLState::cullFace = UNKNOWN;
+		unsigned int GLState::blend = UNKNOWN;
+		unsigned int GLState::blendSource = UNKNOWN;
+		unsigned int GLState::blendDestination = UNKNOWN;
+
+		GLState::Counters GLState::counters;
+		GLState::Counters GLState::lastFrameCounters;
+
+		bool GLState::Changed(unsigned int* current, unsigned int value)
+		{
+			if (*current == value)
+			{
+				counters.Filtered++;
+				return false;
+			}
+
+			*current = value;
+			counters.Issued++;
+			return true;
+		}
+
+		void GLState::UseProgram(unsigned int id)
+		{
+			if (Changed(&program, id))
+				glUseProgram(id);
+		}
+
+		void GLState::BindVertexArray(unsigned int id)
+		{
+			if (Changed(&vao, id))
+				glBindVertexArray(id);
+		}
+
+		void GLState::ActiveTexture(unsigned int unit)
+		{
+			if (Changed(&activeUnit, unit))
+				glActiveTexture(GL_TEXTURE0 + unit);
+		}
+
+		void GLState::BindTexture(unsigned int unit, GLenum target, unsigned int texture)
+		{
+			// the table stores texture + 1 so that its zero initialisation means unknown
+			unsigned int* current = &textures[unit][TargetIndex(target)];
+			if (*current == texture + 1)
+			{
+				counters.Filtered++;
+				return;
+			}
+
+			ActiveTexture(unit);
+			Changed(current, texture + 1);
+			glBindTexture(target, texture);
+		}
+
+		void GLState::BindFramebuffer(unsigned int fbo)
+		{
+			if (Changed(&framebuffer, fbo))
+				glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		}
+
+		unsigned int GLState::GetVertexArray()
+		{
+			return vao == UNKNOWN ? 0 : vao;
+		}
+
+		unsigned int GLState::GetFramebuffer()
+		{
+			return framebuffer == UNKNOWN ? 0 : framebuffer;
+		}
+
+		void GLState::SetCapability(GLenum capability, unsigned int* current, bool enabled)
+		{
+			if (!Changed(current, enabled ? 1 : 0))
+				return;
+
+			if (enabled)
+				glEnable(capability);
+			else
+				glDisable(capability);
+		}
+
+		void GLState::SetDepthTest(bool enabled)
+		{
+			SetCapability(GL_DEPTH_TEST, &depthTest, enabled);
+		}
+
+		void GLState::SetDepthFunc(GLenum func)
+		{
+			if (Changed(&depthFunc, func))
+				glDepthFunc(func);
+		}
+
+		void GLState::SetDepthMask(bool enabled)
+		{
+			if (Changed(&depthMask, enabled ? 1 : 0))
+				glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+		}
+
+		bool GLState::GetDepthTest()
+		{
+			if (depthTest == UNKNOWN)
+				depthTest = glIsEnabled(GL_DEPTH_TEST) ? 1 : 0;
+			return depthTest != 0;
+		}
+
+		GLenum GLState::GetDepthFunc()
+		{
+			if (depthFunc == UNKNOWN)
+			{
+				GLint func = GL_LESS;
+				glGetIntegerv(GL_DEPTH_FUNC, &func);
+				depthFunc = (unsigned int)func;
+			}
+			return depthFunc;
+		}
+
+		bool GLState::GetDepthMask()
+		{
+			if (depthMask == UNKNOWN)
+			{
+				GLboolean mask = GL_TRUE;
+				glGetBooleanv(GL_DEPTH_WRITEMASK, &mask);
+				depthMask = mask ? 1 : 0;
+			}
+			return depthMask != 0;
+		}
+
+		void GLState::SetCullFace(bool enabled)
+		{
+			SetCapability(GL_CULL_FACE, &cullFace, enabled);
+		}
+
+		void GLState::SetBlend(bool enabled)
+		{
+			SetCapability(GL_BLEND, &blend, enabled);
+		}
+
+		void GLState::SetBlendFunc(GLenum source, GLenum destination)
+		{
+			if (blendSource == source && blendDestination == destination)
+			{
+				counters.Filtered++;
+				return;
+			}
+
+			blendSource = source;
+			blendDestination = destination;
+			counters.Issued++;
+			glBlendFunc(source, destination);
+		}
+
+		void GLState::Invalidate()
+		{
+			program = UNKNOWN;
+			vao = UNKNOWN;
+			activeUnit = UNKNOWN;
+			for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+			{
+				for (unsigned int target = 0; target < TEXTURE_TARGETS; target++)
+					textures[unit][target] = 0;
+			}
+			framebuffer = UNKNOWN;
+			depthTest = UNKNOWN;
+			depthFunc = UNKNOWN;
+			depthMask = UNKNOWN;
+			cullFace = UNKNOWN;
+			blend = UNKNOWN;
+			blendSource = UNKNOWN;
+			blendDestination = UNKNOWN;
+		}
+
+		void GLState::ForgetTexture(unsigned int texture)
+		{
+			for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+			{
+				for (unsigned int target = 0; target < TEXTURE_TARGETS; target++)
+				{
+					if (textures[unit][target] == texture + 1)
+						textures[unit][target] = 0;
+				}
+			}
+		}
+
+		void GLState::ForgetVertexArray(unsigned int id)
+		{
+			// deleting the bound vertex array or framebuffer binds 0 in its place
+			if (vao == id)
+				vao = 0;
+		}
+
+		void GLState::ForgetFramebuffer(unsigned int fbo)
+		{
+			if (framebuffer == fbo)
+				framebuffer = 0;
+		}
+
+		const GLState::Counters& GLState::GetCounters()
+		{
+			return counters;
+		}
+
+		const GLState::Counters& GLState::GetLastFrameCounters()
+		{
+			return lastFrameCounters;
+		}
+
+		void GLState::EndFrame()
+		{
+			lastFrameCounters = counters;
+			counters = Counters();
+		}
+
+		unsigned int GLState::TargetIndex(GLenum target)
+		{
+			switch (target)
+			{
+			case GL_TEXTURE_CUBE_MAP:
+				return 1;
+			case GL_TEXTURE_2D_ARRAY:
+				return 2;
+			case GL_TEXTURE_BUFFER:
+				return 3;
+			case GL_TEXTURE_3D:
+				return 4;
+			default:
+				return 0;
+			}
+		}
+	}
+}
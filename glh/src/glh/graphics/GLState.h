@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glad/glad.h>
+
+namespace glh {
+	namespace Graphics {
+
+		// Mirrors the GL state glh touches so calls that wouldn't change anything never reach the driver.
+		// Everything in glh binds through here; code that calls GL directly for any of this state
+		// has to call Invalidate() afterwards.
+		class GLState
+		{
+		public:
+			struct Counters
+			{
+				// calls passed on to GL
+				unsigned int Issued = 0;
+				// calls skipped because the state was already set
+				unsigned int Filtered = 0;
+			};
+
+			static void UseProgram(unsigned int program);
+			static void BindVertexArray(unsigned int vao);
+			static void ActiveTexture(unsigned int unit);
+			// makes unit active only when the binding actually has to change
+			static void BindTexture(unsigned int unit, GLenum target, unsigned int texture);
+			static void BindFramebuffer(unsigned int fbo);
+			// the bound vertex array and framebuffer, 0 while they're unknown
+			static unsigned int GetVertexArray();
+			static unsigned int GetFramebuffer();
+
+			static void SetDepthTest(bool enabled);
+			static void SetDepthFunc(GLenum func);
+			static void SetDepthMask(bool enabled);
+			// the depth state, read back from GL while it's unknown, so passes can restore what they change
+			static bool GetDepthTest();
+			static GLenum GetDepthFunc();
+			static bool GetDepthMask();
+			static void SetCullFace(bool enabled);
+			static void SetBlend(bool enabled);
+			static void SetBlendFunc(GLenum source, GLenum destination);
+
+			// forget all mirrored state, the next call of each kind is always issued
+			static void Invalidate();
+			// called when an object is deleted, GL unbinds it and may hand its name out again
+			static void ForgetTexture(unsigned int texture);
+			static void ForgetVertexArray(unsigned int vao);
+			static void ForgetFramebuffer(unsigned int fbo);
+
+			// counters of the frame in progress and of the last completed one
+			static const Counters& GetCounters();
+			static const Counters& GetLastFrameCounters();
+			static void EndFrame();
+
+			// GL 3.3 guarantees 48 combined units
+			static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+		private:
+			static bool Changed(unsigned int* current, unsigned int value);
+			static void SetCapability(GLenum capability, unsigned int* current, bool enabled);
+			static unsigned int TargetIndex(GLenum target);
+
+			static const unsigned int TEXTURE_TARGETS = 5;
+
+			static unsigned int program;
+			static unsigned int vao;
+			static unsigned int activeUnit;
+			static unsigned int textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+			static unsigned int framebuffer;
+			static unsigned int depthTest;
+			static unsigned int depthFunc;
+			static unsigned int depthMask;
+			static unsigned int cullFace;
+			static unsigned int blend;
+			static unsigned int blendSource;
+			static unsigned int blendDestination;
+
+			static Counters counters;
+			static Counters lastFrameCounters;
+		};
+	}
+}
@@ -0,0 +1,55 @@
+#include "GPUTimer.h"
+
+namespace glh {
+	namespace Graphics {
+
+		void GPUTimer::Begin()
+		{
+			if (queries[0] == 0)
+				glGenQueries(QUERY_COUNT, queries);
+
+			Collect();
+			// the ring is only this far behind if the GPU is, waiting here is then unavoidable
+			if (pending[next])
+			{
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(queries[next], GL_QUERY_RESULT, &elapsed);
+				milliseconds = elapsed / 1000000.0;
+				pending[next] = false;
+			}
+			glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+		}
+
+		void GPUTimer::End()
+		{
+			glEndQuery(GL_TIME_ELAPSED);
+			pending[next] = true;
+			next = (next + 1) % QUERY_COUNT;
+		}
+
+		double GPUTimer::GetMilliseconds() const
+		{
+			return milliseconds;
+		}
+
+		void GPUTimer::Collect()
+		{
+			for (unsigned int i = 0; i < QUERY_COUNT; i++)
+			{
+				unsigned int query = (next + i) % QUERY_COUNT;
+				if (!pending[query])
+					continue;
+
+				GLint available = 0;
+				glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+				if (!available)
+					break;
+
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &elapsed);
+				milliseconds = elapsed / 1000000.0;
+				pending[query] = false;
+			}
+		}
+	}
+}
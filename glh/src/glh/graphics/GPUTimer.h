@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glad/glad.h>
+
+namespace glh {
+	namespace Graphics {
+
+		// Measures GPU time of the commands between Begin and End with GL_TIME_ELAPSED queries.
+		// Results are read a few frames later from a small ring of queries, so measuring never
+		// waits for the GPU; GetMilliseconds is the newest result that has arrived.
+		// Only one timer can be measuring at a time.
+		class GPUTimer
+		{
+		public:
+			static const unsigned int QUERY_COUNT = 4;
+
+			void Begin();
+			void End();
+
+			double GetMilliseconds() const;
+
+		private:
+			// reads every finished query, oldest first
+			void Collect();
+
+			unsigned int queries[QUERY_COUNT] = {};
+			bool pending[QUERY_COUNT] = {};
+			unsigned int next = 0;
+			double milliseconds = 0.0;
+		};
+	}
+}
@@ -0,0 +1,117 @@
+#include "GeometryHeap.h"
+
+#include <glad/glad.h>
+
+#include "GLResources.h"
+
+namespace glh {
+	namespace Graphics {
+
+		unsigned int GeometryHeap::AddMesh(const Model& model)
+		{
+			const std::vector<Model::Vertex>& meshVertices = model.GetVertices();
+
+			MeshRange range;
+			range.FirstIndex = (unsigned int)indices.size();
+			range.IndexCount = (unsigned int)model.indices.size();
+			range.BaseVertex = (unsigned int)vertices.size();
+
+			vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+			indices.insert(indices.end(), model.indices.begin(), model.indices.end());
+			meshes.push_back(range);
+			dirty = true;
+			return (unsigned int)meshes.size() - 1;
+		}
+
+		const MeshRange& GeometryHeap::GetMesh(unsigned int mesh) const
+		{
+			return meshes[mesh];
+		}
+
+		unsigned int GeometryHeap::GetMeshCount() const
+		{
+			return (unsigned int)meshes.size();
+		}
+
+		void GeometryHeap::Create()
+		{
+			VAO = GLResources::CreateVertexArray();
+			Model::Layout::Apply(VAO);
+			InstanceLayout::Apply(VAO);
+			GLResources::SetBindingDivisor(VAO, INSTANCE_BINDING, 1);
+		}
+
+		void GeometryHeap::EnableDepthStream()
+		{
+			if (depthStream)
+				return;
+
+			depthStream = true;
+			depthVAO = GLResources::CreateVertexArray();
+			Model::DepthLayout::Apply(depthVAO);
+			InstanceLayout::Apply(depthVAO);
+			GLResources::SetBindingDivisor(depthVAO, INSTANCE_BINDING, 1);
+			dirty = true;
+		}
+
+		void GeometryHeap::Upload()
+		{
+			if (!dirty)
+				return;
+
+			if (VAO == 0)
+				Create();
+
+			// the heap only grows at load time, so everything is simply uploaded again into new buffers
+			if (VBO != 0)
+			{
+				GLResources::DeleteBuffer(VBO);
+				GLResources::DeleteBuffer(EBO);
+			}
+			VBO = GLResources::CreateBuffer(vertices.size() * sizeof(Model::Vertex), vertices.empty() ? nullptr : &vertices[0]);
+			EBO = GLResources::CreateBuffer(indices.size() * sizeof(unsigned int), indices.empty() ? nullptr : &indices[0]);
+			Model::Layout::SetVertexBuffer(VAO, 0, VBO);
+			GLResources::SetElementBuffer(VAO, EBO);
+
+			if (depthStream)
+			{
+				std::vector<glm::vec3> positions(vertices.size());
+				for (unsigned int i = 0; i < vertices.size(); i++)
+					positions[i] = vertices[i].Position;
+				if (positionVBO != 0)
+					GLResources::DeleteBuffer(positionVBO);
+				positionVBO = GLResources::CreateBuffer(positions.size() * sizeof(glm::vec3), positions.empty() ? nullptr : &positions[0]);
+				Model::DepthLayout::SetVertexBuffer(depthVAO, 0, positionVBO);
+				GLResources::SetElementBuffer(depthVAO, EBO);
+			}
+			dirty = false;
+		}
+
+		unsigned int GeometryHeap::GetVAO() const
+		{
+			return VAO;
+		}
+
+		unsigned int GeometryHeap::GetDepthVAO() const
+		{
+			return depthStream ? depthVAO : VAO;
+		}
+
+		unsigned int GeometryHeap::GetVertexBuffer() const
+		{
+			return VBO;
+		}
+
+		unsigned int GeometryHeap::GetIndexBuffer() const
+		{
+			return EBO;
+		}
+
+		void GeometryHeap::SetInstanceBuffer(unsigned int buffer, unsigned int offset)
+		{
+			InstanceLayout::SetVertexBuffer(VAO, INSTANCE_BINDING, buffer, offset);
+			if (depthStream)
+				InstanceLayout::SetVertexBuffer(depthVAO, INSTANCE_BINDING, buffer, offset);
+		}
+	}
+}
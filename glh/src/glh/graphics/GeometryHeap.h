@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+#include "Model.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// where a mesh lives in the heap, in the form the draw commands want it
+		struct MeshRange
+		{
+			unsigned int FirstIndex = 0;
+			unsigned int IndexCount = 0;
+			unsigned int BaseVertex = 0;
+		};
+
+		// All static meshes in one vertex buffer and one index buffer behind a single VAO, so any
+		// of them can be drawn without a VAO change. The VAO has the Model vertex layout in slots
+		// 0-4 and a per instance uvec2 in slot INSTANCE_ATTRIBUTE that the draw lists fill in.
+		// With a depth stream the heap also keeps a position-only copy of its vertices behind a
+		// second VAO with the same instance attribute, for passes that only need depth.
+		class GeometryHeap
+		{
+		public:
+			static const unsigned int INSTANCE_ATTRIBUTE = 5;
+
+			// copies the model's mesh into the heap and returns its mesh ID
+			unsigned int AddMesh(const Model& model);
+			const MeshRange& GetMesh(unsigned int mesh) const;
+			unsigned int GetMeshCount() const;
+
+			// keeps a position-only stream from the next Upload on
+			void EnableDepthStream();
+			// uploads meshes added since the last call, reallocating the buffers when they grew
+			void Upload();
+			unsigned int GetVAO() const;
+			// the position-only VAO, or the full one without a depth stream
+			unsigned int GetDepthVAO() const;
+			// instance attribute source, bound by the draw list before drawing
+			void SetInstanceBuffer(unsigned int buffer, unsigned int offset);
+			// the heap's buffers, for passes that fetch vertices themselves (see VisibilityBuffer).
+			// Upload replaces them when the heap has grown.
+			unsigned int GetVertexBuffer() const;
+			unsigned int GetIndexBuffer() const;
+
+		private:
+			// Model::Layout reads the vertices from binding 0
+			static const unsigned int INSTANCE_BINDING = 1;
+			typedef VertexLayout<VertexAttribute<INSTANCE_ATTRIBUTE, IntegerVector<unsigned int, 2>, INSTANCE_BINDING>> InstanceLayout;
+
+			void Create();
+
+			unsigned int VAO = 0;
+			unsigned int VBO = 0;
+			unsigned int EBO = 0;
+			unsigned int depthVAO = 0;
+			unsigned int positionVBO = 0;
+			bool depthStream = false;
+			bool dirty = false;
+
+			std::vector<Model::Vertex> vertices;
+			std::vector<unsigned int> indices;
+			std::vector<MeshRange> meshes;
+		};
+	}
+}
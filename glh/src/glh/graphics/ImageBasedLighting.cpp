@@ -0,0 +1,585 @@
+#include "ImageBasedLighting.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <stb_image.h>
+#include <xmmintrin.h>
+
+#include <cmath>
+#include <fstream>
+
+#include "../util/Hash.h"
+#include "../util/Log.h"
+#include "../util/Parallel.h"
+#include "GLResources.h"
+#include "GLState.h"
+#include "Skybox.h"
+
+namespace glh {
+	namespace Graphics {
+
+		static const char IBL_MAGIC[4] = { 'I', 'B', 'L', '2' };
+		static const float PI = 3.14159265358979f;
+		// linear radiance of the sky Upload falls back to when there's nothing else
+		static const float FALLBACK_RADIANCE = 0.2f;
+
+		static_assert(ImageBasedLighting::SOURCE_SIZE % ImageBasedLighting::PREFILTERED_SIZE == 0, "the mirror level is a mip of the source");
+
+		// GGX sample of a prefiltered level around N = V = (0, 0, 1)
+		struct LobeSample
+		{
+			glm::vec3 Direction;
+			float Weight;
+			float Lod;
+		};
+
+		// i-th point of the Hammersley set, y is the bit reversed index
+		static void Hammersley(unsigned int i, unsigned int count, float* x, float* y)
+		{
+			unsigned int bits = i;
+			bits = (bits << 16u) | (bits >> 16u);
+			bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+			bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+			bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+			bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+			*x = (float)i / count;
+			*y = bits * 2.3283064365386963e-10f;
+		}
+
+		// half vector around (0, 0, 1) with GGX's distribution for alpha = roughness²
+		static glm::vec3 SampleGGX(float x, float y, float alpha)
+		{
+			float cosTheta = std::sqrt((1.0f - y) / (1.0f + (alpha * alpha - 1.0f) * y));
+			float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+			float phi = 2.0f * PI * x;
+			return glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+		}
+
+		// direction through the texel at u, v in [-1, 1] of a face, with GL's cube map axes
+		static glm::vec3 FaceDirection(int face, float u, float v)
+		{
+			switch (face)
+			{
+			case 0: return glm::normalize(glm::vec3(1.0f, -v, -u));
+			case 1: return glm::normalize(glm::vec3(-1.0f, -v, u));
+			case 2: return glm::normalize(glm::vec3(u, 1.0f, v));
+			case 3: return glm::normalize(glm::vec3(u, -1.0f, -v));
+			case 4: return glm::normalize(glm::vec3(u, -v, 1.0f));
+			default: return glm::normalize(glm::vec3(-u, -v, -1.0f));
+			}
+		}
+
+		// bilinear lookup in the face a direction points at, clamped at the face's edges
+		static __m128 SampleCube(const std::vector<float>& texels, int size, const glm::vec3& direction)
+		{
+			float x = std::fabs(direction.x), y = std::fabs(direction.y), z = std::fabs(direction.z);
+			int face;
+			float major, s, t;
+			if (x >= y && x >= z)
+			{
+				face = direction.x > 0.0f ? 0 : 1;
+				major = x;
+				s = direction.x > 0.0f ? -direction.z : direction.z;
+				t = -direction.y;
+			}
+			else if (y >= z)
+			{
+				face = direction.y > 0.0f ? 2 : 3;
+				major = y;
+				s = direction.x;
+				t = direction.y > 0.0f ? direction.z : -direction.z;
+			}
+			else
+			{
+				face = direction.z > 0.0f ? 4 : 5;
+				major = z;
+				s = direction.z > 0.0f ? direction.x : -direction.x;
+				t = -direction.y;
+			}
+
+			float px = (s / major * 0.5f + 0.5f) * size - 0.5f;
+			float py = (t / major * 0.5f + 0.5f) * size - 0.5f;
+			px = px < 0.0f ? 0.0f : (px > size - 1.0f ? size - 1.0f : px);
+			py = py < 0.0f ? 0.0f : (py > size - 1.0f ? size - 1.0f : py);
+			int x0 = (int)px, y0 = (int)py;
+			int x1 = x0 + 1 < size ? x0 + 1 : x0;
+			int y1 = y0 + 1 < size ? y0 + 1 : y0;
+			__m128 fx = _mm_set1_ps(px - x0);
+			__m128 fy = _mm_set1_ps(py - y0);
+
+			const float* faceTexels = &texels[(size_t)face * size * size * 4];
+			__m128 a = _mm_loadu_ps(faceTexels + (y0 * size + x0) * 4);
+			__m128 b = _mm_loadu_ps(faceTexels + (y0 * size + x1) * 4);
+			__m128 c = _mm_loadu_ps(faceTexels + (y1 * size + x0) * 4);
+			__m128 d = _mm_loadu_ps(faceTexels + (y1 * size + x1) * 4);
+			__m128 top = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fx));
+			__m128 bottom = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), fx));
+			return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), fy));
+		}
+
+		bool ImageBasedLighting::GetSourceKey(const std::string& skyboxName, uint64_t* key)
+		{
+			const int constants[] = { SOURCE_SIZE, PREFILTERED_SIZE, PREFILTERED_LEVELS, PREFILTERED_SAMPLES, BRDF_SIZE, BRDF_SAMPLES,
+				(int)EnvironmentBlock::SH_COEFFICIENTS };
+			*key = Util::Hash::Bytes(constants, sizeof(constants));
+			for (const std::string& path : Skybox::GetFacePaths(skyboxName))
+			{
+				if (!Util::Hash::File(path, key, *key))
+					return false;
+			}
+			return true;
+		}
+
+		bool ImageBasedLighting::Generate(const std::string& skyboxName)
+		{
+			uint64_t key;
+			if (!GetSourceKey(skyboxName, &key))
+			{
+				Util::Log::WriteError("IBL: could not read the faces of " + skyboxName);
+				return false;
+			}
+
+			std::vector<std::string> paths = Skybox::GetFacePaths(skyboxName);
+			unsigned char* faces[6] = {};
+			int width = 0, height = 0;
+			bool loaded = true;
+			for (unsigned int face = 0; face < 6; face++)
+			{
+				int faceWidth, faceHeight, components;
+				faces[face] = stbi_load(paths[face].c_str(), &faceWidth, &faceHeight, &components, 3);
+				if (faces[face] == nullptr)
+				{
+					Util::Log::WriteError("IBL: failed to load " + paths[face]);
+					loaded = false;
+				}
+				else if (width != 0 && (faceWidth != width || faceHeight != height))
+				{
+					Util::Log::WriteError("IBL: the faces of " + skyboxName + " differ in size");
+					loaded = false;
+				}
+				else
+				{
+					width = faceWidth;
+					height = faceHeight;
+				}
+			}
+			if (!loaded)
+			{
+				for (unsigned int face = 0; face < 6; face++)
+					stbi_image_free(faces[face]);
+				return false;
+			}
+
+			// the skybox is sRGB, everything is integrated in linear light
+			float linear[256];
+			for (int value = 0; value < 256; value++)
+			{
+				float c = value / 255.0f;
+				linear[value] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+
+			std::vector<Cube> mips(1);
+			mips[0].Size = SOURCE_SIZE;
+			mips[0].Texels.resize((size_t)6 * SOURCE_SIZE * SOURCE_SIZE * 4);
+			// every source texel lands in exactly one destination texel's box
+			Util::Parallel::For(6 * SOURCE_SIZE, [&](unsigned int row) {
+				int face = row / SOURCE_SIZE;
+				int y = row % SOURCE_SIZE;
+				int y0 = y * height / SOURCE_SIZE;
+				int y1 = glm::max((y + 1) * height / SOURCE_SIZE, y0 + 1);
+				for (int x = 0; x < SOURCE_SIZE; x++)
+				{
+					int x0 = x * width / SOURCE_SIZE;
+					int x1 = glm::max((x + 1) * width / SOURCE_SIZE, x0 + 1);
+					float sum[3] = { 0.0f, 0.0f, 0.0f };
+					for (int sy = y0; sy < y1; sy++)
+					{
+						const unsigned char* source = faces[face] + (sy * width + x0) * 3;
+						for (int sx = x0; sx < x1; sx++, source += 3)
+						{
+							sum[0] += linear[source[0]];
+							sum[1] += linear[source[1]];
+							sum[2] += linear[source[2]];
+						}
+					}
+					float scale = 1.0f / ((y1 - y0) * (x1 - x0));
+					float* texel = &mips[0].Texels[(((size_t)face * SOURCE_SIZE + y) * SOURCE_SIZE + x) * 4];
+					texel[0] = sum[0] * scale;
+					texel[1] = sum[1] * scale;
+					texel[2] = sum[2] * scale;
+					texel[3] = 1.0f;
+				}
+			});
+			for (unsigned int face = 0; face < 6; face++)
+				stbi_image_free(faces[face]);
+
+			BuildSourceMips(mips);
+			ProjectIrradiance(mips[0]);
+
+			prefiltered.assign(PREFILTERED_LEVELS, Cube());
+			for (int level = 0; level < PREFILTERED_LEVELS; level++)
+				PrefilterLevel(mips, level);
+			IntegrateBRDF();
+			sourceKey = key;
+
+			Util::Log::WriteInfo("IBL: generated the ambient light of " + skyboxName);
+			return true;
+		}
+
+		void ImageBasedLighting::BuildSourceMips(std::vector<Cube>& mips) const
+		{
+			while (mips.back().Size > 1)
+			{
+				const Cube& above = mips.back();
+				Cube mip;
+				mip.Size = above.Size / 2;
+				mip.Texels.resize((size_t)6 * mip.Size * mip.Size * 4);
+				Util::Parallel::For(6 * mip.Size, [&](unsigned int row) {
+					int face = row / mip.Size;
+					int y = row % mip.Size;
+					const __m128 quarter = _mm_set1_ps(0.25f);
+					for (int x = 0; x < mip.Size; x++)
+					{
+						const float* top = &above.Texels[(((size_t)face * above.Size + y * 2) * above.Size + x * 2) * 4];
+						const float* bottom = top + above.Size * 4;
+						__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(top), _mm_loadu_ps(top + 4)),
+							_mm_add_ps(_mm_loadu_ps(bottom), _mm_loadu_ps(bottom + 4)));
+						_mm_storeu_ps(&mip.Texels[(((size_t)face * mip.Size + y) * mip.Size + x) * 4], _mm_mul_ps(sum, quarter));
+					}
+				});
+				mips.push_back(mip);
+			}
+		}
+
+		// Every texel adds its radiance times the basis functions and its solid angle. Rows sum on
+		// their own and are added up in order afterwards, so the result doesn't depend on how the
+		// rows land on the threads. The radiance coefficients are then convolved with the clamped
+		// cosine, whose bands scale by pi, 2pi / 3 and pi / 4.
+		void ImageBasedLighting::ProjectIrradiance(const Cube& source)
+		{
+			const int size = source.Size;
+			const unsigned int SUMS = EnvironmentBlock::SH_COEFFICIENTS * 3 + 1;
+			std::vector<double> rowSums((size_t)6 * size * SUMS, 0.0);
+			Util::Parallel::For(6 * size, [&](unsigned int row) {
+				int face = row / size;
+				int y = row % size;
+				double* sums = &rowSums[(size_t)row * SUMS];
+				float v = 2.0f * (y + 0.5f) / size - 1.0f;
+				for (int x = 0; x < size; x++)
+				{
+					float u = 2.0f * (x + 0.5f) / size - 1.0f;
+					glm::vec3 n = FaceDirection(face, u, v);
+					float distanceSquared = 1.0f + u * u + v * v;
+					float solidAngle = 4.0f / (size * size * distanceSquared * std::sqrt(distanceSquared));
+					float basis[EnvironmentBlock::SH_COEFFICIENTS] = {
+						0.282095f,
+						0.488603f * n.y,
+						0.488603f * n.z,
+						0.488603f * n.x,
+						1.092548f * n.x * n.y,
+						1.092548f * n.y * n.z,
+						0.315392f * (3.0f * n.z * n.z - 1.0f),
+						1.092548f * n.x * n.z,
+						0.546274f * (n.x * n.x - n.y * n.y)
+					};
+					const float* texel = &source.Texels[(((size_t)face * size + y) * size + x) * 4];
+					for (unsigned int i = 0; i < EnvironmentBlock::SH_COEFFICIENTS; i++)
+					{
+						for (unsigned int c = 0; c < 3; c++)
+							sums[i * 3 + c] += texel[c] * basis[i] * solidAngle;
+					}
+					sums[SUMS - 1] += solidAngle;
+				}
+			});
+
+			double total[SUMS] = {};
+			for (unsigned int row = 0; row < (unsigned int)(6 * size); row++)
+			{
+				for (unsigned int i = 0; i < SUMS; i++)
+					total[i] += rowSums[(size_t)row * SUMS + i];
+			}
+
+			// the texel solid angles are approximate, so they're scaled to cover the sphere exactly.
+			// The shaders evaluate the polynomials alone, so the basis constants are folded in, and
+			// irradiance / pi is what a Lambertian albedo is multiplied by.
+			const float bandScale[3] = { 1.0f, 2.0f / 3.0f, 0.25f };
+			const float constants[EnvironmentBlock::SH_COEFFICIENTS] = {
+				0.282095f, 0.488603f, 0.488603f, 0.488603f, 1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f
+			};
+			double normalisation = 4.0 * PI / total[SUMS - 1];
+			for (unsigned int i = 0; i < EnvironmentBlock::SH_COEFFICIENTS; i++)
+			{
+				float scale = (float)normalisation * bandScale[i == 0 ? 0 : (i < 4 ? 1 : 2)] * constants[i];
+				irradiance[i] = glm::vec4((float)total[i * 3] * scale, (float)total[i * 3 + 1] * scale, (float)total[i * 3 + 2] * scale, 0.0f);
+			}
+		}
+
+		// Level 0 is a mirror and copies the source mip of the same size. The others average
+		// PREFILTERED_SAMPLES GGX samples around each texel's direction, taking N = V = R, with every
+		// sample read from the source mip whose texels cover about as much of the sphere as the
+		// sample stands for.
+		void ImageBasedLighting::PrefilterLevel(const std::vector<Cube>& mips, int level)
+		{
+			Cube& cube = prefiltered[level];
+			cube.Size = PREFILTERED_SIZE >> level;
+			if (level == 0)
+			{
+				for (const Cube& mip : mips)
+				{
+					if (mip.Size == cube.Size)
+						cube.Texels = mip.Texels;
+				}
+				return;
+			}
+
+			float roughness = (float)level / (PREFILTERED_LEVELS - 1);
+			float alpha = roughness * roughness;
+			float texelSolidAngle = 4.0f * PI / (6.0f * SOURCE_SIZE * SOURCE_SIZE);
+			std::vector<LobeSample> samples;
+			for (unsigned int i = 0; i < PREFILTERED_SAMPLES; i++)
+			{
+				float x, y;
+				Hammersley(i, PREFILTERED_SAMPLES, &x, &y);
+				glm::vec3 halfway = SampleGGX(x, y, alpha);
+				LobeSample sample;
+				sample.Direction = glm::vec3(2.0f * halfway.z * halfway.x, 2.0f * halfway.z * halfway.y, 2.0f * halfway.z * halfway.z - 1.0f);
+				sample.Weight = sample.Direction.z;
+				if (sample.Weight <= 0.0f)
+					continue;
+
+				// with N = V the pdf of the reflected direction is D / 4
+				float denominator = halfway.z * halfway.z * (alpha * alpha - 1.0f) + 1.0f;
+				float pdf = alpha * alpha / (PI * denominator * denominator) / 4.0f;
+				float sampleSolidAngle = 1.0f / (PREFILTERED_SAMPLES * pdf);
+				float lod = 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+				sample.Lod = glm::min(glm::max(lod, 0.0f), (float)(mips.size() - 1));
+				samples.push_back(sample);
+			}
+
+			cube.Texels.resize((size_t)6 * cube.Size * cube.Size * 4);
+			Util::Parallel::For(6 * cube.Size, [&](unsigned int row) {
+				int face = row / cube.Size;
+				int y = row % cube.Size;
+				float v = 2.0f * (y + 0.5f) / cube.Size - 1.0f;
+				for (int x = 0; x < cube.Size; x++)
+				{
+					float u = 2.0f * (x + 0.5f) / cube.Size - 1.0f;
+					glm::vec3 normal = FaceDirection(face, u, v);
+					glm::vec3 up = std::fabs(normal.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+					glm::vec3 tangent = glm::normalize(glm::cross(up, normal));
+					glm::vec3 bitangent = glm::cross(normal, tangent);
+
+					__m128 sum = _mm_setzero_ps();
+					float totalWeight = 0.0f;
+					for (const LobeSample& sample : samples)
+					{
+						glm::vec3 direction = tangent * sample.Direction.x + bitangent * sample.Direction.y + normal * sample.Direction.z;
+						// trilinear between the two nearest source mips
+						int mip = (int)sample.Lod;
+						int nextMip = mip + 1 < (int)mips.size() ? mip + 1 : mip;
+						__m128 fraction = _mm_set1_ps(sample.Lod - mip);
+						__m128 fine = SampleCube(mips[mip].Texels, mips[mip].Size, direction);
+						__m128 coarse = SampleCube(mips[nextMip].Texels, mips[nextMip].Size, direction);
+						__m128 radiance = _mm_add_ps(fine, _mm_mul_ps(_mm_sub_ps(coarse, fine), fraction));
+						sum = _mm_add_ps(sum, _mm_mul_ps(radiance, _mm_set1_ps(sample.Weight)));
+						totalWeight += sample.Weight;
+					}
+					_mm_storeu_ps(&cube.Texels[(((size_t)face * cube.Size + y) * cube.Size + x) * 4], _mm_mul_ps(sum, _mm_set1_ps(1.0f / totalWeight)));
+				}
+			});
+		}
+
+		// Split sum BRDF term: the scale and bias on F0 of the specular BRDF integrated over the
+		// hemisphere under white light, with the Smith geometry term and k = alpha / 2 for IBL
+		void ImageBasedLighting::IntegrateBRDF()
+		{
+			brdf.resize((size_t)BRDF_SIZE * BRDF_SIZE * 2);
+			Util::Parallel::For(BRDF_SIZE, [&](unsigned int y) {
+				float roughness = (y + 0.5f) / BRDF_SIZE;
+				float alpha = roughness * roughness;
+				float k = alpha / 2.0f;
+				for (int x = 0; x < BRDF_SIZE; x++)
+				{
+					float NdotV = (x + 0.5f) / BRDF_SIZE;
+					glm::vec3 view(std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+					float scale = 0.0f, bias = 0.0f;
+					for (unsigned int i = 0; i < BRDF_SAMPLES; i++)
+					{
+						float hx, hy;
+						Hammersley(i, BRDF_SAMPLES, &hx, &hy);
+						glm::vec3 halfway = SampleGGX(hx, hy, alpha);
+						float VdotH = glm::dot(view, halfway);
+						glm::vec3 light = halfway * (2.0f * VdotH) - view;
+						float NdotL = light.z;
+						if (NdotL <= 0.0f)
+							continue;
+
+						float NdotH = halfway.z;
+						float geometry = NdotV / (NdotV * (1.0f - k) + k) * NdotL / (NdotL * (1.0f - k) + k);
+						float visibility = geometry * VdotH / (NdotH * NdotV);
+						float fresnel = std::pow(1.0f - VdotH, 5.0f);
+						scale += (1.0f - fresnel) * visibility;
+						bias += fresnel * visibility;
+					}
+					brdf[(y * BRDF_SIZE + x) * 2] = scale / BRDF_SAMPLES;
+					brdf[(y * BRDF_SIZE + x) * 2 + 1] = bias / BRDF_SAMPLES;
+				}
+			});
+		}
+
+		bool ImageBasedLighting::Save(const std::string& path) const
+		{
+			if (prefiltered.empty())
+				return false;
+
+			std::ofstream file(path, std::ios::binary);
+			if (!file)
+			{
+				Util::Log::WriteError("IBL: could not write " + path);
+				return false;
+			}
+
+			file.write(IBL_MAGIC, sizeof(IBL_MAGIC));
+			file.write((const char*)&sourceKey, sizeof(sourceKey));
+			file.write((const char*)irradiance, sizeof(irradiance));
+			for (const Cube& cube : prefiltered)
+				file.write((const char*)cube.Texels.data(), cube.Texels.size() * sizeof(float));
+			file.write((const char*)brdf.data(), brdf.size() * sizeof(float));
+			return true;
+		}
+
+		bool ImageBasedLighting::Load(const std::string& path, const std::string& skyboxName)
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
+				return false;
+
+			char magic[4];
+			file.read(magic, sizeof(magic));
+			if (!file || std::string(magic, 4) != std::string(IBL_MAGIC, 4))
+			{
+				Util::Log::WriteError("IBL: " + path + " is not an IBL cache");
+				return false;
+			}
+			// the faces or the constants changed since it was made, it's regenerated
+			uint64_t fileKey = 0;
+			file.read((char*)&fileKey, sizeof(fileKey));
+			uint64_t currentKey;
+			if (!file || !GetSourceKey(skyboxName, &currentKey) || fileKey != currentKey)
+			{
+				Util::Log::WriteInfo("IBL: " + path + " is older than " + skyboxName + " or its settings");
+				return false;
+			}
+			sourceKey = currentKey;
+
+			file.read((char*)irradiance, sizeof(irradiance));
+			prefiltered.assign(PREFILTERED_LEVELS, Cube());
+			for (int level = 0; level < PREFILTERED_LEVELS; level++)
+			{
+				Cube& cube = prefiltered[level];
+				cube.Size = PREFILTERED_SIZE >> level;
+				cube.Texels.resize((size_t)6 * cube.Size * cube.Size * 4);
+				file.read((char*)cube.Texels.data(), cube.Texels.size() * sizeof(float));
+			}
+			brdf.resize((size_t)BRDF_SIZE * BRDF_SIZE * 2);
+			file.read((char*)brdf.data(), brdf.size() * sizeof(float));
+
+			if (!file)
+			{
+				Util::Log::WriteError("IBL: " + path + " is truncated");
+				prefiltered.clear();
+				brdf.clear();
+				return false;
+			}
+			return true;
+		}
+
+		bool ImageBasedLighting::Upload()
+		{
+			bool generated = !prefiltered.empty();
+			if (!generated)
+				Util::Log::WriteWarning("IBL: nothing was generated or loaded, falling back to a flat sky");
+
+			// a single texel stands in for each map of the flat sky, no F0 scale or bias means no
+			// specular light from it
+			const float fallbackTexel[4] = { FALLBACK_RADIANCE, FALLBACK_RADIANCE, FALLBACK_RADIANCE, 1.0f };
+			const float fallbackBRDF[2] = { 0.0f, 0.0f };
+			int levels = generated ? PREFILTERED_LEVELS : 1;
+			int size = generated ? PREFILTERED_SIZE : 1;
+			environmentMap = GLResources::CreateTexture(GL_TEXTURE_CUBE_MAP, GL_RGB16F, size, size, levels);
+			for (int level = 0; level < levels; level++)
+			{
+				for (int face = 0; face < 6; face++)
+				{
+					if (!generated)
+					{
+						GLResources::UploadTexture(GL_TEXTURE_CUBE_MAP, environmentMap, level, face, 1, 1, GL_RGBA, GL_FLOAT, fallbackTexel);
+						continue;
+					}
+					const Cube& cube = prefiltered[level];
+					GLResources::UploadTexture(GL_TEXTURE_CUBE_MAP, environmentMap, level, face, cube.Size, cube.Size, GL_RGBA, GL_FLOAT,
+						&cube.Texels[(size_t)face * cube.Size * cube.Size * 4]);
+				}
+			}
+			GLResources::SetTextureParameter(GL_TEXTURE_CUBE_MAP, environmentMap, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_CUBE_MAP, environmentMap, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_CUBE_MAP, environmentMap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_CUBE_MAP, environmentMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_CUBE_MAP, environmentMap, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			// the rough mips are only a few texels across, filtering across faces hides their seams
+			glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+			int brdfSize = generated ? BRDF_SIZE : 1;
+			brdfMap = GLResources::CreateTexture(GL_TEXTURE_2D, GL_RG16F, brdfSize, brdfSize);
+			GLResources::UploadTexture(GL_TEXTURE_2D, brdfMap, 0, 0, brdfSize, brdfSize, GL_RG, GL_FLOAT, generated ? brdf.data() : fallbackBRDF);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, brdfMap, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, brdfMap, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, brdfMap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D, brdfMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			// a constant radiance only has the first coefficient, which is that radiance
+			EnvironmentBlock block;
+			for (unsigned int i = 0; i < EnvironmentBlock::SH_COEFFICIENTS; i++)
+				block.IrradianceSH[i] = generated ? irradiance[i] : glm::vec4(0.0f);
+			if (!generated)
+				block.IrradianceSH[0] = glm::vec4(glm::vec3(FALLBACK_RADIANCE), 0.0f);
+			block.Parameters = glm::vec4((float)(levels - 1), 0.0f, 0.0f, 0.0f);
+			blockBuffer = GLResources::CreateBuffer(sizeof(EnvironmentBlock), &block);
+			return generated;
+		}
+
+		void ImageBasedLighting::SetupProgram(Shader* program) const
+		{
+			program->use();
+			program->setInt("prefilteredMap", ENVIRONMENT_TEXTURE_UNIT);
+			program->setInt("brdfLUT", BRDF_TEXTURE_UNIT);
+		}
+
+		bool ImageBasedLighting::IsEmpty() const
+		{
+			return prefiltered.empty();
+		}
+
+		uint64_t ImageBasedLighting::GetSourceKey() const
+		{
+			return sourceKey;
+		}
+
+		glm::vec3 ImageBasedLighting::GetRadiance(const glm::vec3& direction) const
+		{
+			if (prefiltered.empty())
+				return glm::vec3(0.0f);
+
+			float radiance[4];
+			_mm_storeu_ps(radiance, SampleCube(prefiltered[0].Texels, prefiltered[0].Size, direction));
+			return glm::vec3(radiance[0], radiance[1], radiance[2]);
+		}
+
+		void ImageBasedLighting::Bind() const
+		{
+			GLState::BindTexture(ENVIRONMENT_TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP, environmentMap);
+			GLState::BindTexture(BRDF_TEXTURE_UNIT, GL_TEXTURE_2D, brdfMap);
+			glBindBufferBase(GL_UNIFORM_BUFFER, ENVIRONMENT_BLOCK_BINDING, blockBuffer);
+		}
+	}
+}
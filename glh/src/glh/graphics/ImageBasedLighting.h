@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+#include "UniformBlocks.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// Ambient light from a skybox with the split sum approximation (Karis, "Real Shading in
+		// Unreal Engine 4"), precomputed on worker threads and cached to disk next to the skybox.
+		//
+		// Diffuse light is the skybox's irradiance as nine spherical harmonics coefficients (Ramamoorthi
+		// and Hanrahan, "An Efficient Representation for Irradiance Environment Maps"), which the
+		// shaders evaluate from the EnvironmentBlock without a texture fetch. Specular light is a cube
+		// whose mips hold the skybox convolved with GGX lobes of rising roughness, importance sampled
+		// with the source mip picked from each sample's solid angle (Krivanek and Colbert, "Real-time
+		// Shading with Filtered Importance Sampling") so few samples don't alias. The BRDF's scale and
+		// bias on F0 for every view angle and roughness come from a 2D lookup table.
+		//
+		// The shaders read them through
+		//
+		// layout (std140) uniform EnvironmentBlock { vec4 irradianceSH[9]; vec4 environmentParameters; };
+		// uniform samplerCube prefilteredMap;   // roughness * environmentParameters.x is the mip
+		// uniform sampler2D brdfLUT;            // x: N.V, y: roughness
+		//
+		// so a pixel's ambient light costs two texture fetches.
+		class ImageBasedLighting
+		{
+		public:
+			static const unsigned int ENVIRONMENT_TEXTURE_UNIT = 16;
+			static const unsigned int BRDF_TEXTURE_UNIT = 17;
+
+			// skybox faces are box filtered down to this before anything is integrated
+			static const int SOURCE_SIZE = 256;
+			static const int PREFILTERED_SIZE = 128;
+			// the last level is roughness 1
+			static const int PREFILTERED_LEVELS = 6;
+			static const int PREFILTERED_SAMPLES = 64;
+			static const int BRDF_SIZE = 128;
+			static const int BRDF_SAMPLES = 512;
+
+			// integrates the faces of Data/Skyboxes/<skyboxName> on worker threads
+			bool Generate(const std::string& skyboxName);
+
+			bool Save(const std::string& path) const;
+			// false if the cache was made from other faces or with other constants
+			bool Load(const std::string& path, const std::string& skyboxName);
+
+			// creates the prefiltered cube, the lookup table and the EnvironmentBlock, false if nothing
+			// was generated or loaded, in which case they hold a flat grey sky so the shaders still
+			// have something bound
+			bool Upload();
+
+			// points the program's prefilteredMap and brdfLUT samplers at their units
+			void SetupProgram(Shader* program) const;
+			// binds the textures and the EnvironmentBlock for the shaders that follow
+			void Bind() const;
+
+			// the skybox's linear radiance towards a direction, from the mirror level, for bakers that
+			// need the same sky the shaders see. Black if nothing was generated or loaded.
+			glm::vec3 GetRadiance(const glm::vec3& direction) const;
+
+			// true until Generate or Load succeeds
+			bool IsEmpty() const;
+			// identifies the faces and constants it was made from, for keying what's baked from it.
+			// 0 while empty.
+			uint64_t GetSourceKey() const;
+
+		private:
+			// hash of every constant above and the skybox's face files
+			static bool GetSourceKey(const std::string& skyboxName, uint64_t* key);
+
+			struct Cube
+			{
+				int Size = 0;
+				// RGBA per texel, face after face
+				std::vector<float> Texels;
+			};
+
+			// adds 2x2 box filtered levels below the first down to 1x1
+			void BuildSourceMips(std::vector<Cube>& mips) const;
+			void ProjectIrradiance(const Cube& source);
+			void PrefilterLevel(const std::vector<Cube>& mips, int level);
+			void IntegrateBRDF();
+
+			// irradiance / pi, premultiplied by the basis constants, w is unused
+			glm::vec4 irradiance[EnvironmentBlock::SH_COEFFICIENTS];
+			// PREFILTERED_LEVELS cubes, RGBA per texel
+			std::vector<Cube> prefiltered;
+			// scale and bias per texel
+			std::vector<float> brdf;
+
+			// of the faces it was generated from
+			uint64_t sourceKey = 0;
+
+			unsigned int environmentMap = 0;
+			unsigned int brdfMap = 0;
+			unsigned int blockBuffer = 0;
+		};
+	}
+}
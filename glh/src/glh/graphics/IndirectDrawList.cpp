@@ -0,0 +1,220 @@
+#include "IndirectDrawList.h"
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "GLResources.h"
+#include "GLState.h"
+
+namespace glh {
+	namespace Graphics {
+
+		IndirectDrawList::IndirectDrawList(GeometryHeap* geometryHeap) : heap(geometryHeap)
+		{
+			glGenBuffers(1, &indirectBuffer);
+			glGenBuffers(1, &instanceBuffer);
+			glGenBuffers(1, &transformBuffer);
+
+			glBindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+			glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+			glGenTextures(1, &transformTexture);
+			GLState::BindTexture(TRANSFORM_TEXTURE_UNIT, GL_TEXTURE_BUFFER, transformTexture);
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, transformBuffer);
+		}
+
+		void IndirectDrawList::Submit(unsigned int mesh, const glm::mat4& transform, unsigned int material)
+		{
+			Submission submission;
+			submission.Mesh = mesh;
+			submission.Material = material;
+			submissions.push_back(submission);
+			transforms.push_back(transform);
+			// the commands built so far don't include this draw
+			prepared = false;
+		}
+
+		void IndirectDrawList::Flush(Shader* shader)
+		{
+			if (submissions.empty())
+			{
+				stats = Stats();
+				return;
+			}
+
+			if (!prepared)
+				Prepare();
+			Draw(shader, heap->GetVAO());
+			Clear();
+		}
+
+		void IndirectDrawList::FlushDepth(Shader* shader)
+		{
+			if (submissions.empty())
+				return;
+
+			if (!prepared)
+				Prepare();
+			Draw(shader, heap->GetDepthVAO());
+		}
+
+		void IndirectDrawList::Clear()
+		{
+			if (prepared)
+			{
+				stats.Objects = (unsigned int)submissions.size();
+				stats.Commands = (unsigned int)commands.size();
+			}
+			else
+				stats = Stats();
+			submissions.clear();
+			transforms.clear();
+			prepared = false;
+		}
+
+		void IndirectDrawList::EnableObjectTable()
+		{
+			if (objectTable)
+				return;
+
+			objectTable = true;
+			glGenBuffers(1, &objectBuffer);
+			glBindBuffer(GL_TEXTURE_BUFFER, objectBuffer);
+			glBufferData(GL_TEXTURE_BUFFER, OBJECT_TABLE_STRIDE * sizeof(unsigned int), nullptr, GL_STREAM_DRAW);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			glGenTextures(1, &objectTexture);
+			GLState::BindTexture(GLResources::EDIT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, objectTexture);
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, objectBuffer);
+		}
+
+		unsigned int IndirectDrawList::GetTransformTexture() const
+		{
+			return transformTexture;
+		}
+
+		unsigned int IndirectDrawList::GetObjectTexture() const
+		{
+			return objectTexture;
+		}
+
+		unsigned int IndirectDrawList::GetObjectCount() const
+		{
+			return (unsigned int)submissions.size();
+		}
+
+		GeometryHeap* IndirectDrawList::GetHeap() const
+		{
+			return heap;
+		}
+
+		void IndirectDrawList::Prepare()
+		{
+			stats = Stats();
+			heap->Upload();
+
+			// counting sort of the objects by mesh, each mesh with any objects becomes one command
+			unsigned int meshCount = heap->GetMeshCount();
+			meshCounts.assign(meshCount + 1, 0);
+			for (const Submission& submission : submissions)
+				meshCounts[submission.Mesh + 1]++;
+
+			commands.clear();
+			for (unsigned int mesh = 0; mesh < meshCount; mesh++)
+			{
+				unsigned int count = meshCounts[mesh + 1];
+				unsigned int first = meshCounts[mesh];
+				meshCounts[mesh + 1] += first;
+				if (count == 0)
+					continue;
+
+				const MeshRange& range = heap->GetMesh(mesh);
+				DrawElementsIndirectCommand command;
+				command.Count = range.IndexCount;
+				command.InstanceCount = count;
+				command.FirstIndex = range.FirstIndex;
+				command.BaseVertex = range.BaseVertex;
+				command.BaseInstance = first;
+				commands.push_back(command);
+			}
+
+			instances.resize(submissions.size() * 2);
+			for (unsigned int i = 0; i < submissions.size(); i++)
+			{
+				unsigned int slot = meshCounts[submissions[i].Mesh]++;
+				instances[slot * 2] = i;
+				instances[slot * 2 + 1] = submissions[i].Material;
+			}
+
+			// three uploads for the whole frame, each orphaning last frame's storage
+			glBindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+			glBufferData(GL_TEXTURE_BUFFER, transforms.size() * sizeof(glm::mat4), &transforms[0], GL_STREAM_DRAW);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+			glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(unsigned int), &instances[0], GL_STREAM_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			stats.APICalls += 2;
+
+			if (objectTable)
+			{
+				objects.resize(submissions.size() * OBJECT_TABLE_STRIDE);
+				for (unsigned int i = 0; i < submissions.size(); i++)
+				{
+					const MeshRange& range = heap->GetMesh(submissions[i].Mesh);
+					objects[i * OBJECT_TABLE_STRIDE] = range.FirstIndex;
+					objects[i * OBJECT_TABLE_STRIDE + 1] = range.BaseVertex;
+					objects[i * OBJECT_TABLE_STRIDE + 2] = submissions[i].Material;
+					objects[i * OBJECT_TABLE_STRIDE + 3] = submissions[i].Mesh;
+				}
+				glBindBuffer(GL_TEXTURE_BUFFER, objectBuffer);
+				glBufferData(GL_TEXTURE_BUFFER, objects.size() * sizeof(unsigned int), &objects[0], GL_STREAM_DRAW);
+				glBindBuffer(GL_TEXTURE_BUFFER, 0);
+				stats.APICalls++;
+			}
+
+			if (GLExtensions::HasMultiDrawIndirect())
+			{
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+				glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), &commands[0], GL_STREAM_DRAW);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+				stats.APICalls++;
+			}
+			prepared = true;
+		}
+
+		void IndirectDrawList::Draw(Shader* shader, unsigned int vao)
+		{
+			shader->use();
+			auto sampler = transformSamplers.find(shader->ID);
+			if (sampler == transformSamplers.end())
+				sampler = transformSamplers.emplace(shader->ID, shader->GetUniform<int>("instanceTransforms")).first;
+			shader->Set(sampler->second, (int)TRANSFORM_TEXTURE_UNIT);
+			GLState::BindTexture(TRANSFORM_TEXTURE_UNIT, GL_TEXTURE_BUFFER, transformTexture);
+			GLState::BindVertexArray(vao);
+
+			if (GLExtensions::HasMultiDrawIndirect())
+			{
+				heap->SetInstanceBuffer(instanceBuffer, 0);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+				GLExtensions::MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)commands.size(), 0);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+				stats.APICalls++;
+			}
+			else
+			{
+				for (const DrawElementsIndirectCommand& command : commands)
+				{
+					heap->SetInstanceBuffer(instanceBuffer, command.BaseInstance * 2 * sizeof(unsigned int));
+					glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.Count, GL_UNSIGNED_INT,
+						(void*)(size_t)(command.FirstIndex * sizeof(unsigned int)), command.InstanceCount, command.BaseVertex);
+					stats.APICalls += 2;
+				}
+			}
+		}
+
+		const IndirectDrawList::Stats& IndirectDrawList::GetStats() const
+		{
+			return stats;
+		}
+	}
+}
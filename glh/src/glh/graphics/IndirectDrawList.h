@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <unordered_map>
+
+#include "GeometryHeap.h"
+#include "Shader.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// layout fixed by glMultiDrawElementsIndirect
+		struct DrawElementsIndirectCommand
+		{
+			unsigned int Count;
+			unsigned int InstanceCount;
+			unsigned int FirstIndex;
+			unsigned int BaseVertex;
+			unsigned int BaseInstance;
+		};
+
+		// Collects the visible objects of a frame that live in a GeometryHeap and draws all of them
+		// with one glMultiDrawElementsIndirect per Flush. Objects of the same mesh become a single
+		// command, and each instance carries a (transform index, material index) pair through the
+		// heap's instance attribute; baseInstance offsets into those pairs per command. Transforms
+		// are read in the vertex shader from a buffer texture (see indirect.vs).
+		//
+		// Without GL 4.3 / ARB_multi_draw_indirect the same commands are issued one by one with
+		// glDrawElementsInstancedBaseVertex, moving the instance attribute instead of using baseInstance.
+		class IndirectDrawList
+		{
+		public:
+			// texture unit the transform buffer texture is bound to, after the material units
+			static const unsigned int TRANSFORM_TEXTURE_UNIT = 6;
+			// values per object in the object table
+			static const unsigned int OBJECT_TABLE_STRIDE = 4;
+
+			struct Stats
+			{
+				unsigned int Objects = 0;
+				unsigned int Commands = 0;
+				// draw and buffer calls made by the last flush
+				unsigned int APICalls = 0;
+			};
+
+			IndirectDrawList(GeometryHeap* heap);
+
+			void Submit(unsigned int mesh, const glm::mat4& transform, unsigned int material = 0);
+			// builds the commands, draws everything submitted with shader and clears the list
+			void Flush(Shader* shader);
+			// draws everything submitted through the heap's position-only VAO, for depth passes that
+			// run before Flush; the list is kept for the Flush that follows
+			void FlushDepth(Shader* shader);
+			// empties the list without drawing, for frames where only FlushDepth passes used it
+			void Clear();
+
+			// from the next Prepare on, also uploads a table of (first index, base vertex, material, mesh)
+			// per object in submission order, as an RGBA32UI buffer texture. Together with the
+			// transforms it lets a pass find any submitted triangle from its object index alone.
+			void EnableObjectTable();
+			// buffer textures of the current list, valid from the first flush of a frame until Clear
+			unsigned int GetTransformTexture() const;
+			unsigned int GetObjectTexture() const;
+			unsigned int GetObjectCount() const;
+			GeometryHeap* GetHeap() const;
+
+			const Stats& GetStats() const;
+
+		private:
+			struct Submission
+			{
+				unsigned int Mesh;
+				unsigned int Material;
+			};
+
+			// sorts the submissions into commands and uploads them, once for all passes over the list
+			void Prepare();
+			void Draw(Shader* shader, unsigned int vao);
+
+			GeometryHeap* heap;
+			bool prepared = false;
+
+			unsigned int indirectBuffer = 0;
+			unsigned int instanceBuffer = 0;
+			unsigned int transformBuffer = 0;
+			unsigned int transformTexture = 0;
+			unsigned int objectBuffer = 0;
+			unsigned int objectTexture = 0;
+			bool objectTable = false;
+
+			std::vector<Submission> submissions;
+			std::vector<glm::mat4> transforms;
+
+			std::vector<DrawElementsIndirectCommand> commands;
+			std::vector<unsigned int> instances;
+			std::vector<unsigned int> meshCounts;
+			std::vector<unsigned int> objects;
+			std::unordered_map<unsigned int, Uniform<int>> transformSamplers;
+
+			Stats stats;
+		};
+	}
+}
@@ -0,0 +1,160 @@
+#include "InstanceBatch.h"
+
+#include <glad/glad.h>
+
+#include "../util/Log.h"
+#include "GLResources.h"
+#include "GLState.h"
+#include "Model.h"
+#include "VertexLayout.h"
+
+namespace glh {
+	namespace Graphics {
+
+		static const unsigned int INVALID_SLOT = 0xffffffff;
+		// the model's vertices are read from binding 0
+		static const unsigned int INSTANCE_BINDING = 1;
+		// a mat4 attribute takes 4 consecutive vec4 slots
+		typedef VertexLayout<
+			VertexAttribute<InstanceBatch::FIRST_ATTRIBUTE + 0, glm::vec4, INSTANCE_BINDING>,
+			VertexAttribute<InstanceBatch::FIRST_ATTRIBUTE + 1, glm::vec4, INSTANCE_BINDING>,
+			VertexAttribute<InstanceBatch::FIRST_ATTRIBUTE + 2, glm::vec4, INSTANCE_BINDING>,
+			VertexAttribute<InstanceBatch::FIRST_ATTRIBUTE + 3, glm::vec4, INSTANCE_BINDING>> TransformLayout;
+		static_assert(TransformLayout::Describes<glm::mat4>(INSTANCE_BINDING), "instance transforms are read as a mat4");
+
+		InstanceBatch::InstanceBatch(Model* batchModel, unsigned int initialCapacity) : model(batchModel)
+		{
+			capacity = initialCapacity > 0 ? initialCapacity : 1;
+
+			VAO = model->CreateVertexArray();
+
+			// the buffer is orphaned and regrown as instances are added, so it keeps mutable storage
+			glGenBuffers(1, &instanceBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+			glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+			TransformLayout::Apply(VAO);
+			TransformLayout::SetVertexBuffer(VAO, INSTANCE_BINDING, instanceBuffer);
+			GLResources::SetBindingDivisor(VAO, INSTANCE_BINDING, 1);
+		}
+
+		unsigned int InstanceBatch::Add(const glm::mat4& transform)
+		{
+			unsigned int handle;
+			if (!freeHandles.empty())
+			{
+				handle = freeHandles.back();
+				freeHandles.pop_back();
+			}
+			else
+			{
+				handle = (unsigned int)handleSlots.size();
+				handleSlots.push_back(INVALID_SLOT);
+			}
+
+			handleSlots[handle] = (unsigned int)transforms.size();
+			transforms.push_back(transform);
+			handleOwners.push_back(handle);
+			dirty = true;
+			return handle;
+		}
+
+		void InstanceBatch::Update(unsigned int handle, const glm::mat4& transform)
+		{
+			if (handle >= handleSlots.size() || handleSlots[handle] == INVALID_SLOT)
+			{
+				Util::Log::WriteError("INSTANCEBATCH: updating an instance that doesn't exist");
+				return;
+			}
+
+			transforms[handleSlots[handle]] = transform;
+			dirty = true;
+		}
+
+		void InstanceBatch::Remove(unsigned int handle)
+		{
+			if (handle >= handleSlots.size() || handleSlots[handle] == INVALID_SLOT)
+			{
+				Util::Log::WriteError("INSTANCEBATCH: removing an instance that doesn't exist");
+				return;
+			}
+
+			// move the last instance into the hole so the array stays dense
+			unsigned int slot = handleSlots[handle];
+			unsigned int last = (unsigned int)transforms.size() - 1;
+			transforms[slot] = transforms[last];
+			handleOwners[slot] = handleOwners[last];
+			handleSlots[handleOwners[slot]] = slot;
+			transforms.pop_back();
+			handleOwners.pop_back();
+
+			handleSlots[handle] = INVALID_SLOT;
+			freeHandles.push_back(handle);
+			dirty = true;
+		}
+
+		void InstanceBatch::Clear()
+		{
+			transforms.clear();
+			handleOwners.clear();
+			handleSlots.clear();
+			freeHandles.clear();
+			collected.clear();
+			dirty = true;
+		}
+
+		void InstanceBatch::Collect(const glm::mat4& transform)
+		{
+			collected.push_back(transform);
+		}
+
+		void InstanceBatch::Upload()
+		{
+			unsigned int count = GetCount();
+			if (!dirty && collected.empty())
+				return;
+
+			glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+			while (capacity < count)
+				capacity *= 2;
+
+			// orphan the old storage so the driver doesn't have to wait for draws still reading it
+			glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+			if (!transforms.empty())
+				glBufferSubData(GL_ARRAY_BUFFER, 0, transforms.size() * sizeof(glm::mat4), &transforms[0]);
+			if (!collected.empty())
+				glBufferSubData(GL_ARRAY_BUFFER, transforms.size() * sizeof(glm::mat4), collected.size() * sizeof(glm::mat4), &collected[0]);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+			// collected instances are gone after this frame, so the next one needs a new upload
+			dirty = !collected.empty();
+		}
+
+		void InstanceBatch::Draw(Shader* shader)
+		{
+			unsigned int count = GetCount();
+			if (count == 0)
+				return;
+
+			Upload();
+
+			shader->use();
+			model->BindTextures();
+			GLState::BindVertexArray(VAO);
+			glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)model->indices.size(), GL_UNSIGNED_INT, 0, (GLsizei)count);
+
+			collected.clear();
+		}
+
+		unsigned int InstanceBatch::GetCount() const
+		{
+			return (unsigned int)(transforms.size() + collected.size());
+		}
+
+		unsigned int InstanceBatch::GetCapacity() const
+		{
+			return capacity;
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Shader.h"
+
+namespace glh {
+	namespace Graphics {
+
+		class Model;
+
+		// Draws many copies of one Model with a single glDrawElementsInstanced.
+		// The batch has its own VAO over the model's vertex and index buffers, with the per instance
+		// model matrix in attribute slots 5-8 (divisor 1) right after the mesh's 0-4, matching
+		// Instanced.vs. Instances are either kept across frames (Add/Update/Remove) or collected for
+		// the current frame only, which is what Model::Draw does while the model is attached to a batch.
+		class InstanceBatch
+		{
+		public:
+			static const unsigned int FIRST_ATTRIBUTE = 5;
+
+			InstanceBatch(Model* model, unsigned int initialCapacity = 64);
+
+			// returns a handle that stays valid until the instance is removed
+			unsigned int Add(const glm::mat4& transform);
+			void Update(unsigned int handle, const glm::mat4& transform);
+			void Remove(unsigned int handle);
+			void Clear();
+
+			// adds an instance for the next Draw only
+			void Collect(const glm::mat4& transform);
+
+			// uploads whatever changed and draws every kept and collected instance with shader
+			void Draw(Shader* shader);
+
+			unsigned int GetCount() const;
+			unsigned int GetCapacity() const;
+
+		private:
+			void Upload();
+
+			Model* model;
+			unsigned int VAO = 0;
+			unsigned int instanceBuffer = 0;
+			unsigned int capacity = 0;
+			bool dirty = false;
+
+			// kept instances are stored densely, handles map to positions through these two tables
+			std::vector<glm::mat4> transforms;
+			std::vector<unsigned int> handleOwners;
+			std::vector<unsigned int> handleSlots;
+			std::vector<unsigned int> freeHandles;
+
+			std::vector<glm::mat4> collected;
+		};
+	}
+}
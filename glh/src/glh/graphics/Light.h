@@ -0,0 +1,20 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace glh {
+	namespace Graphics {
+
+		// A point light whose contribution is windowed down to nothing at Range, so it only needs to
+		// be shaded on pixels within that distance. Two vec4s, which is how shaders read it back.
+		struct PointLight
+		{
+			glm::vec3 Position;
+			float Range = 1.0f;
+			glm::vec3 Color = glm::vec3(1.0f);
+			float Intensity = 1.0f;
+		};
+
+		static_assert(sizeof(PointLight) == 32, "PointLight is read by shaders as two vec4s");
+	}
+}
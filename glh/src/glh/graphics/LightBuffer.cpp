@@ -1,34 +1,399 @@
 #include "LightBuffer.h"
 
 #include <glad\glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <cstring>
+
+#include "../util/Parallel.h"
+#include "../util/Timer.h"
+#include "GLResources.h"
+#include "GLState.h"
 
 namespace glh {
 	namespace Graphics {
-		LightBuffer::LightBuffer() {
-			glGenFramebuffers(1, &depthMapFBO);
-
-			// generate depth texture
-			unsigned int depthMap;
-			glGenTextures(1, &depthMap);
-			glBindTexture(GL_TEXTURE_2D, depthMap);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-			// attach depth texture to framebuffer
-			glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-			glDrawBuffer(GL_NONE);
-			glReadBuffer(GL_NONE);
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-		}
-
-		void LightBuffer::Bind() {
-			glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+
+		static_assert(LightBuffer::CASCADE_COUNT == ShadowBlock::MAX_CASCADES, "the ShadowBlock holds one matrix per cascade");
+
+		LightBuffer::LightBuffer() : lightDirection(0.0f)
+		{
+			depthMapFBO = GLResources::CreateFramebuffer();
+
+			// one depth layer per cascade, compared in the sampler so the shaders get filtered visibility
+			depthMap = GLResources::CreateTexture3D(GL_TEXTURE_2D_ARRAY, GL_DEPTH_COMPONENT24, SHADOW_WIDTH, SHADOW_HEIGHT, CASCADE_COUNT);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+			// the layer is attached before each cascade is drawn
+			GLResources::SetDrawBuffer(depthMapFBO, GL_NONE);
+			GLResources::SetReadBuffer(depthMapFBO, GL_NONE);
+
+			depthProgram = Shader("Data/Shaders/simpleDepth.vs", "Data/Shaders/simpleDepth.fs");
+			lightSpaceMatrix = depthProgram.GetUniform<glm::mat4>("lightSpaceMatrix");
+			model = depthProgram.GetUniform<glm::mat4>("model");
+
+			block.ShadowFilter = glm::vec4(0.0f, POSITIVE_EXPONENT, NEGATIVE_EXPONENT, 0.2f);
+			blockBuffer = GLResources::CreateBuffer(sizeof(ShadowBlock), &block, true);
+		}
+
+		void LightBuffer::SetupProgram(Shader* program) const
+		{
+			program->use();
+			program->setInt("shadowMap", SHADOW_TEXTURE_UNIT);
+			program->setInt("shadowMoments", MOMENTS_TEXTURE_UNIT);
+		}
+
+		void LightBuffer::SetShadowDistance(float distance)
+		{
+			shadowDistance = distance;
+			InvalidateCascades();
+		}
+
+		void LightBuffer::SetSplitBlend(float blend)
+		{
+			splitBlend = blend;
+			InvalidateCascades();
+		}
+
+		void LightBuffer::SetFilter(Filter filter)
+		{
+			if (filter == this->filter)
+				return;
+			this->filter = filter;
+			if (filter == EVSM_FILTER && momentsMap == 0)
+				CreateMomentTargets();
+
+			// the moments pass reads plain depth, PCF lets the sampler compare
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_COMPARE_MODE,
+				filter == EVSM_FILTER ? GL_NONE : GL_COMPARE_REF_TO_TEXTURE);
+			block.ShadowFilter.x = filter == EVSM_FILTER ? 1.0f : 0.0f;
+			InvalidateCascades();
+		}
+
+		void LightBuffer::SetBlurRadius(unsigned int radius)
+		{
+			blurRadius = radius;
+			if (filter == EVSM_FILTER)
+				InvalidateCascades();
+		}
+
+		void LightBuffer::SetLightBleedingReduction(float amount)
+		{
+			block.ShadowFilter.w = amount;
+		}
+
+		unsigned int LightBuffer::AddCaster(const ShadowCaster& caster)
+		{
+			casters.push_back(caster);
+			lightBounds.push_back(AABB());
+			castersAdded = true;
+			return (unsigned int)casters.size() - 1;
+		}
+
+		void LightBuffer::MoveCaster(unsigned int caster, const glm::mat4& model)
+		{
+			casters[caster].Model = model;
+			movedCasters.push_back(caster);
+		}
+
+		void LightBuffer::Render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& direction)
+		{
+			double cullStart = Util::Timer::GetTime();
+
+			// a new light direction turns light space, everything has to be fitted and drawn again
+			if (castersAdded || memcmp(&direction, &lightDirection, sizeof(glm::vec3)) != 0)
+			{
+				lightDirection = direction;
+				glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+				lightRotation = glm::lookAt(glm::vec3(0.0f), direction, up);
+				Util::Parallel::For((unsigned int)casters.size(), [this](unsigned int caster) {
+					lightBounds[caster] = GetLightBounds(caster);
+				});
+				for (unsigned int i = 0; i < CASCADE_COUNT; i++)
+					cascades[i].Valid = false;
+				movedCasters.clear();
+				castersAdded = false;
+			}
+			InvalidateMovedCasters();
+
+			// light space looks down -z, so depths along the light are -z
+			casterNear = 0.0f;
+			for (unsigned int i = 0; i < lightBounds.size(); i++)
+			{
+				if (i == 0 || -lightBounds[i].Max.z < casterNear)
+					casterNear = -lightBounds[i].Max.z;
+			}
+
+			// practical split scheme (Zhang et al., "Parallel-Split Shadow Maps"), blending the
+			// logarithmic splits that suit perspective aliasing with uniform ones
+			float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+			float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+			if (shadowDistance < farPlane)
+				farPlane = shadowDistance;
+			float splits[CASCADE_COUNT + 1];
+			for (unsigned int i = 0; i <= CASCADE_COUNT; i++)
+			{
+				float fraction = (float)i / CASCADE_COUNT;
+				float logarithmic = nearPlane * std::pow(farPlane / nearPlane, fraction);
+				float uniform = nearPlane + (farPlane - nearPlane) * fraction;
+				splits[i] = splitBlend * logarithmic + (1.0f - splitBlend) * uniform;
+			}
+
+			glm::mat4 inverseView = glm::inverse(view);
+			for (unsigned int i = 0; i < CASCADE_COUNT; i++)
+			{
+				FitCascade(i, inverseView, projection, splits[i], splits[i + 1]);
+				block.CascadeSplits[i] = splits[i + 1];
+			}
+
+			// each cascade only writes its own list
+			Util::Parallel::For(CASCADE_COUNT, [this](unsigned int index) {
+				if (!cascades[index].Valid)
+					CullCasters(index);
+			});
+			stats.Casters = (unsigned int)casters.size();
+			stats.CullMilliseconds = (Util::Timer::GetTime() - cullStart) * 1000.0;
+
+			stats.RenderedCascades = 0;
+			stats.CasterDraws = 0;
+			renderTimer.Begin();
+			unsigned int previousFramebuffer = GLState::GetFramebuffer();
+			GLint viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+			// the caller may be in a pass without depth testing or writes, the casters need both
+			bool previousDepthTest = GLState::GetDepthTest();
+			bool previousDepthMask = GLState::GetDepthMask();
+			GLenum previousDepthFunc = GLState::GetDepthFunc();
+			GLState::SetDepthTest(true);
+			GLState::SetDepthMask(true);
+			GLState::SetDepthFunc(GL_LESS);
+			// slope scaled bias against acne, the receivers add a small constant one of their own
+			glEnable(GL_POLYGON_OFFSET_FILL);
+			glPolygonOffset(2.0f, 4.0f);
+			depthProgram.use();
+			bool drawn[CASCADE_COUNT];
+			for (unsigned int i = 0; i < CASCADE_COUNT; i++)
+			{
+				drawn[i] = !cascades[i].Valid;
+				if (!drawn[i])
+					continue;
+				DrawCascade(i);
+				cascades[i].Valid = true;
+				stats.RenderedCascades++;
+			}
+			glDisable(GL_POLYGON_OFFSET_FILL);
+			renderTimer.End();
+			stats.RenderMilliseconds = renderTimer.GetMilliseconds();
+
+			// the moments of the cascades that were drawn, the others keep theirs
+			if (filter == EVSM_FILTER && stats.RenderedCascades > 0)
+			{
+				filterTimer.Begin();
+				glViewport(0, 0, momentsSize, momentsSize);
+				GLState::SetDepthTest(false);
+				GLState::BindVertexArray(emptyVAO);
+				// the moments pass reads the depth layers, nothing else keeps them bound before Bind
+				GLState::BindTexture(SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, depthMap);
+				for (unsigned int i = 0; i < CASCADE_COUNT; i++)
+				{
+					if (drawn[i])
+						FilterCascade(i);
+				}
+				GLResources::GenerateMipmaps(GL_TEXTURE_2D_ARRAY, momentsMap);
+				filterTimer.End();
+				stats.FilterMilliseconds = filterTimer.GetMilliseconds();
+			}
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			GLState::BindFramebuffer(previousFramebuffer);
+			GLState::SetDepthTest(previousDepthTest);
+			GLState::SetDepthMask(previousDepthMask);
+			GLState::SetDepthFunc(previousDepthFunc);
+
+			// from clip space to the [0, 1] texture and depth range of the layers
+			glm::mat4 toTexture = glm::translate(glm::mat4(), glm::vec3(0.5f)) * glm::scale(glm::mat4(), glm::vec3(0.5f));
+			for (unsigned int i = 0; i < CASCADE_COUNT; i++)
+				block.CascadeMatrices[i] = toTexture * cascades[i].Matrix;
+			block.LightDirection = glm::vec4(lightDirection, 0.0f);
+			GLResources::UpdateBuffer(blockBuffer, 0, sizeof(ShadowBlock), &block);
+		}
+
+		void LightBuffer::Bind() const
+		{
+			GLState::BindTexture(SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, depthMap);
+			if (filter == EVSM_FILTER)
+				GLState::BindTexture(MOMENTS_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, momentsMap);
+			glBindBufferBase(GL_UNIFORM_BUFFER, SHADOW_BLOCK_BINDING, blockBuffer);
+		}
+
+		AABB LightBuffer::GetLightBounds(unsigned int caster) const
+		{
+			return casters[caster].Bounds.Transform(lightRotation * casters[caster].Model);
+		}
+
+		bool LightBuffer::Overlaps(const Cascade& cascade, const AABB& bounds) const
+		{
+			return bounds.Max.x >= cascade.Center.x - cascade.Radius && bounds.Min.x <= cascade.Center.x + cascade.Radius &&
+				bounds.Max.y >= cascade.Center.y - cascade.Radius && bounds.Min.y <= cascade.Center.y + cascade.Radius &&
+				-bounds.Min.z >= cascade.NearDepth && -bounds.Max.z <= cascade.FarDepth;
+		}
+
+		// The slice's bounding sphere is centred on the view axis, so neither it nor the cascade
+		// change size when the camera turns.
+		void LightBuffer::FitCascade(unsigned int index, const glm::mat4& inverseView, const glm::mat4& projection, float nearSplit, float farSplit)
+		{
+			Cascade& cascade = cascades[index];
+
+			float tanX = 1.0f / projection[0][0];
+			float tanY = 1.0f / projection[1][1];
+			float centerDepth = (nearSplit + farSplit) * 0.5f;
+			glm::vec3 nearCorner(tanX * nearSplit, tanY * nearSplit, centerDepth - nearSplit);
+			glm::vec3 farCorner(tanX * farSplit, tanY * farSplit, farSplit - centerDepth);
+			float sliceRadius = glm::length(farCorner);
+			if (glm::length(nearCorner) > sliceRadius)
+				sliceRadius = glm::length(nearCorner);
+			glm::vec3 center = glm::vec3(lightRotation * inverseView * glm::vec4(0.0f, 0.0f, -centerDepth, 1.0f));
+
+			bool cached = index >= FIRST_CACHED_CASCADE;
+			float radius = cached ? sliceRadius * CACHE_MARGIN : sliceRadius;
+			float nearDepth = -center.z - radius;
+			if (casterNear < nearDepth)
+				nearDepth = casterNear;
+
+			// a cached cascade stays where it is while the slice is inside it and the casters' depth
+			// range hasn't grown past its near plane
+			if (cached && cascade.Valid && cascade.Radius == radius &&
+				glm::length(center - cascade.Center) + sliceRadius <= radius &&
+				cascade.NearDepth <= casterNear)
+				return;
+
+			// whole texels in light space, so the same world point always lands on the same texel
+			float texelSize = 2.0f * radius / SHADOW_WIDTH;
+			center.x = std::floor(center.x / texelSize) * texelSize;
+			center.y = std::floor(center.y / texelSize) * texelSize;
+
+			cascade.Center = center;
+			cascade.Radius = radius;
+			cascade.NearDepth = nearDepth;
+			cascade.FarDepth = -center.z + radius;
+			cascade.Matrix = glm::ortho(center.x - radius, center.x + radius, center.y - radius, center.y + radius,
+				cascade.NearDepth, cascade.FarDepth) * lightRotation;
+			cascade.Valid = false;
+		}
+
+		// a caster that moved dirties the cascades it was in before and the ones it is in now
+		void LightBuffer::InvalidateMovedCasters()
+		{
+			for (unsigned int caster : movedCasters)
+			{
+				AABB previous = lightBounds[caster];
+				lightBounds[caster] = GetLightBounds(caster);
+				for (unsigned int i = 0; i < CASCADE_COUNT; i++)
+				{
+					if (cascades[i].Valid && (Overlaps(cascades[i], previous) || Overlaps(cascades[i], lightBounds[caster])))
+						cascades[i].Valid = false;
+				}
+			}
+			movedCasters.clear();
+		}
+
+		void LightBuffer::CullCasters(unsigned int index)
+		{
+			Cascade& cascade = cascades[index];
+			cascade.Casters.clear();
+			for (unsigned int caster = 0; caster < casters.size(); caster++)
+			{
+				if (Overlaps(cascade, lightBounds[caster]))
+					cascade.Casters.push_back(caster);
+			}
+		}
+
+		void LightBuffer::DrawCascade(unsigned int index)
+		{
+			const Cascade& cascade = cascades[index];
+			GLState::BindFramebuffer(depthMapFBO);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0, index);
 			glClear(GL_DEPTH_BUFFER_BIT);
+
+			depthProgram.Set(lightSpaceMatrix, cascade.Matrix);
+			for (unsigned int caster : cascade.Casters)
+			{
+				const ShadowCaster& draw = casters[caster];
+				depthProgram.Set(model, draw.Model);
+				GLState::BindVertexArray(draw.VAO);
+				if (draw.Indexed)
+					glDrawElements(GL_TRIANGLES, draw.Count, GL_UNSIGNED_INT, 0);
+				else
+					glDrawArrays(GL_TRIANGLES, 0, draw.Count);
+				stats.CasterDraws++;
+			}
+		}
+
+		void LightBuffer::InvalidateCascades()
+		{
+			for (unsigned int i = 0; i < CASCADE_COUNT; i++)
+				cascades[i].Valid = false;
+		}
+
+		void LightBuffer::CreateMomentTargets()
+		{
+			// averaging 2x2 depth texels into each moment texel is the first step of the prefilter
+			momentsSize = SHADOW_WIDTH / 2;
+			momentsMap = GLResources::CreateTexture3D(GL_TEXTURE_2D_ARRAY, GL_RGBA32F, momentsSize, momentsSize, CASCADE_COUNT, 0);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, momentsMap, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, momentsMap, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, momentsMap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, momentsMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			momentsFBO = GLResources::CreateFramebuffer();
+
+			for (unsigned int i = 0; i < 2; i++)
+			{
+				blurTextures[i] = GLResources::CreateTexture(GL_TEXTURE_2D, GL_RGBA32F, momentsSize, momentsSize);
+				GLResources::SetTextureParameter(GL_TEXTURE_2D, blurTextures[i], GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				GLResources::SetTextureParameter(GL_TEXTURE_2D, blurTextures[i], GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				blurFBOs[i] = GLResources::CreateFramebuffer();
+				GLResources::AttachTexture(blurFBOs[i], GL_COLOR_ATTACHMENT0, blurTextures[i]);
+			}
+
+			momentsProgram = Shader("Data/Shaders/fullscreen.vs", "Data/Shaders/evsmMoments.fs");
+			momentsProgram.use();
+			momentsProgram.setInt("depthMap", SHADOW_TEXTURE_UNIT);
+			momentsProgram.setVec2("exponents", POSITIVE_EXPONENT, NEGATIVE_EXPONENT);
+			momentsLayer = momentsProgram.GetUniform<int>("layer");
+
+			blurProgram = Shader("Data/Shaders/fullscreen.vs", "Data/Shaders/evsmBlur.fs");
+			blurProgram.use();
+			blurProgram.setInt("source", MOMENTS_TEXTURE_UNIT);
+			blurStep = blurProgram.GetUniform<glm::vec2>("texelStep");
+			blurTexels = blurProgram.GetUniform<int>("radius");
+
+			emptyVAO = GLResources::CreateVertexArray();
+		}
+
+		void LightBuffer::FilterCascade(unsigned int index)
+		{
+			GLState::BindFramebuffer(blurFBOs[0]);
+			momentsProgram.use();
+			momentsProgram.Set(momentsLayer, (int)index);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+
+			blurProgram.use();
+			blurProgram.Set(blurTexels, (int)blurRadius);
+			GLState::BindFramebuffer(blurFBOs[1]);
+			GLState::BindTexture(MOMENTS_TEXTURE_UNIT, GL_TEXTURE_2D, blurTextures[0]);
+			blurProgram.Set(blurStep, glm::vec2(1.0f, 0.0f));
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+
+			GLState::BindFramebuffer(momentsFBO);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, momentsMap, 0, index);
+			GLState::BindTexture(MOMENTS_TEXTURE_UNIT, GL_TEXTURE_2D, blurTextures[1]);
+			blurProgram.Set(blurStep, glm::vec2(0.0f, 1.0f));
+			glDrawArrays(GL_TRIANGLES, 0, 3);
 		}
 
 		unsigned int LightBuffer::GetShadowBufferWidth() {
@@ -38,5 +403,10 @@ namespace glh {
 		unsigned int LightBuffer::GetShadowBufferHeight() {
 			return SHADOW_HEIGHT;
 		}
+
+		const LightBuffer::Stats& LightBuffer::GetStats() const
+		{
+			return stats;
+		}
 	}
-}
\ No newline at end of file
+}
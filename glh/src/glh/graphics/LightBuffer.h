@@ -1,23 +1,196 @@
 #pragma once
 
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "AABB.h"
+#include "GPUTimer.h"
+#include "Shader.h"
+#include "UniformBlocks.h"
+
 /*
 made specifically for shadows
 */
 
 namespace glh {
 	namespace Graphics {
+
+		// Something that casts shadows. The bounds are in model space and are moved with the model
+		// matrix, the draw goes through the position-only VAO of simpleDepth.vs.
+		struct ShadowCaster
+		{
+			unsigned int VAO = 0;
+			unsigned int Count = 0;
+			bool Indexed = true;
+			glm::mat4 Model;
+			AABB Bounds;
+		};
+
+		// Cascaded shadow maps for the directional light. The view frustum up to the shadow distance
+		// is cut into CASCADE_COUNT slices with the practical split scheme, a blend of logarithmic
+		// and uniform splits, and every slice gets its own layer of one depth texture array.
+		//
+		// Each cascade covers its slice's bounding sphere, which keeps the cascade's size the same
+		// however the camera turns, and its centre is snapped to whole shadow map texels in light
+		// space so the edges don't crawl as the camera moves. The depth range reaches back to the
+		// casters' bounds so casters outside the view frustum still shadow it. Each cascade only
+		// draws the casters whose light space bounds overlap it.
+		//
+		// The cascades from FIRST_CACHED_CASCADE on cover a sphere CACHE_MARGIN times the slice's,
+		// and keep it until the slice leaves it. They're only redrawn when that happens, when the
+		// light turns or when a caster inside them moves, so most frames draw the near cascades
+		// alone. Since the shadow distance is fixed, the shadow cost doesn't grow with the camera's
+		// far plane.
+		//
+		// With EVSM_FILTER the depth of every redrawn cascade is turned into exponential variance
+		// moments (Lauritzen, "Layered Variance Shadow Maps" and "Summed-Area Variance Shadow Maps")
+		// at half resolution, blurred with a separable Gaussian and mipmapped. The shaders then get
+		// soft shadows from a single trilinear lookup, so a wider blur costs nothing per pixel, and
+		// the moments are only rebuilt with the cascades they come from.
+		//
+		// Shaders read the cascades through
+		//
+		// uniform sampler2DArrayShadow shadowMap;   // depth, for PCF_FILTER
+		// uniform sampler2DArray shadowMoments;     // mipmapped moments, for EVSM_FILTER
+		//
+		// and the ShadowBlock, whose ShadowFilter says which of them to use. Programs using them are
+		// set up with SetupProgram.
 		class LightBuffer
 		{
 		public:
+			static const unsigned int CASCADE_COUNT = 4;
+			static const unsigned int FIRST_CACHED_CASCADE = 2;
+			static const unsigned int SHADOW_TEXTURE_UNIT = 14;
+			// the last unit below LightGrid's that no other pass rebinds in the middle of a frame
+			static const unsigned int MOMENTS_TEXTURE_UNIT = 4;
+
+			enum Filter
+			{
+				// 3x3 comparisons against the depth
+				PCF_FILTER,
+				// prefiltered exponential variance moments
+				EVSM_FILTER
+			};
+
+			struct Stats
+			{
+				unsigned int Casters = 0;
+				// cascades redrawn this frame and the casters drawn into them
+				unsigned int RenderedCascades = 0;
+				unsigned int CasterDraws = 0;
+				double CullMilliseconds = 0.0;
+				double RenderMilliseconds = 0.0;
+				// turning the redrawn cascades into blurred moments
+				double FilterMilliseconds = 0.0;
+			};
+
 			LightBuffer();
 			unsigned int GetShadowBufferWidth();
 			unsigned int GetShadowBufferHeight();
-			void Bind();
+
+			// points the program's shadowMap and shadowMoments samplers at their units
+			void SetupProgram(Shader* program) const;
+
+			// shadows are drawn up to this view distance, 60 by default
+			void SetShadowDistance(float distance);
+			// 0 splits the cascades uniformly, 1 logarithmically, 0.75 by default
+			void SetSplitBlend(float blend);
+			// PCF_FILTER by default, the moments are only allocated once EVSM_FILTER is used
+			void SetFilter(Filter filter);
+			// EVSM blur radius in moment texels, 2 by default
+			void SetBlurRadius(unsigned int radius);
+			// cuts the EVSM light bleeding at the cost of darker penumbrae, 0.2 by default
+			void SetLightBleedingReduction(float amount);
+
+			// casters are kept between frames, the returned ID moves them
+			unsigned int AddCaster(const ShadowCaster& caster);
+			void MoveCaster(unsigned int caster, const glm::mat4& model);
+
+			// fits the cascades to the camera and redraws the ones that changed. direction is the
+			// way the light travels.
+			void Render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& direction);
+			// binds the cascades and the ShadowBlock for the shaders that follow
+			void Bind() const;
+
+			const Stats& GetStats() const;
 
 		private:
+			struct Cascade
+			{
+				// light space centre and radius of the region the cascade covers
+				glm::vec3 Center;
+				float Radius = 0.0f;
+				float NearDepth = 0.0f;
+				float FarDepth = 0.0f;
+				glm::mat4 Matrix;
+				bool Valid = false;
+				std::vector<unsigned int> Casters;
+			};
+
+			// the caster's bounds in light space
+			AABB GetLightBounds(unsigned int caster) const;
+			bool Overlaps(const Cascade& cascade, const AABB& lightBounds) const;
+			void FitCascade(unsigned int index, const glm::mat4& inverseView, const glm::mat4& projection, float nearSplit, float farSplit);
+			void InvalidateMovedCasters();
+			void CullCasters(unsigned int index);
+			void DrawCascade(unsigned int index);
+			void InvalidateCascades();
+			void CreateMomentTargets();
+			// depth to moments at half resolution, then the horizontal and vertical blur into the layer
+			void FilterCascade(unsigned int index);
+
 			unsigned int depthMapFBO;
-			unsigned int SHADOW_WIDTH = 1024;
-			unsigned int SHADOW_HEIGHT = 1024;;
+			unsigned int depthMap;
+			unsigned int SHADOW_WIDTH = 2048;
+			unsigned int SHADOW_HEIGHT = 2048;
+			// how much larger than their slice the cached cascades are
+			const float CACHE_MARGIN = 1.25f;
+
+			float shadowDistance = 60.0f;
+			float splitBlend = 0.75f;
+
+			glm::vec3 lightDirection;
+			// world to light space, without a translation so texel snapping works in one fixed space
+			glm::mat4 lightRotation;
+			// depth of the caster closest to the light
+			float casterNear = 0.0f;
+
+			std::vector<ShadowCaster> casters;
+			// light space bounds of every caster
+			std::vector<AABB> lightBounds;
+			std::vector<unsigned int> movedCasters;
+			bool castersAdded = false;
+
+			Cascade cascades[CASCADE_COUNT];
+			Shader depthProgram;
+			Uniform<glm::mat4> lightSpaceMatrix;
+			Uniform<glm::mat4> model;
+
+			Filter filter = PCF_FILTER;
+			unsigned int blurRadius = 2;
+			// exponents of the positive and negative warps, as large as 32 bit floats allow
+			const float POSITIVE_EXPONENT = 40.0f;
+			const float NEGATIVE_EXPONENT = 5.0f;
+			unsigned int momentsSize = 0;
+			unsigned int momentsMap = 0;
+			unsigned int momentsFBO = 0;
+			// the moments and the horizontal blur, before the vertical blur writes the layer
+			unsigned int blurTextures[2] = { 0, 0 };
+			unsigned int blurFBOs[2] = { 0, 0 };
+			unsigned int emptyVAO = 0;
+			Shader momentsProgram;
+			Uniform<int> momentsLayer;
+			Shader blurProgram;
+			Uniform<glm::vec2> blurStep;
+			Uniform<int> blurTexels;
+
+			unsigned int blockBuffer = 0;
+			ShadowBlock block;
+
+			GPUTimer renderTimer;
+			GPUTimer filterTimer;
+			Stats stats;
 		};
 	}
-}
\ No newline at end of file
+}
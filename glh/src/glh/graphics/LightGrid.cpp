@@ -0,0 +1,222 @@
+#include "LightGrid.h"
+
+#include <glad/glad.h>
+#include <xmmintrin.h>
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "../util/Log.h"
+#include "../util/Parallel.h"
+#include "../util/Timer.h"
+#include "GLResources.h"
+#include "GLState.h"
+#include "PointShadowAtlas.h"
+
+namespace glh {
+	namespace Graphics {
+
+		LightGrid::LightGrid(unsigned int width, unsigned int height) :
+			width(width), height(height), clusterProjection(0.0f)
+		{
+			clusterBounds.resize(CLUSTER_COUNT);
+			sliceDepths.resize(CLUSTERS_Z + 1);
+			sliceLights.resize(CLUSTERS_Z);
+			clusterLights.resize(CLUSTER_COUNT);
+
+			// both lists are orphaned and refilled every frame
+			lightBuffer = GLResources::CreateStreamBuffer(2 * sizeof(glm::vec4));
+			clusterBuffer = GLResources::CreateStreamBuffer(CLUSTER_COUNT * 2 * sizeof(unsigned int));
+			lightTexture = GLResources::CreateBufferTexture(GL_RGBA32F, lightBuffer);
+			clusterTexture = GLResources::CreateBufferTexture(GL_R32UI, clusterBuffer);
+
+			block.ClusterCounts[0] = CLUSTERS_X;
+			block.ClusterCounts[1] = CLUSTERS_Y;
+			block.ClusterCounts[2] = CLUSTERS_Z;
+			block.ClusterCounts[3] = 0;
+			blockBuffer = GLResources::CreateBuffer(sizeof(ClusterBlock), &block, true);
+		}
+
+		void LightGrid::SetupProgram(Shader* program) const
+		{
+			program->use();
+			program->setInt("clusterLights", LIGHT_TEXTURE_UNIT);
+			program->setInt("clusterItems", CLUSTER_TEXTURE_UNIT);
+		}
+
+		void LightGrid::Update(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+			const PointShadowAtlas* shadows)
+		{
+			double buildStart = Util::Timer::GetTime();
+			if (memcmp(&projection, &clusterProjection, sizeof(glm::mat4)) != 0)
+				BuildClusterBounds(projection);
+
+			unsigned int lightCount = (unsigned int)lights.size();
+			if (lightCount > MAX_LIGHTS)
+			{
+				Util::Log::WriteWarning("LIGHTGRID: " + std::to_string(lightCount) + " lights, only the first " + std::to_string(MAX_LIGHTS) + " are shaded");
+				lightCount = MAX_LIGHTS;
+			}
+
+			viewLights.resize(lightCount);
+			lightData.resize(lightCount * 2);
+			for (unsigned int i = 0; i < lightCount; i++)
+			{
+				const PointLight& light = lights[i];
+				glm::vec4 position = view * glm::vec4(light.Position, 1.0f);
+				viewLights[i] = glm::vec4(position.x, position.y, position.z, light.Range);
+				lightData[i * 2] = glm::vec4(light.Position, light.Range);
+				float shadowSlot = shadows != nullptr ? (float)(shadows->GetSlot(i) + 1) : 0.0f;
+				lightData[i * 2 + 1] = glm::vec4(light.Color * light.Intensity, shadowSlot);
+			}
+
+			// slices only write their own clusters and keep the light order, so the lists are the
+			// same however the slices land on the threads
+			Util::Parallel::For(CLUSTERS_Z, [this](unsigned int slice) {
+				CullSlice(slice);
+			});
+
+			stats.Lights = lightCount;
+			stats.ClusterLightReferences = 0;
+			stats.MaxClusterLights = 0;
+			clusterData.resize(CLUSTER_COUNT * 2);
+			for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+			{
+				const std::vector<unsigned int>& list = clusterLights[cluster];
+				clusterData[cluster * 2] = (unsigned int)clusterData.size();
+				clusterData[cluster * 2 + 1] = (unsigned int)list.size();
+				clusterData.insert(clusterData.end(), list.begin(), list.end());
+				stats.ClusterLightReferences += (unsigned int)list.size();
+				if (list.size() > stats.MaxClusterLights)
+					stats.MaxClusterLights = (unsigned int)list.size();
+			}
+
+			GLResources::StreamBuffer(lightBuffer, lightData.size() * sizeof(glm::vec4), lightData.data());
+			GLResources::StreamBuffer(clusterBuffer, clusterData.size() * sizeof(unsigned int), clusterData.data());
+			block.ClusterCounts[3] = lightCount;
+			GLResources::UpdateBuffer(blockBuffer, 0, sizeof(ClusterBlock), &block);
+
+			stats.BuildMilliseconds = (Util::Timer::GetTime() - buildStart) * 1000.0;
+		}
+
+		void LightGrid::Bind() const
+		{
+			GLState::BindTexture(LIGHT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, lightTexture);
+			GLState::BindTexture(CLUSTER_TEXTURE_UNIT, GL_TEXTURE_BUFFER, clusterTexture);
+			glBindBufferBase(GL_UNIFORM_BUFFER, CLUSTER_BLOCK_BINDING, blockBuffer);
+		}
+
+		// Each cluster is bounded by the box around its tile's four corner rays cut at the slice's
+		// near and far depth. The boxes overlap their neighbours a little, which only costs a few
+		// extra list entries.
+		void LightGrid::BuildClusterBounds(const glm::mat4& projection)
+		{
+			clusterProjection = projection;
+			nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+			farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+
+			// slice k starts at near * (far / near)^(k / CLUSTERS_Z)
+			float depthRatio = std::log(farPlane / nearPlane);
+			for (unsigned int slice = 0; slice <= CLUSTERS_Z; slice++)
+				sliceDepths[slice] = nearPlane * std::exp(depthRatio * slice / CLUSTERS_Z);
+			block.ClusterScale = glm::vec4((float)CLUSTERS_X / width, (float)CLUSTERS_Y / height,
+				CLUSTERS_Z / depthRatio, CLUSTERS_Z * std::log(nearPlane) / depthRatio);
+
+			glm::mat4 inverseProjection = glm::inverse(projection);
+			for (unsigned int z = 0; z < CLUSTERS_Z; z++)
+			{
+				for (unsigned int y = 0; y < CLUSTERS_Y; y++)
+				{
+					for (unsigned int x = 0; x < CLUSTERS_X; x++)
+					{
+						Bounds bounds;
+						bounds.Min = glm::vec3(FLT_MAX);
+						bounds.Max = glm::vec3(-FLT_MAX);
+						for (unsigned int corner = 0; corner < 4; corner++)
+						{
+							float ndcX = 2.0f * (x + (corner & 1)) / CLUSTERS_X - 1.0f;
+							float ndcY = 2.0f * (y + (corner >> 1)) / CLUSTERS_Y - 1.0f;
+							glm::vec4 nearPoint = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+							glm::vec3 ray = glm::vec3(nearPoint) / nearPoint.w;
+							for (unsigned int end = 0; end < 2; end++)
+							{
+								glm::vec3 point = ray * (sliceDepths[z + end] / -ray.z);
+								bounds.Min = glm::min(bounds.Min, point);
+								bounds.Max = glm::max(bounds.Max, point);
+							}
+						}
+						clusterBounds[(z * CLUSTERS_Y + y) * CLUSTERS_X + x] = bounds;
+					}
+				}
+			}
+		}
+
+		void LightGrid::CullSlice(unsigned int slice)
+		{
+			SliceLights& candidates = sliceLights[slice];
+			candidates.X.clear();
+			candidates.Y.clear();
+			candidates.Z.clear();
+			candidates.RadiusSquared.clear();
+			candidates.Lights.clear();
+
+			float sliceNear = sliceDepths[slice];
+			float sliceFar = sliceDepths[slice + 1];
+			for (unsigned int i = 0; i < viewLights.size(); i++)
+			{
+				const glm::vec4& light = viewLights[i];
+				if (-light.z + light.w < sliceNear || -light.z - light.w > sliceFar)
+					continue;
+				candidates.X.push_back(light.x);
+				candidates.Y.push_back(light.y);
+				candidates.Z.push_back(light.z);
+				candidates.RadiusSquared.push_back(light.w * light.w);
+				candidates.Lights.push_back(i);
+			}
+			// padding lanes have a negative squared radius, which no distance passes
+			while (candidates.X.size() % 4 != 0)
+			{
+				candidates.X.push_back(0.0f);
+				candidates.Y.push_back(0.0f);
+				candidates.Z.push_back(0.0f);
+				candidates.RadiusSquared.push_back(-1.0f);
+				candidates.Lights.push_back(0);
+			}
+
+			const __m128 zero = _mm_setzero_ps();
+			unsigned int candidateCount = (unsigned int)candidates.X.size();
+			for (unsigned int cluster = slice * CLUSTERS_X * CLUSTERS_Y; cluster < (slice + 1) * CLUSTERS_X * CLUSTERS_Y; cluster++)
+			{
+				std::vector<unsigned int>& list = clusterLights[cluster];
+				list.clear();
+
+				// squared distance from each sphere centre to the box, zero inside it
+				const Bounds& bounds = clusterBounds[cluster];
+				const __m128 minX = _mm_set1_ps(bounds.Min.x), minY = _mm_set1_ps(bounds.Min.y), minZ = _mm_set1_ps(bounds.Min.z);
+				const __m128 maxX = _mm_set1_ps(bounds.Max.x), maxY = _mm_set1_ps(bounds.Max.y), maxZ = _mm_set1_ps(bounds.Max.z);
+				for (unsigned int first = 0; first < candidateCount; first += 4)
+				{
+					__m128 x = _mm_loadu_ps(&candidates.X[first]);
+					__m128 y = _mm_loadu_ps(&candidates.Y[first]);
+					__m128 z = _mm_loadu_ps(&candidates.Z[first]);
+					__m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minX, x), zero), _mm_max_ps(_mm_sub_ps(x, maxX), zero));
+					__m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minY, y), zero), _mm_max_ps(_mm_sub_ps(y, maxY), zero));
+					__m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minZ, z), zero), _mm_max_ps(_mm_sub_ps(z, maxZ), zero));
+					__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					int lanes = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_loadu_ps(&candidates.RadiusSquared[first])));
+					for (unsigned int lane = 0; lane < 4; lane++)
+					{
+						if (lanes & (1 << lane))
+							list.push_back(candidates.Lights[first + lane]);
+					}
+				}
+			}
+		}
+
+		const LightGrid::Stats& LightGrid::GetStats() const
+		{
+			return stats;
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Light.h"
+#include "Shader.h"
+#include "UniformBlocks.h"
+
+namespace glh {
+	namespace Graphics {
+		class PointShadowAtlas;
+
+		// Clustered forward light culling (Olsson, Billeter and Assarsson, "Clustered Deferred and
+		// Forward Shading"). The view frustum is cut into CLUSTERS_X x CLUSTERS_Y screen tiles and
+		// CLUSTERS_Z depth slices that grow exponentially with distance. Every frame each point
+		// light's range sphere is tested against the clusters' view space bounds, and each cluster
+		// gets the list of lights that reach into it. A forward shader then looks up its fragment's
+		// cluster and loops over that list alone, so the cost per pixel follows how many lights
+		// overlap it rather than how many are in the scene.
+		//
+		// Depth slices are spread over worker threads. Each slice first gathers the lights
+		// overlapping its depth range, then tests them four at a time with SSE against every
+		// cluster of the slice.
+		//
+		// GL 3.3 has no storage buffers, so the shaders read the lists from buffer textures:
+		//
+		// uniform samplerBuffer clusterLights;   // two texels per light: position and range, colour * intensity and shadow slot + 1
+		// uniform usamplerBuffer clusterItems;   // an offset and count per cluster, then the light lists
+		//
+		// and the grid's shape from the ClusterBlock. Programs using it are set up with SetupProgram.
+		class LightGrid
+		{
+		public:
+			static const unsigned int CLUSTERS_X = 16;
+			static const unsigned int CLUSTERS_Y = 9;
+			static const unsigned int CLUSTERS_Z = 24;
+			static const unsigned int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+			// lights past this are dropped with a warning
+			static const unsigned int MAX_LIGHTS = 4096;
+
+			// past every other fixed unit, the deferred renderer's tile buffer ends at 12 and the probe grid takes 18
+			static const unsigned int LIGHT_TEXTURE_UNIT = 19;
+			static const unsigned int CLUSTER_TEXTURE_UNIT = 20;
+
+			struct Stats
+			{
+				unsigned int Lights = 0;
+				// sum of the cluster list lengths
+				unsigned int ClusterLightReferences = 0;
+				unsigned int MaxClusterLights = 0;
+				double BuildMilliseconds = 0.0;
+			};
+
+			LightGrid(unsigned int width, unsigned int height);
+
+			// points the program's clusterLights and clusterItems samplers at the grid's units
+			void SetupProgram(Shader* program) const;
+
+			// rebuilds the cluster lists for this frame's lights and camera and uploads them, with each
+			// light's slot in shadows when it has one
+			void Update(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+				const PointShadowAtlas* shadows = nullptr);
+			// binds the lists and the ClusterBlock for the shaders that follow
+			void Bind() const;
+
+			const Stats& GetStats() const;
+
+		private:
+			struct Bounds
+			{
+				glm::vec3 Min;
+				glm::vec3 Max;
+			};
+
+			// the lights overlapping one depth slice, in view space and padded to a multiple of four
+			struct SliceLights
+			{
+				std::vector<float> X;
+				std::vector<float> Y;
+				std::vector<float> Z;
+				std::vector<float> RadiusSquared;
+				std::vector<unsigned int> Lights;
+			};
+
+			// cluster bounds only change with the projection
+			void BuildClusterBounds(const glm::mat4& projection);
+			void CullSlice(unsigned int slice);
+
+			unsigned int width;
+			unsigned int height;
+			glm::mat4 clusterProjection;
+			float nearPlane = 0.0f;
+			float farPlane = 0.0f;
+			std::vector<Bounds> clusterBounds;
+			std::vector<float> sliceDepths;
+
+			// this frame's lights in view space, position and range
+			std::vector<glm::vec4> viewLights;
+			std::vector<SliceLights> sliceLights;
+			std::vector<std::vector<unsigned int>> clusterLights;
+
+			// two texels per light, see the class comment
+			std::vector<glm::vec4> lightData;
+			// an offset and count per cluster followed by all cluster lists
+			std::vector<unsigned int> clusterData;
+
+			unsigned int lightBuffer = 0;
+			unsigned int lightTexture = 0;
+			unsigned int clusterBuffer = 0;
+			unsigned int clusterTexture = 0;
+			unsigned int blockBuffer = 0;
+			ClusterBlock block;
+
+			Stats stats;
+		};
+	}
+}
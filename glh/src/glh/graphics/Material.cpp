@@ -0,0 +1,283 @@
+#include "Material.h"
+
+#include <glad/glad.h>
+
+#include "../util/Log.h"
+#include "UniformBlocks.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// the smallest GL_MAX_UNIFORM_BLOCK_SIZE an implementation may have
+		static const unsigned int MAX_BLOCK_SIZE = 16384;
+
+		unsigned int MaterialSchema::GetSize(ParameterType type)
+		{
+			switch (type)
+			{
+			case VEC2_PARAMETER:
+				return 8;
+			case VEC3_PARAMETER:
+				return 12;
+			case VEC4_PARAMETER:
+				return 16;
+			default:
+				return 4;
+			}
+		}
+
+		int MaterialSchema::AddParameter(const std::string& name, ParameterType type, const void* defaultValue)
+		{
+			if (Find(name) >= 0)
+			{
+				Util::Log::WriteError("MATERIAL: parameter " + name + " is declared twice");
+				return -1;
+			}
+
+			// std140: scalars align to 4 bytes, vec2 to 8, vec3 and vec4 to 16
+			unsigned int parameterSize = GetSize(type);
+			unsigned int alignment = parameterSize == 12 ? 16 : parameterSize;
+			unsigned int offset = (size + alignment - 1) / alignment * alignment;
+			if ((offset + parameterSize + 15) / 16 * 16 * MaterialTable::MAX_MATERIALS > MAX_BLOCK_SIZE)
+			{
+				Util::Log::WriteError("MATERIAL: parameter " + name + " doesn't fit in the parameter block");
+				return -1;
+			}
+
+			Parameter parameter;
+			parameter.Name = name;
+			parameter.Type = type;
+			parameter.Offset = offset;
+			parameters.push_back(parameter);
+
+			size = offset + parameterSize;
+			defaults.resize(GetStride(), 0);
+			memcpy(&defaults[offset], defaultValue, parameterSize);
+			return (int)parameters.size() - 1;
+		}
+
+		int MaterialSchema::Find(const std::string& name) const
+		{
+			for (unsigned int i = 0; i < parameters.size(); i++)
+			{
+				if (parameters[i].Name == name)
+					return (int)i;
+			}
+			return -1;
+		}
+
+		const MaterialSchema::Parameter& MaterialSchema::GetParameter(int index) const
+		{
+			return parameters[index];
+		}
+
+		unsigned int MaterialSchema::GetParameterCount() const
+		{
+			return (unsigned int)parameters.size();
+		}
+
+		unsigned int MaterialSchema::GetStride() const
+		{
+			return (size + 15) / 16 * 16;
+		}
+
+		const std::vector<unsigned char>& MaterialSchema::GetDefaults() const
+		{
+			return defaults;
+		}
+
+		std::string MaterialSchema::GetDeclaration() const
+		{
+			static const char* const GLSL_TYPES[] = { "float", "int", "vec2", "vec3", "vec4" };
+
+			// std140 places the members exactly where AddParameter did
+			std::string declaration = "struct MaterialParameters\n{\n";
+			for (const Parameter& parameter : parameters)
+				declaration += "    " + std::string(GLSL_TYPES[parameter.Type]) + " " + parameter.Name + ";\n";
+			if (parameters.empty())
+				declaration += "    float unused;\n";
+			declaration += "};\n\n";
+			declaration += "layout (std140) uniform MaterialParameterBlock\n{\n";
+			declaration += "    MaterialParameters materials[" + std::to_string(MaterialTable::MAX_MATERIALS) + "];\n};\n\n";
+			declaration += "uniform int materialIndex;\n";
+			return declaration;
+		}
+
+		const char* const Material::SAMPLER_NAMES[TEXTURE_SLOT_COUNT] = {
+			"albedoMap", "normalMap", "ormMap", "reliefMap"
+		};
+
+		Material::Material(const MaterialSchema* materialSchema) : schema(materialSchema), parameters(materialSchema->GetDefaults())
+		{
+		}
+
+		int Material::FindParameter(const std::string& name, MaterialSchema::ParameterType type) const
+		{
+			int index = schema->Find(name);
+			if (index < 0)
+			{
+				Util::Log::WriteError("MATERIAL: no parameter named " + name);
+				return -1;
+			}
+			if (schema->GetParameter(index).Type != type)
+			{
+				Util::Log::WriteError("MATERIAL: parameter " + name + " is used with the wrong type");
+				return -1;
+			}
+			return index;
+		}
+
+		void Material::SetTexture(TextureSlot slot, unsigned int texture)
+		{
+			textures[slot] = texture;
+		}
+
+		unsigned int Material::GetTexture(unsigned int slot) const
+		{
+			return textures[slot];
+		}
+
+		uint32_t Material::GetPermutationKey() const
+		{
+			uint32_t key = 0;
+			for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+			{
+				if (textures[slot] != 0)
+					key |= 1u << slot;
+			}
+			return key;
+		}
+
+		const MaterialSchema* Material::GetSchema() const
+		{
+			return schema;
+		}
+
+		const unsigned char* Material::GetParameterData() const
+		{
+			return parameters.empty() ? nullptr : &parameters[0];
+		}
+
+		MaterialTable::MaterialTable(const MaterialSchema* materialSchema) : schema(materialSchema)
+		{
+			materials.push_back(Material(schema));
+		}
+
+		uint16_t MaterialTable::Add(const Material& material)
+		{
+			if (material.GetSchema() != schema)
+			{
+				Util::Log::WriteError("MATERIALTABLE: material has a different schema");
+				return 0;
+			}
+			if (materials.size() >= MAX_MATERIALS)
+			{
+				Util::Log::WriteError("MATERIALTABLE: too many materials");
+				return 0;
+			}
+			if (inPass)
+			{
+				Util::Log::WriteError("MATERIALTABLE: materials can't be added during a pass");
+				return 0;
+			}
+
+			materials.push_back(material);
+			dirty = true;
+			return (uint16_t)(materials.size() - 1);
+		}
+
+		bool MaterialTable::Update(uint16_t id, const Material& material)
+		{
+			if (id >= materials.size() || material.GetSchema() != schema)
+				return false;
+			if (inPass)
+			{
+				Util::Log::WriteError("MATERIALTABLE: material " + std::to_string(id) + " changed during a pass");
+				return false;
+			}
+
+			materials[id] = material;
+			dirty = true;
+			return true;
+		}
+
+		const Material& MaterialTable::Get(uint16_t id) const
+		{
+			return materials[id < materials.size() ? id : 0];
+		}
+
+		unsigned int MaterialTable::GetCount() const
+		{
+			return (unsigned int)materials.size();
+		}
+
+		void MaterialTable::SetProgram(uint32_t permutation, Shader* program)
+		{
+			program->use();
+			for (unsigned int slot = 0; slot < Material::TEXTURE_SLOT_COUNT; slot++)
+				program->Set(program->GetUniform<int>(Material::SAMPLER_NAMES[slot]), (int)slot);
+
+			for (PermutationProgram& entry : programs)
+			{
+				if (entry.Permutation == permutation)
+				{
+					entry.Program = program;
+					return;
+				}
+			}
+			programs.push_back({ permutation, program });
+		}
+
+		Shader* MaterialTable::GetProgram(uint16_t id) const
+		{
+			uint32_t key = Get(id).GetPermutationKey();
+			Shader* best = nullptr;
+			int bestBits = -1;
+			for (const PermutationProgram& entry : programs)
+			{
+				if ((entry.Permutation & key) != entry.Permutation)
+					continue;
+
+				int bits = 0;
+				for (uint32_t permutation = entry.Permutation; permutation != 0; permutation &= permutation - 1)
+					bits++;
+				if (bits > bestBits)
+				{
+					best = entry.Program;
+					bestBits = bits;
+				}
+			}
+			return best;
+		}
+
+		void MaterialTable::BeginPass()
+		{
+			unsigned int stride = schema->GetStride();
+			if (buffer == 0)
+			{
+				glGenBuffers(1, &buffer);
+				glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+				glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * (stride > 0 ? stride : 16), nullptr, GL_STATIC_DRAW);
+			}
+			if (dirty && stride > 0)
+			{
+				std::vector<unsigned char> data(materials.size() * stride);
+				for (unsigned int i = 0; i < materials.size(); i++)
+					memcpy(&data[i * stride], materials[i].GetParameterData(), stride);
+
+				glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+				glBufferSubData(GL_UNIFORM_BUFFER, 0, data.size(), &data[0]);
+			}
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			dirty = false;
+
+			glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_PARAMETER_BLOCK_BINDING, buffer);
+			inPass = true;
+		}
+
+		void MaterialTable::EndPass()
+		{
+			inPass = false;
+		}
+	}
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// The parameters every material of a family has, laid out with std140 rules so the whole
+		// table can be uploaded as one array of structs. GetDeclaration writes the matching GLSL,
+		//
+		// struct MaterialParameters { float heightScale; int coneSteps; int binarySteps; };
+		// layout (std140) uniform MaterialParameterBlock { MaterialParameters materials[256]; };
+		// uniform int materialIndex;
+		//
+		// for the shaders to include, so they can't drift from the schema.
+		class MaterialSchema
+		{
+		public:
+			enum ParameterType
+			{
+				FLOAT_PARAMETER,
+				INT_PARAMETER,
+				VEC2_PARAMETER,
+				VEC3_PARAMETER,
+				VEC4_PARAMETER
+			};
+
+			struct Parameter
+			{
+				std::string Name;
+				ParameterType Type;
+				unsigned int Offset;
+			};
+
+			// appends a parameter, its value in new materials is defaultValue
+			template <typename T>
+			int Add(const std::string& name, const T& defaultValue);
+
+			int Find(const std::string& name) const;
+			const Parameter& GetParameter(int index) const;
+			unsigned int GetParameterCount() const;
+			// size of one material's parameters, rounded up to 16 bytes like a std140 array element
+			unsigned int GetStride() const;
+			const std::vector<unsigned char>& GetDefaults() const;
+			// GLSL declaring the parameters, their block and materialIndex, see Shader::SetIncludeSource
+			std::string GetDeclaration() const;
+
+			static unsigned int GetSize(ParameterType type);
+
+		private:
+			int AddParameter(const std::string& name, ParameterType type, const void* defaultValue);
+
+			std::vector<Parameter> parameters;
+			std::vector<unsigned char> defaults;
+			unsigned int size = 0;
+		};
+
+		template <typename T> struct MaterialParameterTraits;
+		template <> struct MaterialParameterTraits<float> { static const MaterialSchema::ParameterType Type = MaterialSchema::FLOAT_PARAMETER; };
+		template <> struct MaterialParameterTraits<int> { static const MaterialSchema::ParameterType Type = MaterialSchema::INT_PARAMETER; };
+		template <> struct MaterialParameterTraits<glm::vec2> { static const MaterialSchema::ParameterType Type = MaterialSchema::VEC2_PARAMETER; };
+		template <> struct MaterialParameterTraits<glm::vec3> { static const MaterialSchema::ParameterType Type = MaterialSchema::VEC3_PARAMETER; };
+		template <> struct MaterialParameterTraits<glm::vec4> { static const MaterialSchema::ParameterType Type = MaterialSchema::VEC4_PARAMETER; };
+
+		template <typename T>
+		int MaterialSchema::Add(const std::string& name, const T& defaultValue)
+		{
+			return AddParameter(name, MaterialParameterTraits<T>::Type, &defaultValue);
+		}
+
+		// Textures and parameter values of one material. The permutation key has a bit per bound
+		// texture slot and picks the program variant that draws the material.
+		class Material
+		{
+		public:
+			// texture slot n is bound to texture unit n
+			enum TextureSlot
+			{
+				ALBEDO_SLOT,
+				NORMAL_SLOT,
+				ORM_SLOT,
+				RELIEF_SLOT,
+				TEXTURE_SLOT_COUNT
+			};
+
+			// the sampler each slot is bound to in the material programs
+			static const char* const SAMPLER_NAMES[TEXTURE_SLOT_COUNT];
+
+			Material(const MaterialSchema* schema);
+
+			template <typename T>
+			bool Set(const std::string& name, const T& value);
+			template <typename T>
+			T Get(const std::string& name) const;
+
+			// 0 leaves the texture unit untouched
+			void SetTexture(TextureSlot slot, unsigned int texture);
+			unsigned int GetTexture(unsigned int slot) const;
+
+			uint32_t GetPermutationKey() const;
+			const MaterialSchema* GetSchema() const;
+			const unsigned char* GetParameterData() const;
+
+		private:
+			int FindParameter(const std::string& name, MaterialSchema::ParameterType type) const;
+
+			const MaterialSchema* schema;
+			std::vector<unsigned char> parameters;
+			unsigned int textures[TEXTURE_SLOT_COUNT] = {};
+		};
+
+		template <typename T>
+		bool Material::Set(const std::string& name, const T& value)
+		{
+			int index = FindParameter(name, MaterialParameterTraits<T>::Type);
+			if (index < 0)
+				return false;
+			memcpy(&parameters[schema->GetParameter(index).Offset], &value, sizeof(T));
+			return true;
+		}
+
+		template <typename T>
+		T Material::Get(const std::string& name) const
+		{
+			T value = T();
+			int index = FindParameter(name, MaterialParameterTraits<T>::Type);
+			if (index >= 0)
+				memcpy(&value, &parameters[schema->GetParameter(index).Offset], sizeof(T));
+			return value;
+		}
+
+		// All materials of one schema, their parameters kept in a single uniform buffer indexed by
+		// material ID so switching materials only changes the materialIndex uniform. Materials can't
+		// change while a pass is drawing with them, edits in between are uploaded by the next BeginPass.
+		class MaterialTable
+		{
+		public:
+			static const unsigned int MAX_MATERIALS = 256;
+
+			// material 0 is the schema defaults with no textures
+			MaterialTable(const MaterialSchema* schema);
+
+			uint16_t Add(const Material& material);
+			bool Update(uint16_t id, const Material& material);
+			const Material& Get(uint16_t id) const;
+			unsigned int GetCount() const;
+
+			// draws materials whose permutation key has all the bits of permutation with program,
+			// the most specific match wins. Also points the program's samplers at the texture slots.
+			void SetProgram(uint32_t permutation, Shader* program);
+			Shader* GetProgram(uint16_t id) const;
+
+			// uploads pending edits, binds the parameter block and locks the table until EndPass
+			void BeginPass();
+			void EndPass();
+
+		private:
+			struct PermutationProgram
+			{
+				uint32_t Permutation;
+				Shader* Program;
+			};
+
+			const MaterialSchema* schema;
+			std::vector<Material> materials;
+			std::vector<PermutationProgram> programs;
+
+			unsigned int buffer = 0;
+			bool dirty = true;
+			bool inPass = false;
+		};
+	}
+}
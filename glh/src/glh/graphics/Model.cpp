@@ -7,15 +7,30 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <future>
+
 #include "../Util/Log.h"
+#include "GLResources.h"
+#include "GLState.h"
+#include "InstanceBatch.h"
+#include "TexturePacker.h"
 namespace glh {
 	namespace Graphics {
 
+		static_assert(Model::Layout::Describes<Model::Vertex>(), "the model vertex layout doesn't match Vertex");
+		static_assert(Model::Layout::Offset(1) == offsetof(Model::Vertex, Normal), "vertex normals are misplaced");
+		static_assert(Model::Layout::Offset(2) == offsetof(Model::Vertex, TexCoords), "vertex texture coordinates are misplaced");
+		static_assert(Model::Layout::Offset(3) == offsetof(Model::Vertex, Tangent), "vertex tangents are misplaced");
+		static_assert(Model::Layout::Offset(4) == offsetof(Model::Vertex, Bitangent), "vertex bitangents are misplaced");
 
 		Model::Model(std::string const &path, std::string textureFormat, bool gamma) : gammaCorrection(gamma), texFormat(textureFormat)
 		{
 			LoadModel(path);
+
+			// the BVH only needs the CPU side data, so build it on a worker while the mesh is uploaded
+			std::future<void> bvhBuild = std::async(std::launch::async, &Model::BuildBVH, this);
 			SetupMesh();
+			bvhBuild.wait();
 		}
 
 		unsigned int Model::getVAO() {
@@ -66,17 +81,137 @@ namespace glh {
 
 		void Model::Draw(Shader* shader)
 		{
-			shader->setMat4("model", modelMatrix);
+			if (instanceBatch != nullptr)
+			{
+				instanceBatch->Collect(modelMatrix);
+				return;
+			}
+
+			SetModelUniform(shader, &drawUniform);
 
 			BindTextures();
 
-			// draw mesh
-			glBindVertexArray(VAO);
+			// draw mesh, the VAO stays bound so drawing the same model again skips the bind
+			GLState::BindVertexArray(VAO);
+			glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		}
+
+		void Model::SetInstanceBatch(InstanceBatch* batch) {
+			instanceBatch = batch;
+		}
+
+		unsigned int Model::CreateVertexArray() {
+			unsigned int vertexArray = GLResources::CreateVertexArray();
+			Layout::Apply(vertexArray);
+			Layout::SetVertexBuffer(vertexArray, 0, VBO);
+			GLResources::SetElementBuffer(vertexArray, EBO);
+			return vertexArray;
+		}
+
+		const std::vector<Model::Vertex>& Model::GetVertices() const {
+			return vertices;
+		}
+
+		const TriangleBVH& Model::GetBVH() const {
+			return bvh;
+		}
+
+		void Model::BuildBVH() {
+			std::vector<glm::vec3> positions(vertices.size());
+			for (unsigned int i = 0; i < vertices.size(); i++)
+				positions[i] = vertices[i].Position;
+
+			bvh.Build(positions, indices);
+		}
+
+		void Model::Submit(RenderQueue* queue, Shader* shader, uint16_t material, float depth)
+		{
+			DrawCommand command;
+			command.Program = shader;
+			command.Material = material;
+			command.VAO = VAO;
+			command.DepthVAO = depthVAO;
+			command.Count = (unsigned int)indices.size();
+			command.Model = modelMatrix;
+			command.Depth = depth;
+			queue->Submit(command);
+		}
+
+		void Model::CreateDepthStream(bool texCoords)
+		{
+			if (depthVAO != 0)
+				return;
+
+			std::vector<glm::vec3> positions(vertices.size());
+			for (unsigned int i = 0; i < vertices.size(); i++)
+				positions[i] = vertices[i].Position;
+			positionVBO = GLResources::CreateBuffer(positions.size() * sizeof(glm::vec3), &positions[0]);
+
+			depthVAO = GLResources::CreateVertexArray();
+			if (texCoords)
+			{
+				std::vector<glm::vec2> coordinates(vertices.size());
+				for (unsigned int i = 0; i < vertices.size(); i++)
+					coordinates[i] = vertices[i].TexCoords;
+				texCoordVBO = GLResources::CreateBuffer(coordinates.size() * sizeof(glm::vec2), &coordinates[0]);
+
+				DepthTexturedLayout::Apply(depthVAO);
+				DepthTexturedLayout::SetVertexBuffer(depthVAO, 0, positionVBO);
+				DepthTexturedLayout::SetVertexBuffer(depthVAO, 1, texCoordVBO);
+			}
+			else
+			{
+				DepthLayout::Apply(depthVAO);
+				DepthLayout::SetVertexBuffer(depthVAO, 0, positionVBO);
+			}
+			// the index buffer is shared with the full VAO
+			GLResources::SetElementBuffer(depthVAO, EBO);
+		}
+
+		unsigned int Model::GetDepthVAO() const
+		{
+			return depthVAO != 0 ? depthVAO : VAO;
+		}
+
+		unsigned int Model::GetIndexCount() const
+		{
+			return (unsigned int)indices.size();
+		}
+
+		void Model::DrawDepth(Shader* shader)
+		{
+			SetModelUniform(shader, &depthUniform);
+			GLState::BindVertexArray(GetDepthVAO());
 			glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-			glBindVertexArray(0);
+		}
 
-			// always good practice to set everything back to defaults once configured.
-			glActiveTexture(GL_TEXTURE0);
+		void Model::SetModelUniform(Shader* shader, ModelUniform* cache) const
+		{
+			if (cache->Program != shader->ID)
+			{
+				cache->Program = shader->ID;
+				cache->Model = shader->GetUniform<glm::mat4>("model");
+			}
+			shader->Set(cache->Model, modelMatrix);
+		}
+
+		void Model::SubmitDepth(RenderQueue* queue, Shader* shader, float depth)
+		{
+			DrawCommand command;
+			command.Program = shader;
+			command.VAO = GetDepthVAO();
+			command.Count = (unsigned int)indices.size();
+			command.Model = modelMatrix;
+			command.Depth = depth;
+			queue->Submit(command);
+		}
+
+		Material Model::GetMaterial(const MaterialSchema* schema) const
+		{
+			Material material(schema);
+			for (unsigned int slot = 0; slot < Material::TEXTURE_SLOT_COUNT; slot++)
+				material.SetTexture((Material::TextureSlot)slot, textureMaps[slot]);
+			return material;
 		}
 
 		void Model::BindTextures() {
@@ -85,9 +220,7 @@ namespace glh {
 				if (textureMaps[i] == 0) // if we dont have  texture for this spot.
 					continue;
 
-				glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-				glBindTexture(GL_TEXTURE_2D, textureMaps[i]);
-
+				GLState::BindTexture(i, GL_TEXTURE_2D, textureMaps[i]);
 			}
 		}
 
@@ -129,45 +262,19 @@ namespace glh {
 
 		void Model::SetupMesh()
 		{
-			// create buffers/arrays
-			glGenVertexArrays(1, &VAO);
-			glGenBuffers(1, &VBO);
-			glGenBuffers(1, &EBO);
-
-			glBindVertexArray(VAO);
-			// load data into vertex buffers
-			glBindBuffer(GL_ARRAY_BUFFER, VBO);
 			// A great thing about structs is that their memory layout is sequential for all its items.
 			// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
 			// again translates to 3/2 floats which translates to a byte array.
-			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-			// set the vertex attribute pointers
-			// vertex Positions
-			glEnableVertexAttribArray(0);
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-			// vertex normals
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-			// vertex texture coords
-			glEnableVertexAttribArray(2);
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-			// vertex tangent
-			glEnableVertexAttribArray(3);
-			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-			// vertex bitangent
-			glEnableVertexAttribArray(4);
-			glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-			glBindVertexArray(0);
-
+			VBO = GLResources::CreateBuffer(vertices.size() * sizeof(Vertex), &vertices[0]);
+			EBO = GLResources::CreateBuffer(indices.size() * sizeof(unsigned int), &indices[0]);
+			VAO = CreateVertexArray();
 		}
 
 		void Model::ProcessMesh(aiMesh *mesh, const aiScene *scene)
 		{
+			// all meshes share one vertex array, so this mesh's indices are offset by the vertices already loaded
+			unsigned int baseVertex = (unsigned int)vertices.size();
+
 			// Walk through each of the mesh's vertices
 			for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 			{
@@ -213,7 +320,7 @@ namespace glh {
 				aiFace face = mesh->mFaces[i];
 				// retrieve all indices of the face and store them in the indices vector
 				for (unsigned int j = 0; j < face.mNumIndices; j++)
-					indices.push_back(face.mIndices[j]);
+					indices.push_back(baseVertex + face.mIndices[j]);
 			}
 		}
 
@@ -225,14 +332,9 @@ namespace glh {
 				textureMaps[0] = TextureFromFile("albedo", texFormat, gammaCorrection);
 			if (textureFlags & NORMAL)
 				textureMaps[1] = TextureFromFile("normal", texFormat, gammaCorrection);
-			if (textureFlags & ROUGHNESS)
-				textureMaps[2] = TextureFromFile("roughness", texFormat, gammaCorrection);
-			if (textureFlags & METALLIC)
-				textureMaps[3] = TextureFromFile("metallic", texFormat, gammaCorrection);
-			if (textureFlags & DEPTH)
-				textureMaps[4] = TextureFromFile("depth", texFormat, gammaCorrection);
-			if (textureFlags & AMBIENTOCCLUSION)
-				textureMaps[5] = TextureFromFile("ao", texFormat, gammaCorrection);
+			// the single channel maps are packed into one ORM texture, with the height in alpha when depth is asked for
+			if (textureFlags & (ROUGHNESS | METALLIC | DEPTH | AMBIENTOCCLUSION))
+				textureMaps[2] = TexturePacker::LoadORM(directory, texFormat, (textureFlags & DEPTH) != 0);
 		}
 
 		unsigned int Model::TextureFromFile(const char *name, std::string format, bool gamma)
@@ -255,7 +357,7 @@ namespace glh {
 				else if (nrComponents == 4)
 					format = GL_RGBA;
 
-				glBindTexture(GL_TEXTURE_2D, textureID);
+				GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
 				glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 				glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -7,11 +7,16 @@
 #include <glm/glm.hpp>
 
 #include "Shader.h"
+#include "BVH.h"
+#include "RenderQueue.h"
+#include "VertexLayout.h"
 
 #include <array>
 
 namespace glh {
 	namespace Graphics {
+		class InstanceBatch;
+
 		class Model
 		{
 		public:
@@ -25,7 +30,29 @@ namespace glh {
 
 			// setup
 			void LoadTextures(int textureFlags);
+			// draws the model, or only collects its current transform while it's attached to an instance batch
 			void Draw(Shader* shader);
+			void SetInstanceBatch(InstanceBatch* batch);
+			// a new VAO over this model's vertex and index buffers with the mesh attributes in slots 0-4,
+			// for users that add attributes of their own
+			unsigned int CreateVertexArray();
+			// queues the draw instead of issuing it, depth is the distance from the camera
+			void Submit(RenderQueue* queue, Shader* shader, uint16_t material, float depth);
+
+			// keeps tightly packed copies of the positions (and texture coordinates) next to the full
+			// vertex buffer, with a VAO over just those for depth, shadow and occlusion passes
+			void CreateDepthStream(bool texCoords = false);
+			// the depth-only VAO, or the full one when the model has no depth stream
+			unsigned int GetDepthVAO() const;
+			unsigned int GetIndexCount() const;
+			// draws or queues the mesh through the depth-only VAO without binding textures
+			void DrawDepth(Shader* shader);
+			void SubmitDepth(RenderQueue* queue, Shader* shader, float depth);
+			// a material of the given schema with this model's textures
+			Material GetMaterial(const MaterialSchema* schema) const;
+
+			// triangle BVH over the mesh in model space, built at load time
+			const TriangleBVH& GetBVH() const;
 
 			enum {
 				ALBEDO = 1 << 0,
@@ -35,6 +62,33 @@ namespace glh {
 				DEPTH = 1 << 4,
 				AMBIENTOCCLUSION = 1 << 5
 			};
+			struct Vertex {
+				// position
+				glm::vec3 Position;
+				// normal
+				glm::vec3 Normal;
+				// texCoords
+				glm::vec2 TexCoords;
+				// tangent
+				glm::vec3 Tangent;
+				// bitangent
+				glm::vec3 Bitangent;
+			};
+			// Vertex as the mesh attributes in slots 0-4, read from binding 0
+			typedef VertexLayout<
+				VertexAttribute<0, glm::vec3>,
+				VertexAttribute<1, glm::vec3>,
+				VertexAttribute<2, glm::vec2>,
+				VertexAttribute<3, glm::vec3>,
+				VertexAttribute<4, glm::vec3>> Layout;
+			// positions alone, and positions with texture coordinates in a second stream for alpha
+			// tested materials, at the same locations as in Layout
+			typedef VertexLayout<VertexAttribute<0, glm::vec3>> DepthLayout;
+			typedef VertexLayout<VertexAttribute<0, glm::vec3>, VertexAttribute<2, glm::vec2, 1>> DepthTexturedLayout;
+
+			const std::vector<Vertex>& GetVertices() const;
+
+			// by texture unit: albedo, normal, ORM (see TexturePacker)
 			unsigned int textureMaps[6] = { 0, 0, 0, 0, 0, 0 };
 			std::vector<unsigned int> indices;
 
@@ -44,8 +98,17 @@ namespace glh {
 			void ProcessNode(aiNode *node, const aiScene *scene);
 			void ProcessMesh(aiMesh *mesh, const aiScene *scene);
 			void SetupMesh();
+			void BuildBVH();
 			unsigned int TextureFromFile(const char *name, std::string format, bool gamma = false);
 
+			// the model uniform of the program a draw path last used, resolved again only when the program changes
+			struct ModelUniform
+			{
+				unsigned int Program = 0;
+				Uniform<glm::mat4> Model;
+			};
+			void SetModelUniform(Shader* shader, ModelUniform* cache) const;
+
 			// Model physical attributes
 			glm::vec3 position;
 			glm::vec3 rotation;
@@ -59,22 +122,19 @@ namespace glh {
 
 			//  Mesh Data  
 			unsigned int VAO, VBO, EBO;
-
-			struct Vertex {
-				// position
-				glm::vec3 Position;
-				// normal
-				glm::vec3 Normal;
-				// texCoords
-				glm::vec2 TexCoords;
-				// tangent
-				glm::vec3 Tangent;
-				// bitangent
-				glm::vec3 Bitangent;
-			};
+			unsigned int depthVAO = 0;
+			unsigned int positionVBO = 0;
+			unsigned int texCoordVBO = 0;
 
 			std::vector<Vertex> vertices;
 
+			TriangleBVH bvh;
+			InstanceBatch* instanceBatch = nullptr;
+
+			// Draw and DrawDepth usually alternate between two programs, so each keeps its own
+			ModelUniform drawUniform;
+			ModelUniform depthUniform;
+
 		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,332 @@
+#include "PointShadowAtlas.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include "../util/Parallel.h"
+#include "../util/Timer.h"
+#include "GLResources.h"
+#include "GLState.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// the faces in GL's cube map order, with the up vectors that make a face's screen axes the
+		// s and t axes GL samples that face with
+		static const glm::vec3 FACE_DIRECTIONS[PointShadowAtlas::FACE_COUNT] = {
+			glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+		};
+		static const glm::vec3 FACE_UPS[PointShadowAtlas::FACE_COUNT] = {
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+		};
+		static const float NEAR_PLANE = 0.05f;
+
+		PointShadowAtlas::PointShadowAtlas(unsigned int resolution, unsigned int slotCount) : resolution(resolution)
+		{
+			slots.resize(slotCount);
+
+			depthMap = GLResources::CreateTexture3D(GL_TEXTURE_2D_ARRAY, GL_DEPTH_COMPONENT24, resolution, resolution, slotCount * FACE_COUNT);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, depthMap, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+			depthMapFBO = GLResources::CreateFramebuffer();
+			GLResources::SetDrawBuffer(depthMapFBO, GL_NONE);
+			GLResources::SetReadBuffer(depthMapFBO, GL_NONE);
+
+			depthProgram = Shader("Data/Shaders/pointShadow.vs", "Data/Shaders/pointShadow.fs", "Data/Shaders/pointShadow.gs");
+			model = depthProgram.GetUniform<glm::mat4>("model");
+			firstLayer = depthProgram.GetUniform<int>("firstLayer");
+			faceMask = depthProgram.GetUniform<int>("faceMask");
+			lightPositionRange = depthProgram.GetUniform<glm::vec4>("lightPositionRange");
+			for (unsigned int face = 0; face < FACE_COUNT; face++)
+				faceMatrices.push_back(depthProgram.GetUniform<glm::mat4>("faceMatrices[" + std::to_string(face) + "]"));
+		}
+
+		void PointShadowAtlas::SetupProgram(Shader* program) const
+		{
+			program->use();
+			program->setInt("pointShadowMaps", SHADOW_TEXTURE_UNIT);
+		}
+
+		void PointShadowAtlas::SetUpdateBudget(unsigned int budget)
+		{
+			updateBudget = budget;
+		}
+
+		unsigned int PointShadowAtlas::AddCaster(const ShadowCaster& caster)
+		{
+			casters.push_back(caster);
+			casterBounds.push_back(caster.Bounds.Transform(caster.Model));
+			// a new caster may fall into any cube
+			for (Slot& slot : slots)
+				slot.Dirty = true;
+			return (unsigned int)casters.size() - 1;
+		}
+
+		void PointShadowAtlas::MoveCaster(unsigned int caster, const glm::mat4& model)
+		{
+			casters[caster].Model = model;
+			movedCasters.push_back(caster);
+		}
+
+		void PointShadowAtlas::Update(const std::vector<PointLight>& lights, const glm::vec3& viewPosition)
+		{
+			double cullStart = Util::Timer::GetTime();
+			InvalidateMovedCasters();
+			AssignSlots(lights, viewPosition);
+
+			// the cubes that are due, the most important and longest waiting first
+			std::vector<unsigned int> due;
+			for (unsigned int i = 0; i < slots.size(); i++)
+			{
+				if (slots[i].Light >= 0 && slots[i].Dirty)
+					due.push_back(i);
+			}
+			std::sort(due.begin(), due.end(), [this](unsigned int a, unsigned int b) {
+				float priorityA = slots[a].Importance * (slots[a].Age + 1);
+				float priorityB = slots[b].Importance * (slots[b].Age + 1);
+				return priorityA != priorityB ? priorityA > priorityB : a < b;
+			});
+			if (due.size() > updateBudget)
+			{
+				for (unsigned int i = updateBudget; i < due.size(); i++)
+					slots[due[i]].Age++;
+				due.resize(updateBudget);
+			}
+			stats.PendingLights = 0;
+			for (const Slot& slot : slots)
+			{
+				if (slot.Light >= 0 && slot.Dirty)
+					stats.PendingLights++;
+			}
+			stats.PendingLights -= (unsigned int)due.size();
+			stats.CullMilliseconds = (Util::Timer::GetTime() - cullStart) * 1000.0;
+
+			stats.UpdatedLights = (unsigned int)due.size();
+			stats.CasterDraws = 0;
+			stats.FaceDraws = 0;
+			renderTimer.Begin();
+			if (!due.empty())
+			{
+				unsigned int previousFramebuffer = GLState::GetFramebuffer();
+				GLint viewport[4];
+				glGetIntegerv(GL_VIEWPORT, viewport);
+				glViewport(0, 0, resolution, resolution);
+				// the caller may be in a pass without depth testing or writes, the casters need both
+				bool previousDepthTest = GLState::GetDepthTest();
+				bool previousDepthMask = GLState::GetDepthMask();
+				GLenum previousDepthFunc = GLState::GetDepthFunc();
+				GLState::SetDepthTest(true);
+				GLState::SetDepthMask(true);
+				GLState::SetDepthFunc(GL_LESS);
+				depthProgram.use();
+				for (unsigned int slot : due)
+				{
+					const PointLight& light = lights[slots[slot].Light];
+					slots[slot].Position = light.Position;
+					slots[slot].Range = light.Range;
+					slots[slot].Dirty = false;
+					slots[slot].Drawn = true;
+					slots[slot].Age = 0;
+					DrawSlot(slot);
+				}
+				glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+				GLState::BindFramebuffer(previousFramebuffer);
+				GLState::SetDepthTest(previousDepthTest);
+				GLState::SetDepthMask(previousDepthMask);
+				GLState::SetDepthFunc(previousDepthFunc);
+			}
+			renderTimer.End();
+			stats.RenderMilliseconds = renderTimer.GetMilliseconds();
+		}
+
+		void PointShadowAtlas::Bind() const
+		{
+			GLState::BindTexture(SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, depthMap);
+		}
+
+		int PointShadowAtlas::GetSlot(unsigned int light) const
+		{
+			if (light >= lightSlots.size() || lightSlots[light] < 0)
+				return -1;
+			// a cube still waiting for its first draw would shadow the light with whatever it held before
+			return slots[lightSlots[light]].Drawn ? lightSlots[light] : -1;
+		}
+
+		// Importance is the light's intensity over its squared distance to the camera, taken no
+		// closer than its range. Lights with no caster in range need no cube at all.
+		void PointShadowAtlas::AssignSlots(const std::vector<PointLight>& lights, const glm::vec3& viewPosition)
+		{
+			unsigned int lightCount = (unsigned int)lights.size();
+			importance.resize(lightCount);
+			Util::Parallel::For(lightCount, [&](unsigned int i) {
+				const PointLight& light = lights[i];
+				Slot probe;
+				probe.Position = light.Position;
+				probe.Range = light.Range;
+				importance[i] = 0.0f;
+				for (const AABB& bounds : casterBounds)
+				{
+					if (GetFaceMask(probe, bounds) != 0)
+					{
+						glm::vec3 offset = light.Position - viewPosition;
+						float distanceSquared = glm::dot(offset, offset);
+						if (distanceSquared < light.Range * light.Range)
+							distanceSquared = light.Range * light.Range;
+						importance[i] = light.Intensity * glm::dot(light.Color, glm::vec3(0.2126f, 0.7152f, 0.0722f)) / distanceSquared;
+						break;
+					}
+				}
+			});
+
+			ranked.clear();
+			for (unsigned int i = 0; i < lightCount; i++)
+			{
+				if (importance[i] > 0.0f)
+					ranked.push_back(i);
+			}
+			unsigned int shadowed = (unsigned int)std::min(ranked.size(), slots.size());
+			std::partial_sort(ranked.begin(), ranked.begin() + shadowed, ranked.end(), [this](unsigned int a, unsigned int b) {
+				return importance[a] != importance[b] ? importance[a] > importance[b] : a < b;
+			});
+			ranked.resize(shadowed);
+
+			// lights that stay in the top set keep their slot and cube, the others give theirs up
+			std::vector<int> previous(lightCount, -1);
+			for (unsigned int i = 0; i < slots.size(); i++)
+			{
+				if (slots[i].Light >= 0 && (unsigned int)slots[i].Light < lightCount)
+					previous[slots[i].Light] = i;
+				slots[i].Light = -1;
+			}
+			lightSlots.assign(lightCount, -1);
+			for (unsigned int light : ranked)
+			{
+				if (previous[light] >= 0)
+				{
+					Slot& slot = slots[previous[light]];
+					slot.Light = light;
+					if (lights[light].Position != slot.Position || lights[light].Range != slot.Range)
+						slot.Dirty = true;
+					lightSlots[light] = previous[light];
+				}
+			}
+			unsigned int freeSlot = 0;
+			for (unsigned int light : ranked)
+			{
+				if (lightSlots[light] >= 0)
+					continue;
+				while (slots[freeSlot].Light >= 0)
+					freeSlot++;
+				slots[freeSlot].Light = light;
+				slots[freeSlot].Dirty = true;
+				slots[freeSlot].Drawn = false;
+				slots[freeSlot].Age = 0;
+				lightSlots[light] = freeSlot;
+			}
+			for (unsigned int light : ranked)
+				slots[lightSlots[light]].Importance = importance[light];
+			stats.ShadowedLights = shadowed;
+		}
+
+		// a caster that moved dirties the cubes it was in before and the ones it is in now
+		void PointShadowAtlas::InvalidateMovedCasters()
+		{
+			for (unsigned int caster : movedCasters)
+			{
+				AABB previous = casterBounds[caster];
+				casterBounds[caster] = casters[caster].Bounds.Transform(casters[caster].Model);
+				for (Slot& slot : slots)
+				{
+					if (slot.Light >= 0 && (GetFaceMask(slot, previous) != 0 || GetFaceMask(slot, casterBounds[caster]) != 0))
+						slot.Dirty = true;
+				}
+			}
+			movedCasters.clear();
+		}
+
+		// A face sees the directions whose largest component is along its axis. The box reaches
+		// the +x face if some point in it has x at least as large as its smallest |y| and |z|,
+		// which is conservative but cheap.
+		unsigned int PointShadowAtlas::GetFaceMask(const Slot& slot, const AABB& bounds) const
+		{
+			glm::vec3 low = bounds.Min - slot.Position;
+			glm::vec3 high = bounds.Max - slot.Position;
+
+			glm::vec3 nearest = glm::clamp(glm::vec3(0.0f), low, high);
+			if (glm::dot(nearest, nearest) > slot.Range * slot.Range)
+				return 0;
+
+			glm::vec3 smallest = glm::abs(nearest);
+			unsigned int mask = 0;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float other1 = smallest[(axis + 1) % 3];
+				float other2 = smallest[(axis + 2) % 3];
+				if (high[axis] > 0.0f && high[axis] >= other1 && high[axis] >= other2)
+					mask |= 1 << (axis * 2);
+				if (low[axis] < 0.0f && -low[axis] >= other1 && -low[axis] >= other2)
+					mask |= 1 << (axis * 2 + 1);
+			}
+			return mask;
+		}
+
+		void PointShadowAtlas::DrawSlot(unsigned int index)
+		{
+			const Slot& slot = slots[index];
+			GLState::BindFramebuffer(depthMapFBO);
+
+			// clearing the layered attachment would clear every slot, so the six layers are cleared alone
+			for (unsigned int face = 0; face < FACE_COUNT; face++)
+			{
+				glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0, index * FACE_COUNT + face);
+				glClear(GL_DEPTH_BUFFER_BIT);
+			}
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0);
+
+			glm::mat4 faceProjection = glm::perspective(glm::radians(90.0f), 1.0f, NEAR_PLANE, slot.Range);
+			for (unsigned int face = 0; face < FACE_COUNT; face++)
+				depthProgram.Set(faceMatrices[face], faceProjection * glm::lookAt(slot.Position, slot.Position + FACE_DIRECTIONS[face], FACE_UPS[face]));
+			depthProgram.Set(firstLayer, (int)(index * FACE_COUNT));
+			depthProgram.Set(lightPositionRange, glm::vec4(slot.Position, slot.Range));
+
+			for (unsigned int caster = 0; caster < casters.size(); caster++)
+			{
+				unsigned int mask = GetFaceMask(slot, casterBounds[caster]);
+				if (mask == 0)
+					continue;
+
+				const ShadowCaster& draw = casters[caster];
+				depthProgram.Set(faceMask, (int)mask);
+				depthProgram.Set(model, draw.Model);
+				GLState::BindVertexArray(draw.VAO);
+				if (draw.Indexed)
+					glDrawElements(GL_TRIANGLES, draw.Count, GL_UNSIGNED_INT, 0);
+				else
+					glDrawArrays(GL_TRIANGLES, 0, draw.Count);
+				stats.CasterDraws++;
+				for (unsigned int face = 0; face < FACE_COUNT; face++)
+				{
+					if (mask & (1 << face))
+						stats.FaceDraws++;
+				}
+			}
+		}
+
+		const PointShadowAtlas::Stats& PointShadowAtlas::GetStats() const
+		{
+			return stats;
+		}
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "AABB.h"
+#include "GPUTimer.h"
+#include "Light.h"
+#include "LightBuffer.h"
+#include "Shader.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// Cube shadow maps for the most important point lights, kept in one depth texture array
+		// with six layers per slot. GL 3.3 has no cube map arrays, so the shaders pick the face and
+		// its texture coordinates themselves, with the same axes GL uses for cube maps.
+		//
+		// A light's cube is drawn in one pass: a geometry shader sends every caster triangle to
+		// each face it can touch through gl_Layer, so a caster costs one draw instead of six. The
+		// CPU only passes the faces whose frusta the caster's bounds reach. Depth is the distance to
+		// the light over its range, which is what the shaders compare against, plus a slope scaled
+		// bias the fragment shader adds since polygon offset doesn't apply to depth it writes.
+		//
+		// Each frame the lights are ranked by intensity and how close they are to the camera, and
+		// the top ones get a slot, keeping the one they had if they already had one. A slot's
+		// cube only needs drawing when its light or a caster in its range moved. At most the update
+		// budget of those are drawn per frame, picked by importance times how many frames they
+		// have waited, so bright nearby lights refresh every frame and dim far ones catch up later.
+		//
+		// Shaders read the slots through
+		//
+		// uniform sampler2DArrayShadow pointShadowMaps;   // layer slot * 6 + face
+		//
+		// and find a light's slot with GetSlot, which LightGrid passes on next to the light.
+		class PointShadowAtlas
+		{
+		public:
+			static const unsigned int FACE_COUNT = 6;
+			// the units below LightGrid's that no other pass rebinds in the middle of a frame
+			static const unsigned int SHADOW_TEXTURE_UNIT = 5;
+
+			struct Stats
+			{
+				unsigned int ShadowedLights = 0;
+				// cubes drawn this frame and the caster draws and faces they took
+				unsigned int UpdatedLights = 0;
+				unsigned int PendingLights = 0;
+				unsigned int CasterDraws = 0;
+				unsigned int FaceDraws = 0;
+				double CullMilliseconds = 0.0;
+				double RenderMilliseconds = 0.0;
+			};
+
+			// slotCount cubes of resolution² texels per face
+			PointShadowAtlas(unsigned int resolution = 256, unsigned int slotCount = 16);
+
+			// points the program's pointShadowMaps sampler at SHADOW_TEXTURE_UNIT
+			void SetupProgram(Shader* program) const;
+
+			// cubes drawn per frame at most, 4 by default
+			void SetUpdateBudget(unsigned int budget);
+
+			// casters are kept between frames, the returned ID moves them
+			unsigned int AddCaster(const ShadowCaster& caster);
+			void MoveCaster(unsigned int caster, const glm::mat4& model);
+
+			// assigns the slots for this frame's lights and draws the cubes that are due
+			void Update(const std::vector<PointLight>& lights, const glm::vec3& viewPosition);
+			void Bind() const;
+
+			// the light's slot, -1 when it casts no shadow this frame or its cube hasn't been drawn yet
+			int GetSlot(unsigned int light) const;
+			const Stats& GetStats() const;
+
+		private:
+			struct Slot
+			{
+				// index of the light in the list given to Update, -1 when the slot is free
+				int Light = -1;
+				// what the cube was drawn with
+				glm::vec3 Position;
+				float Range = 0.0f;
+				bool Dirty = true;
+				// the cube has been drawn for this light since it got the slot, until then it holds
+				// another light's depth or none at all
+				bool Drawn = false;
+				unsigned int Age = 0;
+				float Importance = 0.0f;
+			};
+
+			void AssignSlots(const std::vector<PointLight>& lights, const glm::vec3& viewPosition);
+			void InvalidateMovedCasters();
+			// bit per face of the slot's cube that the caster's bounds reach, 0 outside its range
+			unsigned int GetFaceMask(const Slot& slot, const AABB& bounds) const;
+			void DrawSlot(unsigned int slot);
+
+			unsigned int resolution;
+			unsigned int updateBudget = 4;
+			unsigned int depthMap = 0;
+			unsigned int depthMapFBO = 0;
+
+			std::vector<Slot> slots;
+			std::vector<int> lightSlots;
+			std::vector<float> importance;
+			std::vector<unsigned int> ranked;
+
+			std::vector<ShadowCaster> casters;
+			// world space bounds of every caster
+			std::vector<AABB> casterBounds;
+			std::vector<unsigned int> movedCasters;
+
+			Shader depthProgram;
+			Uniform<glm::mat4> model;
+			Uniform<int> firstLayer;
+			Uniform<int> faceMask;
+			Uniform<glm::vec4> lightPositionRange;
+			std::vector<Uniform<glm::mat4>> faceMatrices;
+
+			GPUTimer renderTimer;
+			Stats stats;
+		};
+	}
+}
@@ -0,0 +1,213 @@
+#include "ReliefMap.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <cmath>
+#include <fstream>
+
+#include "../util/Hash.h"
+#include "../util/Log.h"
+#include "../util/Parallel.h"
+#include "GLState.h"
+#include "TexturePacker.h"
+
+namespace glh {
+	namespace Graphics {
+
+		static const char RELIEF_MAGIC[4] = { 'R', 'L', 'F', '2' };
+		// forward steps taken to find where a ray leaves the surface again
+		static const int EXIT_SEARCH_STEPS = 24;
+
+		bool ReliefMap::Generate(const std::string& depthPath)
+		{
+			if (!GetSourceKey(depthPath, &sourceKey))
+			{
+				Util::Log::WriteError("RELIEFMAP: failed to load " + depthPath);
+				return false;
+			}
+
+			int sourceWidth, sourceHeight, components;
+			unsigned char* data = stbi_load(depthPath.c_str(), &sourceWidth, &sourceHeight, &components, 1);
+			if (data == nullptr)
+			{
+				Util::Log::WriteError("RELIEFMAP: failed to load " + depthPath);
+				return false;
+			}
+
+			width = glm::min(sourceWidth, MAX_RESOLUTION);
+			height = glm::min(sourceHeight, MAX_RESOLUTION);
+			std::vector<unsigned char> resampled;
+			const unsigned char* source = data;
+			if (width != sourceWidth || height != sourceHeight)
+			{
+				resampled.resize(width * height);
+				TexturePacker::Resample(data, sourceWidth, sourceHeight, 1, &resampled[0], width, height);
+				source = &resampled[0];
+			}
+
+			std::vector<float> depths(width * height);
+			for (int i = 0; i < width * height; i++)
+				depths[i] = source[i] / 255.0f;
+			stbi_image_free(data);
+
+			texels.resize(width * height * 2);
+			Util::Parallel::For(height, [&](unsigned int y) {
+				for (int x = 0; x < width; x++)
+				{
+					int texel = y * width + x;
+					texels[texel * 2] = (unsigned char)(depths[texel] * 255.0f + 0.5f);
+					texels[texel * 2 + 1] = (unsigned char)(std::sqrt(ComputeCone(depths, x, y)) * 255.0f);
+				}
+			});
+
+			Util::Log::WriteInfo("RELIEFMAP: generated " + std::to_string(width) + "x" + std::to_string(height) + " cones from " + depthPath);
+			return true;
+		}
+
+		// For every destination texel t near s, a ray is cast from the top of s through the surface
+		// at t and followed until it leaves the surface. The cone at s may not contain that exit point,
+		// or the ray could cross the surface twice inside it.
+		float ReliefMap::ComputeCone(const std::vector<float>& depths, int x, int y) const
+		{
+			auto depthAt = [&](float px, float py) {
+				int ix = ((int)std::floor(px) % width + width) % width;
+				int iy = ((int)std::floor(py) % height + height) % height;
+				return depths[iy * width + ix];
+			};
+
+			float sourceDepth = depths[y * width + x];
+			glm::vec2 texelSize(1.0f / width, 1.0f / height);
+			// the cone's footprint at the top must stay inside the searched window
+			float windowSize = SEARCH_RADIUS * glm::min(texelSize.x, texelSize.y);
+			float ratio = sourceDepth > 0.0f ? glm::min(1.0f, windowSize / sourceDepth) : 1.0f;
+
+			for (int dy = -SEARCH_RADIUS; dy <= SEARCH_RADIUS; dy++)
+			{
+				for (int dx = -SEARCH_RADIUS; dx <= SEARCH_RADIUS; dx++)
+				{
+					if ((dx == 0 && dy == 0) || dx * dx + dy * dy > SEARCH_RADIUS * SEARCH_RADIUS)
+						continue;
+
+					float destinationDepth = depthAt(x + dx + 0.5f, y + dy + 0.5f);
+					if (destinationDepth <= 0.0f)
+						continue;
+
+					// ray from (s, 0) through (t, depth(t)), scaled to run from t to the bottom
+					glm::vec3 position(x + dx + 0.5f, y + dy + 0.5f, destinationDepth);
+					glm::vec3 direction(dx / destinationDepth, dy / destinationDepth, 1.0f);
+					direction *= 1.0f - destinationDepth;
+					int steps = glm::clamp((int)std::ceil(glm::length(glm::vec2(direction.x, direction.y))), 1, EXIT_SEARCH_STEPS);
+					glm::vec3 step = direction / (float)steps;
+
+					position += step;
+					for (int i = 1; i < steps && depthAt(position.x, position.y) <= position.z; i++)
+						position += step;
+
+					if (position.z >= sourceDepth)
+						continue;
+					float distance = glm::length(glm::vec2(position.x - (x + 0.5f), position.y - (y + 0.5f)) * texelSize);
+					ratio = glm::min(ratio, distance / (sourceDepth - position.z));
+				}
+			}
+			return ratio;
+		}
+
+		bool ReliefMap::Save(const std::string& path) const
+		{
+			std::ofstream file(path, std::ios::binary);
+			if (!file)
+			{
+				Util::Log::WriteError("RELIEFMAP: could not write " + path);
+				return false;
+			}
+
+			file.write(RELIEF_MAGIC, sizeof(RELIEF_MAGIC));
+			file.write((const char*)&sourceKey, sizeof(sourceKey));
+			file.write((const char*)&width, sizeof(width));
+			file.write((const char*)&height, sizeof(height));
+			file.write((const char*)texels.data(), texels.size());
+			return true;
+		}
+
+		bool ReliefMap::Load(const std::string& path, const std::string& depthPath)
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
+				return false;
+
+			char magic[4];
+			file.read(magic, sizeof(magic));
+			if (!file || std::string(magic, 4) != std::string(RELIEF_MAGIC, 4))
+			{
+				Util::Log::WriteError("RELIEFMAP: " + path + " is not a relief map");
+				return false;
+			}
+			uint64_t fileKey = 0;
+			file.read((char*)&fileKey, sizeof(fileKey));
+			if (!file || !GetSourceKey(depthPath, &sourceKey) || fileKey != sourceKey)
+			{
+				Util::Log::WriteInfo("RELIEFMAP: " + path + " is older than " + depthPath);
+				return false;
+			}
+			file.read((char*)&width, sizeof(width));
+			file.read((char*)&height, sizeof(height));
+			if (!file || width <= 0 || height <= 0 || width > MAX_RESOLUTION || height > MAX_RESOLUTION)
+			{
+				Util::Log::WriteError("RELIEFMAP: " + path + " has a bad size");
+				width = height = 0;
+				return false;
+			}
+			texels.resize(width * height * 2);
+			file.read((char*)texels.data(), texels.size());
+
+			if (!file)
+			{
+				Util::Log::WriteError("RELIEFMAP: " + path + " is truncated");
+				width = height = 0;
+				texels.clear();
+				return false;
+			}
+			return true;
+		}
+
+		bool ReliefMap::GetSourceKey(const std::string& depthPath, uint64_t* key)
+		{
+			const int constants[] = { MAX_RESOLUTION, SEARCH_RADIUS, EXIT_SEARCH_STEPS };
+			uint64_t constantsHash = Util::Hash::Bytes(constants, sizeof(constants));
+			return Util::Hash::File(depthPath, key, constantsHash);
+		}
+
+		unsigned int ReliefMap::Upload() const
+		{
+			if (texels.empty())
+				return 0;
+
+			unsigned int textureID;
+			glGenTextures(1, &textureID);
+			GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, width, height, 0, GL_RG, GL_UNSIGNED_BYTE, texels.data());
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glGenerateMipmap(GL_TEXTURE_2D);
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			return textureID;
+		}
+
+		int ReliefMap::GetWidth() const
+		{
+			return width;
+		}
+
+		int ReliefMap::GetHeight() const
+		{
+			return height;
+		}
+	}
+}
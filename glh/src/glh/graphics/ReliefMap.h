@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace glh {
+	namespace Graphics {
+
+		// Relaxed cone step map generated offline from a depth map (Policarpo and Oliveira, "Relaxed
+		// Cone Stepping for Relief Mapping", GPU Gems 3). Every texel stores the widest cone above it
+		// that a view ray can enter and still hit the surface at most once, so the shader can step
+		// by whole cones instead of fixed layers and finish with a short binary search.
+		//
+		// r: depth, g: square root of the cone ratio (more precision for narrow cones)
+		//
+		// Cones are only checked against texels within SEARCH_RADIUS and clamped so they never reach
+		// further than that, which keeps generation time down at the cost of some narrower cones.
+		class ReliefMap
+		{
+		public:
+			// larger depth maps are resampled down before the cones are computed
+			static const int MAX_RESOLUTION = 512;
+			static const int SEARCH_RADIUS = 12;
+
+			// computes the cones from a depth image on worker threads
+			bool Generate(const std::string& depthPath);
+
+			// the file keeps a hash of the depth image and the generation constants
+			bool Save(const std::string& path) const;
+			// false if the file wasn't generated from depthPath's current contents with these constants
+			bool Load(const std::string& path, const std::string& depthPath);
+
+			// uploads the map as a mipmapped RG8 texture, returns 0 if nothing was generated or loaded
+			unsigned int Upload() const;
+
+			int GetWidth() const;
+			int GetHeight() const;
+
+		private:
+			float ComputeCone(const std::vector<float>& depths, int x, int y) const;
+			// hash of the depth image's contents and everything else the cones depend on
+			static bool GetSourceKey(const std::string& depthPath, uint64_t* key);
+
+			int width = 0;
+			int height = 0;
+			uint64_t sourceKey = 0;
+			std::vector<unsigned char> texels;
+		};
+	}
+}
@@ -0,0 +1,298 @@
+#include "RenderQueue.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "../util/Log.h"
+#include "GLResources.h"
+#include "GLState.h"
+#include "UniformBlocks.h"
+
+namespace glh {
+	namespace Graphics {
+
+		static const unsigned int DEPTH_BITS = 27;
+		static const unsigned int VAO_BITS = 12;
+		static const unsigned int MATERIAL_BITS = 12;
+		static const unsigned int PROGRAM_BITS = 8;
+
+		void RenderQueue::SetMaterialTable(MaterialTable* table) {
+			materialTable = table;
+		}
+
+		void RenderQueue::SetUniformRing(UniformRing* ring) {
+			uniformRing = ring;
+		}
+
+		void RenderQueue::SetDepthRange(float nearPlane, float farPlane) {
+			depthNear = nearPlane;
+			depthFar = farPlane;
+		}
+
+		void RenderQueue::SetDepthPrepass(Shader* program) {
+			prepassProgram = program;
+		}
+
+		void RenderQueue::Submit(const DrawCommand& command) {
+			SortEntry entry;
+			entry.Key = MakeKey(command);
+			entry.Index = (uint32_t)commands.size();
+			entries.push_back(entry);
+			commands.push_back(command);
+		}
+
+		// GL object names can be any 32 bit value, so they're mapped to small dense IDs that fit in the key
+		uint16_t RenderQueue::GetCompactID(std::unordered_map<unsigned int, uint16_t>* table, unsigned int name, uint16_t limit) {
+			auto it = table->find(name);
+			if (it != table->end())
+				return it->second;
+
+			uint16_t id = (uint16_t)(table->size() % limit);
+			(*table)[name] = id;
+			return id;
+		}
+
+		const RenderQueue::ProgramUniforms& RenderQueue::GetProgramUniforms(const Shader* program) {
+			auto it = programUniforms.find(program->ID);
+			if (it != programUniforms.end())
+				return it->second;
+
+			ProgramUniforms& uniforms = programUniforms[program->ID];
+			uniforms.Model = program->GetUniform<glm::mat4>("model");
+			uniforms.MaterialIndex = program->GetUniform<int>("materialIndex");
+			return uniforms;
+		}
+
+		uint64_t RenderQueue::MakeKey(const DrawCommand& command) {
+			uint64_t program = GetCompactID(&programIDs, command.Program->ID, 1 << PROGRAM_BITS);
+			uint64_t vao = GetCompactID(&vaoIDs, command.VAO, 1 << VAO_BITS);
+			uint64_t material = command.Material & ((1 << MATERIAL_BITS) - 1);
+
+			float normalisedDepth = glm::clamp((command.Depth - depthNear) / (depthFar - depthNear), 0.0f, 1.0f);
+			uint64_t depth = (uint64_t)(normalisedDepth * ((1 << DEPTH_BITS) - 1));
+
+			uint64_t key = (uint64_t)(command.Pass & 0xf) << 60;
+			if (!command.Transparent)
+			{
+				key |= program << (MATERIAL_BITS + VAO_BITS + DEPTH_BITS);
+				key |= material << (VAO_BITS + DEPTH_BITS);
+				key |= vao << DEPTH_BITS;
+				key |= depth;
+			}
+			else
+			{
+				// blending needs back to front order, so depth has to come before state
+				key |= (uint64_t)1 << 59;
+				key |= (((1 << DEPTH_BITS) - 1) - depth) << (PROGRAM_BITS + MATERIAL_BITS + VAO_BITS);
+				key |= program << (MATERIAL_BITS + VAO_BITS);
+				key |= material << VAO_BITS;
+				key |= vao;
+			}
+			return key;
+		}
+
+		// LSD radix sort on the keys, 8 bits per pass, skipping passes where every key has the same byte
+		void RenderQueue::Sort() {
+			unsigned int histograms[8][256];
+			memset(histograms, 0, sizeof(histograms));
+			for (const SortEntry& entry : entries)
+			{
+				for (int pass = 0; pass < 8; pass++)
+					histograms[pass][(entry.Key >> (pass * 8)) & 0xff]++;
+			}
+
+			scratch.resize(entries.size());
+			for (int pass = 0; pass < 8; pass++)
+			{
+				unsigned int* histogram = histograms[pass];
+				if (histogram[(entries[0].Key >> (pass * 8)) & 0xff] == entries.size())
+					continue;
+
+				unsigned int offset = 0;
+				for (int digit = 0; digit < 256; digit++)
+				{
+					unsigned int count = histogram[digit];
+					histogram[digit] = offset;
+					offset += count;
+				}
+
+				for (const SortEntry& entry : entries)
+					scratch[histogram[(entry.Key >> (pass * 8)) & 0xff]++] = entry;
+				entries.swap(scratch);
+			}
+		}
+
+		void RenderQueue::Flush() {
+			stats = Stats();
+			if (entries.empty())
+				return;
+
+			Sort();
+
+			// all object blocks are written up front so the fallback path uploads them in one go
+			objectOffsets.resize(commands.size());
+			if (uniformRing != nullptr)
+			{
+				for (unsigned int i = 0; i < commands.size(); i++)
+				{
+					ObjectBlock* object = (ObjectBlock*)uniformRing->Allocate(sizeof(ObjectBlock), &objectOffsets[i]);
+					if (object == nullptr)
+					{
+						objectOffsets[i] = 0xffffffff;
+						continue;
+					}
+					object->Model = commands[i].Model;
+				}
+				uniformRing->Flush();
+			}
+
+			if (prepassProgram != nullptr)
+				DrawPrepass();
+
+			shadingTimer.Begin();
+			if (materialTable != nullptr)
+				materialTable->BeginPass();
+
+			Shader* currentProgram = nullptr;
+			const ProgramUniforms* currentUniforms = nullptr;
+			int currentMaterial = -1;
+			unsigned int currentVAO = 0;
+			unsigned int boundTextures[Material::TEXTURE_SLOT_COUNT] = {};
+
+			for (const SortEntry& entry : entries)
+			{
+				const DrawCommand& command = commands[entry.Index];
+
+				bool programChanged = command.Program != currentProgram;
+				if (programChanged)
+				{
+					command.Program->use();
+					currentProgram = command.Program;
+					currentUniforms = &GetProgramUniforms(currentProgram);
+					stats.ProgramChanges++;
+				}
+
+				if (programChanged || command.Material != currentMaterial)
+				{
+					// the parameters are already on the GPU, only the textures and the index change
+					if (materialTable != nullptr)
+					{
+						const Material& material = materialTable->Get(command.Material);
+						for (unsigned int unit = 0; unit < Material::TEXTURE_SLOT_COUNT; unit++)
+						{
+							unsigned int texture = material.GetTexture(unit);
+							if (texture == 0 || texture == boundTextures[unit])
+								continue;
+
+							GLState::BindTexture(unit, GL_TEXTURE_2D, texture);
+							boundTextures[unit] = texture;
+							stats.TextureBinds++;
+						}
+					}
+					currentProgram->Set(currentUniforms->MaterialIndex, (int)command.Material);
+					if (command.Material != currentMaterial)
+						stats.MaterialChanges++;
+					currentMaterial = command.Material;
+				}
+
+				if (command.VAO != currentVAO)
+				{
+					GLState::BindVertexArray(command.VAO);
+					currentVAO = command.VAO;
+					stats.VAOChanges++;
+				}
+
+				// pre-passed pixels are already resolved, only the nearest surface passes GL_EQUAL
+				bool prepassed = IsPrepassed(command);
+				GLState::SetDepthFunc(prepassed ? GL_EQUAL : GL_LESS);
+				GLState::SetDepthMask(!prepassed);
+
+				BindObject(entry.Index, currentProgram, currentUniforms);
+				if (command.Indexed)
+					glDrawElements(command.Mode, command.Count, GL_UNSIGNED_INT, 0);
+				else
+					glDrawArrays(command.Mode, 0, command.Count);
+				stats.Draws++;
+			}
+
+			if (materialTable != nullptr)
+				materialTable->EndPass();
+			GLState::SetDepthFunc(GL_LESS);
+			GLState::SetDepthMask(true);
+			shadingTimer.End();
+
+			stats.PrepassMilliseconds = prepassProgram != nullptr ? prepassTimer.GetMilliseconds() : 0.0;
+			stats.ShadingMilliseconds = shadingTimer.GetMilliseconds();
+			commands.clear();
+			entries.clear();
+		}
+
+		void RenderQueue::BindObject(unsigned int index, Shader* program, const ProgramUniforms* uniforms) {
+			if (uniformRing != nullptr)
+			{
+				if (objectOffsets[index] != 0xffffffff)
+					uniformRing->BindRange(OBJECT_BLOCK_BINDING, objectOffsets[index], sizeof(ObjectBlock));
+				else
+				{
+					// slow, the driver has to keep the previous contents for draws in flight, but never stale
+					if (overflowObject == 0)
+						overflowObject = GLResources::CreateBuffer(sizeof(ObjectBlock), nullptr, true);
+					ObjectBlock object;
+					object.Model = commands[index].Model;
+					GLResources::UpdateBuffer(overflowObject, 0, sizeof(ObjectBlock), &object);
+					glBindBufferBase(GL_UNIFORM_BUFFER, OBJECT_BLOCK_BINDING, overflowObject);
+				}
+			}
+			// programs without the ObjectBlock still take the matrix as a plain uniform
+			program->Set(uniforms->Model, commands[index].Model);
+		}
+
+		bool RenderQueue::IsPrepassed(const DrawCommand& command) const {
+			return prepassProgram != nullptr && !command.Transparent && !command.AlphaTested;
+		}
+
+		// lays down the depth of every opaque draw in key order, which is front to back within a
+		// program and material, so the pre-pass itself is cheap to reject
+		void RenderQueue::DrawPrepass() {
+			prepassTimer.Begin();
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			GLState::SetDepthFunc(GL_LESS);
+			GLState::SetDepthMask(true);
+
+			prepassProgram->use();
+			stats.ProgramChanges++;
+			const ProgramUniforms* uniforms = &GetProgramUniforms(prepassProgram);
+			unsigned int currentVAO = 0;
+			for (const SortEntry& entry : entries)
+			{
+				const DrawCommand& command = commands[entry.Index];
+				if (!IsPrepassed(command))
+					continue;
+
+				unsigned int vao = command.DepthVAO != 0 ? command.DepthVAO : command.VAO;
+				if (vao != currentVAO)
+				{
+					GLState::BindVertexArray(vao);
+					currentVAO = vao;
+					stats.VAOChanges++;
+				}
+
+				BindObject(entry.Index, prepassProgram, uniforms);
+				if (command.Indexed)
+					glDrawElements(command.Mode, command.Count, GL_UNSIGNED_INT, 0);
+				else
+					glDrawArrays(command.Mode, 0, command.Count);
+				stats.PrepassDraws++;
+			}
+
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			prepassTimer.End();
+		}
+
+		const RenderQueue::Stats& RenderQueue::GetStats() const {
+			return stats;
+		}
+	}
+}
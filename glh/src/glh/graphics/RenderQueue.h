@@ -0,0 +1,128 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+#include "GPUTimer.h"
+#include "Material.h"
+#include "Shader.h"
+#include "UniformRing.h"
+
+namespace glh {
+	namespace Graphics {
+
+		struct DrawCommand
+		{
+			unsigned int Pass = 0;
+			bool Transparent = false;
+			Shader* Program = nullptr;
+			// ID in the queue's material table, 0 binds no textures
+			uint16_t Material = 0;
+			unsigned int VAO = 0;
+			// position-only VAO the depth pre-pass draws through, 0 uses VAO
+			unsigned int DepthVAO = 0;
+			// draws whose fragments can be discarded stay out of the depth pre-pass and write their own depth
+			bool AlphaTested = false;
+			GLenum Mode = GL_TRIANGLES;
+			unsigned int Count = 0;
+			bool Indexed = true;
+			glm::mat4 Model;
+			// view space distance, used to sort opaque draws front to back and transparent ones back to front
+			float Depth = 0.0f;
+		};
+
+		// Collects the draws of a frame, sorts them by a packed 64 bit key and submits them
+		// with as few program, texture and vertex array changes as possible.
+		//
+		// opaque key:      pass:4 | 0:1 | program:8 | material:12 | vao:12 | depth:27
+		// transparent key: pass:4 | 1:1 | inverted depth:27 | program:8 | material:12 | vao:12
+		//
+		// With a depth pre-pass the opaque draws are first issued with a position-only program and
+		// colour writes off, then shaded with GL_EQUAL and depth writes off so every pixel runs the
+		// expensive fragment shader once. Both programs must compute gl_Position the same way and
+		// declare it invariant. The GPU time of both passes is reported to weigh the pre-pass cost
+		// against what it saves.
+		class RenderQueue
+		{
+		public:
+			struct Stats
+			{
+				unsigned int Draws = 0;
+				unsigned int ProgramChanges = 0;
+				unsigned int MaterialChanges = 0;
+				unsigned int TextureBinds = 0;
+				unsigned int VAOChanges = 0;
+				unsigned int PrepassDraws = 0;
+				// GPU time of the pre-pass and of the shading pass, from a frame or two ago
+				double PrepassMilliseconds = 0.0;
+				double ShadingMilliseconds = 0.0;
+			};
+
+			// textures and parameters of the draws' materials, locked while the queue is flushed
+			void SetMaterialTable(MaterialTable* table);
+			// when set, each draw's model matrix is streamed through the ring into the ObjectBlock
+			// instead of being set as a uniform. Draws that don't fit in the frame's region go through
+			// a buffer of their own, updated per draw, until the ring has grown.
+			void SetUniformRing(UniformRing* ring);
+			// distances are quantised over this range
+			void SetDepthRange(float nearPlane, float farPlane);
+			// enables the depth pre-pass with the given position-only program, nullptr disables it
+			void SetDepthPrepass(Shader* program);
+
+			void Submit(const DrawCommand& command);
+			// radix sorts the draws submitted since the last flush, issues them and clears the queue
+			void Flush();
+
+			// counters of the last flush
+			const Stats& GetStats() const;
+
+		private:
+			struct SortEntry
+			{
+				uint64_t Key;
+				uint32_t Index;
+			};
+
+			// the per draw uniforms of a program, resolved the first time the program is flushed
+			struct ProgramUniforms
+			{
+				Uniform<glm::mat4> Model;
+				Uniform<int> MaterialIndex;
+			};
+
+			const ProgramUniforms& GetProgramUniforms(const Shader* program);
+			uint64_t MakeKey(const DrawCommand& command);
+			uint16_t GetCompactID(std::unordered_map<unsigned int, uint16_t>* table, unsigned int name, uint16_t limit);
+			void Sort();
+			void BindObject(unsigned int index, Shader* program, const ProgramUniforms* uniforms);
+			void DrawPrepass();
+			bool IsPrepassed(const DrawCommand& command) const;
+
+			UniformRing* uniformRing = nullptr;
+			std::vector<unsigned int> objectOffsets;
+			// ObjectBlock of the draws the ring had no room for
+			unsigned int overflowObject = 0;
+
+			MaterialTable* materialTable = nullptr;
+			std::unordered_map<unsigned int, uint16_t> programIDs;
+			std::unordered_map<unsigned int, uint16_t> vaoIDs;
+			std::unordered_map<unsigned int, ProgramUniforms> programUniforms;
+
+			std::vector<DrawCommand> commands;
+			std::vector<SortEntry> entries;
+			std::vector<SortEntry> scratch;
+
+			float depthNear = 0.1f;
+			float depthFar = 100.0f;
+
+			Shader* prepassProgram = nullptr;
+			GPUTimer prepassTimer;
+			GPUTimer shadingTimer;
+
+			Stats stats;
+		};
+	}
+}
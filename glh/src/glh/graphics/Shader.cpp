@@ -2,9 +2,13 @@
 
 #include "Shader.h"
 
+#include "UniformBlocks.h"
+
 namespace glh {
 	namespace Graphics {
 
+		std::unordered_map<std::string, std::string> Shader::includeSources;
+
 		Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath)
 		{
 			if (vertexPath == nullptr || fragmentPath == nullptr)
@@ -56,6 +60,21 @@ namespace glh {
 				Util::Log::WriteError("Shader::File " + std::string(vertexPath) + " or " + std::string(vertexPath) + " not successfully read");
 				return;
 			}
+			std::vector<std::string> included;
+			std::string resolved;
+			if (ResolveIncludes(vertexPath, vertexCode, &included, &resolved))
+				vertexCode.swap(resolved);
+			included.clear();
+			resolved.clear();
+			if (ResolveIncludes(fragmentPath, fragmentCode, &included, &resolved))
+				fragmentCode.swap(resolved);
+			if (geometryPath != nullptr)
+			{
+				included.clear();
+				resolved.clear();
+				if (ResolveIncludes(geometryPath, geometryCode, &included, &resolved))
+					geometryCode.swap(resolved);
+			}
 			const char* vShaderCode = vertexCode.c_str();
 			const char * fShaderCode = fragmentCode.c_str();
 			// 2. compile shaders
@@ -88,6 +107,7 @@ namespace glh {
 				glAttachShader(ID, geometry);
 			glLinkProgram(ID);
 			checkCompileErrors(ID, "PROGRAM", "");
+			Reflect();
 			// delete the shaders as they're linked into our program now and no longer necessery
 			glDeleteShader(vertex);
 			glDeleteShader(fragment);
@@ -95,6 +115,187 @@ namespace glh {
 				glDeleteShader(geometry);
 		}
 
+		void Shader::SetIncludeSource(const std::string &name, const std::string &source)
+		{
+			includeSources[name] = source;
+		}
+
+		bool Shader::ResolveIncludes(const std::string &path, const std::string &source, std::vector<std::string> *included,
+			std::string *resolved)
+		{
+			std::string directory = path.substr(0, path.find_last_of('/') + 1);
+			std::istringstream lines(source);
+			std::string line;
+			int lineNumber = 0;
+			while (std::getline(lines, line))
+			{
+				lineNumber++;
+				size_t start = line.find_first_not_of(" \t");
+				if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+				{
+					*resolved += line + "\n";
+					continue;
+				}
+
+				size_t open = line.find('"', start);
+				size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+				if (close == std::string::npos)
+				{
+					Util::Log::WriteError("SHADER: " + path + "(" + std::to_string(lineNumber) + ") has a malformed #include");
+					return false;
+				}
+
+				std::string name = line.substr(open + 1, close - open - 1);
+				bool pasted = false;
+				for (const std::string& includedName : *included)
+					pasted = pasted || includedName == name;
+				if (!pasted)
+				{
+					included->push_back(name);
+
+					std::string includeSource;
+					auto registered = includeSources.find(name);
+					if (registered != includeSources.end())
+						includeSource = registered->second;
+					else
+					{
+						std::ifstream file(directory + name);
+						if (!file)
+						{
+							Util::Log::WriteError("SHADER: " + path + " includes " + name + ", which doesn't exist");
+							return false;
+						}
+						std::stringstream stream;
+						stream << file.rdbuf();
+						includeSource = stream.str();
+					}
+
+					if (!ResolveIncludes(directory + name, includeSource, included, resolved))
+						return false;
+				}
+				// keeps the line numbers of compile errors pointing into this file
+				*resolved += "#line " + std::to_string(lineNumber + 1) + "\n";
+			}
+			return true;
+		}
+
+		void Shader::Reflect()
+		{
+			uniforms.clear();
+			uniformTable.clear();
+
+			GLint linked = 0;
+			glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+			if (!linked)
+				return;
+
+			// shared blocks always live at the same binding point, whichever program declares them
+			for (unsigned int binding = 0; binding < UNIFORM_BLOCK_BINDING_COUNT; binding++)
+			{
+				GLuint blockIndex = glGetUniformBlockIndex(ID, UNIFORM_BLOCK_NAMES[binding]);
+				if (blockIndex != GL_INVALID_INDEX)
+					glUniformBlockBinding(ID, blockIndex, binding);
+			}
+
+			GLint count = 0;
+			GLint maxLength = 0;
+			glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+			glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+			std::vector<GLchar> nameBuffer(maxLength + 1);
+			std::vector<UniformInfo> found;
+			for (GLint i = 0; i < count; i++)
+			{
+				GLsizei length = 0;
+				GLint size = 0;
+				GLenum type = 0;
+				glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, &nameBuffer[0]);
+				std::string name(&nameBuffer[0], length);
+
+				// uniforms in blocks have no location
+				int location = glGetUniformLocation(ID, name.c_str());
+				if (location < 0)
+					continue;
+
+				if (size > 1 && name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+				{
+					// arrays are reported once as name[0], the bare name and every element are registered separately
+					std::string base = name.substr(0, name.size() - 3);
+					found.push_back(UniformInfo{ base, 0, location, type, 0 });
+					for (GLint element = 0; element < size; element++)
+					{
+						std::string elementName = base + "[" + std::to_string(element) + "]";
+						found.push_back(UniformInfo{ elementName, 0, glGetUniformLocation(ID, elementName.c_str()), type, 0 });
+					}
+				}
+				else
+					found.push_back(UniformInfo{ name, 0, location, type, 0 });
+			}
+
+			// power of two table at most half full so probe sequences stay short
+			unsigned int tableSize = 16;
+			while (tableSize < found.size() * 2)
+				tableSize *= 2;
+			uniformTable.assign(tableSize, 0);
+
+			// an array's bare name and its first element are one location, so they share a shadow
+			std::unordered_map<int, int> shadows;
+			for (const UniformInfo& info : found)
+			{
+				auto shadow = shadows.insert(std::make_pair(info.Location, (int)shadows.size())).first;
+				AddUniform(info.Name, info.Location, info.Type, shadow->second);
+			}
+
+			shadowValues.assign(shadows.size() * SHADOW_SIZE, 0);
+			shadowValid.assign(shadows.size(), 0);
+		}
+
+		void Shader::AddUniform(const std::string &name, int location, GLenum type, int shadow)
+		{
+			UniformInfo info;
+			info.Name = name;
+			info.Hash = HashName(name);
+			info.Location = location;
+			info.Type = type;
+			info.Shadow = shadow;
+
+			unsigned int mask = (unsigned int)uniformTable.size() - 1;
+			unsigned int slot = info.Hash & mask;
+			while (uniformTable[slot] != 0)
+				slot = (slot + 1) & mask;
+
+			uniforms.push_back(info);
+			uniformTable[slot] = (int)uniforms.size();
+		}
+
+		int Shader::FindUniform(const std::string &name) const
+		{
+			if (uniformTable.empty())
+				return -1;
+
+			uint32_t hash = HashName(name);
+			unsigned int mask = (unsigned int)uniformTable.size() - 1;
+			for (unsigned int slot = hash & mask; uniformTable[slot] != 0; slot = (slot + 1) & mask)
+			{
+				const UniformInfo& info = uniforms[uniformTable[slot] - 1];
+				if (info.Hash == hash && info.Name == name)
+					return uniformTable[slot] - 1;
+			}
+			return -1;
+		}
+
+		// FNV-1a
+		uint32_t Shader::HashName(const std::string &name)
+		{
+			uint32_t hash = 2166136261u;
+			for (char c : name)
+			{
+				hash ^= (unsigned char)c;
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
 		// utility function for checking shader compilation/linking errors.
 		// ------------------------------------------------------------------------
 		void Shader::checkCompileErrors(GLuint shader, std::string type, std::string name)
@@ -7,10 +7,94 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
 
 #include "../util/Log.h"
+#include "GLState.h"
 namespace glh {
 	namespace Graphics {
+
+		// Handle to a uniform of a specific shader, resolved once with Shader::GetUniform.
+		// Setting through a handle does no name lookup at all.
+		template <typename T>
+		struct Uniform
+		{
+			int Location = -1;
+			int Index = -1;
+
+			bool IsValid() const { return Index >= 0; }
+		};
+
+		inline bool IsSamplerType(GLenum type)
+		{
+			switch (type)
+			{
+			case GL_SAMPLER_1D:
+			case GL_SAMPLER_2D:
+			case GL_SAMPLER_3D:
+			case GL_SAMPLER_CUBE:
+			case GL_SAMPLER_1D_SHADOW:
+			case GL_SAMPLER_2D_SHADOW:
+			case GL_SAMPLER_2D_ARRAY:
+			case GL_SAMPLER_2D_ARRAY_SHADOW:
+			case GL_SAMPLER_CUBE_SHADOW:
+			case GL_SAMPLER_BUFFER:
+			case GL_INT_SAMPLER_2D:
+			case GL_UNSIGNED_INT_SAMPLER_2D:
+			case GL_INT_SAMPLER_BUFFER:
+			case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		// how each value type is uploaded and which GLSL types it may be used for
+		template <typename T> struct UniformTraits;
+		template <> struct UniformTraits<int>
+		{
+			static void Upload(int location, const int& value) { glUniform1i(location, value); }
+			static bool Accepts(GLenum type) { return type == GL_INT || type == GL_BOOL || IsSamplerType(type); }
+		};
+		template <> struct UniformTraits<float>
+		{
+			static void Upload(int location, const float& value) { glUniform1f(location, value); }
+			static bool Accepts(GLenum type) { return type == GL_FLOAT; }
+		};
+		template <> struct UniformTraits<glm::vec2>
+		{
+			static void Upload(int location, const glm::vec2& value) { glUniform2fv(location, 1, &value[0]); }
+			static bool Accepts(GLenum type) { return type == GL_FLOAT_VEC2; }
+		};
+		template <> struct UniformTraits<glm::vec3>
+		{
+			static void Upload(int location, const glm::vec3& value) { glUniform3fv(location, 1, &value[0]); }
+			static bool Accepts(GLenum type) { return type == GL_FLOAT_VEC3; }
+		};
+		template <> struct UniformTraits<glm::vec4>
+		{
+			static void Upload(int location, const glm::vec4& value) { glUniform4fv(location, 1, &value[0]); }
+			static bool Accepts(GLenum type) { return type == GL_FLOAT_VEC4; }
+		};
+		template <> struct UniformTraits<glm::mat2>
+		{
+			static void Upload(int location, const glm::mat2& value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+			static bool Accepts(GLenum type) { return type == GL_FLOAT_MAT2; }
+		};
+		template <> struct UniformTraits<glm::mat3>
+		{
+			static void Upload(int location, const glm::mat3& value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+			static bool Accepts(GLenum type) { return type == GL_FLOAT_MAT3; }
+		};
+		template <> struct UniformTraits<glm::mat4>
+		{
+			static void Upload(int location, const glm::mat4& value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+			static bool Accepts(GLenum type) { return type == GL_FLOAT_MAT4; }
+		};
+
 		class Shader
 		{
 		public:
@@ -22,75 +106,162 @@ namespace glh {
 
 			void LoadShader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
 
+			// A line #include "name" in a shader source is replaced by the source registered under name,
+			// or else by the file of that name in the shader's directory. Each name is pasted once per
+			// stage, so included files can include what they depend on. Register before loading.
+			static void SetIncludeSource(const std::string &name, const std::string &source);
+
 			// activate the shader
 			// ------------------------------------------------------------------------
 			void use()
 			{
-				glUseProgram(ID);
+				GLState::UseProgram(ID);
+			}
+			// typed handles, looked up once at setup so the render loop never touches uniform names
+			// ------------------------------------------------------------------------
+			template <typename T>
+			Uniform<T> GetUniform(const std::string &name) const
+			{
+				Uniform<T> uniform;
+				int index = FindUniform(name);
+				if (index < 0)
+					return uniform;
+
+				if (!UniformTraits<T>::Accepts(uniforms[index].Type))
+				{
+					Util::Log::WriteError("SHADER: uniform " + name + " is set with the wrong type");
+					return uniform;
+				}
+
+				uniform.Location = uniforms[index].Location;
+				uniform.Index = index;
+				return uniform;
 			}
+
+			template <typename T>
+			void Set(const Uniform<T> &uniform, const T &value) const
+			{
+				if (uniform.Index >= 0)
+					SetValue(uniform.Index, value);
+			}
+
 			// utility uniform functions
 			// ------------------------------------------------------------------------
 			void setBool(const std::string &name, bool value) const
 			{
-				glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+				SetNamed(name, (int)value);
 			}
 			// ------------------------------------------------------------------------
 			void setInt(const std::string &name, int value) const
 			{
-				glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+				SetNamed(name, value);
 			}
 			// ------------------------------------------------------------------------
 			void setFloat(const std::string &name, float value) const
 			{
-				glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+				SetNamed(name, value);
 			}
 			// ------------------------------------------------------------------------
 			void setVec2(const std::string &name, const glm::vec2 &value) const
 			{
-				glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+				SetNamed(name, value);
 			}
 			void setVec2(const std::string &name, float x, float y) const
 			{
-				glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+				SetNamed(name, glm::vec2(x, y));
 			}
 			// ------------------------------------------------------------------------
 			void setVec3(const std::string &name, const glm::vec3 &value) const
 			{
-				glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+				SetNamed(name, value);
 			}
 			void setVec3(const std::string &name, float x, float y, float z) const
 			{
-				glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+				SetNamed(name, glm::vec3(x, y, z));
 			}
 			// ------------------------------------------------------------------------
 			void setVec4(const std::string &name, const glm::vec4 &value) const
 			{
-				glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+				SetNamed(name, value);
 			}
 			void setVec4(const std::string &name, float x, float y, float z, float w)
 			{
-				glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+				SetNamed(name, glm::vec4(x, y, z, w));
 			}
 			// ------------------------------------------------------------------------
 			void setMat2(const std::string &name, const glm::mat2 &mat) const
 			{
-				glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+				SetNamed(name, mat);
 			}
 			// ------------------------------------------------------------------------
 			void setMat3(const std::string &name, const glm::mat3 &mat) const
 			{
-				glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+				SetNamed(name, mat);
 			}
 			// ------------------------------------------------------------------------
 			void setMat4(const std::string &name, const glm::mat4 &mat) const
 			{
-				glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+				SetNamed(name, mat);
 			}
 
 		private:
 			// utility function for checking shader compilation/linking errors.
 			// ------------------------------------------------------------------------
 			void checkCompileErrors(GLuint shader, std::string type, std::string name);
+
+			// pastes the includes of source, false if one can't be found
+			static bool ResolveIncludes(const std::string &path, const std::string &source, std::vector<std::string> *included,
+				std::string *resolved);
+
+			static std::unordered_map<std::string, std::string> includeSources;
+
+			struct UniformInfo
+			{
+				std::string Name;
+				uint32_t Hash;
+				int Location;
+				GLenum Type;
+				// slot of the shadowed value, shared by every name of the same location
+				int Shadow;
+			};
+
+			// every active uniform is stored in a flat open addressed table after linking, array elements get an entry each.
+			// Shared uniform blocks are bound to their fixed binding points here too.
+			void Reflect();
+			void AddUniform(const std::string &name, int location, GLenum type, int shadow);
+			int FindUniform(const std::string &name) const;
+			static uint32_t HashName(const std::string &name);
+
+			template <typename T>
+			void SetNamed(const std::string &name, const T &value) const
+			{
+				int index = FindUniform(name);
+				if (index >= 0)
+					SetValue(index, value);
+			}
+
+			// the last value set is shadowed, so setting a uniform to the value it already has skips the upload
+			template <typename T>
+			void SetValue(int index, const T &value) const
+			{
+				static_assert(sizeof(T) <= SHADOW_SIZE, "uniform type too large to shadow");
+				const UniformInfo& info = uniforms[index];
+				unsigned char* shadow = &shadowValues[info.Shadow * SHADOW_SIZE];
+				if (shadowValid[info.Shadow] && memcmp(shadow, &value, sizeof(T)) == 0)
+					return;
+
+				memcpy(shadow, &value, sizeof(T));
+				shadowValid[info.Shadow] = 1;
+				UniformTraits<T>::Upload(info.Location, value);
+			}
+
+			static const unsigned int SHADOW_SIZE = 64;
+
+			std::vector<UniformInfo> uniforms;
+			// indices into uniforms + 1, 0 marks an empty slot
+			std::vector<int> uniformTable;
+			mutable std::vector<unsigned char> shadowValues;
+			mutable std::vector<unsigned char> shadowValid;
 		};
 	}
 }
\ No newline at end of file
@@ -1,31 +1,35 @@
 #include "Skybox.h"
 
 #include <glad/glad.h>
+#include <GLFW\glfw3.h>
 #include <stb_image.h>
 
 #include "../Util/Log.h"
-
+#include "GLResources.h"
+#include "GLState.h"
+#include "VertexLayout.h"
 
 #include <vector>
 
 namespace glh {
 	namespace Graphics {
 
+		// the cube is positions only
+		typedef VertexLayout<VertexAttribute<0, glm::vec3>> CubeLayout;
+
 		void Skybox::Draw(glm::mat3 view, glm::mat4 projection) {
 			skyboxShader.use();
-			skyboxShader.setMat4("view", glm::mat4(view));
-			skyboxShader.setMat4("projection", projection);
+			skyboxShader.Set(viewUniform, glm::mat4(view));
+			skyboxShader.Set(projectionUniform, projection);
 
-			glDepthFunc(GL_LEQUAL);
-			glBindVertexArray(VAO);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+			GLState::SetDepthFunc(GL_LEQUAL);
+			GLState::BindVertexArray(VAO);
+			GLState::BindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
 			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (void*)0);
-			glDepthFunc(GL_LESS);
+			GLState::SetDepthFunc(GL_LESS);
 			//glBindVertexArray(0); // no need to unbind it every time as whenever we modify a vertex array we should bind it anyway
 		}
 
-		// loads a cubemap texture from 6 individual texture faces
 		// order:
 		// +X (right)
 		// -X (left)
@@ -33,9 +37,8 @@ namespace glh {
 		// -Y (bottom)
 		// +Z (front) 
 		// -Z (back)
-		void Skybox::loadCubemapTexture(std::string skyboxName) {
-			std::vector<std::string> faces
-			{
+		std::vector<std::string> Skybox::GetFacePaths(const std::string& skyboxName) {
+			return {
 				"Data/Skyboxes/" + skyboxName + "/right.jpg",
 				"Data/Skyboxes/" + skyboxName + "/left.jpg",
 				"Data/Skyboxes/" + skyboxName + "/top.jpg",
@@ -43,30 +46,52 @@ namespace glh {
 				"Data/Skyboxes/" + skyboxName + "/front.jpg",
 				"Data/Skyboxes/" + skyboxName + "/back.jpg"
 			};
+		}
 
-			glGenTextures(1, &cubemapTexture);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+		// loads a cubemap texture from 6 individual texture faces
+		void Skybox::loadCubemapTexture(std::string skyboxName) {
+			std::vector<std::string> faces = GetFacePaths(skyboxName);
 
-			int width, height, nrChannels;
+			// immutable storage needs the face size up front, so every face is loaded before the texture is made
+			int width = 0, height = 0, nrChannels;
+			unsigned char* data[6] = {};
 			for (unsigned int i = 0; i < faces.size(); i++)
 			{
-				unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-				if (data)
+				int faceWidth, faceHeight;
+				data[i] = stbi_load(faces[i].c_str(), &faceWidth, &faceHeight, &nrChannels, 3);
+				if (!data[i])
+					Util::Log::WriteError("Cubemap texture failed to load at path: " + faces[i]);
+				else if (width != 0 && (faceWidth != width || faceHeight != height))
 				{
-					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-					stbi_image_free(data);
+					// the storage is sized for the first face, a different one would be read out of bounds
+					Util::Log::WriteError("Cubemap face " + faces[i] + " differs in size from the others");
+					stbi_image_free(data[i]);
+					data[i] = nullptr;
 				}
 				else
 				{
-					Util::Log::WriteError("Cubemap texture failed to load at path: " + faces[i]);
-					stbi_image_free(data);
+					width = faceWidth;
+					height = faceHeight;
+				}
+			}
+
+			if (width == 0)
+				return;
+
+			cubemapTexture = GLResources::CreateTexture(GL_TEXTURE_CUBE_MAP, GL_RGB8, width, height);
+			for (unsigned int i = 0; i < faces.size(); i++)
+			{
+				if (data[i])
+				{
+					GLResources::UploadTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture, 0, i, width, height, GL_RGB, GL_UNSIGNED_BYTE, data[i]);
+					stbi_image_free(data[i]);
 				}
 			}
-			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_CUBE_MAP, cubemapTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_CUBE_MAP, cubemapTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			GLResources::SetTextureParameter(GL_TEXTURE_CUBE_MAP, cubemapTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_CUBE_MAP, cubemapTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			GLResources::SetTextureParameter(GL_TEXTURE_CUBE_MAP, cubemapTexture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 		}
 
 		Skybox::Skybox(std::string skyboxName) {
@@ -77,32 +102,28 @@ namespace glh {
 
 			skyboxShader.use();
 			skyboxShader.setInt("skybox", 0);
+			viewUniform = skyboxShader.GetUniform<glm::mat4>("view");
+			projectionUniform = skyboxShader.GetUniform<glm::mat4>("projection");
 
-			glGenVertexArrays(1, &VAO);
-			glGenBuffers(1, &VBO);
-			glGenBuffers(1, &EBO);
+			VBO = GLResources::CreateBuffer(sizeof(vertices), vertices);
+			EBO = GLResources::CreateBuffer(sizeof(indices), indices);
 
-			// bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-			glBindVertexArray(VAO);
-
-			glBindBuffer(GL_ARRAY_BUFFER, VBO);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-			glEnableVertexAttribArray(0);
-
-			// note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			VAO = GLResources::CreateVertexArray();
+			CubeLayout::Apply(VAO);
+			CubeLayout::SetVertexBuffer(VAO, 0, VBO);
+			GLResources::SetElementBuffer(VAO, EBO);
+		}
 
-			// remember: do NOT unbind the EBO while a VAO is active as the bound element buffer object IS stored in the VAO; keep the EBO bound.
-			//glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		Skybox::~Skybox() {
+			// nothing to free once the context is gone, as when the skybox outlives glfwTerminate
+			if (glfwGetCurrentContext() == nullptr)
+				return;
 
-			// You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
-			// VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-			glBindVertexArray(0);
+			GLResources::DeleteVertexArray(VAO);
+			GLResources::DeleteBuffer(VBO);
+			GLResources::DeleteBuffer(EBO);
+			if (cubemapTexture != 0)
+				GLResources::DeleteTexture(cubemapTexture);
 		}
 
 	}
@@ -3,6 +3,8 @@
 #include <glm\glm.hpp>
 
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include "../Graphics/Shader.h"
 namespace glh {
@@ -12,16 +14,25 @@ namespace glh {
 		{
 		public:
 			Skybox(std::string skyboxName);
+			~Skybox();
+			// owns its GL objects
+			Skybox(const Skybox&) = delete;
+			Skybox& operator=(const Skybox&) = delete;
 
 			void Draw(glm::mat3 view, glm::mat4 projection);
 
+			// the six face images of a skybox in cube map order: +X, -X, +Y, -Y, +Z, -Z
+			static std::vector<std::string> GetFacePaths(const std::string& skyboxName);
+
 		private:
 			unsigned int VAO, VBO, EBO;
-			unsigned int cubemapTexture;
+			unsigned int cubemapTexture = 0;
 
 			void loadCubemapTexture(std::string skyboxName);
 
 			Shader skyboxShader;
+			Uniform<glm::mat4> viewUniform;
+			Uniform<glm::mat4> projectionUniform;
 
 			float vertices[24] = {
 				// positions, Upper, Lower, Back, Front, Left, Right
@@ -0,0 +1,133 @@
+#include "TexturePacker.h"
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <fstream>
+
+#include "../util/Log.h"
+#include "../util/Parallel.h"
+#include "GLState.h"
+
+namespace glh {
+	namespace Graphics {
+
+		static const char* const ORM_SOURCES[TexturePacker::ORM_CHANNEL_COUNT] = {
+			"ao", "roughness", "metallic", "depth"
+		};
+		static const unsigned char ORM_DEFAULTS[TexturePacker::ORM_CHANNEL_COUNT] = {
+			255, 255, 0, 0
+		};
+
+		bool TexturePacker::PackORM(const std::string& directory, const std::string& extension, bool heightInAlpha,
+			std::vector<unsigned char>* pixels, int* width, int* height)
+		{
+			struct Source
+			{
+				unsigned char* Data = nullptr;
+				int Width = 0;
+				int Height = 0;
+			};
+			Source sources[ORM_CHANNEL_COUNT];
+			unsigned int channelCount = heightInAlpha ? ORM_CHANNEL_COUNT : ORM_HEIGHT;
+
+			// the source maps are stored as full RGB images, only their first channel is kept
+			Util::Parallel::For(channelCount, [&](unsigned int channel) {
+				std::string path = directory + "/" + ORM_SOURCES[channel] + "." + extension;
+				if (!std::ifstream(path).good())
+					return;
+				int components;
+				sources[channel].Data = stbi_load(path.c_str(), &sources[channel].Width, &sources[channel].Height, &components, 1);
+				if (sources[channel].Data == nullptr)
+					Util::Log::WriteError("TEXTUREPACKER: failed to load " + path);
+			});
+
+			*width = 0;
+			*height = 0;
+			for (unsigned int channel = 0; channel < channelCount; channel++)
+			{
+				if (sources[channel].Width * sources[channel].Height > *width * *height)
+				{
+					*width = sources[channel].Width;
+					*height = sources[channel].Height;
+				}
+			}
+			if (*width == 0)
+				return false;
+
+			unsigned int texels = *width * *height;
+			pixels->resize(texels * ORM_CHANNEL_COUNT);
+			std::vector<unsigned char> resampled;
+			for (unsigned int channel = 0; channel < ORM_CHANNEL_COUNT; channel++)
+			{
+				const unsigned char* data = sources[channel].Data;
+				if (data == nullptr)
+				{
+					for (unsigned int texel = 0; texel < texels; texel++)
+						(*pixels)[texel * ORM_CHANNEL_COUNT + channel] = ORM_DEFAULTS[channel];
+					continue;
+				}
+
+				if (sources[channel].Width != *width || sources[channel].Height != *height)
+				{
+					resampled.resize(texels);
+					Resample(data, sources[channel].Width, sources[channel].Height, 1, &resampled[0], *width, *height);
+					data = &resampled[0];
+				}
+				for (unsigned int texel = 0; texel < texels; texel++)
+					(*pixels)[texel * ORM_CHANNEL_COUNT + channel] = data[texel];
+				stbi_image_free(sources[channel].Data);
+			}
+			return true;
+		}
+
+		unsigned int TexturePacker::LoadORM(const std::string& directory, const std::string& extension, bool heightInAlpha)
+		{
+			std::vector<unsigned char> pixels;
+			int width, height;
+			if (!PackORM(directory, extension, heightInAlpha, &pixels, &width, &height))
+			{
+				Util::Log::WriteWarning("TEXTUREPACKER: no ao, roughness, metallic or depth maps in " + directory);
+				return 0;
+			}
+
+			unsigned int textureID;
+			glGenTextures(1, &textureID);
+			GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+			glGenerateMipmap(GL_TEXTURE_2D);
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			return textureID;
+		}
+
+		void TexturePacker::Resample(const unsigned char* source, int sourceWidth, int sourceHeight, unsigned int channels,
+			unsigned char* destination, int width, int height)
+		{
+			for (int y = 0; y < height; y++)
+			{
+				float sourceY = ((y + 0.5f) * sourceHeight) / height - 0.5f;
+				int y0 = sourceY < 0.0f ? 0 : (int)sourceY;
+				int y1 = y0 + 1 < sourceHeight ? y0 + 1 : sourceHeight - 1;
+				float fy = sourceY < 0.0f ? 0.0f : sourceY - y0;
+				for (int x = 0; x < width; x++)
+				{
+					float sourceX = ((x + 0.5f) * sourceWidth) / width - 0.5f;
+					int x0 = sourceX < 0.0f ? 0 : (int)sourceX;
+					int x1 = x0 + 1 < sourceWidth ? x0 + 1 : sourceWidth - 1;
+					float fx = sourceX < 0.0f ? 0.0f : sourceX - x0;
+					for (unsigned int c = 0; c < channels; c++)
+					{
+						float top = source[(y0 * sourceWidth + x0) * channels + c] * (1.0f - fx) + source[(y0 * sourceWidth + x1) * channels + c] * fx;
+						float bottom = source[(y1 * sourceWidth + x0) * channels + c] * (1.0f - fx) + source[(y1 * sourceWidth + x1) * channels + c] * fx;
+						destination[(y * width + x) * channels + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace glh {
+	namespace Graphics {
+
+		// Packs the single channel maps of a PBR material into one "ORM" texture when it's imported:
+		//
+		// r: ambient occlusion, g: roughness, b: metallic, a: parallax height (depth) or 0
+		//
+		// so shaders need one fetch instead of four for them. Missing maps get neutral values
+		// (no occlusion, fully rough, dielectric, flat) and maps of different sizes are resampled
+		// to the largest one.
+		class TexturePacker
+		{
+		public:
+			enum OrmChannel
+			{
+				ORM_AO,
+				ORM_ROUGHNESS,
+				ORM_METALLIC,
+				ORM_HEIGHT,
+				ORM_CHANNEL_COUNT
+			};
+
+			// reads ao, roughness, metallic and depth from directory into RGBA texels,
+			// returns false if the material has none of them
+			static bool PackORM(const std::string& directory, const std::string& extension, bool heightInAlpha,
+				std::vector<unsigned char>* pixels, int* width, int* height);
+			// packs and uploads the maps as a mipmapped RGBA8 texture, returns 0 if there's nothing to pack
+			static unsigned int LoadORM(const std::string& directory, const std::string& extension = "png", bool heightInAlpha = true);
+
+			// bilinear resample of 8 bit texels
+			static void Resample(const unsigned char* source, int sourceWidth, int sourceHeight, unsigned int channels,
+				unsigned char* destination, int width, int height);
+		};
+	}
+}
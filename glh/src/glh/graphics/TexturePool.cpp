@@ -0,0 +1,196 @@
+#include "TexturePool.h"
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "../util/Log.h"
+#include "../util/Parallel.h"
+#include "GLResources.h"
+#include "GLState.h"
+#include "TexturePacker.h"
+#include "UniformBlocks.h"
+
+namespace glh {
+	namespace Graphics {
+
+		static const char* const MAP_NAMES[TexturePool::MAP_TYPE_COUNT] = {
+			"albedo", "normal", "orm"
+		};
+
+		// white albedo, flat normal, unoccluded, fully rough, dielectric, no displacement
+		static const unsigned char DEFAULT_TEXELS[TexturePool::MAP_TYPE_COUNT][4] = {
+			{ 255, 255, 255, 255 },
+			{ 128, 128, 255, 255 },
+			{ 255, 255, 0, 0 }
+		};
+
+		static const char* const ORM_SOURCES[] = {
+			"ao", "roughness", "metallic", "depth"
+		};
+
+		static bool FileExists(const std::string& path)
+		{
+			return std::ifstream(path).good();
+		}
+
+		TexturePool::TexturePool(unsigned int poolResolution) : resolution(poolResolution)
+		{
+			for (unsigned int type = 0; type < MAP_TYPE_COUNT; type++)
+				layerSources[type].push_back(LayerSource());
+		}
+
+		unsigned int TexturePool::AddMaterial(const std::string& directory, const std::string& extension)
+		{
+			if (materials.size() >= MAX_MATERIALS)
+			{
+				Util::Log::WriteError("TEXTUREPOOL: too many materials");
+				return 0;
+			}
+			if (built)
+				Util::Log::WriteWarning("TEXTUREPOOL: material added after Build, it has no textures until the next Build");
+
+			LayerSource source;
+			source.Directory = directory;
+			source.Extension = extension;
+
+			MaterialLayers material = {};
+			for (unsigned int type = ALBEDO_MAP; type <= NORMAL_MAP; type++)
+			{
+				if (FileExists(directory + "/" + MAP_NAMES[type] + "." + extension))
+					material.Layers[type] = AddLayer((MapType)type, source);
+			}
+			for (const char* name : ORM_SOURCES)
+			{
+				if (FileExists(directory + "/" + name + "." + extension))
+				{
+					material.Layers[ORM_MAP] = AddLayer(ORM_MAP, source);
+					break;
+				}
+			}
+
+			materials.push_back(material);
+			return (unsigned int)materials.size() - 1;
+		}
+
+		void TexturePool::SetParameters(unsigned int material, uint16_t tableMaterial)
+		{
+			if (material < materials.size())
+				materials[material].Parameters = tableMaterial;
+		}
+
+		// materials sharing a source share its layer
+		unsigned int TexturePool::AddLayer(MapType type, const LayerSource& source)
+		{
+			std::string key = source.Directory + "/" + MAP_NAMES[type] + "." + source.Extension;
+			auto it = layerLookup[type].find(key);
+			if (it != layerLookup[type].end())
+				return it->second;
+
+			unsigned int layer = (unsigned int)layerSources[type].size();
+			layerSources[type].push_back(source);
+			layerLookup[type][key] = layer;
+			return layer;
+		}
+
+		void TexturePool::LoadLayer(MapType type, unsigned int layer, std::vector<unsigned char>* pixels)
+		{
+			const unsigned int channels = 4;
+			pixels->resize(resolution * resolution * channels);
+
+			const LayerSource& source = layerSources[type][layer];
+			int width = 0, height = 0, fileChannels = 0;
+			unsigned char* data = nullptr;
+			std::vector<unsigned char> packed;
+			if (layer != 0 && type == ORM_MAP)
+			{
+				if (TexturePacker::PackORM(source.Directory, source.Extension, true, &packed, &width, &height))
+					data = &packed[0];
+			}
+			else if (layer != 0)
+			{
+				std::string path = source.Directory + "/" + MAP_NAMES[type] + "." + source.Extension;
+				data = stbi_load(path.c_str(), &width, &height, &fileChannels, channels);
+			}
+
+			if (data == nullptr)
+			{
+				if (layer != 0)
+					Util::Log::WriteError("TEXTUREPOOL: failed to load the " + std::string(MAP_NAMES[type]) + " map of " + source.Directory);
+				for (unsigned int texel = 0; texel < resolution * resolution; texel++)
+					memcpy(&(*pixels)[texel * channels], DEFAULT_TEXELS[type], channels);
+				return;
+			}
+
+			if (width == (int)resolution && height == (int)resolution)
+				memcpy(&(*pixels)[0], data, pixels->size());
+			else
+				TexturePacker::Resample(data, width, height, channels, &(*pixels)[0], resolution, resolution);
+			if (type != ORM_MAP)
+				stbi_image_free(data);
+		}
+
+		void TexturePool::Build()
+		{
+			for (unsigned int type = 0; type < MAP_TYPE_COUNT; type++)
+			{
+				unsigned int layerCount = (unsigned int)layerSources[type].size();
+				std::vector<std::vector<unsigned char>> pixels(layerCount);
+				Util::Parallel::For(layerCount, [&](unsigned int layer) {
+					LoadLayer((MapType)type, layer, &pixels[layer]);
+				});
+
+				// immutable storage can't grow, a rebuild starts over with a new array
+				if (arrays[type] != 0)
+					GLResources::DeleteTexture(arrays[type]);
+				unsigned int texture = GLResources::CreateTexture3D(GL_TEXTURE_2D_ARRAY, GL_RGBA8, resolution, resolution, std::max(layerCount, 1u), 0);
+				for (unsigned int layer = 0; layer < layerCount; layer++)
+					GLResources::UploadTexture3D(GL_TEXTURE_2D_ARRAY, texture, 0, layer, resolution, resolution, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[layer][0]);
+				GLResources::GenerateMipmaps(GL_TEXTURE_2D_ARRAY, texture);
+
+				GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+				GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+				GLResources::SetTextureParameter(GL_TEXTURE_2D_ARRAY, texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				arrays[type] = texture;
+			}
+
+			if (materialBuffer == 0)
+				glGenBuffers(1, &materialBuffer);
+			glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+			glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(MaterialLayers), nullptr, GL_STATIC_DRAW);
+			if (!materials.empty())
+				glBufferSubData(GL_UNIFORM_BUFFER, 0, materials.size() * sizeof(MaterialLayers), &materials[0]);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+			built = true;
+			Util::Log::WriteInfo("TEXTUREPOOL: " + std::to_string(materials.size()) + " materials at " +
+				std::to_string(resolution) + "x" + std::to_string(resolution));
+		}
+
+		void TexturePool::Bind()
+		{
+			for (unsigned int type = 0; type < MAP_TYPE_COUNT; type++)
+				GLState::BindTexture(type, GL_TEXTURE_2D_ARRAY, arrays[type]);
+			glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, materialBuffer);
+		}
+
+		unsigned int TexturePool::GetResolution() const
+		{
+			return resolution;
+		}
+
+		unsigned int TexturePool::GetMaterialCount() const
+		{
+			return (unsigned int)materials.size();
+		}
+
+		unsigned int TexturePool::GetLayerCount(MapType type) const
+		{
+			return (unsigned int)layerSources[type].size();
+		}
+	}
+}
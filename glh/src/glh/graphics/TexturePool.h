@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace glh {
+	namespace Graphics {
+
+		// Material textures of one resolution class stored as layers of a GL_TEXTURE_2D_ARRAY per map
+		// type, so any number of materials can be drawn without rebinding textures. A material is
+		// just a set of layer indices, uploaded to the MaterialBlock uniform block:
+		//
+		// layout (std140) uniform MaterialBlock { uvec4 materialLayers[256]; };
+		//
+		// where materialLayers[m] holds the albedo, normal and ORM layers of material m followed by
+		// the MaterialTable entry its parameters are read from (see pbrarray.fs). ORM layers are packed from the
+		// material's ao, roughness, metallic and depth maps by TexturePacker.
+		// Images of another size are resampled to the pool's resolution when the pool is built.
+		// Layer 0 of every array is a neutral default used for maps a material doesn't have.
+		class TexturePool
+		{
+		public:
+			// same order as the texture units of the PBR shaders
+			enum MapType
+			{
+				ALBEDO_MAP,
+				NORMAL_MAP,
+				ORM_MAP,
+				MAP_TYPE_COUNT
+			};
+
+			static const unsigned int MAX_MATERIALS = 256;
+
+			TexturePool(unsigned int resolution);
+
+			// adds the maps named albedo, normal, ao, roughness, metallic and depth found in directory,
+			// returns the material index
+			unsigned int AddMaterial(const std::string& directory, const std::string& extension = "png");
+
+			// the MaterialTable entry holding the material's parameters, 0 (the defaults) until set
+			void SetParameters(unsigned int material, uint16_t tableMaterial);
+
+			// loads every image on worker threads and uploads the arrays and the material block
+			void Build();
+			// binds the arrays to texture units 0-2 and the material block to its binding point
+			void Bind();
+
+			unsigned int GetResolution() const;
+			unsigned int GetMaterialCount() const;
+			unsigned int GetLayerCount(MapType type) const;
+
+		private:
+			// mirrors a uvec4 of the MaterialBlock
+			struct MaterialLayers
+			{
+				unsigned int Layers[MAP_TYPE_COUNT];
+				unsigned int Parameters;
+			};
+
+			// an image file for albedo and normal layers, a material directory for ORM layers
+			struct LayerSource
+			{
+				std::string Directory;
+				std::string Extension;
+			};
+
+			unsigned int AddLayer(MapType type, const LayerSource& source);
+			void LoadLayer(MapType type, unsigned int layer, std::vector<unsigned char>* pixels);
+
+			unsigned int resolution;
+			bool built = false;
+
+			// sources of the layers of each map type, layer 0 is the default
+			std::vector<LayerSource> layerSources[MAP_TYPE_COUNT];
+			std::unordered_map<std::string, unsigned int> layerLookup[MAP_TYPE_COUNT];
+			std::vector<MaterialLayers> materials;
+
+			unsigned int arrays[MAP_TYPE_COUNT] = {};
+			unsigned int materialBuffer = 0;
+		};
+	}
+}
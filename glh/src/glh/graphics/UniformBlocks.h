@@ -0,0 +1,138 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace glh {
+	namespace Graphics {
+
+		// Uniform blocks shared by all programs. Every block has a fixed binding point which Shader
+		// assigns by name after linking, so GLSL 330 shaders only need to declare the blocks they use
+		// with the same name and std140 layout:
+		//
+		// layout (std140) uniform FrameBlock  { float time; float deltaTime; };
+		// layout (std140) uniform ViewBlock   { mat4 projection; mat4 view; vec4 viewPosition; };
+		// layout (std140) uniform LightBlock  { vec4 lightPosition; vec4 lightPositions[4]; vec4 lightColors[4]; int lightCount; };
+		// layout (std140) uniform ObjectBlock { mat4 model; };
+		// layout (std140) uniform ClusterBlock { vec4 clusterScale; uvec4 clusterCounts; };
+		// layout (std140) uniform ShadowBlock { mat4 cascadeMatrices[4]; vec4 cascadeSplits; vec4 shadowLightDirection; vec4 shadowFilter; };
+		// layout (std140) uniform EnvironmentBlock { vec4 irradianceSH[9]; vec4 environmentParameters; };
+		// layout (std140) uniform ProbeBlock { vec4 probeOrigin; vec4 probeInverseSpacing; vec4 probeCounts; };
+		enum UniformBlockBinding
+		{
+			FRAME_BLOCK_BINDING = 0,
+			VIEW_BLOCK_BINDING = 1,
+			LIGHT_BLOCK_BINDING = 2,
+			OBJECT_BLOCK_BINDING = 3,
+			// filled by TexturePool
+			MATERIAL_BLOCK_BINDING = 4,
+			// filled by MaterialTable
+			MATERIAL_PARAMETER_BLOCK_BINDING = 5,
+			// filled by LightGrid
+			CLUSTER_BLOCK_BINDING = 6,
+			// filled by LightBuffer
+			SHADOW_BLOCK_BINDING = 7,
+			// filled by ImageBasedLighting
+			ENVIRONMENT_BLOCK_BINDING = 8,
+			// filled by IrradianceVolume
+			PROBE_BLOCK_BINDING = 9,
+			UNIFORM_BLOCK_BINDING_COUNT
+		};
+
+		static const char* const UNIFORM_BLOCK_NAMES[UNIFORM_BLOCK_BINDING_COUNT] = {
+			"FrameBlock",
+			"ViewBlock",
+			"LightBlock",
+			"ObjectBlock",
+			"MaterialBlock",
+			"MaterialParameterBlock",
+			"ClusterBlock",
+			"ShadowBlock",
+			"EnvironmentBlock",
+			"ProbeBlock"
+		};
+
+		// the C++ side of the blocks, padded by hand to match std140
+		struct FrameBlock
+		{
+			float Time = 0.0f;
+			float DeltaTime = 0.0f;
+			float padding[2];
+		};
+
+		struct ViewBlock
+		{
+			glm::mat4 Projection;
+			glm::mat4 View;
+			// w is unused
+			glm::vec4 ViewPosition;
+		};
+
+		struct LightBlock
+		{
+			static const unsigned int MAX_LIGHTS = 4;
+
+			// the light used by the single light Blinn-Phong shaders, w is unused
+			glm::vec4 LightPosition;
+			glm::vec4 LightPositions[MAX_LIGHTS];
+			glm::vec4 LightColors[MAX_LIGHTS];
+			int LightCount = 0;
+			int padding[3];
+		};
+
+		struct ObjectBlock
+		{
+			glm::mat4 Model;
+		};
+
+		struct ClusterBlock
+		{
+			// x, y: clusters per pixel, z, w: scale and bias that turn log(view depth) into a depth slice
+			glm::vec4 ClusterScale;
+			// clusters along x, y and z, then the light count
+			unsigned int ClusterCounts[4];
+		};
+
+		struct ShadowBlock
+		{
+			static const unsigned int MAX_CASCADES = 4;
+
+			// world to shadow map texture space of each cascade, depth included
+			glm::mat4 CascadeMatrices[MAX_CASCADES];
+			// view depth where each cascade ends
+			glm::vec4 CascadeSplits;
+			// the way the sun's light travels, which the shaders light with too, w is unused
+			glm::vec4 LightDirection;
+			// x: 1 for EVSM, 0 for PCF, y, z: the positive and negative EVSM exponents, w: light bleeding reduction
+			glm::vec4 ShadowFilter;
+		};
+
+		struct EnvironmentBlock
+		{
+			static const unsigned int SH_COEFFICIENTS = 9;
+
+			// diffuse irradiance / pi as spherical harmonics, premultiplied by the basis constants, w is unused
+			glm::vec4 IrradianceSH[SH_COEFFICIENTS];
+			// x: mip level of the roughest prefiltered reflection, yzw are unused
+			glm::vec4 Parameters;
+		};
+
+		struct ProbeBlock
+		{
+			// xyz: position of the first probe, w: 1 once a volume is bound
+			glm::vec4 Origin;
+			// xyz: probes per unit along each axis, w is unused
+			glm::vec4 InverseSpacing;
+			// xyz: probes along each axis, w is unused
+			glm::vec4 Counts;
+		};
+
+		static_assert(sizeof(FrameBlock) == 16, "FrameBlock doesn't match its std140 layout");
+		static_assert(sizeof(ViewBlock) == 144, "ViewBlock doesn't match its std140 layout");
+		static_assert(sizeof(LightBlock) == 160, "LightBlock doesn't match its std140 layout");
+		static_assert(sizeof(ObjectBlock) == 64, "ObjectBlock doesn't match its std140 layout");
+		static_assert(sizeof(ClusterBlock) == 32, "ClusterBlock doesn't match its std140 layout");
+		static_assert(sizeof(ShadowBlock) == 304, "ShadowBlock doesn't match its std140 layout");
+		static_assert(sizeof(EnvironmentBlock) == 160, "EnvironmentBlock doesn't match its std140 layout");
+		static_assert(sizeof(ProbeBlock) == 48, "ProbeBlock doesn't match its std140 layout");
+	}
+}
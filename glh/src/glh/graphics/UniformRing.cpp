@@ -0,0 +1,174 @@
+#include "UniformRing.h"
+
+#include <cstring>
+#include <string>
+
+#include "../util/Log.h"
+#include "GLExtensions.h"
+
+namespace glh {
+	namespace Graphics {
+
+		void UniformRing::Create(unsigned int size)
+		{
+			GLint offsetAlignment = 256;
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+			alignment = (unsigned int)offsetAlignment;
+			frameSize = (size + alignment - 1) / alignment * alignment;
+
+			unsigned int totalSize = frameSize * FRAME_COUNT;
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+
+			persistent = GLExtensions::HasBufferStorage();
+			if (persistent)
+			{
+				GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				GLExtensions::BufferStorage(GL_UNIFORM_BUFFER, totalSize, nullptr, flags);
+				mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, totalSize, flags);
+				if (mapped == nullptr)
+				{
+					Util::Log::WriteError("UNIFORMRING: persistent mapping failed");
+					persistent = false;
+				}
+			}
+
+			if (!persistent)
+			{
+				// buffer storage is immutable, so a failed mapping needs a new buffer
+				if (GLExtensions::HasBufferStorage())
+				{
+					glDeleteBuffers(1, &buffer);
+					glGenBuffers(1, &buffer);
+					glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+				}
+				glBufferData(GL_UNIFORM_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+				staging = new unsigned char[totalSize];
+				mapped = staging;
+			}
+
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			frame = 0;
+			head = 0;
+			flushed = 0;
+			demand = 0;
+		}
+
+		void UniformRing::Destroy()
+		{
+			for (unsigned int i = 0; i < FRAME_COUNT; i++)
+			{
+				if (fences[i] == nullptr)
+					continue;
+
+				GLenum result = glClientWaitSync(fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+				while (result == GL_TIMEOUT_EXPIRED)
+					result = glClientWaitSync(fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				glDeleteSync(fences[i]);
+				fences[i] = nullptr;
+			}
+
+			// deleting the buffer unmaps it
+			glDeleteBuffers(1, &buffer);
+			buffer = 0;
+			delete[] staging;
+			staging = nullptr;
+			mapped = nullptr;
+		}
+
+		void UniformRing::BeginFrame()
+		{
+			if (demand > frameSize)
+			{
+				// half as much again so a slowly growing scene doesn't recreate the ring every frame
+				unsigned int size = demand + demand / 2;
+				Util::Log::WriteWarning("UNIFORMRING: a frame needed " + std::to_string(demand) + " of " +
+					std::to_string(frameSize) + " bytes, growing to " + std::to_string(size));
+				Destroy();
+				Create(size);
+			}
+			demand = 0;
+
+			frame = (frame + 1) % FRAME_COUNT;
+			head = frame * frameSize;
+			flushed = head;
+
+			GLsync fence = fences[frame];
+			if (fence == nullptr)
+				return;
+
+			// normally signalled long ago, this only blocks when the CPU is more than FRAME_COUNT frames ahead
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			while (result == GL_TIMEOUT_EXPIRED)
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			if (result == GL_WAIT_FAILED)
+				Util::Log::WriteError("UNIFORMRING: waiting for the frame fence failed");
+
+			glDeleteSync(fence);
+			fences[frame] = nullptr;
+		}
+
+		void* UniformRing::Allocate(unsigned int size, unsigned int* offset)
+		{
+			// counted even when it doesn't fit, so the next frame knows how much room it needs
+			unsigned int alignedSize = (size + alignment - 1) / alignment * alignment;
+			demand += alignedSize;
+
+			unsigned int end = (frame + 1) * frameSize;
+			if (head + size > end)
+				return nullptr;
+
+			*offset = head;
+			void* data = mapped + head;
+			head += alignedSize;
+			if (head > end)
+				head = end;
+			return data;
+		}
+
+		bool UniformRing::Push(unsigned int binding, const void* data, unsigned int size)
+		{
+			unsigned int offset;
+			void* destination = Allocate(size, &offset);
+			if (destination == nullptr)
+				return false;
+
+			memcpy(destination, data, size);
+			Flush();
+			BindRange(binding, offset, size);
+			return true;
+		}
+
+		void UniformRing::Flush()
+		{
+			if (persistent || head == flushed)
+				return;
+
+			glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, flushed, head - flushed, staging + flushed);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			flushed = head;
+		}
+
+		void UniformRing::EndFrame()
+		{
+			Flush();
+			fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+
+		void UniformRing::BindRange(unsigned int binding, unsigned int offset, unsigned int size)
+		{
+			glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+		}
+
+		unsigned int UniformRing::GetBuffer() const
+		{
+			return buffer;
+		}
+
+		bool UniformRing::IsPersistent() const
+		{
+			return persistent;
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glad/glad.h>
+
+namespace glh {
+	namespace Graphics {
+
+		// Streams uniform block data through one buffer split into a region per frame in flight.
+		// With GL 4.4 / ARB_buffer_storage the buffer is persistently and coherently mapped and written
+		// in place. On plain 3.3 writes go to a CPU copy that Flush() uploads with a single
+		// glBufferSubData. Either way a fence per region keeps the CPU from overwriting data the GPU
+		// is still reading.
+		//
+		// per frame: BeginFrame, Allocate/Push..., Flush before the draws that read it, EndFrame
+		class UniformRing
+		{
+		public:
+			static const unsigned int FRAME_COUNT = 3;
+
+			// frameSize is the most data a single frame can push to begin with
+			void Create(unsigned int frameSize);
+
+			// waits until the GPU is done with the region about to be reused. If the last frame ran out
+			// of space the ring is first recreated with room for it, once the GPU is done with all of it.
+			void BeginFrame();
+			// returns space for size bytes in the current frame's region and its offset in the buffer,
+			// nullptr if the frame is out of space
+			void* Allocate(unsigned int size, unsigned int* offset);
+			// copies the block into the ring and binds it to the binding point
+			bool Push(unsigned int binding, const void* data, unsigned int size);
+			// makes the writes since the last flush visible to GL
+			void Flush();
+			void EndFrame();
+
+			void BindRange(unsigned int binding, unsigned int offset, unsigned int size);
+
+			unsigned int GetBuffer() const;
+			bool IsPersistent() const;
+
+		private:
+			void Destroy();
+
+			unsigned int buffer = 0;
+			unsigned char* mapped = nullptr;
+			unsigned char* staging = nullptr;
+			bool persistent = false;
+
+			unsigned int frameSize = 0;
+			unsigned int alignment = 256;
+			unsigned int frame = 0;
+			unsigned int head = 0;
+			unsigned int flushed = 0;
+			// bytes the current frame asked for, including what didn't fit
+			unsigned int demand = 0;
+			GLsync fences[FRAME_COUNT] = {};
+		};
+	}
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GLResources.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// packed component types for quantized streams, see VertexComponentTraits
+		// N integers read as floats in [0, 1] (unsigned) or [-1, 1] (signed)
+		template <typename T, int N> struct NormalizedVector { T Values[N]; };
+		// N integers read as ivec/uvec by the shader
+		template <typename T, int N> struct IntegerVector { T Values[N]; };
+		// N half floats
+		template <int N> struct HalfVector { unsigned short Values[N]; };
+		// a signed normalized xyz in 10 bits each and a w in 2, read as a vec4
+		struct PackedNormal { unsigned int Bits; };
+
+		// GL format of a vertex attribute stored as T
+		template <typename T> struct VertexComponentTraits;
+		template <> struct VertexComponentTraits<float> { static const GLint COUNT = 1; static const GLenum TYPE = GL_FLOAT; static const bool NORMALIZED = false; static const bool INTEGER = false; };
+		template <> struct VertexComponentTraits<glm::vec2> { static const GLint COUNT = 2; static const GLenum TYPE = GL_FLOAT; static const bool NORMALIZED = false; static const bool INTEGER = false; };
+		template <> struct VertexComponentTraits<glm::vec3> { static const GLint COUNT = 3; static const GLenum TYPE = GL_FLOAT; static const bool NORMALIZED = false; static const bool INTEGER = false; };
+		template <> struct VertexComponentTraits<glm::vec4> { static const GLint COUNT = 4; static const GLenum TYPE = GL_FLOAT; static const bool NORMALIZED = false; static const bool INTEGER = false; };
+		template <> struct VertexComponentTraits<PackedNormal> { static const GLint COUNT = 4; static const GLenum TYPE = GL_INT_2_10_10_10_REV; static const bool NORMALIZED = true; static const bool INTEGER = false; };
+		template <int N> struct VertexComponentTraits<HalfVector<N>> { static const GLint COUNT = N; static const GLenum TYPE = GL_HALF_FLOAT; static const bool NORMALIZED = false; static const bool INTEGER = false; };
+
+		template <typename T> struct VertexIntegerType;
+		template <> struct VertexIntegerType<signed char> { static const GLenum TYPE = GL_BYTE; };
+		template <> struct VertexIntegerType<unsigned char> { static const GLenum TYPE = GL_UNSIGNED_BYTE; };
+		template <> struct VertexIntegerType<short> { static const GLenum TYPE = GL_SHORT; };
+		template <> struct VertexIntegerType<unsigned short> { static const GLenum TYPE = GL_UNSIGNED_SHORT; };
+		template <> struct VertexIntegerType<int> { static const GLenum TYPE = GL_INT; };
+		template <> struct VertexIntegerType<unsigned int> { static const GLenum TYPE = GL_UNSIGNED_INT; };
+
+		template <typename T, int N> struct VertexComponentTraits<NormalizedVector<T, N>> { static const GLint COUNT = N; static const GLenum TYPE = VertexIntegerType<T>::TYPE; static const bool NORMALIZED = true; static const bool INTEGER = false; };
+		template <typename T, int N> struct VertexComponentTraits<IntegerVector<T, N>> { static const GLint COUNT = N; static const GLenum TYPE = VertexIntegerType<T>::TYPE; static const bool NORMALIZED = false; static const bool INTEGER = true; };
+
+		// shader input location reading a T from a vertex buffer binding
+		template <unsigned int Location, typename T, unsigned int Binding = 0>
+		struct VertexAttribute
+		{
+			static_assert(Location < GLResources::MAX_VERTEX_ATTRIBUTES, "vertex attribute location out of range");
+			static_assert(Binding < GLResources::MAX_VERTEX_BINDINGS, "vertex buffer binding out of range");
+			static_assert(VertexComponentTraits<T>::COUNT >= 1 && VertexComponentTraits<T>::COUNT <= 4, "vertex attributes have 1 to 4 components");
+
+			static const unsigned int LOCATION = Location;
+			static const unsigned int BINDING = Binding;
+			static const unsigned int SIZE = sizeof(T);
+			typedef VertexComponentTraits<T> Traits;
+		};
+
+		// Vertex format described by its attributes, in memory order per binding. Attributes of one
+		// binding are tightly packed and interleaved; attributes on different bindings make
+		// deinterleaved streams. Strides and offsets are computed at compile time so a layout can be
+		// checked against the struct that fills its buffer:
+		//
+		// static_assert(Layout::Describes<Vertex>(), "...");
+		// static_assert(Layout::Offset(1) == offsetof(Vertex, Normal), "...");
+		template <typename... Attributes>
+		class VertexLayout
+		{
+		public:
+			static const unsigned int ATTRIBUTE_COUNT = sizeof...(Attributes);
+			static_assert(ATTRIBUTE_COUNT > 0, "a vertex layout needs at least one attribute");
+
+			// bytes between consecutive vertices of a binding
+			static constexpr GLsizei Stride(unsigned int binding)
+			{
+				const unsigned int bindings[] = { Attributes::BINDING... };
+				const unsigned int sizes[] = { Attributes::SIZE... };
+				GLsizei stride = 0;
+				for (unsigned int i = 0; i < ATTRIBUTE_COUNT; i++)
+				{
+					if (bindings[i] == binding)
+						stride += sizes[i];
+				}
+				return stride;
+			}
+
+			// offset of the attribute at location within a vertex of its binding
+			static constexpr GLuint Offset(unsigned int location)
+			{
+				const unsigned int locations[] = { Attributes::LOCATION... };
+				const unsigned int bindings[] = { Attributes::BINDING... };
+				const unsigned int sizes[] = { Attributes::SIZE... };
+				unsigned int binding = 0;
+				for (unsigned int i = 0; i < ATTRIBUTE_COUNT; i++)
+				{
+					if (locations[i] == location)
+						binding = bindings[i];
+				}
+				GLuint offset = 0;
+				for (unsigned int i = 0; i < ATTRIBUTE_COUNT && locations[i] != location; i++)
+				{
+					if (bindings[i] == binding)
+						offset += sizes[i];
+				}
+				return offset;
+			}
+
+			static constexpr bool HasUniqueLocations()
+			{
+				const unsigned int locations[] = { Attributes::LOCATION... };
+				for (unsigned int i = 0; i < ATTRIBUTE_COUNT; i++)
+				{
+					for (unsigned int j = i + 1; j < ATTRIBUTE_COUNT; j++)
+					{
+						if (locations[i] == locations[j])
+							return false;
+					}
+				}
+				return true;
+			}
+
+			// whether every attribute is on binding and exactly fills a Vertex
+			template <typename Vertex>
+			static constexpr bool Describes(unsigned int binding = 0)
+			{
+				return Stride(binding) == (GLsizei)sizeof(Vertex) && UsesOnly(binding);
+			}
+
+			// sets the formats and bindings of every attribute of vao
+			static void Apply(unsigned int vao)
+			{
+				static_assert(HasUniqueLocations(), "two vertex attributes share a location");
+				int expand[] = { (ApplyAttribute<Attributes>(vao), 0)... };
+				(void)expand;
+			}
+
+			// attaches a buffer to one of the layout's bindings with that binding's stride
+			static void SetVertexBuffer(unsigned int vao, unsigned int binding, unsigned int buffer, GLintptr offset = 0)
+			{
+				GLResources::SetVertexBuffer(vao, binding, buffer, offset, Stride(binding));
+			}
+
+		private:
+			static constexpr bool UsesOnly(unsigned int binding)
+			{
+				const unsigned int bindings[] = { Attributes::BINDING... };
+				for (unsigned int i = 0; i < ATTRIBUTE_COUNT; i++)
+				{
+					if (bindings[i] != binding)
+						return false;
+				}
+				return true;
+			}
+
+			template <typename Attribute>
+			static void ApplyAttribute(unsigned int vao)
+			{
+				typedef typename Attribute::Traits Traits;
+				if (Traits::INTEGER)
+					GLResources::SetIntegerAttribute(vao, Attribute::LOCATION, Attribute::BINDING, Traits::COUNT, Traits::TYPE, Offset(Attribute::LOCATION));
+				else
+					GLResources::SetAttribute(vao, Attribute::LOCATION, Attribute::BINDING, Traits::COUNT, Traits::TYPE, Traits::NORMALIZED, Offset(Attribute::LOCATION));
+			}
+		};
+	}
+}
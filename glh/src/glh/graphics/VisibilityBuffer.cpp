@@ -0,0 +1,130 @@
+#include "VisibilityBuffer.h"
+
+#include <glad/glad.h>
+
+#include "../util/Log.h"
+#include "GLResources.h"
+#include "GLState.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// the resolve pass reads vertices from the heap as RG32F texels, see visibilityResolve.fs
+		static const unsigned int VERTEX_TEXELS = 7;
+		static_assert(sizeof(Model::Vertex) == VERTEX_TEXELS * 2 * sizeof(float), "visibilityResolve.fs reads a vertex as 7 RG32F texels");
+
+		VisibilityBuffer::VisibilityBuffer(unsigned int width, unsigned int height) : visibility(width, height)
+		{
+			visibility.AddColourBuffer(GL_R32UI);
+			// only the raster pass itself tests against this depth
+			visibility.AddDepthStencBuffer();
+			visibility.CheckStatus();
+
+			rasterProgram = Shader("Data/Shaders/visibility.vs", "Data/Shaders/visibility.fs");
+
+			resolveProgram = Shader("Data/Shaders/fullscreen.vs", "Data/Shaders/visibilityResolve.fs");
+			resolveProgram.use();
+			resolveProgram.setInt("albedoMaps", TexturePool::ALBEDO_MAP);
+			resolveProgram.setInt("normalMaps", TexturePool::NORMAL_MAP);
+			resolveProgram.setInt("ormMaps", TexturePool::ORM_MAP);
+			resolveProgram.setInt("instanceTransforms", IndirectDrawList::TRANSFORM_TEXTURE_UNIT);
+			resolveProgram.setInt("visibilityBuffer", VISIBILITY_TEXTURE_UNIT);
+			resolveProgram.setInt("vertices", VERTEX_TEXTURE_UNIT);
+			resolveProgram.setInt("indices", INDEX_TEXTURE_UNIT);
+			resolveProgram.setInt("objects", OBJECT_TEXTURE_UNIT);
+			resolveProgram.setVec2("screenSize", (float)width, (float)height);
+
+			glGenTextures(1, &vertexTexture);
+			glGenTextures(1, &indexTexture);
+			emptyVAO = GLResources::CreateVertexArray();
+		}
+
+		void VisibilityBuffer::Rasterize(IndirectDrawList* drawList)
+		{
+			drawList->EnableObjectTable();
+
+			if (!warned)
+			{
+				GeometryHeap* heap = drawList->GetHeap();
+				for (unsigned int mesh = 0; mesh < heap->GetMeshCount(); mesh++)
+				{
+					if (heap->GetMesh(mesh).IndexCount / 3 > MAX_TRIANGLES)
+					{
+						Util::Log::WriteWarning("VISIBILITY: mesh " + std::to_string(mesh) + " has more than " + std::to_string(MAX_TRIANGLES) + " triangles, their IDs will overlap");
+						warned = true;
+					}
+				}
+				if (drawList->GetObjectCount() > MAX_OBJECTS)
+				{
+					Util::Log::WriteWarning("VISIBILITY: more than " + std::to_string(MAX_OBJECTS) + " objects, their IDs will overlap");
+					warned = true;
+				}
+			}
+
+			rasterTimer.Begin();
+			visibility.Bind();
+			const GLuint empty[4] = { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff };
+			glClearBufferuiv(GL_COLOR, 0, empty);
+			glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			drawList->FlushDepth(&rasterProgram);
+			rasterTimer.End();
+		}
+
+		void VisibilityBuffer::Resolve(IndirectDrawList* drawList, TexturePool* pool, Framebuffer* target)
+		{
+			stats.Objects = drawList->GetObjectCount();
+			// the raster pass uploaded the heap, so its buffers are final for this frame
+			AttachHeap(drawList->GetHeap());
+
+			resolveTimer.Begin();
+			target->Bind();
+			GLState::SetDepthFunc(GL_LESS);
+			GLState::SetDepthMask(true);
+			resolveProgram.use();
+			pool->Bind();
+			GLState::BindTexture(IndirectDrawList::TRANSFORM_TEXTURE_UNIT, GL_TEXTURE_BUFFER, drawList->GetTransformTexture());
+			GLState::BindTexture(VISIBILITY_TEXTURE_UNIT, GL_TEXTURE_2D, visibility.GetColourBuffer(0));
+			GLState::BindTexture(VERTEX_TEXTURE_UNIT, GL_TEXTURE_BUFFER, vertexTexture);
+			GLState::BindTexture(INDEX_TEXTURE_UNIT, GL_TEXTURE_BUFFER, indexTexture);
+			GLState::BindTexture(OBJECT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, drawList->GetObjectTexture());
+			GLState::BindVertexArray(emptyVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			resolveTimer.End();
+			drawList->Clear();
+
+			stats.RasterMilliseconds = rasterTimer.GetMilliseconds();
+			stats.ResolveMilliseconds = resolveTimer.GetMilliseconds();
+		}
+
+		void VisibilityBuffer::AttachHeap(GeometryHeap* heap)
+		{
+			if (heap->GetVertexBuffer() != attachedVertexBuffer)
+			{
+				attachedVertexBuffer = heap->GetVertexBuffer();
+				GLState::BindTexture(VERTEX_TEXTURE_UNIT, GL_TEXTURE_BUFFER, vertexTexture);
+				glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, attachedVertexBuffer);
+			}
+			if (heap->GetIndexBuffer() != attachedIndexBuffer)
+			{
+				attachedIndexBuffer = heap->GetIndexBuffer();
+				GLState::BindTexture(INDEX_TEXTURE_UNIT, GL_TEXTURE_BUFFER, indexTexture);
+				glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, attachedIndexBuffer);
+			}
+		}
+
+		Shader* VisibilityBuffer::GetResolveProgram()
+		{
+			return &resolveProgram;
+		}
+
+		Framebuffer* VisibilityBuffer::GetFramebuffer()
+		{
+			return &visibility;
+		}
+
+		const VisibilityBuffer::Stats& VisibilityBuffer::GetStats() const
+		{
+			return stats;
+		}
+	}
+}
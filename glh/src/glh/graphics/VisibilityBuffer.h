@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Framebuffer.h"
+#include "GPUTimer.h"
+#include "IndirectDrawList.h"
+#include "Shader.h"
+#include "TexturePool.h"
+
+namespace glh {
+	namespace Graphics {
+
+		// Visibility buffer rendering (Burns and Hunt, "The Visibility Buffer: A Cache-Friendly
+		// Approach to Deferred Shading"), for dense meshes whose triangles only cover a few pixels.
+		// The raster pass draws positions only and writes one 32 bit ID per pixel. The resolve pass
+		// is a fullscreen triangle: it fetches the pixel's triangle from the GeometryHeap, works out
+		// the barycentrics and their screen derivatives analytically, and then runs the TexturePool
+		// material once. No G-buffer is written, and quads along triangle edges are never shaded twice.
+		// The resolve writes gl_FragDepth, which costs it early depth testing but lets it mix with
+		// the forward and deferred paths in any order.
+		//
+		// ID layout: object index in the IndirectDrawList << TRIANGLE_BITS | triangle index in its
+		// mesh. All ones means nothing was drawn.
+		class VisibilityBuffer
+		{
+		public:
+			static const unsigned int TRIANGLE_BITS = 18;
+			static const unsigned int MAX_TRIANGLES = 1u << TRIANGLE_BITS;
+			static const unsigned int MAX_OBJECTS = (1u << (32 - TRIANGLE_BITS)) - 1;
+
+			// units the resolve pass reads from, after the material arrays and the transforms
+			static const unsigned int VISIBILITY_TEXTURE_UNIT = 7;
+			static const unsigned int VERTEX_TEXTURE_UNIT = 8;
+			static const unsigned int INDEX_TEXTURE_UNIT = 9;
+			static const unsigned int OBJECT_TEXTURE_UNIT = 10;
+
+			struct Stats
+			{
+				unsigned int Objects = 0;
+				double RasterMilliseconds = 0.0;
+				double ResolveMilliseconds = 0.0;
+			};
+
+			VisibilityBuffer(unsigned int width, unsigned int height);
+
+			// writes the IDs and depth of everything submitted to drawList. It has to be the list's
+			// first flush of the frame, because it turns the list's object table on.
+			void Rasterize(IndirectDrawList* drawList);
+			// shades every covered pixel into target with the materials of pool and the forward shaders'
+			// lighting, and clears drawList. Each pixel's depth is rebuilt from its triangle and depth tested, so the
+			// result composites with anything drawn into target before or after.
+			void Resolve(IndirectDrawList* drawList, TexturePool* pool, Framebuffer* target);
+
+			// lights like the forward shaders, set it up with the same lighting resources
+			Shader* GetResolveProgram();
+			Framebuffer* GetFramebuffer();
+			const Stats& GetStats() const;
+
+		private:
+			// points the vertex and index buffer textures at the heap's current buffers
+			void AttachHeap(GeometryHeap* heap);
+
+			Framebuffer visibility;
+			Shader rasterProgram;
+			Shader resolveProgram;
+
+			unsigned int vertexTexture = 0;
+			unsigned int indexTexture = 0;
+			unsigned int attachedVertexBuffer = 0;
+			unsigned int attachedIndexBuffer = 0;
+			unsigned int emptyVAO = 0;
+			bool warned = false;
+
+			GPUTimer rasterTimer;
+			GPUTimer resolveTimer;
+			Stats stats;
+		};
+	}
+}
@@ -0,0 +1,37 @@
+#include "Hash.h"
+
+#include <fstream>
+#include <vector>
+
+namespace glh {
+	namespace Util {
+
+		uint64_t Hash::Bytes(const void* data, size_t size, uint64_t seed)
+		{
+			const uint8_t* bytes = (const uint8_t*)data;
+			uint64_t hash = seed;
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+		bool Hash::File(const std::string& path, uint64_t* hash, uint64_t seed)
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
+				return false;
+
+			std::vector<char> buffer(1 << 16);
+			*hash = seed;
+			while (file)
+			{
+				file.read(buffer.data(), buffer.size());
+				*hash = Bytes(buffer.data(), (size_t)file.gcount(), *hash);
+			}
+			return file.eof();
+		}
+	}
+}
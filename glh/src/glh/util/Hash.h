@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace glh {
+	namespace Util {
+
+		// 64 bit FNV-1a, for telling whether what a disk cache was built from has changed.
+		// Hashes chain by passing the previous result as the seed.
+		class Hash {
+		public:
+			static const uint64_t SEED = 14695981039346656037ull;
+
+			static uint64_t Bytes(const void* data, size_t size, uint64_t seed = SEED);
+			// hashes the file's contents, false if it can't be read
+			static bool File(const std::string& path, uint64_t* hash, uint64_t seed = SEED);
+		};
+
+	}
+}
@@ -0,0 +1,40 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace glh {
+	namespace Util {
+
+		unsigned int Parallel::GetWorkerCount()
+		{
+			unsigned int cores = std::thread::hardware_concurrency();
+			return cores > 0 ? cores : 1;
+		}
+
+		void Parallel::For(unsigned int count, const std::function<void(unsigned int)>& body)
+		{
+			if (count == 0)
+				return;
+
+			std::atomic<unsigned int> next(0);
+			auto worker = [&]() {
+				for (unsigned int i = next++; i < count; i = next++)
+					body(i);
+			};
+
+			std::vector<std::thread> threads;
+			unsigned int workers = std::min(GetWorkerCount(), count);
+			for (unsigned int i = 1; i < workers; i++)
+				threads.emplace_back(worker);
+
+			// the calling thread takes part too
+			worker();
+
+			for (std::thread& thread : threads)
+				thread.join();
+		}
+	}
+}
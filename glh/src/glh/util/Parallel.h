@@ -0,0 +1,19 @@
+#pragma once
+
+#include <functional>
+
+namespace glh {
+	namespace Util {
+
+		class Parallel {
+		public:
+			// number of threads work is spread over, including the calling thread
+			static unsigned int GetWorkerCount();
+
+			// calls body(i) for every i in [0, count) spread over all cores, returns once every call has finished.
+			// Indices are handed out dynamically so uneven work still balances.
+			static void For(unsigned int count, const std::function<void(unsigned int)>& body);
+		};
+
+	}
+}